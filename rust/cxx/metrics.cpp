@@ -104,6 +104,16 @@ void Client::bridge_transfer_c2i(size_t byte_count) {
     (*_impl)->bridge_transfer_c2i(byte_count);
 }
 
+void Client::tls_handshake(bool resumed) {
+    if (!_impl) return;
+    (*_impl)->tls_handshake(resumed);
+}
+
+void Client::fresh_fetch_skipped(size_t body_size) {
+    if (!_impl) return;
+    (*_impl)->fresh_fetch_skipped(body_size);
+}
+
 SetAuxResult Client::set_aux_key_value(std::string_view record_id, std::string_view key, std::string_view value) {
     if (!_impl) return SetAuxResult::Noop;
 
@@ -134,6 +144,11 @@ Bootstrap DhtNode::bootstrap() {
     return Bootstrap{(*_impl)->new_bootstrap()};
 }
 
+Lookup DhtNode::lookup() {
+    if (!_impl) return Lookup{{}};
+    return Lookup{(*_impl)->new_lookup()};
+}
+
 //--------------------------------------------------------------------
 
 void Bootstrap::mark_success() {
@@ -143,6 +158,13 @@ void Bootstrap::mark_success() {
 
 //--------------------------------------------------------------------
 
+void Lookup::mark_success() {
+    if (!_impl) return;
+    (*_impl)->mark_success();
+}
+
+//--------------------------------------------------------------------
+
 void Request::increment_transfer_size(size_t added) {
     if (!_impl) return;
     (*_impl)->increment_transfer_size(added);
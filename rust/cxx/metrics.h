@@ -15,6 +15,7 @@ namespace asio = boost::asio;
 class MainlineDht;
 class DhtNode;
 class Bootstrap;
+class Lookup;
 class Request;
 class EncryptionKey;
 
@@ -57,6 +58,14 @@ public:
     void bridge_transfer_i2c(size_t);
     void bridge_transfer_c2i(size_t);
 
+    // Count a TLS client handshake (with an origin or injector),
+    // which either resumed a previous session or was a full one.
+    void tls_handshake(bool resumed);
+
+    // Count a response served from the local cache
+    // without even trying to fetch it fresh from the injector.
+    void fresh_fetch_skipped(size_t body_size);
+
     // Returns `false` if this is a `noop` client.
     SetAuxResult set_aux_key_value(std::string_view record_id, std::string_view key, std::string_view value);
 
@@ -88,6 +97,9 @@ private:
 class DhtNode {
 public:
     Bootstrap bootstrap();
+    // A lookup of nodes closest to some target (e.g. for `get_peers`),
+    // its duration is recorded once `mark_success` is called.
+    Lookup lookup();
 
 private:
     friend class MainlineDht;
@@ -109,6 +121,18 @@ private:
     OptBox<bridge::Bootstrap> _impl;
 };
 
+class Lookup {
+public:
+    void mark_success();
+
+private:
+    friend class DhtNode;
+
+    Lookup(OptBox<bridge::Lookup> impl) : _impl(std::move(impl)) {}
+
+    OptBox<bridge::Lookup> _impl;
+};
+
 // -- Requests ------------------------------------------------------
 
 class Request {
@@ -3,7 +3,7 @@
 use super::{
     collector::{
         request::{self, RequestId, RequestType},
-        BootstrapId, Collector, IpVersion,
+        BootstrapId, Collector, IpVersion, LookupId,
     },
     crypto::EncryptionKey,
     record_id::RecordId,
@@ -39,6 +39,8 @@ mod ffi {
         fn new_cache_out_request(self: &Client) -> Box<Request>;
         fn bridge_transfer_i2c(self: &Client, byte_count: usize);
         fn bridge_transfer_c2i(self: &Client, byte_count: usize);
+        fn tls_handshake(self: &Client, resumed: bool);
+        fn fresh_fetch_skipped(self: &Client, body_size: usize);
         fn set_aux_key_value(self: &Client, record_id: String, key: String, value: String) -> bool;
 
         // Until the processor is set, no metrics will be stored on the disk nor sent. The (non
@@ -55,10 +57,14 @@ mod ffi {
 
         type DhtNode;
         fn new_bootstrap(self: &DhtNode) -> Box<Bootstrap>;
+        fn new_lookup(self: &DhtNode) -> Box<Lookup>;
 
         type Bootstrap;
         fn mark_success(self: &Bootstrap);
 
+        type Lookup;
+        fn mark_success(self: &Lookup);
+
         //------------------------------------------------------------
         type Request;
         fn mark_success(self: &Request);
@@ -273,6 +279,16 @@ impl Client {
         collector.bridge_transfer_c2i(byte_count);
     }
 
+    fn tls_handshake(&self, resumed: bool) {
+        let mut collector = self.inner.collector.lock().unwrap();
+        collector.tls_handshake(resumed);
+    }
+
+    fn fresh_fetch_skipped(&self, body_size: usize) {
+        let mut collector = self.inner.collector.lock().unwrap();
+        collector.fresh_fetch_skipped(body_size);
+    }
+
     fn set_aux_key_value(&self, record_id: String, key: String, value: String) -> bool {
         let mut collector = self.inner.collector.lock().unwrap();
         if record_id == self.current_record_id() {
@@ -401,6 +417,10 @@ impl DhtNode {
     fn new_bootstrap(&self) -> Box<Bootstrap> {
         Box::new(Bootstrap::new(self.ipv, self.collector.clone()))
     }
+
+    fn new_lookup(&self) -> Box<Lookup> {
+        Box::new(Lookup::new(self.ipv, self.collector.clone()))
+    }
 }
 
 // -------------------------------------------------------------------
@@ -448,6 +468,49 @@ impl Drop for Bootstrap {
 
 // -------------------------------------------------------------------
 
+pub struct Lookup {
+    lookup_id: LookupId,
+    success: Mutex<bool>,
+    collector: Arc<Mutex<Collector>>,
+}
+
+impl Lookup {
+    fn new(ipv: IpVersion, collector: Arc<Mutex<Collector>>) -> Self {
+        let lookup_id = collector.lock().unwrap().lookup_start(ipv);
+
+        Lookup {
+            lookup_id,
+            success: Mutex::new(false),
+            collector,
+        }
+    }
+
+    fn mark_success(&self) {
+        *self.success.lock().unwrap() = true;
+
+        self.collector
+            .lock()
+            .unwrap()
+            .lookup_finish(self.lookup_id, true);
+    }
+}
+
+impl Drop for Lookup {
+    fn drop(&mut self) {
+        if *self.success.lock().unwrap() {
+            // Don't report false if we already reported true.
+            return;
+        }
+
+        self.collector
+            .lock()
+            .unwrap()
+            .lookup_finish(self.lookup_id, false);
+    }
+}
+
+// -------------------------------------------------------------------
+
 struct Request {
     collector: Arc<Mutex<Collector>>,
     request_type: RequestType,
@@ -159,7 +159,7 @@ impl Serialize for BootstrapSerializer<'_> {
 }
 
 #[derive(Debug, Serialize)]
-struct ExponentialHistogram {
+pub(super) struct ExponentialHistogram {
     scale: u32,
     buckets: BTreeMap<usize, u32>,
     // Counter for those values that don't fit into `buckets`
@@ -167,7 +167,7 @@ struct ExponentialHistogram {
 }
 
 impl ExponentialHistogram {
-    fn new(scale: u32, bucket_count: usize, values: impl Iterator<Item = u128>) -> Self {
+    pub(super) fn new(scale: u32, bucket_count: usize, values: impl Iterator<Item = u128>) -> Self {
         let mut buckets = BTreeMap::new();
 
         let mut more = 0;
@@ -0,0 +1,138 @@
+use super::{bootstrap::ExponentialHistogram, IpVersion};
+use serde::{ser::SerializeMap, Serialize, Serializer};
+use std::collections::HashMap;
+use tokio::time::Instant;
+
+#[derive(Clone, Copy, Debug)]
+pub struct LookupId {
+    ipv: IpVersion,
+    id: usize,
+}
+
+// DHT lookups (e.g. for peers of a swarm) of one IP version.
+#[derive(Default)]
+struct Summary {
+    started: HashMap<usize, Instant>,
+    // Durations of successful lookups in milliseconds.
+    success_durations: Vec<u128>,
+    failure_count: u32,
+}
+
+impl Summary {
+    fn clear_finished(&mut self) {
+        self.success_durations.clear();
+        self.failure_count = 0;
+    }
+
+    // Nearest-rank percentile of successful lookup durations.
+    fn percentile(sorted: &[u128], p: usize) -> Option<u128> {
+        if sorted.is_empty() {
+            return None;
+        }
+        let rank = (p * sorted.len()).div_ceil(100).max(1);
+        Some(sorted[rank - 1])
+    }
+}
+
+pub struct Lookups {
+    next_id: usize,
+    v4: Summary,
+    v6: Summary,
+}
+
+impl Lookups {
+    pub fn new() -> Self {
+        Self {
+            next_id: 0,
+            v4: Summary::default(),
+            v6: Summary::default(),
+        }
+    }
+
+    pub fn start(&mut self, ipv: IpVersion) -> LookupId {
+        let id = self.next_id;
+        self.next_id += 1;
+
+        self.summary(ipv).started.insert(id, Instant::now());
+
+        LookupId { ipv, id }
+    }
+
+    pub fn finish(&mut self, id: LookupId, success: bool) {
+        let summary = self.summary(id.ipv);
+
+        let Some(at) = summary.started.remove(&id.id) else {
+            // This could happen when the lookup started and then `on_device_id_changed` was called.
+            return;
+        };
+
+        if success {
+            summary
+                .success_durations
+                .push(Instant::now().duration_since(at).as_millis());
+        } else {
+            summary.failure_count += 1;
+        }
+    }
+
+    pub fn on_record_sequence_number_changed(&mut self) {
+        self.v4.clear_finished();
+        self.v6.clear_finished();
+    }
+
+    pub fn on_device_id_changed(&mut self) {
+        self.v4 = Summary::default();
+        self.v6 = Summary::default();
+    }
+
+    fn summary(&mut self, ipv: IpVersion) -> &mut Summary {
+        match ipv {
+            IpVersion::V4 => &mut self.v4,
+            IpVersion::V6 => &mut self.v6,
+        }
+    }
+}
+
+impl Serialize for Lookups {
+    fn serialize<S: Serializer>(&self, serializer: S) -> Result<S::Ok, S::Error> {
+        let mut map = serializer.serialize_map(Some(2))?;
+        map.serialize_entry("v4", &self.v4)?;
+        map.serialize_entry("v6", &self.v6)?;
+        map.end()
+    }
+}
+
+impl Serialize for Summary {
+    fn serialize<S: Serializer>(&self, serializer: S) -> Result<S::Ok, S::Error> {
+        let mut sorted = self.success_durations.clone();
+        sorted.sort_unstable();
+
+        let mut map = serializer.serialize_map(Some(8))?;
+        map.serialize_entry(
+            "histogram",
+            &ExponentialHistogram::new(100, 10, sorted.iter().copied()),
+        )?;
+        map.serialize_entry("unfinished", &self.started.len())?;
+        map.serialize_entry("failures", &self.failure_count)?;
+        map.serialize_entry("min", &sorted.first())?;
+        map.serialize_entry("max", &sorted.last())?;
+        map.serialize_entry("p50", &Self::percentile(&sorted, 50))?;
+        map.serialize_entry("p90", &Self::percentile(&sorted, 90))?;
+        map.serialize_entry("p99", &Self::percentile(&sorted, 99))?;
+        map.end()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn percentile() {
+        let sorted: Vec<u128> = (1..=10).collect();
+        assert_eq!(Summary::percentile(&sorted, 50), Some(5));
+        assert_eq!(Summary::percentile(&sorted, 90), Some(9));
+        assert_eq!(Summary::percentile(&sorted, 99), Some(10));
+        assert_eq!(Summary::percentile(&[], 50), None);
+    }
+}
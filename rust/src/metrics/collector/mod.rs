@@ -1,5 +1,6 @@
 mod auxiliary;
 mod bootstrap;
+mod lookup;
 pub mod request;
 
 use super::{
@@ -9,6 +10,7 @@ use super::{
 };
 use auxiliary::Auxiliary;
 pub use bootstrap::{BootstrapId, Bootstraps};
+pub use lookup::{LookupId, Lookups};
 use chrono::{Datelike, Timelike};
 pub use request::Requests;
 use serde_json::json;
@@ -24,7 +26,10 @@ pub enum IpVersion {
 pub struct Collector {
     on_modify_tx: Arc<ConstantBackoffWatchSender>,
     bootstraps: Bootstraps,
+    lookups: Lookups,
     bridge: Bridge,
+    tls_handshakes: TlsHandshakes,
+    fresh_fetch_skipped: FreshFetchSkipped,
     pub requests: Requests,
     aux: Auxiliary,
     has_new_data: bool,
@@ -40,7 +45,10 @@ impl Collector {
         Self {
             on_modify_tx: on_modify_tx.clone(),
             bootstraps: Bootstraps::new(),
+            lookups: Lookups::new(),
             bridge: Default::default(),
+            tls_handshakes: Default::default(),
+            fresh_fetch_skipped: Default::default(),
             requests: Requests::new(on_modify_tx),
             aux: Auxiliary::new(),
             has_new_data: false,
@@ -68,6 +76,17 @@ impl Collector {
         self.mark_modified(true)
     }
 
+    pub fn lookup_start(&mut self, ipv: IpVersion) -> LookupId {
+        let id = self.lookups.start(ipv);
+        self.mark_modified(true);
+        id
+    }
+
+    pub fn lookup_finish(&mut self, id: LookupId, success: bool) {
+        self.lookups.finish(id, success);
+        self.mark_modified(true)
+    }
+
     pub fn bridge_transfer_i2c(&mut self, byte_count: usize) {
         self.bridge.transfer_injector_to_client += byte_count as u64;
         self.mark_modified(true);
@@ -78,6 +97,21 @@ impl Collector {
         self.mark_modified(true);
     }
 
+    pub fn tls_handshake(&mut self, resumed: bool) {
+        if resumed {
+            self.tls_handshakes.resumed += 1;
+        } else {
+            self.tls_handshakes.full += 1;
+        }
+        self.mark_modified(true);
+    }
+
+    pub fn fresh_fetch_skipped(&mut self, body_size: usize) {
+        self.fresh_fetch_skipped.responses += 1;
+        self.fresh_fetch_skipped.bytes += body_size as u64;
+        self.mark_modified(true);
+    }
+
     pub fn collect(&mut self, id_interval: WholeWeek, sq_interval: WholeHour) -> Option<String> {
         if !self.has_new_data() {
             return None;
@@ -94,6 +128,15 @@ impl Collector {
             "bridge_i2c": self.bridge.transfer_injector_to_client,
             "bridge_c2i": self.bridge.transfer_injector_to_client,
             "bootstraps": self.bootstraps,
+            "lookups": self.lookups,
+            "tls_handshakes": {
+                "full": self.tls_handshakes.full,
+                "resumed": self.tls_handshakes.resumed,
+            },
+            "fresh_fetch_skipped": {
+                "responses": self.fresh_fetch_skipped.responses,
+                "bytes": self.fresh_fetch_skipped.bytes,
+            },
             "requests": self.requests,
             "aux": self.aux,
         })
@@ -105,8 +148,11 @@ impl Collector {
     // Called when the device_id changes to not leak more data into the next record
     pub fn on_device_id_changed(&mut self) {
         self.bootstraps.on_device_id_changed();
+        self.lookups.on_device_id_changed();
         self.requests.on_device_id_changed();
         self.bridge.on_device_id_changed();
+        self.tls_handshakes = Default::default();
+        self.fresh_fetch_skipped = Default::default();
         self.aux.on_device_id_changed();
         self.mark_modified(false);
     }
@@ -114,8 +160,11 @@ impl Collector {
     // Clear whatever metrics have started and finished, leave the unfinished records.
     pub fn on_record_sequence_number_changed(&mut self) {
         self.bootstraps.on_record_sequence_number_changed();
+        self.lookups.on_record_sequence_number_changed();
         self.requests.on_record_sequence_number_changed();
         self.bridge.on_record_sequence_number_changed();
+        self.tls_handshakes = Default::default();
+        self.fresh_fetch_skipped = Default::default();
         self.aux.on_record_sequence_number_changed();
         self.mark_modified(false);
     }
@@ -159,3 +208,15 @@ impl Bridge {
         self.transfer_client_to_injector = 0;
     }
 }
+
+#[derive(Default)]
+struct TlsHandshakes {
+    full: u64,
+    resumed: u64,
+}
+
+#[derive(Default)]
+struct FreshFetchSkipped {
+    responses: u64,
+    bytes: u64,
+}
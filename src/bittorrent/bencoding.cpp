@@ -42,116 +42,144 @@ std::string bencoding_encode(const BencodedValue& value)
 
 
 
-boost::optional<int64_t> destructive_parse_int(std::string& encoded)
-{
-    boost::string_view sw = encoded;
-    auto opt_num = parse::number<int64_t>(sw);
-    if (!opt_num) return boost::none;
-    encoded.erase(0, encoded.size() - sw.size());
-    return opt_num;
-}
+static bool is_digit(char c) { return '0' <= c && c <= '9'; }
 
-boost::optional<std::string> destructive_parse_string(std::string& encoded)
+// Consume a string (`<length>:<contents>`) from the beginning of `s`.
+static boost::optional<boost::string_view> pop_string(boost::string_view& s)
 {
-    boost::optional<int64_t> size = destructive_parse_int(encoded);
-    if (!size) {
-        return boost::none;
-    }
-    if (encoded[0] != ':') {
-        return boost::none;
+    size_t size = 0, i = 0;
+    for (; i < s.size() && is_digit(s[i]); ++i) {
+        size = size * 10 + (s[i] - '0');
+        if (size > size_t(length_limit)) return boost::none;
     }
-    encoded.erase(0, 1);
-    if (encoded.size() < (size_t)*size) {
-        return boost::none;
-    }
-    if (*size > length_limit) return boost::none;
-    std::string value = encoded.substr(0, *size);
-    encoded.erase(0, *size);
+    if (i == 0 || i == s.size() || s[i] != ':') return boost::none;
+    s.remove_prefix(i + 1);
+    if (s.size() < size) return boost::none;
+    auto value = s.substr(0, size);
+    s.remove_prefix(size);
     return value;
 }
 
-boost::optional<BencodedValue> destructive_parse_value(std::string& encoded, uint8_t depth)
+// Skip the value at the beginning of `s`, which is known to be valid.
+static void skip_valid_value(boost::string_view& s)
+{
+    size_t nested = 0;
+    do {
+        switch (s[0]) {
+            case 'i': s.remove_prefix(s.find('e') + 1); break;
+            case 'l': case 'd': ++nested; s.remove_prefix(1); break;
+            case 'e': --nested; s.remove_prefix(1); break;
+            default: pop_string(s);
+        }
+    } while (nested);
+}
+
+// Validate and skip the value at the beginning of `s`.
+static bool skip_value(boost::string_view& s, uint8_t depth)
 {
-    if (encoded.size() == 0 || depth > depth_limit) {
-        return boost::none;
+    if (s.empty() || depth > depth_limit) {
+        return false;
     }
 
-    if (encoded[0] == 'i') {
-        encoded.erase(0, 1);
-        boost::optional<int64_t> value = destructive_parse_int(encoded);
-        if (!value) {
-            return boost::none;
-        }
-        if (encoded.size() == 0) {
-            return boost::none;
-        }
-        if (encoded[0] != 'e') {
-            return boost::none;
+    switch (s[0]) {
+        case 'i': {
+            s.remove_prefix(1);
+            if (!parse::number<int64_t>(s)) return false;
+            if (s.empty() || s[0] != 'e') return false;
+            s.remove_prefix(1);
+            return true;
         }
-        encoded.erase(0, 1);
-        return BencodedValue(*value);
-    } else if ('0' <= encoded[0] && encoded[0] <= '9') {
-        boost::optional<std::string> value = destructive_parse_string(encoded);
-        if (!value) {
-            return boost::none;
-        }
-        return BencodedValue(std::move(*value));
-    } else if (encoded[0] == 'l') {
-        depth++;
-        encoded.erase(0, 1);
-        BencodedList output;
-        while (encoded.size() > 0 && encoded[0] != 'e') {
-            boost::optional<BencodedValue> value = destructive_parse_value(encoded, depth);
-            if (!value) {
-                return boost::none;
+        case 'l': {
+            s.remove_prefix(1);
+            while (!s.empty() && s[0] != 'e') {
+                if (!skip_value(s, depth + 1)) return false;
             }
-            output.push_back(std::move(*value));
-        }
-        if (encoded.size() == 0) {
-            return boost::none;
+            if (s.empty()) return false;
+            s.remove_prefix(1);
+            return true;
         }
-        assert(encoded[0] == 'e');
-        encoded.erase(0, 1);
-        return BencodedValue(output);
-    } else if (encoded[0] == 'd') {
-        depth++;
-        encoded.erase(0, 1);
-        BencodedMap output;
-        while (encoded.size() > 0 && encoded[0] != 'e') {
-            boost::optional<std::string> key = destructive_parse_string(encoded);
-            if (!key) {
-                return boost::none;
-            }
-            boost::optional<BencodedValue> value = destructive_parse_value(encoded, depth);
-            if (!value) {
-                return boost::none;
+        case 'd': {
+            s.remove_prefix(1);
+            while (!s.empty() && s[0] != 'e') {
+                /* Keys are not checked to be in ascending order
+                 * to allow unsorted dicts coming from bs servers.
+                 */
+                if (!pop_string(s)) return false;
+                if (!skip_value(s, depth + 1)) return false;
             }
-            /* Disabled validation to allow unsorted dicts coming from bs servers:
-             * key/value pairs MUST be in ascending key order.
-             *
-            if (!output.empty()) {
-                if (output.rbegin()->first >= key) {
-                    return boost::none;
-                }
-            }*/
-            output[std::move(*key)] = std::move(*value);
+            if (s.empty()) return false;
+            s.remove_prefix(1);
+            return true;
         }
-        if (encoded.size() == 0) {
-            return boost::none;
-        }
-        assert(encoded[0] == 'e');
-        encoded.erase(0, 1);
-        return BencodedValue(output);
+        default:
+            return pop_string(s).has_value();
+    }
+}
+
+boost::optional<BencodedView> BencodedView::parse(boost::string_view encoded)
+{
+    auto s = encoded;
+    if (!skip_value(s, 1)) return boost::none;
+    return BencodedView(encoded.substr(0, encoded.size() - s.size()));
+}
+
+BencodedView BencodedView::pop_value(boost::string_view& s)
+{
+    auto start = s;
+    skip_valid_value(s);
+    return BencodedView(start.substr(0, start.size() - s.size()));
+}
+
+boost::optional<int64_t> BencodedView::as_int() const
+{
+    if (!is_int()) return boost::none;
+    auto s = _encoded.substr(1);
+    return parse::number<int64_t>(s);
+}
+
+boost::optional<boost::string_view> BencodedView::as_string_view() const
+{
+    if (!is_string()) return boost::none;
+    auto s = _encoded;
+    return pop_string(s);
+}
+
+boost::optional<BencodedView> BencodedView::find(boost::string_view key) const
+{
+    boost::optional<BencodedView> ret;
+    for_each_entry([&] (boost::string_view k, BencodedView v) {
+        if (k == key) ret = v;
+    });
+    return ret;
+}
+
+BencodedValue BencodedView::to_value() const
+{
+    if (is_int()) {
+        return BencodedValue(*as_int());
+    } else if (is_string()) {
+        return BencodedValue(std::string(*as_string_view()));
+    } else if (is_list()) {
+        BencodedList output;
+        for_each_item([&] (BencodedView v) {
+            output.push_back(v.to_value());
+        });
+        return BencodedValue(std::move(output));
     } else {
-        return boost::none;
+        assert(is_map());
+        BencodedMap output;
+        for_each_entry([&] (boost::string_view k, BencodedView v) {
+            output[std::string(k)] = v.to_value();
+        });
+        return BencodedValue(std::move(output));
     }
 }
 
 boost::optional<BencodedValue> bencoding_decode(boost::string_view encoded)
 {
-    // TODO: We shouldn't need to create the string here
-    auto encoded_s = std::string(encoded);
-    return destructive_parse_value(encoded_s, 1);
+    auto view = BencodedView::parse(encoded);
+    if (!view) return boost::none;
+    return view->to_value();
 }
 
 std::ostream& operator<<(std::ostream& os, const BencodedValue& value)
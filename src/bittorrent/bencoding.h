@@ -35,9 +35,12 @@ class BencodedValue : public detail::value {
     BencodedValue() : detail::value("") {}
     BencodedValue(int64_t value): detail::value(value) {}
     BencodedValue(const std::string& value): detail::value(value) {}
+    BencodedValue(std::string&& value): detail::value(std::move(value)) {}
     BencodedValue(const char* value): detail::value(std::string(value)) {}
     BencodedValue(const BencodedList& value): detail::value(value) {}
+    BencodedValue(BencodedList&& value): detail::value(std::move(value)) {}
     BencodedValue(const BencodedMap& value): detail::value(value) {}
+    BencodedValue(BencodedMap&& value): detail::value(std::move(value)) {}
 
     bool is_int() const { return boost::get<int64_t>(this) ? true : false; }
     bool is_string() const { return boost::get<std::string>(this) ? true : false; }
@@ -100,6 +103,81 @@ class BencodedValue : public detail::value {
 constexpr uint8_t depth_limit = 100;
 constexpr int length_limit = 2000000;
 
+/*
+ * A bencoded value referring to the data it was parsed from
+ * (which must outlive the view and its strings).
+ *
+ * Parsing validates the whole value (with the same limits as
+ * `bencoding_decode`) without allocating memory; building a
+ * `BencodedValue` out of it is only needed to keep it around.
+ *
+ * Entries of dictionaries are looked up linearly in encoded order,
+ * which is fine for small dictionaries like those of DHT messages.
+ */
+class BencodedView {
+    public:
+    // Data after the first value in `encoded` is ignored.
+    OUINET_COMMON_API
+    static boost::optional<BencodedView> parse(boost::string_view encoded);
+
+    bool is_int() const { return _encoded[0] == 'i'; }
+    bool is_string() const { return '0' <= _encoded[0] && _encoded[0] <= '9'; }
+    bool is_list() const { return _encoded[0] == 'l'; }
+    bool is_map() const { return _encoded[0] == 'd'; }
+
+    OUINET_COMMON_API
+    boost::optional<int64_t> as_int() const;
+
+    OUINET_COMMON_API
+    boost::optional<boost::string_view> as_string_view() const;
+
+    // The value of the given key if this is a dictionary having it
+    // (the last one if the key is repeated).
+    OUINET_COMMON_API
+    boost::optional<BencodedView> find(boost::string_view key) const;
+
+    // Calls `f(item)` for each item if this is a list.
+    template<class F>
+    void for_each_item(F&& f) const {
+        if (!is_list()) return;
+        auto s = contents();
+        while (s[0] != 'e') f(pop_value(s));
+    }
+
+    // Calls `f(key, value)` for each entry (in encoded order)
+    // if this is a dictionary.
+    template<class F>
+    void for_each_entry(F&& f) const {
+        if (!is_map()) return;
+        auto s = contents();
+        while (s[0] != 'e') {
+            auto key = *pop_value(s).as_string_view();
+            f(key, pop_value(s));
+        }
+    }
+
+    // Copy the whole value.
+    OUINET_COMMON_API
+    BencodedValue to_value() const;
+
+    // The encoded value, as found in the parsed data.
+    boost::string_view encoded() const { return _encoded; }
+
+    private:
+    explicit BencodedView(boost::string_view encoded) : _encoded(encoded) {}
+
+    // The encoded items (or entries) of a list (or dictionary),
+    // followed by the final `e`.
+    boost::string_view contents() const { return _encoded.substr(1); }
+
+    // Consume the (already validated) value at the beginning of `s`.
+    OUINET_COMMON_API
+    static BencodedView pop_value(boost::string_view& s);
+
+    private:
+    boost::string_view _encoded;
+};
+
 OUINET_COMMON_API
 std::string bencoding_encode(const BencodedValue& value);
 
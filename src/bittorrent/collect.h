@@ -130,31 +130,18 @@ void collect(
                 new_candidates.push_back(NodeContact(), asio::error::eof);
             };
 
-            bool is_first_round = first_candidates.count(candidate);
-
-            if (is_first_round) {
-                WatchDog wd(yield.get_executor(), std::chrono::seconds(5), [&] () mutable {
-                    if (dbg) cerr << dbg << "dismiss " << candidate << "\n";
-                    on_finish();
-                });
-
-                WatchDog dummy_wd;
-
-                evaluate( candidate
-                        , dummy_wd
-                        , new_candidates
-                        , yield);
-            } else {
-                WatchDog wd(yield.get_executor(), std::chrono::milliseconds(200), [&] () mutable {
-                    if (dbg) cerr << dbg << "dismiss " << candidate << "\n";
-                    on_finish();
-                });
-
-                evaluate( candidate
-                        , wd
-                        , new_candidates
-                        , yield);
-            }
+            // `evaluate` extends this up to when a reply from the candidate
+            // is expected. Past that the candidate is dismissed, so that its
+            // slot goes to another candidate while its reply is still awaited.
+            WatchDog wd(yield.get_executor(), std::chrono::milliseconds(200), [&] () mutable {
+                if (dbg) cerr << dbg << "dismiss " << candidate << "\n";
+                on_finish();
+            });
+
+            evaluate( candidate
+                    , wd
+                    , new_candidates
+                    , yield);
 
             on_finish();
         });
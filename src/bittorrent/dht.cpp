@@ -1,8 +1,26 @@
 #include "dht.h"
+#include "../util/async.h"
 
 namespace ouinet::bittorrent {
 
 DhtBase::DhtBase() {}
 DhtBase::~DhtBase() {}
 
+std::expected<std::set<NodeID>, sys::error_code>
+DhtBase::tracker_announce_batch(
+    std::vector<NodeID> infohashes,
+    std::optional<int> port,
+    Async yield
+) {
+    std::set<NodeID> announced;
+
+    for (auto& infohash : infohashes) {
+        if (tracker_announce(infohash, port, yield)) {
+            announced.insert(infohash);
+        }
+    }
+
+    return announced;
+}
+
 } // namespace ouinet::bittorrent
@@ -2,7 +2,9 @@
 
 #include <asio_utp/udp_multiplexer.hpp>
 #include <boost/asio/spawn.hpp>
+#include <optional>
 #include <set>
+#include <vector>
 #include "node_id.h"
 #include "namespaces.h"
 #include "../util/promise.h"
@@ -38,6 +40,12 @@ public:
     virtual std::expected<std::set<UdpEndpoint>, sys::error_code>
     tracker_get_peers(NodeID infohash, Async) = 0;
 
+    // Announce several swarms (without retrieving their peers), return the
+    // infohashes of those which were announced.  Implementations may share
+    // work between swarms whose infohashes are close to each other.
+    virtual std::expected<std::set<NodeID>, sys::error_code>
+    tracker_announce_batch(std::vector<NodeID> infohashes, std::optional<int> port, Async);
+
     virtual Executor get_executor() = 0;
 
     virtual bool all_ready() const = 0;
@@ -6,6 +6,7 @@
 #include <boost/filesystem/path.hpp>
 
 #include <chrono>
+#include <optional>
 #include <type_traits>
 #include <vector>
 #include <set>
@@ -117,6 +118,20 @@ class OUINET_COMMON_API DhtNode {
         Async
     );
 
+    /**
+     * Announce yourself on several bittorrent swarms, without retrieving
+     * their peers. Swarms are looked up in order of their infohashes,
+     * starting each lookup from the nodes that replied to the previous ones,
+     * so swarms with close infohashes share most of the lookup work.
+     *
+     * @return The infohashes of the swarms that were announced.
+     */
+    std::expected<std::set<NodeID>, sys::error_code> tracker_announce_batch(
+        std::vector<NodeID> infohashes,
+        std::optional<int> port,
+        Async
+    );
+
     /**
      * Search the DHT for BEP-44 immutable data item with key $key.
      * @return The data stored in the DHT under $key, or nullopt if no such
@@ -310,10 +325,22 @@ class OUINET_COMMON_API DhtNode {
         std::string announce_token;
     };
 
+    // If `known_nodes` is given, those closest to `infohash` are used as
+    // starting points of the search (besides those in the routing table),
+    // and the nodes which reply are added to it.
     std::expected<void, sys::error_code> tracker_do_search_peers(
         NodeID infohash,
         std::set<udp::endpoint>& peers,
         std::map<NodeID, TrackerNode>& responsible_nodes,
+        std::map<NodeID, udp::endpoint>* known_nodes,
+        Async
+    );
+
+    // Returns whether any of the responsible nodes accepted the announcement.
+    bool tracker_do_announce(
+        NodeID infohash,
+        std::optional<int> port,
+        const std::map<NodeID, TrackerNode>& responsible_nodes,
         Async
     );
 
@@ -336,10 +363,58 @@ class OUINET_COMMON_API DhtNode {
         Async
     );
 
+    template<class Evaluate>
+    requires
+        std::invocable<
+            Evaluate,
+            const Contact&,
+            WatchDog&,
+            util::AsyncQueue<NodeContact>&,
+            Async
+        >
+    std::expected<void, sys::error_code>
+    collect(
+        DebugCtx&,
+        const NodeID& target,
+        const std::vector<NodeContact>& extra_seeds,
+        Evaluate&&,
+        Async
+    );
+
     fs::path stored_contacts_path() const;
+    fs::path routing_snapshot_path() const;
 
     void store_contacts() const;
 
+    public:
+    // A routing table saved by a previous run, so that the next one can rejoin
+    // the DHT without a full bootstrap (see `warm_bootstrap`).
+    //
+    // It is saved as a text file like:
+    //
+    //     saved <seconds since the epoch>
+    //     wan <our WAN endpoint>
+    //     id <our node ID>
+    //     <node ID>,<node endpoint>,<seconds since its last reply>,<failed queries>
+    //     ...
+    struct RoutingSnapshot {
+        std::chrono::system_clock::time_point saved;
+        udp::endpoint wan_endpoint;
+        NodeID node_id;
+        std::vector<RoutingTable::StoredNode> nodes;
+
+        std::string serialize() const;
+        static std::expected<RoutingSnapshot, sys::error_code> parse(boost::string_view);
+    };
+
+    private:
+    std::optional<RoutingSnapshot> routing_snapshot() const;
+
+    // Rejoin the DHT with the node ID and routing table of a previous run
+    // if it was recent enough, without a full bootstrap.
+    // Returns false if the saved state could not be used.
+    bool warm_bootstrap(const RoutingSnapshot&, Async);
+
     private:
     AsioExecutor _exec;
     ip::udp::endpoint _local_endpoint;
@@ -1,6 +1,7 @@
 // Temporary, shall be removed once I'm done with this branch
 #define SPEED_DEBUG 0
 
+#include <algorithm>
 #include <chrono>
 #include <cstddef>
 #include <expected>
@@ -15,11 +16,6 @@
 #if SPEED_DEBUG
 #   include <boost/optional/optional_io.hpp>
 #endif
-#include <boost/accumulators/accumulators.hpp>
-#include <boost/accumulators/statistics/stats.hpp>
-#include <boost/accumulators/statistics/rolling_mean.hpp>
-#include <boost/accumulators/statistics/rolling_variance.hpp>
-#include <boost/accumulators/statistics/rolling_count.hpp>
 
 #include "bencoding.h"
 #include "code.h"
@@ -29,12 +25,14 @@
 #include "mainline_dht.h"
 #include "node_contact.h"
 #include "proximity_map.h"
+#include "rtt_estimator.h"
 #include "udp_multiplexer.h"
 
 #include "cxx/dns.h"
 #include "../async_sleep.h"
 #include "../defer.h"
 #include "../parse/endpoint.h"
+#include "../parse/number.h"
 #include "../or_throw.h"
 #include "../util.h"
 #include "../util/address.h"
@@ -48,6 +46,7 @@
 #include "../util/str.h"
 #include "../util/success_condition.h"
 #include "../util/file_io.h"
+#include "../util/lru_cache.h"
 #include "../util/variant.h"
 #include "../logger.h"
 
@@ -60,7 +59,6 @@ using std::string;
 using boost::string_view;
 using std::cerr;
 using Candidates = std::vector<NodeContact>;
-namespace accum = boost::accumulators;
 using Clock = std::chrono::steady_clock;
 namespace fs = boost::filesystem;
 
@@ -70,98 +68,76 @@ namespace fs = boost::filesystem;
 // queries are ignored.
 const int MAX_HANDLE_QUERY_CONCURRENCY = 32;
 
-class Stat {
-private:
-    using AccumSet = accum::accumulator_set< float
-                                           , accum::stats< accum::tag::rolling_mean
-                                                         , accum::tag::rolling_variance
-                                                         , accum::tag::rolling_count>>;
-
+// Estimates reply times per query type and per node.
+//
+// The estimate for a node is used once it replied to some query;
+// otherwise that for the query type is used.
+class DhtNode::Stats {
 public:
-    using Duration = std::chrono::steady_clock::duration;
+    using Duration = RttEstimator::Duration;
 
-public:
-    Stat()
-        : _accum_set(accum::tag::rolling_window::window_size = 10)
-    {}
+    // Estimates of this many nodes are kept (least recently used are dropped).
+    static constexpr size_t max_nodes = 1024;
 
-    void add_reply_time(Duration d)
+public:
+    void add_reply_time( boost::string_view msg_type
+                       , const udp::endpoint& node
+                       , Duration d)
     {
-        using namespace std::chrono;
-        float seconds = duration_cast<milliseconds>(d).count() / 1000.f;
-        _accum_set(seconds);
-    }
-
-    Duration max_reply_wait_time() const {
-        //// 2 Should cover ~97.6% of all responses
-        //// 3 Should cover ~99.9% of all responses
-        auto ov = mean_plus_deviation(3);
-        if (!ov) return default_max_reply_wait_time();
-
-        return std::min(*ov, default_max_reply_wait_time());
-        //return std::min(3**ov/2, default_max_reply_wait_time());
-    }
+        find_or_create(msg_type).add_reply_time(d);
 
-    static
-    Duration default_max_reply_wait_time() {
-        return std::chrono::seconds(3);
+        auto key = encode_endpoint(node);
+        if (auto e = _per_node.get(key)) {
+            e->add_reply_time(d);
+        } else {
+            _per_node.put(key, RttEstimator())->add_reply_time(d);
+        }
     }
 
-    static
-    Duration seconds_to_duration(float secs) {
-        using namespace std::chrono;
-        return milliseconds(int64_t(secs*1000.f));
+    void add_timeout(const udp::endpoint& node)
+    {
+        if (auto e = _per_node.get(encode_endpoint(node))) e->add_timeout();
     }
 
-private:
-    boost::optional<Duration> mean_plus_deviation(float deviation_multiply) const {
-        auto count = accum::rolling_count(_accum_set);
-
-        if (count < 5) return boost::none;
-
-        auto mean     = accum::rolling_mean(_accum_set);
-        auto variance = accum::rolling_variance(_accum_set);
-
-        if (variance < 0) return boost::none;
-
-        auto deviation = sqrt(variance);
-
-        return seconds_to_duration(mean + deviation_multiply*deviation);
+    // See `RttEstimator::expected`.
+    Duration expected_reply_time( boost::string_view msg_type
+                                , const udp::endpoint* node = nullptr)
+    {
+        return estimator(msg_type, node).expected();
     }
 
-private:
-    AccumSet _accum_set;
-};
-
-class DhtNode::Stats {
-public:
-    using Duration = Stat::Duration;
-
-public:
-
-    void add_reply_time(boost::string_view msg_type, Duration d)
+    // See `RttEstimator::timeout`.
+    Duration reply_timeout( boost::string_view msg_type
+                          , const udp::endpoint* node = nullptr)
     {
-        find_or_create(msg_type).add_reply_time(d);
+        return estimator(msg_type, node).timeout();
     }
 
-    Duration max_reply_wait_time(const std::string& msg_type)
+private:
+    const RttEstimator& estimator( boost::string_view msg_type
+                                 , const udp::endpoint* node)
     {
-        return find_or_create(msg_type).max_reply_wait_time();
+        if (node) {
+            auto e = _per_node.get(encode_endpoint(*node));
+            if (e && e->has_samples()) return *e;
+        }
+        return find_or_create(msg_type);
     }
 
-private:
-    Stat& find_or_create(boost::string_view msg_type) {
-        auto i = _per_msg_stat.find(msg_type);
-        if (i == _per_msg_stat.end()) {
-            auto p = _per_msg_stat.insert(std::make_pair( std::string(msg_type)
-                                                        , Stat()));
+    RttEstimator& find_or_create(boost::string_view msg_type) {
+        auto i = _per_msg.find(msg_type);
+        if (i == _per_msg.end()) {
+            auto p = _per_msg.insert(std::make_pair( std::string(msg_type)
+                                                   , RttEstimator()));
             return p.first->second;
         }
         return i->second;
     }
 
 private:
-    std::map<std::string, Stat, std::less<>> _per_msg_stat;
+    std::map<std::string, RttEstimator, std::less<>> _per_msg;
+    // Indexed by compact endpoint (see `encode_endpoint`).
+    util::LruCache<std::string, RttEstimator> _per_node{max_nodes};
 };
 
 static bool read_nodes( bool is_v4
@@ -273,12 +249,17 @@ fs::path DhtNode::stored_contacts_path() const
     return _storage_dir / util::str("stored_peers-", ipv, ".txt");
 }
 
-static
-std::expected<std::set<NodeContact>, sys::error_code>
-read_stored_contacts(const fs::path& path, Async yield)
+fs::path DhtNode::routing_snapshot_path() const
 {
-    std::set<NodeContact> ret;
+    if (_storage_dir == fs::path()) return fs::path();
+    string ipv = _local_endpoint.address().is_v4() ? "ipv4" : "ipv6";
+    return _storage_dir / util::str("routing_table-", ipv, ".txt");
+}
 
+static
+std::expected<std::string, sys::error_code>
+read_file(const fs::path& path, Async yield)
+{
     auto file = util::file_io::open_readonly(yield.get_executor(), path);
     if (!file) {
         return std::unexpected(file.error());
@@ -297,8 +278,43 @@ read_stored_contacts(const fs::path& path, Async yield)
         return std::unexpected(result.error());
     }
 
-    boost::string_view sw = data;
+    return data;
+}
 
+// Atomically replace the file at `path` with `data`.
+static
+std::expected<void, sys::error_code>
+write_file(const fs::path& path, const std::string& data, Async yield)
+{
+    auto result0 = util::file_io::check_or_create_directory(path.parent_path());
+    if (!result0) {
+        return std::unexpected(result0.error());
+    }
+
+    auto atomic_file = util::atomic_file::make(yield.get_executor(), path);
+    if (!atomic_file) {
+        return std::unexpected(atomic_file.error());
+    }
+
+    auto result1 = util::file_io::write(
+            atomic_file->lowest_layer(),
+            asio::buffer(data),
+            yield
+        );
+
+    if (!result1) {
+        return std::unexpected(result1.error());
+    }
+
+    return compat([&](sys::error_code& ec) {
+        atomic_file->commit(ec);
+    })();
+}
+
+// Call `f` with each non-empty line in `sw`.
+template<class F>
+static void for_each_line(boost::string_view sw, F&& f)
+{
     while (!sw.empty()) {
         auto pos = sw.find('\n');
         auto s = sw.substr(0, pos);
@@ -306,9 +322,25 @@ read_stored_contacts(const fs::path& path, Async yield)
         if (pos == sw.npos) sw = sw.substr(sw.size(), 0);
         else                sw = sw.substr(pos + 1);
 
+        if (!s.empty()) f(s);
+    }
+}
+
+static
+std::expected<std::set<NodeContact>, sys::error_code>
+read_stored_contacts(const fs::path& path, Async yield)
+{
+    std::set<NodeContact> ret;
+
+    auto data = read_file(path, yield);
+    if (!data) {
+        return std::unexpected(data.error());
+    }
+
+    for_each_line(*data, [&] (boost::string_view s) {
         auto comma_pos = s.find(',');
 
-        if (comma_pos == s.npos || comma_pos == s.npos - 1) continue;
+        if (comma_pos == s.npos || comma_pos == s.npos - 1) return;
 
         auto id_s = s.substr(0, comma_pos);
         auto ep_s = s.substr(comma_pos+1);
@@ -316,10 +348,10 @@ read_stored_contacts(const fs::path& path, Async yield)
         auto opt_id = NodeID::from_hex(id_s);
         auto opt_ep = parse::endpoint<udp>(ep_s);
 
-        if (!opt_ep || !opt_id) continue;
+        if (!opt_ep || !opt_id) return;
 
         ret.insert({*opt_id, *opt_ep});
-    }
+    });
 
     return ret;
 }
@@ -335,18 +367,6 @@ write_stored_contacts( std::set<NodeContact> contacts
         return std::unexpected(old_contacts.error());
     }
 
-    auto result0 = util::file_io::check_or_create_directory(path.parent_path());
-    if (!result0) {
-        LOG_ERROR(yield, " Failed to store contacts: ", result0.error());
-        return std::unexpected(result0.error());
-    }
-
-    auto atomic_file = util::atomic_file::make(yield.get_executor(), path);
-    if (!atomic_file) {
-        LOG_ERROR(yield, " Failed to store contacts: ", atomic_file.error());
-        return std::unexpected(atomic_file.error());
-    }
-
     string data;
 
     for (unsigned i = 0; i < 500; ++i) {
@@ -368,30 +388,138 @@ write_stored_contacts( std::set<NodeContact> contacts
         data += util::str(c.id, ",", c.endpoint);
     }
 
-    auto result1 = util::file_io::write(
-            atomic_file->lowest_layer(),
-            asio::buffer(data),
-            yield
-        );
+    auto result = write_file(path, data, yield);
+    if (!result) {
+        LOG_ERROR(yield, " Failed to store contacts: ", result.error());
+        return std::unexpected(result.error());
+    }
 
-    if (!result1) {
-        LOG_ERROR(yield, " Failed to store contacts: ", result1.error());
-        return std::unexpected(result1.error());
+    LOG_DEBUG(yield, " Successfully stored contacts");
+
+    return {};
+}
+
+std::expected<DhtNode::RoutingSnapshot, sys::error_code>
+DhtNode::RoutingSnapshot::parse(boost::string_view data)
+{
+    using namespace std::chrono;
+
+    RoutingSnapshot ret;
+    bool has_saved = false, has_wan = false, has_id = false;
+
+    for_each_line(data, [&] (boost::string_view s) {
+        auto space_pos = s.find(' ');
+
+        if (space_pos != s.npos) {
+            auto key = s.substr(0, space_pos);
+            auto value = s.substr(space_pos + 1);
+
+            if (key == "saved") {
+                auto secs = parse::number<int64_t>(value);
+                if (!secs) return;
+                ret.saved = system_clock::time_point(seconds(*secs));
+                has_saved = true;
+            } else if (key == "wan") {
+                auto ep = parse::endpoint<udp>(value);
+                if (!ep) return;
+                ret.wan_endpoint = *ep;
+                has_wan = true;
+            } else if (key == "id") {
+                auto id = NodeID::from_hex(value);
+                if (!id) return;
+                ret.node_id = *id;
+                has_id = true;
+            }
+            return;
+        }
+
+        auto id_s = s.substr(0, s.find(','));
+        s.remove_prefix(std::min(s.size(), id_s.size() + 1));
+        auto ep_s = s.substr(0, s.find(','));
+        s.remove_prefix(std::min(s.size(), ep_s.size() + 1));
+        auto age_s = s.substr(0, s.find(','));
+        s.remove_prefix(std::min(s.size(), age_s.size() + 1));
+
+        auto id = NodeID::from_hex(id_s);
+        auto ep = parse::endpoint<udp>(ep_s);
+        auto age = parse::number<int64_t>(age_s);
+        auto failed = parse::number<int>(s);
+
+        if (!id || !ep || !age || !failed) return;
+
+        ret.nodes.push_back(RoutingTable::StoredNode{
+            .contact        = {*id, *ep},
+            .reply_age      = seconds(*age),
+            .queries_failed = *failed,
+        });
+    });
+
+    if (!has_saved || !has_wan || !has_id) {
+        return std::unexpected(sys::errc::make_error_code(sys::errc::bad_message));
     }
 
-    auto result2 = compat([&](sys::error_code& ec) {
-        atomic_file->commit(ec);
-    })();
-    if (!result2) {
-        LOG_ERROR(yield, " Failed to store contacts: ", result2.error());
-        return std::unexpected(result2.error());
+    return ret;
+}
+
+std::string DhtNode::RoutingSnapshot::serialize() const
+{
+    using namespace std::chrono;
+
+    string data = util::str(
+        "saved ", duration_cast<seconds>(saved.time_since_epoch()).count(), "\n",
+        "wan ", wan_endpoint, "\n",
+        "id ", node_id, "\n");
+
+    for (auto& n : nodes) {
+        data += util::str( n.contact.id, ",", n.contact.endpoint, ","
+                         , duration_cast<seconds>(n.reply_age).count(), ","
+                         , n.queries_failed, "\n");
     }
 
-    LOG_DEBUG(yield, " Successfully stored contacts");
+    return data;
+}
+
+static
+std::expected<DhtNode::RoutingSnapshot, sys::error_code>
+read_routing_snapshot(const fs::path& path, Async yield)
+{
+    auto data = read_file(path, yield);
+    if (!data) {
+        return std::unexpected(data.error());
+    }
+
+    return DhtNode::RoutingSnapshot::parse(*data);
+}
+
+static
+std::expected<void, sys::error_code>
+write_routing_snapshot( const DhtNode::RoutingSnapshot& snapshot
+                      , const fs::path& path
+                      , Async yield)
+{
+    auto result = write_file(path, snapshot.serialize(), yield);
+    if (!result) {
+        LOG_ERROR(yield, " Failed to store routing table: ", result.error());
+        return std::unexpected(result.error());
+    }
+
+    LOG_DEBUG(yield, " Successfully stored routing table");
 
     return {};
 }
 
+std::optional<DhtNode::RoutingSnapshot> DhtNode::routing_snapshot() const
+{
+    if (!_routing_table || !_ready) return std::nullopt;
+
+    return RoutingSnapshot{
+        .saved        = std::chrono::system_clock::now(),
+        .wan_endpoint = _wan_endpoint,
+        .node_id      = _node_id,
+        .nodes        = _routing_table->stored_nodes(),
+    };
+}
+
 void DhtNode::store_contacts() const
 {
     if (!_routing_table) return;
@@ -404,9 +532,14 @@ void DhtNode::store_contacts() const
 
     spawn_detached(_exec, _cancel, _log_path, [
         path = std::move(path),
-        contacts = std::move(contacts)
+        contacts = std::move(contacts),
+        snapshot_path = routing_snapshot_path(),
+        snapshot = routing_snapshot()
     ] (Async yield) mutable {
         std::ignore = write_stored_contacts(std::move(contacts), path, yield);
+        if (snapshot) {
+            std::ignore = write_routing_snapshot(*snapshot, snapshot_path, yield);
+        }
     });
 }
 
@@ -432,7 +565,7 @@ std::expected<std::set<udp::endpoint>, sys::error_code> DhtNode::tracker_get_pee
     std::set<udp::endpoint> peers;
     std::map<NodeID, TrackerNode> responsible_nodes;
 
-    auto result = tracker_do_search_peers(infohash, peers, responsible_nodes, yield);
+    auto result = tracker_do_search_peers(infohash, peers, responsible_nodes, nullptr, yield);
 
     if (!result) {
         return std::unexpected(result.error());
@@ -449,11 +582,57 @@ std::expected<std::set<udp::endpoint>, sys::error_code> DhtNode::tracker_announc
     std::set<udp::endpoint> peers;
     std::map<NodeID, TrackerNode> responsible_nodes;
 
-    auto result = tracker_do_search_peers(infohash, peers, responsible_nodes, yield);
+    auto result = tracker_do_search_peers(infohash, peers, responsible_nodes, nullptr, yield);
     if (!result) {
         return std::unexpected(result.error());
     }
 
+    if (tracker_do_announce(infohash, port, responsible_nodes, yield)) {
+        return std::move(peers);
+    } else {
+        return std::unexpected(boost::asio::error::network_down);
+    }
+}
+
+std::expected<std::set<NodeID>, sys::error_code> DhtNode::tracker_announce_batch(
+    std::vector<NodeID> infohashes,
+    std::optional<int> port,
+    Async yield
+) {
+    // Nodes that replied to the lookups so far. Since infohashes are
+    // announced in order, some of these are already close to the next one,
+    // so its lookup only takes a round or two instead of starting
+    // from the (distant) nodes of the routing table.
+    std::map<NodeID, udp::endpoint> known_nodes;
+    std::set<NodeID> announced;
+
+    std::sort(infohashes.begin(), infohashes.end());
+
+    for (auto& infohash : infohashes) {
+        std::set<udp::endpoint> peers;
+        std::map<NodeID, TrackerNode> responsible_nodes;
+
+        auto result = tracker_do_search_peers(infohash, peers, responsible_nodes, &known_nodes, yield);
+
+        if (!result) {
+            if (announced.empty()) return std::unexpected(result.error());
+            break;
+        }
+
+        if (tracker_do_announce(infohash, port, responsible_nodes, yield)) {
+            announced.insert(infohash);
+        }
+    }
+
+    return announced;
+}
+
+bool DhtNode::tracker_do_announce(
+    NodeID infohash,
+    std::optional<int> port,
+    const std::map<NodeID, TrackerNode>& responsible_nodes,
+    Async yield
+) {
     bool success = false;
     WaitCondition wc(_exec);
     for (auto& i : responsible_nodes) {
@@ -481,11 +660,7 @@ std::expected<std::set<udp::endpoint>, sys::error_code> DhtNode::tracker_announc
     }
     wc.wait(yield);
 
-    if (success) {
-        return std::move(peers);
-    } else {
-        return std::unexpected(boost::asio::error::network_down);
-    }
+    return success;
 }
 
 std::optional<BencodedValue> DhtNode::data_get_immutable(const NodeID& key, Async yield) {
@@ -800,7 +975,7 @@ NodeID DhtNode::data_put_mutable(
                 put_message["salt"] = data.salt;
             }
 
-            wd.expires_after(_stats->max_reply_wait_time("put"));
+            wd.expires_after(_stats->reply_timeout("put", &ep));
 
             sys::error_code ec;
             compat([&](Async yield) {
@@ -942,10 +1117,11 @@ void DhtNode::receive_loop(Async yield)
             break;
         }
 
-        // TODO: The bencode parser should only need a string_view.
-        boost::optional<BencodedValue> decoded_message = bencoding_decode(*packet);
+        // The message is only copied if it is going to be handled,
+        // so that floods of unwanted messages do not cause allocations.
+        auto message = BencodedView::parse(*packet);
 
-        if (!decoded_message) {
+        if (!message) {
 #           if DEBUG_SHOW_MESSAGES
             LOG_DEBUG(yield, " recv: ", sender, " Failed parsing \"", packet, "\"");
 #           endif
@@ -954,20 +1130,21 @@ void DhtNode::receive_loop(Async yield)
         }
 
 #       if DEBUG_SHOW_MESSAGES
-        LOG_DEBUG(yield, " recv: ", sender, " ", *decoded_message);
+        LOG_DEBUG(yield, " recv: ", sender, " ", message->to_value());
 #       endif
 
-        BencodedMap* message_map = decoded_message->as_map();
-        if (!message_map) {
+        if (!message->is_map()) {
             continue;
         }
 
-        if (!message_map->count("y") || !message_map->count("t")) {
+        auto message_type_ = message->find("y");
+        auto transaction_id_ = message->find("t");
+        if (!message_type_ || !transaction_id_) {
             continue;
         }
 
-        boost::optional<string_view> message_type = (*message_map)["y"].as_string_view();
-        boost::optional<string_view> transaction_id = (*message_map)["t"].as_string_view();
+        boost::optional<string_view> message_type = message_type_->as_string_view();
+        boost::optional<string_view> transaction_id = transaction_id_->as_string_view();
         if (!message_type || !transaction_id) {
             continue;
         }
@@ -984,7 +1161,7 @@ void DhtNode::receive_loop(Async yield)
                 [
                     this,
                     sender,
-                    message_map = std::move(*message_map),
+                    message_map = std::move(*message->to_value().as_map()),
                     &handle_query_ok,
                     &concurrency
                 ] (Async yield) mutable {
@@ -1005,7 +1182,7 @@ void DhtNode::receive_loop(Async yield)
         } else if (*message_type == "r" || *message_type == "e") {
             auto it = _active_requests.find(*transaction_id);
             if (it != _active_requests.end() && it->second.destination == sender) {
-                it->second.callback(std::move(*message_map));
+                it->second.callback(std::move(*message->to_value().as_map()));
             }
         }
     }
@@ -1022,6 +1199,10 @@ void DhtNode::store_contacts_loop(Async yield)
 
         std::ignore = write_stored_contacts(std::move(contacts), path, yield);
 
+        if (auto snapshot = routing_snapshot()) {
+            std::ignore = write_routing_snapshot(*snapshot, routing_snapshot_path(), yield);
+        }
+
         async_sleep(std::chrono::minutes(6), yield);
     }
 }
@@ -1108,12 +1289,13 @@ std::expected<BencodedMap, sys::error_code> DhtNode::send_query_await_reply(
 
     auto cancel_con = _cancel.connect([&]() { yield.cancel(); });
 
-    //auto timeout_duration = _stats->max_reply_wait_time(query_type);
-    auto timeout_duration = std::chrono::seconds(10);
+    auto timeout_duration = _stats->reply_timeout(query_type, &dst.endpoint);
 
     if (dms) {
+        // Past the expected reply time, the caller may query other nodes
+        // while we keep waiting for this one.
         auto d1 = dms->time_to_finish();
-        auto d2 = _stats->max_reply_wait_time(query_type);
+        auto d2 = _stats->expected_reply_time(query_type, &dst.endpoint);
 
         dms->expires_after(std::max(d1,d2));
     }
@@ -1164,7 +1346,9 @@ std::expected<BencodedMap, sys::error_code> DhtNode::send_query_await_reply(
     );
 
     if (result) {
-        _stats->add_reply_time(query_type, Clock::now() - start);
+        _stats->add_reply_time(query_type, dst.endpoint, Clock::now() - start);
+    } else if (result.error() == asio::error::timed_out) {
+        _stats->add_timeout(dst.endpoint);
     }
 
     if (dst.id) {
@@ -1714,10 +1898,23 @@ std::expected<void, sys::error_code> DhtNode::bootstrap(Async yield)
 
     auto metrics = _metrics.bootstrap();
 
+    auto snapshot = read_routing_snapshot(routing_snapshot_path(), yield);
+
+    if (snapshot && warm_bootstrap(*snapshot, yield)) {
+        metrics.mark_success();
+        return {};
+    }
+
     auto bootstraps = _bootstrap_config.collect();
     auto old_contacts = read_stored_contacts(stored_contacts_path(), yield)
         .value_or(std::set<NodeContact>{});
 
+    if (snapshot) {
+        for (auto& n : snapshot->nodes) {
+            old_contacts.insert(n.contact);
+        }
+    }
+
     for (auto& c : old_contacts) {
         bootstraps.push_back(c.endpoint);
     }
@@ -1879,6 +2076,102 @@ std::expected<void, sys::error_code> DhtNode::bootstrap(Async yield)
     return {};
 }
 
+bool DhtNode::warm_bootstrap(const RoutingSnapshot& snapshot, Async yield)
+{
+    using namespace std::chrono;
+
+    // Past this, too many of the saved nodes are likely gone (or too much
+    // of the table would be bad anyway, see `RoutingTable::RoutingNode::is_good`).
+    constexpr auto MAX_DOWNTIME = hours(1);
+    // As in a full bootstrap, this many nodes must agree on our WAN address.
+    constexpr size_t SCORE_GOAL = 5;
+    // Saved nodes to ping (in parallel), the most recently heard from first.
+    constexpr size_t MAX_PINGS = 32;
+
+    auto downtime = system_clock::now() - snapshot.saved;
+
+    if (downtime < system_clock::duration(0) || downtime > MAX_DOWNTIME) return false;
+    if (snapshot.nodes.size() < SCORE_GOAL) return false;
+    if (!_peer_filter.is_allowed(snapshot.wan_endpoint)) return false;
+
+    // Our ID goes in the pings, and it is still valid (see BEP42)
+    // as long as our WAN address is the same.
+    _node_id = snapshot.node_id;
+
+    udp::endpoint my_endpoint;
+    std::vector<NodeContact> repliers;
+
+    {
+        Async child_yield(yield);
+        WaitCondition wc(_exec);
+
+        try {
+            auto count = std::min(snapshot.nodes.size(), MAX_PINGS);
+
+            for (size_t i = 0; i < count; ++i) {
+                child_yield.spawn([
+                    &,
+                    lock = wc.lock(),
+                    contact = snapshot.nodes[i].contact
+                ] (Async yield) {
+                    auto result = bootstrap_single(contact.endpoint, yield);
+
+                    if (!result) return;
+                    if (result->my_ep.address() != snapshot.wan_endpoint.address()) return;
+
+                    my_endpoint = result->my_ep;
+                    repliers.push_back(contact);
+
+                    if (repliers.size() >= SCORE_GOAL) {
+                        child_yield.cancel();
+                    }
+                });
+            }
+        } catch (Async::Cancelled& e) {
+            if (yield.is_cancelled()) {
+                throw e;
+            }
+        }
+
+        wc.wait(yield);
+    }
+
+    if (repliers.size() < SCORE_GOAL) {
+        LOG_DEBUG(yield, " Not enough saved nodes replied (", repliers.size()
+                       , "), bootstrapping from scratch");
+        _node_id = NodeID::zero();
+        return false;
+    }
+
+    _wan_endpoint = my_endpoint;
+
+    LOG_INFO(yield, " WAN endpoint: ", _wan_endpoint, " (restored routing table"
+                  , " with ", snapshot.nodes.size(), " nodes)");
+
+    auto send_ping_fn = [&] (const NodeContact& c) { send_ping(c); };
+    _routing_table = std::make_unique<RoutingTable>(_node_id, send_ping_fn);
+    _routing_table->restore(snapshot.nodes, duration_cast<Clock::duration>(downtime));
+
+    for (auto& c : repliers) {
+        _routing_table->try_add_node(c, true);
+        _bootstrap_endpoints.push_back(c.endpoint);
+    }
+
+    _ready = true;
+
+    /*
+     * The restored table is good enough for queries, so refresh the path to
+     * ourselves in the background.
+     */
+    yield.spawn(_cancel, [this] (auto yield) {
+        std::ignore = compat([&](Cancel cancel, asio::yield_context yield) {
+            return find_closest_nodes(_node_id, cancel, yield);
+        })(yield);
+    });
+
+    return true;
+}
+
 
 template<class Evaluate>
 requires std::invocable<
@@ -1894,6 +2187,25 @@ DhtNode::collect(
     const NodeID& target_id,
     Evaluate&& evaluate,
     Async yield
+) {
+    return collect(dbg, target_id, {}, std::forward<Evaluate>(evaluate), yield);
+}
+
+template<class Evaluate>
+requires std::invocable<
+    Evaluate,
+    const Contact&,
+    WatchDog&,
+    util::AsyncQueue<NodeContact>&,
+    Async
+>
+std::expected<void, sys::error_code>
+DhtNode::collect(
+    DebugCtx& dbg,
+    const NodeID& target_id,
+    const std::vector<NodeContact>& extra_seeds,
+    Evaluate&& evaluate,
+    Async yield
 ) {
     auto canceled = _cancel.connect([&] { yield.cancel(); });
 
@@ -1925,6 +2237,11 @@ DhtNode::collect(
     auto table_contacts =
         _routing_table->find_closest_routing_nodes(target_id, RESPONSIBLE_TRACKERS_PER_SWARM);
 
+    for (auto& contact : extra_seeds) {
+        seed_candidates.insert(contact);
+        added_endpoints.insert(contact.endpoint);
+    }
+
     for (auto& contact : table_contacts) {
         seed_candidates.insert(contact);
         added_endpoints.insert(contact.endpoint);
@@ -2300,8 +2617,8 @@ boost::optional<BencodedMap> DhtNode::query_get_data2(
     sys::error_code ec;
 
     assert(!cancel_signal);
-    dms.expires_after( _stats->max_reply_wait_time("get")
-                     + _stats->max_reply_wait_time("find_node"));
+    dms.expires_after( _stats->expected_reply_time("get", &node.endpoint)
+                     + _stats->expected_reply_time("find_node", &node.endpoint));
 
     Cancel local_cancel(cancel_signal);
     WaitCondition wc(_exec);
@@ -2311,7 +2628,7 @@ boost::optional<BencodedMap> DhtNode::query_get_data2(
     // all. If such nodes make up the entire routing table (as is often the
     // case), the lookup might fail entirely. But doing an entire search
     // through nodes without BEP 44 support slows things down quite a lot.
-    WatchDog wd(_exec, _stats->max_reply_wait_time("get"), [&] () mutable {
+    WatchDog wd(_exec, _stats->expected_reply_time("get", &node.endpoint), [&] () mutable {
         if (local_cancel) return;
         task::spawn_detached(_exec, [&, lock = wc.lock()] ( asio::yield_context yield) {
             if (dbg) cerr << dbg << "query_find_node2 start " << node << "\n";
@@ -2379,8 +2696,8 @@ boost::optional<BencodedMap> DhtNode::query_get_data3(
     sys::error_code ec;
 
     assert(!cancel_signal);
-    //dms.expires_after( _stats->max_reply_wait_time("get")
-    //                 + _stats->max_reply_wait_time("find_node"));
+    //dms.expires_after( _stats->expected_reply_time("get", &node.endpoint)
+    //                 + _stats->expected_reply_time("find_node", &node.endpoint));
 
     Cancel local_cancel(cancel_signal);
     //WaitCondition wc(_exec);
@@ -2433,6 +2750,7 @@ std::expected<void, sys::error_code> DhtNode::tracker_do_search_peers(
     NodeID infohash,
     std::set<udp::endpoint>& peers,
     std::map<NodeID, TrackerNode>& responsible_nodes,
+    std::map<NodeID, udp::endpoint>* known_nodes,
     Async yield
 ) {
     struct ResponsibleNode {
@@ -2442,8 +2760,18 @@ std::expected<void, sys::error_code> DhtNode::tracker_do_search_peers(
     };
     ProximityMap<ResponsibleNode> responsible_nodes_full(infohash, RESPONSIBLE_TRACKERS_PER_SWARM);
 
+    std::vector<NodeContact> known_closest;
+
+    if (known_nodes) {
+        ProximityMap<udp::endpoint> closest(infohash, RESPONSIBLE_TRACKERS_PER_SWARM);
+        for (auto& i : *known_nodes) closest.insert(i);
+        for (auto& i : closest) known_closest.push_back({ i.first, i.second });
+    }
+
+    auto metrics = _metrics.lookup();
+
     DebugCtx dbg;
-    auto result = collect(dbg, infohash, [&](
+    auto result = collect(dbg, infohash, known_closest, [&](
         const Contact& candidate,
         WatchDog& wd,
         util::AsyncQueue<NodeContact>& closer_nodes,
@@ -2466,6 +2794,10 @@ std::expected<void, sys::error_code> DhtNode::tracker_do_search_peers(
         );
         if (!response_) return;
 
+        if (known_nodes && candidate.id) {
+            known_nodes->emplace(*candidate.id, candidate.endpoint);
+        }
+
         BencodedMap& response = *response_;
 
         boost::optional<std::string> announce_token = response["token"].as_string();
@@ -2497,6 +2829,10 @@ std::expected<void, sys::error_code> DhtNode::tracker_do_search_peers(
         responsible_nodes[i.first] = { i.second.node_endpoint, i.second.put_token };
     }
 
+    if (result && !responsible_nodes.empty()) {
+        metrics.mark_success();
+    }
+
     return result;
 }
 
@@ -2673,6 +3009,46 @@ MainlineDht::tracker_announce(
     return output;
 }
 
+std::expected<std::set<NodeID>, sys::error_code>
+MainlineDht::tracker_announce_batch(
+    std::vector<NodeID> infohashes,
+    std::optional<int> port,
+    Async yield
+) {
+    auto cc = _cancel.connect([&] { yield.cancel(); });
+
+    std::expected<std::set<NodeID>, sys::error_code> output =
+        std::unexpected(asio::error::network_unreachable);
+
+    WaitCondition wc(yield.get_executor());
+
+    for (auto& i : _nodes) {
+        yield.spawn([
+            &,
+            node = i.second.get(),
+            lock = wc.lock()
+        ] (Async yield) {
+            auto announced = node->tracker_announce_batch(infohashes, port, yield);
+
+            if (announced) {
+                if (output) {
+                    output->insert(announced->begin(), announced->end());
+                } else {
+                    output = std::move(announced);
+                }
+            } else {
+                if (!output) {
+                    output = std::unexpected(announced.error());
+                }
+            }
+        });
+    }
+
+    wc.wait(yield);
+
+    return output;
+}
+
 std::expected<std::set<udp::endpoint>, sys::error_code>
 MainlineDht::tracker_get_peers(NodeID infohash, Async yield)
 {
@@ -80,6 +80,9 @@ class OUINET_COMMON_API MainlineDht : public DhtBase {
     std::expected<std::set<udp::endpoint>, sys::error_code>
     tracker_announce(NodeID infohash, std::optional<int> port, Async) override;
 
+    std::expected<std::set<NodeID>, sys::error_code>
+    tracker_announce_batch(std::vector<NodeID> infohashes, std::optional<int> port, Async) override;
+
     std::expected<std::set<udp::endpoint>, sys::error_code>
     tracker_get_peers(NodeID infohash, Async) override;
 
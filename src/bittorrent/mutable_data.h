@@ -54,7 +54,6 @@ struct OUINET_COMMON_API MutableDataItem {
     boost::optional<MutableDataItem> bdecode(boost::string_view s) {
         using namespace std;
 
-        // TODO: bencoding_decode should accept string_view
         auto ins = bencoding_decode(s);
 
         if (!ins || !ins->is_map()) {  // general format and type of data
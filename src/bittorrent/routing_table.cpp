@@ -2,6 +2,9 @@
 #include "mainline_dht.h"
 #include "proximity_map.h"
 
+#include <algorithm>
+#include <bit>
+#include <map>
 #include <set>
 #include <iostream>
 
@@ -10,11 +13,26 @@ using namespace ouinet;
 using namespace ouinet::bittorrent;
 
 //--------------------------------------------------------------------
+template<class R, class P>
+static void erase_if(R& r, P&& p)
+{
+    r.erase( std::remove_if(std::begin(r), std::end(r), std::forward<P>(p))
+           , std::end(r));
+}
+
+template<class Q>
+static void erase_front_questionables(Q& q, RoutingTable::Clock::time_point now)
+{
+    while (!q.empty() && q[0].is_questionable(now)) {
+        q.pop_front();
+    }
+}
+
 template<class From, class To, class Pred>
 static void move_elements(From& from, To&& to, const Pred& predicate)
 {
     for (size_t i = 0; i < from.size();) {
-        if (predicate(from[i])) {
+        if (predicate(from[i].contact.id)) {
             to.push_back(std::move(from[i]));
             from.erase(from.begin() + i);
         } else {
@@ -23,19 +41,106 @@ static void move_elements(From& from, To&& to, const Pred& predicate)
     }
 }
 
-template<class R, class P>
-static void erase_if(R& r, P&& p)
+// Number of leading bits which are the same in both IDs.
+static size_t common_prefix_bits(const NodeID& a, const NodeID& b)
 {
-    r.erase( std::remove_if(std::begin(r), std::end(r), std::forward<P>(p))
-           , std::end(r));
+    for (size_t i = 0; i < NodeID::size; ++i) {
+        uint8_t x = a.buffer[i] ^ b.buffer[i];
+        if (x) return i * 8 + std::countl_zero(x);
+    }
+    return NodeID::bit_size;
 }
 
-template<class Q>
-static void erase_front_questionables(Q& q)
+// The leading 64 bits of the distance between `a` and `b`,
+// which is enough to compare most distances.
+static uint64_t distance_prefix(const NodeID& a, const NodeID& b)
 {
-    while (!q.empty() && q[0].is_questionable()) {
-        q.pop_front();
+    uint64_t ret = 0;
+    for (size_t i = 0; i < sizeof(ret); ++i) {
+        ret = (ret << 8) | uint8_t(a.buffer[i] ^ b.buffer[i]);
+    }
+    return ret;
+}
+
+//--------------------------------------------------------------------
+RoutingTable::CompactEndpoint
+RoutingTable::CompactEndpoint::from(const asio::ip::udp::endpoint& ep)
+{
+    CompactEndpoint ret{};
+    auto addr = ep.address();
+
+    ret.is_v4 = addr.is_v4();
+    ret.port = ep.port();
+
+    if (ret.is_v4) {
+        auto bytes = addr.to_v4().to_bytes();
+        std::copy(bytes.begin(), bytes.end(), ret.address.begin());
+    } else {
+        auto bytes = addr.to_v6().to_bytes();
+        std::copy(bytes.begin(), bytes.end(), ret.address.begin());
+    }
+
+    return ret;
+}
+
+asio::ip::udp::endpoint RoutingTable::CompactEndpoint::to_endpoint() const
+{
+    using namespace asio::ip;
+
+    if (is_v4) {
+        address_v4::bytes_type bytes;
+        std::copy(address.begin(), address.begin() + bytes.size(), bytes.begin());
+        return udp::endpoint(address_v4(bytes), port);
     }
+
+    return udp::endpoint(address_v6(address), port);
+}
+
+//--------------------------------------------------------------------
+RoutingTable::RoutingNode RoutingTable::NodeList::get(size_t i) const
+{
+    return RoutingNode {
+        .contact        = contact(i),
+        .recv_time      = recv_times[i],
+        .reply_time     = reply_times[i],
+        .queries_failed = queries_failed[i],
+        .ping_ongoing   = ping_ongoing[i],
+    };
+}
+
+std::optional<size_t> RoutingTable::NodeList::find(const NodeContact& c) const
+{
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (ids[i] == c.id && endpoints[i] == CompactEndpoint::from(c.endpoint)) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+void RoutingTable::NodeList::push_back(const RoutingNode& n)
+{
+    insert(size(), n);
+}
+
+void RoutingTable::NodeList::insert(size_t i, const RoutingNode& n)
+{
+    ids.insert(ids.begin() + i, n.contact.id);
+    endpoints.insert(endpoints.begin() + i, CompactEndpoint::from(n.contact.endpoint));
+    recv_times.insert(recv_times.begin() + i, n.recv_time);
+    reply_times.insert(reply_times.begin() + i, n.reply_time);
+    queries_failed.insert(queries_failed.begin() + i, n.queries_failed);
+    ping_ongoing.insert(ping_ongoing.begin() + i, n.ping_ongoing);
+}
+
+void RoutingTable::NodeList::erase(size_t i)
+{
+    ids.erase(ids.begin() + i);
+    endpoints.erase(endpoints.begin() + i);
+    recv_times.erase(recv_times.begin() + i);
+    reply_times.erase(reply_times.begin() + i);
+    queries_failed.erase(queries_failed.begin() + i);
+    ping_ongoing.erase(ping_ongoing.begin() + i);
 }
 
 //--------------------------------------------------------------------
@@ -81,8 +186,8 @@ bool RoutingTable::would_split_bucket( size_t bucket_id
     size_t cnt = 0;
     if (dst <= half_dst) { cnt++; }
 
-    for (auto& n : b.nodes) {
-        if ((n.contact.id ^ _node_id) <= half_dst) {
+    for (auto& id : b.nodes.ids) {
+        if ((id ^ _node_id) <= half_dst) {
             cnt++;
         }
     }
@@ -94,20 +199,9 @@ bool RoutingTable::would_split_bucket( size_t bucket_id
 
 size_t RoutingTable::find_bucket_id(const NodeID& id) const
 {
-    NodeID distance = _node_id ^ id;
-    NodeID max = NodeID::max();
-
-    size_t ret = 0;
-
-    for (size_t i = 0; i < _buckets.size(); ++i) {
-        if (distance > max) {
-            return ret;
-        }
-        max.set_bit(i, false);
-        ret = i;
-    }
-
-    return ret;
+    // Bucket `i` has the nodes whose first bit different from ours is `i`,
+    // but the last one also has all those closer to us.
+    return std::min(common_prefix_bits(_node_id, id), _buckets.size() - 1);
 }
 
 RoutingTable::Bucket* RoutingTable::find_bucket(NodeID id)
@@ -123,13 +217,20 @@ void RoutingTable::split_bucket(size_t i)
 
     auto new_bucket_max_size = max_distance(i+1);
 
-    auto belongs_to_new_bucket = [&] (const RoutingNode& n) {
-        return (n.contact.id ^ _node_id) <= new_bucket_max_size;
+    auto belongs_to_new_bucket = [&] (const NodeID& id) {
+        return (id ^ _node_id) <= new_bucket_max_size;
     };
 
-    move_elements(_buckets[i].nodes
-                 , new_bucket.nodes
-                 , belongs_to_new_bucket);
+    auto& nodes = _buckets[i].nodes;
+
+    for (size_t j = 0; j < nodes.size();) {
+        if (belongs_to_new_bucket(nodes.ids[j])) {
+            new_bucket.nodes.push_back(nodes.get(j));
+            nodes.erase(j);
+        } else {
+            ++j;
+        }
+    }
 
     move_elements(_buckets[i].verified_candidates
                  , new_bucket.verified_candidates
@@ -145,28 +246,73 @@ void RoutingTable::split_bucket(size_t i)
 std::vector<NodeContact>
 RoutingTable::find_closest_routing_nodes(NodeID target, size_t count)
 {
+    struct Candidate {
+        uint64_t distance_prefix;
+        uint32_t bucket;
+        uint32_t index;
+    };
+
     std::vector<NodeContact> output;
 
     if (count == 0) return output;
 
-    size_t bucket_i = find_bucket_id(target);
-    bool done = false;
+    output.reserve(count);
+
+    std::vector<Candidate> candidates;
+
+    auto id = [&] (const Candidate& c) -> const NodeID& {
+        return _buckets[c.bucket].nodes.ids[c.index];
+    };
+
+    // Add the nodes in buckets [first, last) to the output,
+    // or as many of the closest ones as still fit in it.
+    // Returns whether the output is full.
+    auto add_closest = [&] (size_t first, size_t last) {
+        candidates.clear();
+
+        size_t group_size = 0;
+        for (size_t b = first; b < last; ++b) group_size += _buckets[b].nodes.size();
+        candidates.reserve(group_size);
 
-    for (size_t i = bucket_i; i < _buckets.size() && !done; ++i) {
-        for (auto& n : _buckets[i].nodes) {
-            output.push_back(n.contact);
-            if (output.size() >= count) done = true;
-            if (done) break;
+        for (size_t b = first; b < last; ++b) {
+            auto& ids = _buckets[b].nodes.ids;
+            for (size_t i = 0; i < ids.size(); ++i) {
+                candidates.push_back({ distance_prefix(ids[i], target), uint32_t(b), uint32_t(i) });
+            }
         }
-    }
 
-    while (bucket_i && !done) {
-        --bucket_i;
-        for (auto& n : _buckets[bucket_i].nodes) {
-            output.push_back(n.contact);
-            if (output.size() >= count) done = true;
-            if (done) break;
+        auto n = std::min(candidates.size(), count - output.size());
+
+        std::partial_sort( candidates.begin(), candidates.begin() + n, candidates.end()
+                         , [&] (auto& l, auto& r) {
+                               if (l.distance_prefix != r.distance_prefix) {
+                                   return l.distance_prefix < r.distance_prefix;
+                               }
+                               return (id(l) ^ target) < (id(r) ^ target);
+                           });
+
+        for (size_t i = 0; i < n; ++i) {
+            auto& c = candidates[i];
+            output.push_back(_buckets[c.bucket].nodes.contact(c.index));
         }
+
+        return output.size() == count;
+    };
+
+    /*
+     * Nodes in the bucket of the target share more leading bits with it than
+     * any others, then come those in the buckets after it (which only differ
+     * from the target where it differs from us), and then those in each of
+     * the buckets before it. Thus only the group of buckets which does not fit
+     * whole in the output needs to be looked at in full.
+     */
+    size_t bucket_i = find_bucket_id(target);
+
+    if (add_closest(bucket_i, bucket_i + 1)) return output;
+    if (add_closest(bucket_i + 1, _buckets.size())) return output;
+
+    while (bucket_i--) {
+        if (add_closest(bucket_i, bucket_i + 1)) return output;
     }
 
     return output;
@@ -187,22 +333,20 @@ void RoutingTable::try_add_node(NodeContact contact, bool is_verified)
     /*
      * Check whether the contact is already in the routing table. If so, bump it.
      */
-    for (size_t i = 0; i < bucket->nodes.size(); i++) {
-        if (bucket->nodes[i].contact == contact) {
-            RoutingNode node = bucket->nodes[i];
-
-            node.recv_time = now;
+    if (auto i = bucket->nodes.find(contact)) {
+        RoutingNode node = bucket->nodes.get(*i);
 
-            if (is_verified) {
-                node.reply_time     = now;
-                node.queries_failed = 0;
-                node.ping_ongoing   = false;
-            }
+        node.recv_time = now;
 
-            bucket->nodes.erase(bucket->nodes.begin() + i);
-            bucket->nodes.push_back(node);
-            return;
+        if (is_verified) {
+            node.reply_time     = now;
+            node.queries_failed = 0;
+            node.ping_ongoing   = false;
         }
+
+        bucket->nodes.erase(*i);
+        bucket->nodes.push_back(node);
+        return;
     }
 
     erase_if(bucket->verified_candidates,   [&] (auto& c) { return c.contact == contact; });
@@ -254,9 +398,9 @@ void RoutingTable::try_add_node(NodeContact contact, bool is_verified)
      * per above.
      */
     for (size_t i = 0; i < bucket->nodes.size(); i++) {
-        if (!bucket->nodes[i].is_good()) {
+        if (!bucket->nodes.is_good(i, now)) {
             if (is_verified) {
-                bucket->nodes.erase(bucket->nodes.begin() + i);
+                bucket->nodes.erase(i);
 
                 bucket->nodes.push_back(RoutingNode {
                     .contact        = contact,
@@ -278,13 +422,13 @@ void RoutingTable::try_add_node(NodeContact contact, bool is_verified)
      */
     size_t questionable_nodes = 0;
 
-    for (auto& n : bucket->nodes) {
-        if (n.is_questionable()) {
+    for (size_t i = 0; i < bucket->nodes.size(); i++) {
+        if (bucket->nodes.is_questionable(i, now)) {
             questionable_nodes++;
 
-            if (!n.ping_ongoing) {
-                _send_ping(n.contact);
-                n.ping_ongoing = true;
+            if (!bucket->nodes.ping_ongoing[i]) {
+                _send_ping(bucket->nodes.contact(i));
+                bucket->nodes.ping_ongoing[i] = true;
             }
         }
     }
@@ -309,7 +453,7 @@ void RoutingTable::try_add_node(NodeContact contact, bool is_verified)
          * An unverified contact can either replace other unverified contacts,
          * or verified contacts that have become questionable (read: old).
          */
-        erase_front_questionables(bucket->verified_candidates);
+        erase_front_questionables(bucket->verified_candidates, now);
 
         if (bucket->verified_candidates.size() < questionable_nodes) {
             bucket->unverified_candidates.push_back(candidate);
@@ -332,26 +476,24 @@ void RoutingTable::try_add_node(NodeContact contact, bool is_verified)
 void RoutingTable::fail_node(NodeContact contact)
 {
     Bucket* bucket = find_bucket(contact.id);
+    auto& nodes = bucket->nodes;
+
+    auto now = Clock::now();
 
     /*
      * Find the contact in the routing table.
      */
-    size_t node_i = bucket->nodes.size();
+    auto opt_node_i = nodes.find(contact);
 
-    for (size_t i = 0; i < bucket->nodes.size(); i++) {
-        if (bucket->nodes[i].contact == contact) {
-            node_i = i;
-            break;
-        }
-    }
+    if (!opt_node_i) return;
 
-    if (node_i == bucket->nodes.size()) return;
+    size_t node_i = *opt_node_i;
 
-    bucket->nodes[node_i].queries_failed++;
+    nodes.queries_failed[node_i]++;
 
-    if (bucket->nodes[node_i].is_good()) {
-        if (bucket->nodes[node_i].is_questionable()) {
-            bucket->nodes[node_i].ping_ongoing = true;
+    if (nodes.is_good(node_i, now)) {
+        if (nodes.is_questionable(node_i, now)) {
+            nodes.ping_ongoing[node_i] = true;
             _send_ping(contact);
         }
         return;
@@ -360,14 +502,14 @@ void RoutingTable::fail_node(NodeContact contact)
     /*
      * The node is bad. Try to replace it with one of the queued replacements.
      */
-    erase_front_questionables(bucket->verified_candidates);
-    erase_front_questionables(bucket->unverified_candidates);
+    erase_front_questionables(bucket->verified_candidates, now);
+    erase_front_questionables(bucket->unverified_candidates, now);
 
     if (!bucket->verified_candidates.empty()) {
         /*
          * If there is a verified candidate available, use it.
          */
-        bucket->nodes.erase(bucket->nodes.begin() + node_i);
+        nodes.erase(node_i);
 
         auto c = bucket->verified_candidates[0];
         bucket->verified_candidates.pop_front();
@@ -380,9 +522,9 @@ void RoutingTable::fail_node(NodeContact contact)
             .ping_ongoing   = false
         };
 
-        for (size_t i = 0; i < bucket->nodes.size(); i++) {
-            if (bucket->nodes[i].recv_time > node.recv_time) {
-                bucket->nodes.insert(bucket->nodes.begin() + i, node);
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (nodes.recv_times[i] > node.recv_time) {
+                nodes.insert(i, node);
                 break;
             }
         }
@@ -401,8 +543,8 @@ void RoutingTable::fail_node(NodeContact contact)
      */
     size_t questionable_nodes = 0;
 
-    for (auto& n : bucket->nodes) {
-        if (n.is_questionable()) questionable_nodes++;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (nodes.is_questionable(i, now)) questionable_nodes++;
     }
 
     while (bucket->verified_candidates.size() > questionable_nodes) {
@@ -416,13 +558,11 @@ void RoutingTable::fail_node(NodeContact contact)
 
 set<NodeContact> RoutingTable::dump_contacts() const
 {
-    using asio::ip::udp;
-
     set<NodeContact> ret;
 
     for (auto& bucket : _buckets) {
-        for (auto& node : bucket.nodes) {
-            ret.insert(node.contact);
+        for (size_t i = 0; i < bucket.nodes.size(); ++i) {
+            ret.insert(bucket.nodes.contact(i));
         }
         for (auto& node : bucket.verified_candidates) {
             ret.insert(node.contact);
@@ -431,3 +571,80 @@ set<NodeContact> RoutingTable::dump_contacts() const
 
     return ret;
 }
+
+std::vector<RoutingTable::StoredNode> RoutingTable::stored_nodes() const
+{
+    std::vector<StoredNode> ret;
+
+    auto now = Clock::now();
+
+    auto store = [&] (const RoutingNode& n) {
+        ret.push_back(StoredNode{
+            .contact        = n.contact,
+            .reply_age      = now - n.reply_time,
+            .queries_failed = n.queries_failed,
+        });
+    };
+
+    for (auto& bucket : _buckets) {
+        for (size_t i = 0; i < bucket.nodes.size(); ++i) store(bucket.nodes.get(i));
+        for (auto& node : bucket.verified_candidates) store(node);
+    }
+
+    std::sort(ret.begin(), ret.end(), [] (auto& l, auto& r) {
+        return l.reply_age < r.reply_age;
+    });
+
+    return ret;
+}
+
+void RoutingTable::restore(const std::vector<StoredNode>& stored, Clock::duration downtime)
+{
+    // Freshest nodes first, so that they win the space in full buckets.
+    std::vector<const StoredNode*> order;
+    order.reserve(stored.size());
+    for (auto& n : stored) order.push_back(&n);
+
+    std::stable_sort(order.begin(), order.end(), [] (auto l, auto r) {
+        return l->reply_age < r->reply_age;
+    });
+
+    // While adding them all nodes look fresh, thus none are pinged
+    // nor replaced.
+    for (auto n : order) {
+        try_add_node(n->contact, true);
+    }
+
+    std::map<NodeContact, const StoredNode*> by_contact;
+    for (auto n : order) by_contact.emplace(n->contact, n);
+
+    auto now = Clock::now();
+
+    auto find_stored = [&] (const NodeContact& c) -> const StoredNode* {
+        auto i = by_contact.find(c);
+        if (i == by_contact.end()) return nullptr;
+        return i->second;
+    };
+
+    // Buckets may have been split while adding, so only now is it known where
+    // each node ended.
+    for (auto& bucket : _buckets) {
+        auto& nodes = bucket.nodes;
+
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            auto n = find_stored(nodes.contact(i));
+            if (!n) continue;
+            nodes.recv_times[i]     = now - (n->reply_age + downtime);
+            nodes.reply_times[i]    = nodes.recv_times[i];
+            nodes.queries_failed[i] = n->queries_failed;
+        }
+
+        for (auto& node : bucket.verified_candidates) {
+            auto n = find_stored(node.contact);
+            if (!n) continue;
+            node.recv_time      = now - (n->reply_age + downtime);
+            node.reply_time     = node.recv_time;
+            node.queries_failed = n->queries_failed;
+        }
+    }
+}
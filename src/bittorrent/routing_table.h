@@ -2,8 +2,10 @@
 
 #include <boost/asio/ip/udp.hpp>
 
+#include <array>
 #include <chrono>
 #include <deque>
+#include <optional>
 #include <set>
 
 #include "node_contact.h"
@@ -17,10 +19,38 @@ class OUINET_COMMON_API RoutingTable {
 public:
     static constexpr size_t BUCKET_SIZE = 8;
 
-private:
     using Clock = std::chrono::steady_clock;
+
+    // What is kept about a node across restarts.
+    struct StoredNode {
+        NodeContact contact;
+        Clock::duration reply_age; // time since its last reply
+        int queries_failed;
+    };
+
+private:
     using SendPing = std::function<void(const NodeContact&)>;
 
+    static bool is_good( int queries_failed
+                       , Clock::time_point recv_time
+                       , Clock::time_point reply_time
+                       , Clock::time_point now)
+    {
+        using namespace std::chrono_literals;
+
+        return queries_failed <= 2
+            && recv_time  >= now - 15min
+            && reply_time >= now - 2h;
+    }
+
+    // "questionable" is defined in BEP0005
+    // http://www.bittorrent.org/beps/bep_0005.html#routing-table
+    static bool is_questionable(Clock::time_point recv_time, Clock::time_point now)
+    {
+        using namespace std::chrono_literals;
+        return recv_time < now - 15min;
+    }
+
     struct RoutingNode {
         NodeContact contact;
 
@@ -30,21 +60,59 @@ private:
         int queries_failed;
         bool ping_ongoing;
 
-        inline bool is_good() const {
-            using namespace std::chrono_literals;
+        inline bool is_good(Clock::time_point now) const {
+            return RoutingTable::is_good(queries_failed, recv_time, reply_time, now);
+        }
+
+        inline bool is_questionable(Clock::time_point now) const {
+            return RoutingTable::is_questionable(recv_time, now);
+        }
+    };
+
+    // An UDP endpoint in 20 bytes instead of the 28 of `udp::endpoint`.
+    struct CompactEndpoint {
+        std::array<uint8_t, 16> address; // only the first 4 bytes for IPv4
+        uint16_t port;
+        bool is_v4;
+
+        static CompactEndpoint from(const asio::ip::udp::endpoint&);
+        asio::ip::udp::endpoint to_endpoint() const;
 
-            auto now = Clock::now();
+        bool operator==(const CompactEndpoint&) const = default;
+    };
 
-            return queries_failed <= 2
-                && recv_time  >= now - 15min
-                && reply_time >= now - 2h;
+    /*
+     * The nodes in a bucket, as a struct of arrays
+     * so that searching for IDs only goes through IDs.
+     */
+    struct NodeList {
+        std::vector<NodeID> ids;
+        std::vector<CompactEndpoint> endpoints;
+        std::vector<Clock::time_point> recv_times;
+        std::vector<Clock::time_point> reply_times;
+        std::vector<int> queries_failed;
+        std::vector<bool> ping_ongoing;
+
+        size_t size() const { return ids.size(); }
+        bool empty() const { return ids.empty(); }
+
+        NodeContact contact(size_t i) const {
+            return { ids[i], endpoints[i].to_endpoint() };
         }
 
-        // "questionable" is defined in BEP0005
-        // http://www.bittorrent.org/beps/bep_0005.html#routing-table
-        inline bool is_questionable() const {
-            using namespace std::chrono_literals;
-            return recv_time < Clock::now() - 15min;
+        RoutingNode get(size_t i) const;
+        std::optional<size_t> find(const NodeContact&) const;
+
+        void push_back(const RoutingNode&);
+        void insert(size_t i, const RoutingNode&);
+        void erase(size_t i);
+
+        bool is_good(size_t i, Clock::time_point now) const {
+            return RoutingTable::is_good(queries_failed[i], recv_times[i], reply_times[i], now);
+        }
+
+        bool is_questionable(size_t i, Clock::time_point now) const {
+            return RoutingTable::is_questionable(recv_times[i], now);
         }
     };
 
@@ -56,7 +124,7 @@ private:
          * The number of nodes plus the number of candidates always stays below
          * BUCKET_SIZE + questionable_count_in(nodes).
          */
-        std::vector<RoutingNode> nodes;
+        NodeList nodes;
         std::deque<RoutingNode> verified_candidates;
         std::deque<RoutingNode> unverified_candidates;
     };
@@ -65,6 +133,7 @@ public:
     RoutingTable(const NodeID& node_id, SendPing);
     RoutingTable(const RoutingTable&) = delete;
 
+    // The `count` nodes closest to `target` in the XOR metric, closest first.
     std::vector<NodeContact> find_closest_routing_nodes(NodeID target, size_t count);
 
     void fail_node(NodeContact);
@@ -77,6 +146,15 @@ public:
 
     std::set<NodeContact> dump_contacts() const;
 
+    // Nodes (and verified candidates) with their liveness data,
+    // the most recently heard from first.
+    std::vector<StoredNode> stored_nodes() const;
+
+    // Add nodes previously returned by `stored_nodes` without pinging them,
+    // as if `downtime` had passed since then, so that those which have not
+    // replied for long are still questionable (or bad) as they were.
+    void restore(const std::vector<StoredNode>&, Clock::duration downtime);
+
 private:
     RoutingTable::Bucket* find_bucket(NodeID id);
     size_t find_bucket_id(const NodeID&) const;
@@ -90,4 +168,3 @@ private:
 };
 
 } // namespaces
-
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <optional>
+
+namespace ouinet::bittorrent {
+
+// Estimates the time to get a reply to a query from the round trip times
+// observed so far, in the same way as TCP does (RFC 6298):
+// a smoothed round trip time (SRTT) and its mean deviation (RTTVAR).
+//
+// Each timeout doubles the reply timeout (up to `max_timeout`)
+// until the next reply arrives.
+class RttEstimator {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Duration = Clock::duration;
+
+    // Used until the first reply arrives.
+    static constexpr Duration default_expected = std::chrono::seconds(1);
+    static constexpr Duration default_timeout = std::chrono::seconds(3);
+
+    static constexpr Duration min_timeout = std::chrono::milliseconds(250);
+    static constexpr Duration max_timeout = std::chrono::seconds(10);
+
+    // Enough to go from `min_timeout` to `max_timeout`.
+    static constexpr unsigned max_backoff = max_timeout / min_timeout;
+
+    void add_reply_time(Duration rtt)
+    {
+        rtt = std::max(rtt, Duration::zero());
+
+        if (!_srtt) {
+            _srtt = rtt;
+            _rttvar = rtt / 2;
+        } else {
+            auto delta = *_srtt > rtt ? *_srtt - rtt : rtt - *_srtt;
+            _rttvar = (_rttvar * 3 + delta) / 4;
+            *_srtt = (*_srtt * 7 + rtt) / 8;
+        }
+
+        _backoff = 1;
+    }
+
+    void add_timeout()
+    {
+        _backoff = std::min(_backoff * 2, max_backoff);
+    }
+
+    bool has_samples() const { return _srtt.has_value(); }
+
+    // Past this time, a reply is unlikely to be on its way
+    // (though it may still arrive before `timeout`),
+    // so it makes sense to also query someone else.
+    Duration expected() const
+    {
+        if (!_srtt) return default_expected;
+        return std::min(*_srtt + 2 * _rttvar, timeout());
+    }
+
+    // Past this time, a reply is not going to arrive.
+    Duration timeout() const
+    {
+        // Back off from the bounded timeout, so that it also grows
+        // when round trip times are below `min_timeout`.
+        auto t = _srtt ? *_srtt + 4 * _rttvar : default_timeout;
+        t = std::clamp(t, min_timeout, max_timeout);
+        return std::min(t * _backoff, max_timeout);
+    }
+
+private:
+    std::optional<Duration> _srtt;
+    Duration _rttvar = Duration::zero();
+    unsigned _backoff = 1;
+};
+
+} // namespace ouinet::bittorrent
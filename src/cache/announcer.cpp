@@ -1,15 +1,19 @@
 #include <boost/asio/spawn.hpp>
-#include <list>
+#include <boost/asio/steady_timer.hpp>
+#include <algorithm>
+#include <set>
 #include <sstream>
+#include <unordered_map>
+#include <vector>
 #include <iomanip>
 #include <cstdlib>
 #include <ctime>
 #include "announcer.h"
-#include "util/async_queue.h"
 #include "logger.h"
 #include "defer.h"
 #include "../util/compat.h"
 #include "../util/debug.h"
+#include "../util/timer_wheel.h"
 #include "../util/wait_condition.h"
 #include "async_sleep.h"
 #include "bittorrent/node_id.h"
@@ -27,6 +31,7 @@ using namespace ouinet::cache;
 using namespace chrono_literals;
 
 namespace bt = bittorrent;
+using util::AsioExecutor;
 using Clock = chrono::steady_clock;
 
 //--------------------------------------------------------------------
@@ -39,6 +44,12 @@ struct Entry {
     Clock::time_point successful_update;
     Clock::time_point failed_update;
 
+    // Changes every time the entry is scheduled for an update,
+    // so that stale updates in the schedule (e.g. of entries which were
+    // removed and added again) can be told apart.
+    uint64_t generation = 0;
+
+    bool announcing = false;
     bool to_remove = false;
 
     Entry() = default;
@@ -47,105 +58,90 @@ struct Entry {
         : key(std::move(key))
         , infohash(util::sha1_digest(this->key))
     { }
-
-    bool attempted_update() const {
-        return successful_update != Clock::time_point()
-            || failed_update     != Clock::time_point();
-    }
 };
 
 //--------------------------------------------------------------------
 // Base Loop
 struct Announcer::Loop {
-    using Entries = util::AsyncQueue<Entry, std::list>;
+    struct Update {
+        Key key;
+        uint64_t generation;
+    };
+
+    using Entries = std::unordered_map<Key, Entry>;
 
     AsioExecutor ex;
     Entries entries;
+    util::TimerWheel<Update> schedule;
+    uint64_t next_generation = 0;
+    asio::steady_timer _timer;
     size_t _simultaneous_announcements;
     Cancel _cancel;
-    Cancel _timer_cancel;
     util::LogPath _log_path;
 
     static Clock::duration success_reannounce_period() { return 20min; }
     static Clock::duration failure_reannounce_period() { return 5min;  }
 
+    // Up to this many entries are announced by each of the
+    // simultaneous announcement jobs in one go.
+    static constexpr size_t max_entries_per_job = 16;
+
     Loop(AsioExecutor ex, size_t simultaneous_announcements, util::LogPath log_path)
         : ex(ex)
-        , entries(ex)
-        , _simultaneous_announcements(simultaneous_announcements)
+        // One turn of the wheel covers the longest reannounce period.
+        , schedule(1s, 2048)
+        , _timer(ex)
+        , _simultaneous_announcements(std::max<size_t>(simultaneous_announcements, 1))
         , _log_path(std::move(log_path))
     { }
 
     inline static bool debug() { return get_logger().get_threshold() <= DEBUG; }
 
-    Entries::iterator find_entry_by_key(const Key& key) {
-        for (auto i = entries.begin(); i != entries.end(); ++i) {
-            if (i->first.key == key) return i;
-        }
-        return entries.end();
-    }
-
     bool add(Key key) {
-        auto entry_i = find_entry_by_key(key);
-        bool already_has_key = (entry_i != entries.end());
+        auto [i, inserted] = entries.try_emplace(key, key);
 
-        if (already_has_key) {
+        if (!inserted) {
             LOG_DEBUG(_log_path, " Adding ", key, " (already exists)");
-            entry_i->first.to_remove = false;
-        } else {
-            LOG_DEBUG(_log_path, " Adding ", key);
+            i->second.to_remove = false;
+            return false;
         }
 
-        if (already_has_key) return false;
+        LOG_DEBUG(_log_path, " Adding ", key);
 
-        // To preserve the order in which entries are added and updated we put
-        // this new entry _after_ all entries that have not yet been updated.
-        Entries::iterator i = entries.begin();
-
-        for (; i != entries.end(); ++i) {
-            const auto& e = i->first;
-            if (e.attempted_update()) break;
-        }
-
-        entries.insert(i, Entry(std::move(key)));
-        _timer_cancel();
-        _timer_cancel = Cancel();
+        // Right away.
+        schedule_update(i->second, Clock::time_point());
+        _timer.cancel();
         return true;
     }
 
     bool remove(const Key& key) {
-        Entries::iterator i = entries.begin();
-
-        for (; i != entries.end(); ++i)
-            if (i->first.key == key) break;  // found
+        auto i = entries.find(key);
         if (i == entries.end()) return false;  // not found
 
-        LOG_DEBUG(_log_path, " Marking ", key, " for removal");
-        // The actual removal is not done here but in the main loop.
-        i->first.to_remove = true;
-        // No new entries, so no `_timer_cancel` reset.
+        if (i->second.announcing) {
+            LOG_DEBUG(_log_path, " Marking ", key, " for removal");
+            // Removed once the announcement is done.
+            i->second.to_remove = true;
+        } else {
+            LOG_DEBUG(_log_path, " Removing ", key);
+            // Its update in the schedule is just ignored.
+            entries.erase(i);
+        }
+
         return true;
     }
 
-    Clock::duration next_update_after(const Entry& e) const
-    {
-        if (e.successful_update == Clock::time_point()
-             && e.failed_update == Clock::time_point()) {
-            return 0s;
-        }
-
-        auto now = Clock::now();
+    void schedule_update(Entry& e, Clock::time_point at) {
+        e.generation = next_generation++;
+        schedule.schedule(at, {e.key, e.generation});
+    }
 
+    Clock::time_point next_update_at(const Entry& e) const
+    {
         if (e.successful_update >= e.failed_update) {
-            auto p = success_reannounce_period();
-            if (e.successful_update + p <= now) return 0s;
-            return e.successful_update + p - now;
-        }
-        else {
-            auto p = failure_reannounce_period();
-            if (e.failed_update + p < now) return 0s;
-            return e.failed_update + p - now;
+            return e.successful_update + success_reannounce_period();
         }
+        return e.failed_update + failure_reannounce_period();
     }
 
     void print_entries() const {
@@ -175,8 +171,7 @@ struct Announcer::Loop {
         };
 
         LOG_DEBUG(_log_path, " Entries:");
-        for (auto& ep : entries) {
-            auto& e = ep.first;
+        for (auto& [key, e] : entries) {
             ss << " " << e.infohash << " | successful_update=";
             print(e.successful_update);
             ss << " | failed_update=";
@@ -188,35 +183,53 @@ struct Announcer::Loop {
         }
     }
 
-    std::expected<Entries::iterator, sys::error_code> pick_entry(Async yield)
+    // Wait until some entries need to be updated and return up to `max` of
+    // them (the rest are left for the next call).
+    std::vector<Entry*> pick_entries(size_t max, Async yield)
     {
+        std::vector<Update> due;
+        std::vector<Entry*> picked;
+
         while (true) {
-            if (entries.empty()) {
-                LOG_DEBUG(yield, " No entries to update, waiting...");
+            auto now = Clock::now();
+            schedule.expire(now, due);
 
-                auto result = entries.async_wait_for_push(yield);
+            for (auto& u : due) {
+                auto i = entries.find(u.key);
+                if (i == entries.end() || i->second.generation != u.generation) {
+                    continue;  // stale
+                }
+
+                auto& e = i->second;
 
-                if (!result) {
-                    return std::unexpected(result.error());
+                if (picked.size() == max) {
+                    schedule_update(e, Clock::time_point());
+                    continue;
                 }
 
-                continue;
+                e.announcing = true;
+                picked.push_back(&e);
             }
 
-            assert(!entries.empty());
+            due.clear();
 
-            auto i = entries.begin();
+            if (!picked.empty()) return picked;
 
-            auto d = next_update_after(i->first);
+            auto next = schedule.next_expiry();
 
-            LOG_DEBUG( yield, " Found entry to update. It'll be updated in "
-                            , chrono::duration_cast<chrono::seconds>(d).count()
-                            , " seconds: ", i->first.key);
-
-            if (d == 0s) return i;
+            if (next) {
+                LOG_DEBUG( yield, " Next update in "
+                                , chrono::duration_cast<chrono::seconds>(*next - now).count()
+                                , " seconds");
+                _timer.expires_at(*next);
+            } else {
+                LOG_DEBUG(yield, " No entries to update, waiting...");
+                _timer.expires_at(Clock::time_point::max());
+            }
 
-            auto cc = yield.cancel_slot([&] { _timer_cancel(); });
-            async_sleep(d, yield);
+            auto cc = yield.cancel_slot([&] { _timer.cancel(); });
+            // Also interrupted when entries are added.
+            std::ignore = _timer.async_wait(yield);
         }
     }
 
@@ -236,53 +249,74 @@ struct Announcer::Loop {
         WaitCondition wc(ex);
 
         while (true) {
-            for (size_t n = 0; n < _simultaneous_announcements; ++n) {
-                LOG_DEBUG(yield, " Picking entry to update (", (n + 1), "/", _simultaneous_announcements, ")");
-                auto ei = pick_entry(yield);
-                assert(ei);
-
-                if ((**ei).first.to_remove) {
-                    // Marked for removal, drop the entry and get another one.
-                    entries.erase(*ei);
-                    continue;
-                }
+            auto picked = pick_entries(_simultaneous_announcements * max_entries_per_job, yield);
 
-                yield.spawn([this, lock = wc.lock()] (Async yield) {
-                    // Try inserting three times before moving to the next entry
-                    bool success = false;
-
-                    Entry e = std::move(entries.begin()->first);
-                    for (int i = 0; i != 3; ++i) {
-                        auto result = announce(e, yield);
-                        if (result) {
-                            success = true;
-                            break;
-                        }
-
-                        async_sleep(chrono::seconds(1+i), yield);
-                    }
-
-                    if (success) {
-                        e.failed_update     = {};
-                        e.successful_update = Clock::now();
-                    } else  {
-                        e.failed_update     = Clock::now();
-                    }
-
-                    if (!e.to_remove) entries.push_back(std::move(e));
-                    if (debug()) { print_entries(); }
-                });
+            // Entries with close infohashes go to the same job, so that they
+            // can share the lookups of the DHT nodes responsible for them.
+            std::sort(picked.begin(), picked.end(), [] (const Entry* l, const Entry* r) {
+                return l->infohash < r->infohash;
+            });
+
+            auto jobs = std::min(_simultaneous_announcements, picked.size());
 
-                entries.erase(*ei);
+            LOG_DEBUG(yield, " Updating ", picked.size(), " entries in ", jobs, " jobs");
+
+            for (size_t n = 0; n < jobs; ++n) {
+                std::vector<Entry*> job_entries( picked.begin() + picked.size() * n / jobs
+                                               , picked.begin() + picked.size() * (n + 1) / jobs);
+
+                yield.spawn([this, job_entries = std::move(job_entries), lock = wc.lock()] (Async yield) {
+                    update(job_entries, yield);
+                });
             }
 
             std::ignore = wc.wait(yield);
         }
     }
 
-    // Virtual announce method - to be overridden by children
-    virtual std::expected<void, sys::error_code>
-    announce(Entry& e, Async yield) = 0;
+    void update(const std::vector<Entry*>& job_entries, Async yield)
+    {
+        std::set<bt::NodeID> pending;
+
+        for (auto e : job_entries) {
+            LOG_DEBUG(yield, " Updating ", e->key);
+            pending.insert(e->infohash);
+        }
+
+        // Try three times before giving up until the next update.
+        for (int i = 0; i != 3 && !pending.empty(); ++i) {
+            if (i) async_sleep(chrono::seconds(i), yield);
+
+            auto announced = announce(std::vector<bt::NodeID>(pending.begin(), pending.end()), yield);
+            for (auto& infohash : announced) pending.erase(infohash);
+        }
+
+        auto now = Clock::now();
+
+        for (auto e : job_entries) {
+            if (pending.count(e->infohash)) {
+                e->failed_update     = now;
+            } else {
+                e->failed_update     = {};
+                e->successful_update = now;
+            }
+
+            e->announcing = false;
+
+            if (e->to_remove) {
+                entries.erase(entries.find(e->key));
+            } else {
+                schedule_update(*e, next_update_at(*e));
+            }
+        }
+
+        if (debug()) { print_entries(); }
+    }
+
+    // Virtual announce method - to be overridden by children.
+    // Returns the infohashes which were announced.
+    virtual std::set<bt::NodeID>
+    announce(std::vector<bt::NodeID> infohashes, Async yield) = 0;
 
     virtual ~Loop() { _cancel(); }
 };
@@ -312,20 +346,25 @@ struct Bep5Loop : public Announcer::Loop {
         });
     }
 
-    std::expected<void, sys::error_code> announce(Entry& e, Async yield) override
+    std::set<bt::NodeID>
+    announce(std::vector<bt::NodeID> infohashes, Async yield) override
     {
-        LOG_DEBUG(_log_path, " Announcing (BEP5/DHT): ", e.key, "...");
+        auto count = infohashes.size();
 
-        auto endpoints = dht->tracker_announce(e.infohash, std::nullopt, yield);
+        LOG_DEBUG(_log_path, " Announcing (BEP5/DHT) ", count, " swarms...");
 
-        LOG_DEBUG(_log_path, " Announcing (BEP5/DHT): ", e.key
-                           , ": done; result=", ouinet::debug(endpoints));
+        auto announced = dht->tracker_announce_batch(std::move(infohashes), std::nullopt, yield);
 
-        if (!endpoints) {
-            return std::unexpected(endpoints.error());
+        if (!announced) {
+            LOG_DEBUG(_log_path, " Announcing (BEP5/DHT) ", count
+                               , " swarms: failed; ec=", announced.error());
+            return {};
         }
 
-        return {};
+        LOG_DEBUG(_log_path, " Announcing (BEP5/DHT) ", count
+                           , " swarms: done; announced=", announced->size());
+
+        return std::move(*announced);
     }
 };
 
@@ -0,0 +1,282 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <optional>
+#include <vector>
+
+namespace ouinet::cache {
+
+// Decides which blocks of a response to request from which peers,
+// so that several of them can be fetched at the same time.
+//
+// Only blocks in a window of `window` blocks are fetched,
+// starting with the first one not delivered yet
+// (blocks are delivered in order, see `delivered`).
+// This bounds the number of blocks which are either being fetched
+// or waiting for an earlier block before being delivered.
+//
+// Whenever a peer is idle (i.e. it has less requests in flight than it accepts),
+// it is assigned the first pending block in the window which it has, the fastest peers being assigned blocks first
+// (according to the time they took to send previous blocks).
+//
+// If there are no pending blocks for an idle peer,
+// it is also assigned a block already being fetched from other peers (endgame)
+// when the block has been in flight for much longer than expected (stalled),
+// or when the idle peer is expected to send it sooner
+// (e.g. because the block was assigned to a slow peer).
+//
+// This does no I/O: the caller sends requests to peers as assigned,
+// reports back their results, and keeps received blocks until delivered.
+template<class Peer>
+class BlockScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Whether the peer has the given block (with the expected data).
+    using HasBlock = std::function<bool(std::size_t block_id)>;
+
+    struct Assignment {
+        Peer* peer;
+        std::size_t block_id;
+    };
+
+    // Assumed time for a block from a peer which did not send any yet.
+    static constexpr Clock::duration default_block_time = std::chrono::seconds(1);
+    // A block is stalled when it takes this many times longer than expected.
+    static constexpr unsigned stall_factor = 3;
+    // Maximum number of peers from which the same block is requested.
+    static constexpr std::size_t max_requests_per_block = 2;
+
+    // Schedule blocks `first_block` to `block_count - 1`.
+    BlockScheduler( std::size_t first_block
+                  , std::size_t block_count
+                  , std::size_t window)
+        : _block_count(block_count)
+        , _window(std::max<std::size_t>(window, 1))
+        , _window_start(first_block)
+        , _blocks(block_count)
+    {}
+
+    BlockScheduler(const BlockScheduler&) = delete;
+    BlockScheduler& operator=(const BlockScheduler&) = delete;
+
+    // The peer gets up to `max_requests` requests in flight at the same time.
+    void add_peer(Peer* peer, HasBlock has_block, std::size_t max_requests = 1)
+    {
+        auto& ps = _peers[peer];
+        ps.has_block = std::move(has_block);
+        ps.max_requests = std::max<std::size_t>(max_requests, 1);
+    }
+
+    // Forget about the peer, its requests in flight are dropped
+    // (so their blocks may be assigned to other peers).
+    void remove_peer(Peer* peer)
+    {
+        auto pi = _peers.find(peer);
+        if (pi == _peers.end()) return;
+        for (auto block_id : pi->second.requests) {
+            drop_request(_blocks[block_id], peer);
+        }
+        _peers.erase(pi);
+    }
+
+    bool has_peer(Peer* peer) const
+    {
+        return _peers.count(peer) != 0;
+    }
+
+    bool has_peers() const
+    {
+        return !_peers.empty();
+    }
+
+    // Whether some known peer has the given block.
+    bool is_available(std::size_t block_id) const
+    {
+        for (auto& [_, ps] : _peers) {
+            if (ps.has_block(block_id)) return true;
+        }
+        return false;
+    }
+
+    // Assign blocks to idle peers.
+    // The returned requests are considered in flight from now on.
+    std::vector<Assignment> schedule(Clock::time_point now)
+    {
+        std::vector<Assignment> ret;
+
+        std::vector<Peer*> idle;
+        for (auto& [peer, ps] : _peers) {
+            if (ps.requests.size() < ps.max_requests) idle.push_back(peer);
+        }
+
+        std::stable_sort(idle.begin(), idle.end(), [&] (Peer* p1, Peer* p2) {
+            return expected_time(_peers[p1]) < expected_time(_peers[p2]);
+        });
+
+        // Fill one request per idle peer at a time,
+        // so that the fastest peer does not take all blocks by itself.
+        for (bool assigned = true; assigned;) {
+            assigned = false;
+            for (auto peer : idle) {
+                auto& ps = _peers[peer];
+                if (ps.requests.size() >= ps.max_requests) continue;
+
+                auto block_id = pick(peer, ps, now);
+                if (!block_id) continue;
+
+                _blocks[*block_id].requests.push_back({peer, now});
+                ps.requests.push_back(*block_id);
+                ret.push_back({peer, *block_id});
+                assigned = true;
+            }
+        }
+
+        return ret;
+    }
+
+    // The given block was received from the peer.
+    // Returns false if the block had already been received from another peer.
+    bool received(Peer* peer, std::size_t block_id, Clock::time_point now)
+    {
+        assert(block_id < _block_count);
+        auto& bs = _blocks[block_id];
+
+        auto pi = _peers.find(peer);
+        if (pi != _peers.end()) {
+            auto& ps = pi->second;
+            if (auto started = drop_request(bs, peer)) {
+                // With several requests in flight, the peer only starts sending
+                // this block after sending the previous one.
+                auto from = std::max(*started, ps.last_received.value_or(*started));
+                auto took = now - from;
+                ps.block_time = ps.block_time ? (*ps.block_time * 3 + took) / 4 : took;
+            }
+            ps.last_received = now;
+            std::erase(ps.requests, block_id);
+        }
+
+        if (bs.received) return false;
+        bs.received = true;
+        return true;
+    }
+
+    // The given block could not be received from the peer,
+    // so it may be assigned to another one.
+    void failed(Peer* peer, std::size_t block_id)
+    {
+        assert(block_id < _block_count);
+        drop_request(_blocks[block_id], peer);
+
+        auto pi = _peers.find(peer);
+        if (pi != _peers.end()) std::erase(pi->second.requests, block_id);
+    }
+
+    // The first block in the window has been delivered,
+    // so the window moves on to the next one.
+    void delivered(std::size_t block_id)
+    {
+        assert(block_id == _window_start);
+        assert(_blocks[block_id].received);
+        ++_window_start;
+    }
+
+    std::size_t window_start() const { return _window_start; }
+
+    bool is_received(std::size_t block_id) const
+    {
+        return block_id < _block_count && _blocks[block_id].received;
+    }
+
+private:
+    struct Request {
+        Peer* peer;
+        Clock::time_point started;
+    };
+
+    struct BlockState {
+        bool received = false;
+        std::vector<Request> requests;  // in flight
+    };
+
+    struct PeerState {
+        HasBlock has_block;
+        std::size_t max_requests = 1;
+        // Average time to get a block from the peer, if known.
+        std::optional<Clock::duration> block_time;
+        std::optional<Clock::time_point> last_received;
+        std::vector<std::size_t> requests;  // in flight
+    };
+
+    static Clock::duration expected_time(const PeerState& ps)
+    {
+        return ps.block_time.value_or(default_block_time);
+    }
+
+    Clock::duration expected_time(Peer* peer) const
+    {
+        auto pi = _peers.find(peer);
+        return pi == _peers.end() ? default_block_time : expected_time(pi->second);
+    }
+
+    // Returns when the dropped request started, if there was one.
+    static std::optional<Clock::time_point> drop_request(BlockState& bs, Peer* peer)
+    {
+        auto ri = std::find_if( bs.requests.begin(), bs.requests.end()
+                              , [&] (const Request& r) { return r.peer == peer; });
+        if (ri == bs.requests.end()) return std::nullopt;
+        auto started = ri->started;
+        bs.requests.erase(ri);
+        return started;
+    }
+
+    std::optional<std::size_t> pick(Peer* peer, const PeerState& ps, Clock::time_point now) const
+    {
+        auto end = std::min(_block_count, _window_start + _window);
+
+        for (auto block_id = _window_start; block_id < end; ++block_id) {
+            auto& bs = _blocks[block_id];
+            if (bs.received || !bs.requests.empty()) continue;
+            if (ps.has_block(block_id)) return block_id;
+        }
+
+        // Endgame: request again blocks already in flight.
+        // The peer sends requested blocks in order, so this one would come last.
+        auto ready_at = now + expected_time(ps) * (ps.requests.size() + 1);
+
+        for (auto block_id = _window_start; block_id < end; ++block_id) {
+            auto& bs = _blocks[block_id];
+            if (bs.received || bs.requests.empty()) continue;
+            if (bs.requests.size() >= max_requests_per_block) continue;
+
+            bool requested = false, stalled = true;
+            auto expected_at = Clock::time_point::max();
+
+            for (auto& r : bs.requests) {
+                if (r.peer == peer) requested = true;
+                auto t = expected_time(r.peer);
+                if (now - r.started <= t * stall_factor) stalled = false;
+                expected_at = std::min(expected_at, r.started + t);
+            }
+
+            if (requested || !ps.has_block(block_id)) continue;
+            if (stalled || ready_at < expected_at) return block_id;
+        }
+
+        return std::nullopt;
+    }
+
+private:
+    const std::size_t _block_count;
+    const std::size_t _window;
+    std::size_t _window_start;
+    std::vector<BlockState> _blocks;
+    std::map<Peer*, PeerState> _peers;
+};
+
+} // namespace ouinet::cache
@@ -96,6 +96,10 @@ public:
         _prev_chained_digest = prev_chained_digest;
     }
 
+    void set_prev_chained_signature(Signature prev_chained_signature) {
+        _prev_chained_signature = prev_chained_signature;
+    }
+
     void set_offset(size_t offset) {
         _offset = offset;
     }
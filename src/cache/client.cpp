@@ -5,10 +5,13 @@
 #include "http_sign.h"
 #include "http_store.h"
 #include "resource_key.h"
+#include "store_journal.h"
+#include "swarm_peer_cache.h"
 #include "../default_timeout.h"
 #include "../http_util.h"
 #include "../parse/number.h"
 #include "../util/set_io.h"
+#include "../util/debug.h"
 #include "../util/lru_cache.h"
 #include "../task.h"
 #include "../util/keep_alive.h"
@@ -23,6 +26,7 @@
 #include "../constants.h"
 #include "../session.h"
 #include "../bep5_swarms.h"
+#include "../cache_control.h"
 #include "multi_peer_reader.h"
 #include <map>
 #include <string>
@@ -45,20 +49,26 @@ using cache::ResourceId;
 namespace fs = boost::filesystem;
 namespace bt = bittorrent;
 
+// Block requests accepted in flight on a single peer connection
+// (they are still read and served one after the other).
+static const size_t peer_pipeline_depth = 4;
+
+// How often buffered changes to the store journal are written.
+static const auto journal_flush_period = chrono::seconds(5);
+
 struct GarbageCollector {
-    cache::HttpStore& http_store;  // for looping over entries
-    cache::HttpStore::keep_func keep;  // caller-provided checks
+    using collect_func = std::function<std::expected<void, sys::error_code>(Async)>;
+
+    collect_func collect;  // caller-provided collection
 
     util::LogPath _log_path;
     AsioExecutor _executor;
     Cancel _cancel;
 
-    GarbageCollector( cache::HttpStore& http_store
-                    , cache::HttpStore::keep_func keep
+    GarbageCollector( collect_func collect
                     , util::LogPath log_path
                     , AsioExecutor ex)
-        : http_store(http_store)
-        , keep(std::move(keep))
+        : collect(std::move(collect))
         , _log_path(std::move(log_path))
         , _executor(ex)
     {}
@@ -73,9 +83,7 @@ struct GarbageCollector {
                 async_sleep(chrono::minutes(7), yield);
 
                 LOG_DEBUG(yield, " Collecting garbage...");
-                auto r = http_store.for_each([&] (cache::ResourceId const& resource_id, auto rr, Async y) {
-                    return keep(resource_id, std::move(rr), y);
-                }, yield);
+                auto r = collect(yield);
                 if (!r) LOG_WARN(yield, " Collecting garbage: failed; ec=", r.error());
                 else LOG_DEBUG(yield, " Collecting garbage: done");
             }
@@ -100,6 +108,10 @@ struct Client::Impl {
     Client::opt_path _static_cache_dir;
     unique_ptr<cache::HttpStore> _http_store;
     boost::posix_time::time_duration _max_cached_age;
+    std::size_t _max_cached_size;  // 0 means unlimited
+    std::size_t _static_cache_size = 0;
+    std::unique_ptr<StoreJournal> _journal;
+    StoreIndex _store_index;
     Cancel _lifetime_cancel;
     std::unique_ptr<Bep5Announcer> _bep5_announcer;
     std::shared_ptr<I2pTrackerClient> _i2p_tracker;
@@ -107,6 +119,7 @@ struct Client::Impl {
     GarbageCollector _gc;
     map<string, udp::endpoint> _peer_cache;
     util::LruCache<std::string, shared_ptr<DhtLookup>> _dht_peer_lookups;
+    shared_ptr<SwarmPeerCache> _swarm_peers;
     util::LruCache<std::string, shared_ptr<I2pTrackerLookup>> _i2p_peer_lookups;
     LocalPeerDiscovery _local_peer_discovery;
     std::unique_ptr<DhtGroups> _groups;
@@ -119,6 +132,8 @@ struct Client::Impl {
         , Client::opt_path static_cache_dir
         , unique_ptr<cache::HttpStore> http_store_
         , boost::posix_time::time_duration max_cached_age
+        , std::size_t max_cached_size
+        , StoreIndex::Policy eviction_policy
         , util::LogPath log_path)
         : _newest_proto_seen(std::make_shared<unsigned>(http_::protocol_version_current))
         , _ex(ex)
@@ -130,8 +145,10 @@ struct Client::Impl {
         , _static_cache_dir(std::move(static_cache_dir))
         , _http_store(std::move(http_store_))
         , _max_cached_age(max_cached_age)
-        , _gc(*_http_store, [&] (const auto& resource_id, auto rr, auto y) {
-              return keep_cache_entry(resource_id, std::move(rr), y);
+        , _max_cached_size(max_cached_size)
+        , _store_index(eviction_policy)
+        , _gc([&] (auto y) {
+              return collect_garbage(y);
           }, log_path, _ex)
         , _dht_peer_lookups(256)
         , _i2p_peer_lookups(256)
@@ -167,6 +184,14 @@ struct Client::Impl {
         if (_dht || _bep5_announcer) return false;
 
         _dht = std::move(dht);
+
+        // Reach peers found before a restart while the DHT looks them up again.
+        static const auto swarm_peers_fname = "swarm-peers";
+        _swarm_peers = std::make_shared<SwarmPeerCache>( _cache_dir / swarm_peers_fname
+                                                       , chrono::minutes(30));
+        if (auto r = _swarm_peers->load(); !r && r.error() != sys::errc::no_such_file_or_directory)
+            _WARN("Failed to load swarm peers; ec=", r.error());
+
         _bep5_announcer = std::make_unique<Bep5Announcer>(
             _dht,
             simultaneous_announcements,
@@ -227,6 +252,8 @@ struct Client::Impl {
                 return handle_not_found(sink, req.keep_alive(), yield);
             }
 
+            hl->pipeline_depth = peer_pipeline_depth;
+
             if (auto r = async_write_blob_type(BlobType::cypher_text, sink, yield); !r) {
                 return std::unexpected(r.error());
             }
@@ -259,6 +286,8 @@ struct Client::Impl {
             }
         }
 
+        _store_index.touch(req.resource_id());
+
         _YDEBUG(yield, "BEGIN");
 
         // Remember to always set `ec` before return in case of error,
@@ -317,7 +346,14 @@ struct Client::Impl {
     std::expected<std::size_t, sys::error_code>
     local_size(Async yield) const
     {
-        return _http_store->size(yield);
+        // Computed from the index to avoid scanning the store.
+        return _store_index.total_size() + _static_cache_size;
+    }
+
+    std::optional<StoreIndex::Entry> local_entry(const ResourceId& resource_id) const
+    {
+        if (auto e = _store_index.find(resource_id)) return *e;
+        return std::nullopt;
     }
 
     [[nodiscard]]
@@ -343,6 +379,7 @@ struct Client::Impl {
             unpublish_cache_entry(resource_id, group_pinned);
             if (group_pinned) return true; // keep entries of pinned groups
 
+            index_erase(resource_id);
             return false;  // remove entries that are not pinned
         }, yield);
 
@@ -404,7 +441,7 @@ struct Client::Impl {
 
         if (!lookup) {
             lookup = _dht_peer_lookups.put( swarm_name
-                                      , make_shared<DhtLookup>(_dht, swarm_name));
+                                      , make_shared<DhtLookup>(_dht, swarm_name, _swarm_peers));
         }
 
         return *lookup;
@@ -449,13 +486,16 @@ struct Client::Impl {
                 return std::move(*rs);  // do not care about body size
             }
 
-            auto data_size_sv = rs->response_header()[http_::response_data_size_hdr];
-            auto data_size_o = parse::number<std::size_t>(data_size_sv);
-            if (data_size_o && rs_sz == *data_size_o) {
+            if (is_complete(*rs, rs_sz)) {
                 return std::move(*rs);  // local copy available and complete, use it
             }
-            // TODO: Ideally, an incomplete or stale local cache entry
-            // could be reused in the multi-peer download below.
+        }
+
+        // Blocks of an incomplete local copy need not be fetched again from peers,
+        // and storing the resulting response extends the local copy.
+        std::optional<MultiPeerReader::Seed> seed;
+        if (rs && !is_head_request) {
+            seed = local_seed(resource_id, yield);
         }
 
         util::LogPath log_path = yield.log_path().tag("multi_peer_reader");
@@ -470,7 +510,8 @@ struct Client::Impl {
                 [&] (CacheType::Bep5Http) -> VisitR {
                     auto peer_lookup_ = dht_peer_lookup(compute_swarm_name(group));
 
-                    auto local_peers = _local_peer_discovery.found_peers();
+                    // Only LAN peers which likely hold the resource, freshest first.
+                    auto local_peers = _local_peer_discovery.likely_holders(resource_id);
 
                     if (_dht) {
                         if (get_logger().get_threshold() <= DEBUG) {
@@ -479,7 +520,7 @@ struct Client::Impl {
                             LOG_DEBUG(yield, "    group=       ", group);
                             LOG_DEBUG(yield, "    swarm_name=  ", peer_lookup_->swarm_name());
                             LOG_DEBUG(yield, "    infohash=    ", peer_lookup_->infohash());
-                            LOG_DEBUG(yield, "    local_peers= ", local_peers);
+                            LOG_DEBUG(yield, "    local_peers= ", debug(local_peers));
                         };
 
                         return std::make_unique<MultiPeerReader>
@@ -496,7 +537,7 @@ struct Client::Impl {
                         if (get_logger().get_threshold() <= DEBUG) {
                             LOG_DEBUG(yield, " Peer lookup with local discovery only:");
                             LOG_DEBUG(yield, "    resource_id= ", resource_id);
-                            LOG_DEBUG(yield, "    local_peers= ", local_peers);
+                            LOG_DEBUG(yield, "    local_peers= ", debug(local_peers));
                         };
 
                         return std::make_unique<MultiPeerReader>
@@ -543,6 +584,11 @@ struct Client::Impl {
 
         if (!reader) return std::unexpected(reader.error());
 
+        if (seed) {
+            LOG_DEBUG(yield, " Resuming from incomplete local copy; blocks=", seed->hash_list.blocks.size());
+            (*reader)->seed(std::move(*seed));
+        }
+
         auto s =  Session::create(
                 std::move(*reader),
                 is_head_request,
@@ -568,6 +614,44 @@ struct Client::Impl {
         }
     }
 
+    // Like `load`, but only from the local store,
+    // and failing if the local copy is not complete.
+    [[nodiscard]]
+    std::expected<Session, sys::error_code>
+    load_local(const CachePeerRetrieveRequest& request, Async yield)
+    {
+        bool is_head_request = request.method() == http::verb::head;
+
+        std::size_t rs_sz = 0;
+        auto rs = load_from_local(request.resource_id(), is_head_request, rs_sz, yield);
+        LOG_DEBUG(yield, " Looking up local cache only; ec=", rs ? sys::error_code() : rs.error());
+
+        if (rs && !is_head_request && !is_complete(*rs, rs_sz)) {
+            return std::unexpected(asio::error::not_found);
+        }
+        return rs;
+    }
+
+    static bool is_complete(const Session& rs, std::size_t body_size)
+    {
+        auto data_size_sv = rs.response_header()[http_::response_data_size_hdr];
+        auto data_size_o = parse::number<std::size_t>(data_size_sv);
+        return data_size_o && body_size == *data_size_o;
+    }
+
+    // Return verified blocks of an incomplete local copy, if any.
+    std::optional<MultiPeerReader::Seed>
+    local_seed(const ResourceId& resource_id, Async yield)
+    {
+        auto hl = _http_store->load_hash_list(resource_id, yield);
+        if (!hl) return std::nullopt;  // no data blocks with signatures
+
+        auto rr = _http_store->reader(resource_id, yield);
+        if (!rr) return std::nullopt;
+
+        return MultiPeerReader::Seed{std::move(*hl), std::move(*rr)};
+    }
+
     [[nodiscard]]
     std::expected<Session, sys::error_code>
     load_from_local( const ResourceId& resource_id
@@ -597,6 +681,8 @@ struct Client::Impl {
         auto rs = Session::create(std::move(rr), is_head_request, yield.tag("read_hdr"));
         if (!rs) return std::unexpected(rs.error());
 
+        _store_index.touch(resource_id);
+
         rs->response_header().set( http_::response_source_hdr  // for agent
                                  , http_::response_source_hdr_local_cache);
         return std::move(*rs);
@@ -614,10 +700,31 @@ struct Client::Impl {
             return std::unexpected(r.error());
         }
 
+        // A stored response missing from the index would never be evicted,
+        // so remove it unless it gets indexed (even if cancelled meanwhile).
+        bool indexed = false;
+        auto unstore = defer([&] {
+            if (indexed) return;
+            _WARN("Failed to index stored response, removing; resource_id=", resource_id);
+            evict_cache_entry(resource_id);
+        });
+
+        if (auto r = index_stored_entry(resource_id, yield); !r) {
+            return std::unexpected(r.error());
+        }
+        indexed = true;
+
         if (auto r = _groups->add(group, resource_id, yield); !r) {
             return std::unexpected(r.error());
         }
 
+        enforce_size_budget();
+        if (!_store_index.find(resource_id)) {
+            // It was evicted right away, not worth announcing.
+            _DEBUG("Stored response does not fit in the local cache; resource_id=", resource_id);
+            return {};
+        }
+
         if (_bep5_announcer) {
             if (_bep5_announcer->add(compute_swarm_name(group)))
                 _VERBOSE("Start announcing group: ", group);
@@ -651,6 +758,18 @@ struct Client::Impl {
         return *head;
     }
 
+    // Return zero if not available.
+    static
+    std::time_t
+    injection_time(const http::response_header<>& head)
+    {
+        auto ts_sv = util::http_injection_ts(head);
+        if (ts_sv.empty()) return 0;  // missing header or field
+        auto ts_o = parse::number<std::time_t>(ts_sv);
+        if (!ts_o) return 0;  // malformed creation time stamp
+        return *ts_o;
+    }
+
     // Return maximum if not available.
     boost::posix_time::time_duration
     cache_entry_age(const http::response_header<>& head)
@@ -660,15 +779,147 @@ struct Client::Impl {
 
         static auto max_age = bsecs(ssecs::max().count());
 
-        auto ts_sv = util::http_injection_ts(head);
-        if (ts_sv.empty()) return max_age;  // missing header or field
-        auto ts_o = parse::number<ssecs::rep>(ts_sv);
-        if (!ts_o) return max_age;  // malformed creation time stamp
+        auto ts = injection_time(head);
+        if (ts == 0) return max_age;
         auto now = ssecs(std::time(nullptr));  // as done by injector
-        auto age = now - ssecs(*ts_o);
+        auto age = now - ssecs(ts);
         return bsecs(age.count());
     }
 
+    // Add the given stored response to the index,
+    // or update its entry if it was already there.
+    [[nodiscard]]
+    std::expected<void, sys::error_code>
+    index_stored_entry(const cache::ResourceId& resource_id, Async yield)
+    {
+        auto rr = _http_store->reader(resource_id, yield);
+        if (!rr) return std::unexpected(rr.error());
+
+        auto hdr = read_response_header(**rr, yield);
+        if (!hdr) return std::unexpected(hdr.error());
+
+        return index_stored_entry(resource_id, *hdr, std::time(nullptr));
+    }
+
+    [[nodiscard]]
+    std::expected<void, sys::error_code>
+    index_stored_entry( const cache::ResourceId& resource_id
+                      , const http::response_header<>& hdr
+                      , std::time_t accessed)
+    {
+        StoreIndex::Entry e;
+
+        auto size = _http_store->entry_size(resource_id);
+        if (!size) return std::unexpected(size.error());
+        e.size = *size;
+
+        auto body_size = _http_store->body_size(resource_id);  // may be missing
+        e.body_size = body_size ? *body_size : 0;
+        auto data_size = parse::number<std::size_t>(hdr[http_::response_data_size_hdr]);
+        e.complete = data_size && *data_size == e.body_size;
+
+        e.injected = injection_time(hdr);
+        e.expires = CacheControl::expiration_time(hdr, e.injected);
+        e.accessed = accessed;
+
+        index_insert(resource_id, e);
+        return {};
+    }
+
+    // These keep the content filter advertised to LAN peers
+    // in sync with the index.
+
+    void index_insert(const cache::ResourceId& resource_id, StoreIndex::Entry e)
+    {
+        if (!_store_index.find(resource_id)) _local_peer_discovery.add_resource(resource_id);
+        _store_index.insert(resource_id, std::move(e));
+    }
+
+    void index_restore(const cache::ResourceId& resource_id, StoreIndex::Entry e)
+    {
+        if (!_store_index.find(resource_id)) _local_peer_discovery.add_resource(resource_id);
+        _store_index.restore(resource_id, std::move(e));
+    }
+
+    void index_erase(const cache::ResourceId& resource_id)
+    {
+        if (_store_index.erase(resource_id)) _local_peer_discovery.remove_resource(resource_id);
+    }
+
+    // Remove the entry from the store, the index and its groups,
+    // regardless of it being pinned.
+    void evict_cache_entry(const cache::ResourceId& resource_id)
+    {
+        if (auto r = _http_store->remove(resource_id); !r) {
+            _WARN("Failed to remove cached response; resource_id=", resource_id, " ec=", r.error());
+        }
+        index_erase(resource_id);
+        unpublish_cache_entry(resource_id);
+    }
+
+    // Evict unpinned entries until the local cache fits in its maximum size.
+    void enforce_size_budget()
+    {
+        if (_max_cached_size == 0) return;  // unlimited
+        if (_store_index.total_size() <= _max_cached_size) return;
+
+        auto victims = _store_index.victims(_max_cached_size, [&] (const auto& resource_id) {
+            return _groups->is_pinned(resource_id);
+        });
+
+        for (const auto& resource_id : victims) {
+            _DEBUG( "Local cache over its maximum size; removing: "
+                  , _store_index.total_size(), " > ", _max_cached_size
+                  , "; resource_id=", resource_id);
+            evict_cache_entry(resource_id);
+        }
+
+        if (_store_index.total_size() > _max_cached_size)
+            _WARN( "Local cache over its maximum size with only pinned entries left: "
+                 , _store_index.total_size(), " > ", _max_cached_size);
+    }
+
+    // Evict entries which are too old or do not fit in the local cache,
+    // without having to scan the store.
+    [[nodiscard]]
+    std::expected<void, sys::error_code>
+    collect_garbage(Async yield)
+    {
+        // Same criteria as in `keep_cache_entry`.
+        if (!_max_cached_age.is_special()) {
+            auto min_ts = std::time(nullptr) - _max_cached_age.total_seconds();
+            for (const auto& resource_id : _store_index.injected_before(min_ts)) {
+                if (_groups->is_pinned(resource_id)) continue;
+
+                _DEBUG("Cached response is too old; removing: resource_id=", resource_id);
+                evict_cache_entry(resource_id);
+            }
+        }
+
+        enforce_size_budget();
+
+        if (_journal && _journal->needs_compaction()) {
+            if (auto r = _journal->compact(journal_state()); !r)
+                _WARN("Failed to compact store journal; ec=", r.error());
+        }
+
+        store_swarm_peers(yield);
+
+        return {};
+    }
+
+    void store_swarm_peers(Async yield) const
+    {
+        if (!_swarm_peers) return;
+        if (auto r = _swarm_peers->store(yield); !r)
+            _WARN("Failed to store swarm peers; ec=", r.error());
+    }
+
+    StoreJournal::State journal_state() const
+    {
+        return {_store_index.entries(), _groups->stored_groups()};
+    }
+
     inline
     void unpublish_cache_entry(const cache::ResourceId& resource_id)
     {
@@ -718,13 +969,17 @@ struct Client::Impl {
                   , age, " > ", _max_cached_age
                   , "; resource_id=", resource_id );
 
-            if (_groups->is_pinned(resource_id)) {
-                _DEBUG("Keep ", resource_id, " even if it is old because it is pinned");
-                return true;
+            if (!_groups->is_pinned(resource_id)) {
+                unpublish_cache_entry(resource_id);
+                return false;
             }
+            _DEBUG("Keep ", resource_id, " even if it is old because it is pinned");
+        }
 
-            unpublish_cache_entry(resource_id);
-            return false;
+        // Access times are not kept in storage,
+        // so assume that newer entries were accessed more recently.
+        if (auto r = index_stored_entry(resource_id, *hdr, injection_time(*hdr)); !r) {
+            return std::unexpected(r.error());
         }
 
         return true;
@@ -735,6 +990,9 @@ struct Client::Impl {
     load_stored_groups(Async yield)
     {
         static const auto groups_curver_subdir = "dht_groups";
+        static const auto journal_fname = "store-index";
+        // Entries of other protocol versions are not kept (see `keep_cache_entry`).
+        static const uint32_t journal_tag = http_::protocol_version_current;
 
         auto slot = _lifetime_cancel.connect([&] { yield.cancel(); });
 
@@ -755,16 +1013,125 @@ struct Client::Impl {
         }
 
         auto groups_dir = _cache_dir / groups_curver_subdir;
+        auto journal_path = _cache_dir / journal_fname;
+
+        // Avoid scanning the whole store and groups if the journal is usable.
+        auto state = StoreJournal::load(journal_path, journal_tag);
+        if (!state && state.error() != sys::errc::no_such_file_or_directory)
+            _WARN("Failed to load store journal, scanning storage; ec=", state.error());
+
+        auto groups = state
+            ? ( static_groups
+              ? load_backed_dht_groups(groups_dir, std::move(static_groups), std::move(state->groups), yield)
+              : load_dht_groups(groups_dir, std::move(state->groups), yield))
+            : ( static_groups
+              ? load_backed_dht_groups(groups_dir, std::move(static_groups), yield)
+              : load_dht_groups(groups_dir, yield));
+        if (!groups) return std::unexpected(groups.error());
+        _groups = std::move(*groups);
+
+        if (state) {
+            for (auto& [resource_id, entry] : state->entries)
+                index_restore(resource_id, entry);
+
+            if (state->unclean) {
+                _WARN("Local cache was not closed cleanly, checking storage");
+                if (auto r = reconcile_stored_entries(yield); !r) return r;
+            }
 
-        if (auto r = static_groups
-                ? load_backed_dht_groups(groups_dir, std::move(static_groups), yield)
-                : load_dht_groups(groups_dir, yield)) {
-            _groups = std::move(*r);
+            // Groups and entries are journaled separately,
+            // so drop group items which were not indexed.
+            for (auto& [group_name, items] : _groups->stored_groups())
+                for (auto& item_name : items)
+                    if (!_store_index.find(item_name)) {
+                        _WARN("Group resource missing from store journal: ", item_name, " (", group_name, ")");
+                        _groups->remove(item_name);
+                    }
+        } else {
+            if (auto r = scan_stored_entries(yield); !r) return r;
         }
-        else {
-            return std::unexpected(r.error());
+
+        _INFO("Loaded local cache: ", _store_index.size(), " responses, "
+              , _store_index.total_size(), " bytes");
+
+        // Resources in the static cache are not indexed,
+        // but they are served to LAN peers as well.
+        if (_static_cache_dir)
+            for (auto& group_name : _groups->groups())
+                for (auto& item_name : _groups->items(group_name))
+                    if (!_store_index.find(item_name))
+                        _local_peer_discovery.add_resource(item_name);
+
+        // Start journaling from a fresh snapshot.
+        if (auto r = StoreJournal::create(journal_path, journal_tag, journal_state())) {
+            _journal = std::move(*r);
+            _store_index.set_journal(_journal.get());
+            _groups->set_journal(_journal.get());
+            start_journal_flush();
+        } else {
+            _WARN("Failed to create store journal, the next start will scan storage; ec=", r.error());
+        }
+
+        return {};
+    }
+
+    // Periodically write buffered journal changes,
+    // so that few of them are lost if the process dies.
+    void start_journal_flush()
+    {
+        spawn_detached(_ex, _lifetime_cancel, _log_path, [&] (Async yield) {
+            while (true) {
+                async_sleep(journal_flush_period, yield);
+                if (_journal) _journal->flush();
+            }
+        });
+    }
+
+    // Fix the index restored from the journal where it does not match the store,
+    // e.g. because the process died between storing a response and journaling it.
+    // Since this walks the store, only do it if the journal was not closed cleanly.
+    // Only the names of stored responses are listed,
+    // and just the ones missing from the index are looked into.
+    [[nodiscard]]
+    std::expected<void, sys::error_code>
+    reconcile_stored_entries(Async yield)
+    {
+        auto stored = _http_store->list();
+        if (!stored) return std::unexpected(stored.error());
+
+        std::vector<ResourceId> gone;
+        for (auto& [resource_id, _] : _store_index.entries())
+            if (!stored->contains(resource_id)) gone.push_back(resource_id);
+
+        for (auto& resource_id : gone) {
+            _WARN("Journaled response missing from store: ", resource_id);
+            index_erase(resource_id);
         }
 
+        for (auto& resource_id : *stored) {
+            if (_store_index.find(resource_id)) continue;
+            _WARN("Stored response missing from store journal: ", resource_id);
+
+            if (auto rr = _http_store->reader(resource_id, yield)) {
+                auto keep = keep_cache_entry(resource_id, std::move(*rr), yield);
+                if (keep && *keep) continue;  // indexed
+                if (!keep) _WARN("Failed to check cached response; resource_id=", resource_id, " ec=", keep.error());
+            } else {
+                _WARN("Failed to open cached response; resource_id=", resource_id, " ec=", rr.error());
+            }
+
+            if (auto r = _http_store->remove(resource_id); !r)
+                _WARN("Failed to remove cached response; resource_id=", resource_id, " ec=", r.error());
+        }
+
+        return {};
+    }
+
+    // Build the index and check groups by looking into every stored response.
+    [[nodiscard]]
+    std::expected<void, sys::error_code>
+    scan_stored_entries(Async yield)
+    {
         auto r = _http_store->for_each([&] (const auto& resource_id, auto rr, Async yield) {
             return keep_cache_entry(resource_id, std::move(rr), yield);
         }, yield);
@@ -803,6 +1170,15 @@ struct Client::Impl {
     void stop() {
         _lifetime_cancel();
         _local_peer_discovery.stop();
+        if (_journal) _journal->flush();
+
+        if (_swarm_peers) {
+            // The cache is kept alive by the coroutine after the client goes away.
+            spawn_detached(_ex, _log_path, [swarm_peers = _swarm_peers] (Async yield) {
+                if (auto r = swarm_peers->store(yield); !r)
+                    _WARN("Failed to store swarm peers; ec=", r.error());
+            });
+        }
     }
 
     unsigned get_newest_proto_version() const {
@@ -824,6 +1200,8 @@ Client::build( std::set<udp::endpoint> lan_my_eps
              , sign::PublicKey cache_pk
              , fs::path cache_dir
              , boost::posix_time::time_duration max_cached_age
+             , std::size_t max_cached_size
+             , StoreIndex::Policy eviction_policy
              , Client::opt_path static_cache_dir
              , Client::opt_path static_cache_content_dir
              , Async yield)
@@ -837,6 +1215,7 @@ Client::build( std::set<udp::endpoint> lan_my_eps
 
     // Use a static HTTP store if its directories are provided.
     std::unique_ptr<BaseHttpStore> static_http_store;
+    std::size_t static_http_store_size = 0;
     if (static_cache_dir) {
         assert(static_cache_content_dir);
         auto store_dir = *static_cache_dir / store_curver_subdir;
@@ -863,6 +1242,13 @@ Client::build( std::set<udp::endpoint> lan_my_eps
                                                       , cache_pk
                                                       , ex);
         ec = {};
+
+        // It is read-only, so compute its size just once.
+        if (static_http_store) {
+            auto sz = static_http_store->size(yield);
+            if (sz) static_http_store_size = *sz;
+            else _WARN("Failed to get size of static HTTP store; ec=", sz.error());
+        }
     }
 
     // Remove obsolete stores.
@@ -886,11 +1272,16 @@ Client::build( std::set<udp::endpoint> lan_my_eps
 
     unique_ptr<Impl> impl(new Impl( ex, std::move(lan_my_eps)
                                   , cache_pk, std::move(cache_dir), std::move(static_cache_dir)
-                                  , std::move(http_store), max_cached_age, yield.log_path()));
+                                  , std::move(http_store)
+                                  , max_cached_age, max_cached_size, eviction_policy
+                                  , yield.log_path()));
+    impl->_static_cache_size = static_http_store_size;
 
     if (auto r = impl->load_stored_groups(yield); !r) {
         return std::unexpected(r.error());
     }
+    // The maximum size may have been lowered since the last run.
+    impl->enforce_size_budget();
     impl->_gc.start();
 
     return shared_ptr<Client>(new Client(std::move(impl)));
@@ -918,6 +1309,12 @@ Client::load( const CachePeerRetrieveRequest& request
     return _impl->load(request, metrics, yield);
 }
 
+std::expected<Session, sys::error_code>
+Client::load_local(const CachePeerRetrieveRequest& request, Async yield)
+{
+    return _impl->load_local(request, yield);
+}
+
 std::expected<void, sys::error_code>
 Client::store( const cache::ResourceId& key
              , const GroupName& group
@@ -942,6 +1339,12 @@ Client::local_size(Async yield) const
     return _impl->local_size(yield);
 }
 
+std::optional<StoreIndex::Entry>
+Client::local_entry(const ResourceId& resource_id) const
+{
+    return _impl->local_entry(resource_id);
+}
+
 std::expected<void, sys::error_code>
 Client::local_purge(Async yield)
 {
@@ -13,6 +13,7 @@
 #include "resource_id.h"
 #include "dht_groups.h"
 #include "peer_message.h"
+#include "store_index.h"
 #include "util/crypto_stream_key.h"
 #include "ouiservice/i2p/fwd.h"
 #include "ouiservice/i2p/address.h"
@@ -40,6 +41,8 @@ private:
          , sign::PublicKey cache_pk
          , fs::path cache_dir
          , boost::posix_time::time_duration max_cached_age
+         , std::size_t max_cached_size
+         , StoreIndex::Policy eviction_policy
          , opt_path static_cache_dir
          , opt_path static_cache_content_dir
          , Async);
@@ -54,10 +57,13 @@ public:
          , sign::PublicKey cache_pk
          , fs::path cache_dir
          , boost::posix_time::time_duration max_cached_age
+         , std::size_t max_cached_size
+         , StoreIndex::Policy eviction_policy
          , Async yield)
     {
         return build( std::move(lan_my_endpoints), std::move(cache_pk)
                     , std::move(cache_dir), max_cached_age
+                    , max_cached_size, eviction_policy
                     , boost::none, boost::none
                     , yield);
     }
@@ -68,6 +74,8 @@ public:
          , sign::PublicKey cache_pk
          , fs::path cache_dir
          , boost::posix_time::time_duration max_cached_age
+         , std::size_t max_cached_size
+         , StoreIndex::Policy eviction_policy
          , fs::path static_cache_dir
          , fs::path static_cache_content_dir
          , Async yield)
@@ -76,6 +84,7 @@ public:
         assert(!static_cache_content_dir.empty());
         return build( std::move(lan_my_endpoints), std::move(cache_pk)
                     , std::move(cache_dir), max_cached_age
+                    , max_cached_size, eviction_policy
                     , opt_path{std::move(static_cache_dir)}
                     , opt_path{std::move(static_cache_content_dir)}
                     , yield);
@@ -96,6 +105,12 @@ public:
         , metrics::Client& metrics
         , Async);
 
+    // Like `load`, but without looking up peers,
+    // and failing unless the local copy is complete.
+    [[nodiscard]]
+    std::expected<Session, sys::error_code>
+    load_local(const CachePeerRetrieveRequest&, Async);
+
     [[nodiscard]]
     std::expected<void, sys::error_code>
     store( const ResourceId&
@@ -115,6 +130,11 @@ public:
     [[nodiscard]]
     std::expected<std::size_t, sys::error_code> local_size(Async) const;
 
+    // Metadata of the locally stored response for the given resource
+    // (if any), taken from the index of the local cache without reading the store.
+    std::optional<StoreIndex::Entry> local_entry(const ResourceId&) const;
+
+
     [[nodiscard]] std::expected<void, sys::error_code> local_purge(Async);
 
     bool pin_group(const std::string& group_name, sys::error_code& ec);
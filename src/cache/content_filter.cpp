@@ -0,0 +1,142 @@
+#include "content_filter.h"
+
+#include <cassert>
+#include <limits>
+
+#include "../util/hash.h"
+
+namespace ouinet::cache {
+
+static uint32_t load_u32(const uint8_t* p)
+{
+    return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | uint32_t(p[3]);
+}
+
+ContentFilter::Key
+ContentFilter::key(const ResourceId& rid)
+{
+    auto digest = util::sha1_digest(rid.hex_string());
+    // An odd second hash never cycles over a power of two number of bits.
+    return Key{load_u32(digest.data()), load_u32(digest.data() + 4) | 1};
+}
+
+ContentFilter::ContentFilter(std::size_t bits, unsigned hashes)
+    : _bits(bits)
+    , _hashes(hashes)
+    , _bytes((bits + 7) / 8, '\0')
+{
+    assert(bits > 0 && hashes > 0);
+}
+
+bool
+ContentFilter::valid(std::size_t bits, unsigned hashes)
+{
+    return bits > 0 && bits <= max_bits && hashes > 0 && hashes <= max_hashes;
+}
+
+std::optional<ContentFilter>
+ContentFilter::from_bytes(std::size_t bits, unsigned hashes, std::string_view bytes)
+{
+    if (!valid(bits, hashes)) return std::nullopt;
+    if (bytes.size() != (bits + 7) / 8) return std::nullopt;
+
+    ContentFilter filter(bits, hashes);
+    filter._bytes.assign(bytes.data(), bytes.size());
+    return filter;
+}
+
+bool
+ContentFilter::assign_bytes(std::size_t offset, std::string_view bytes)
+{
+    if (offset > _bytes.size() || bytes.size() > _bytes.size() - offset) return false;
+    _bytes.replace(offset, bytes.size(), bytes.data(), bytes.size());
+    return true;
+}
+
+std::vector<uint32_t>
+ContentFilter::positions(Key key) const
+{
+    std::vector<uint32_t> ret;
+    ret.reserve(_hashes);
+    for (unsigned i = 0; i < _hashes; ++i) {
+        ret.push_back((uint64_t(key.h1) + uint64_t(i) * key.h2) % _bits);
+    }
+    return ret;
+}
+
+bool
+ContentFilter::may_contain(Key key) const
+{
+    for (auto pos : positions(key)) {
+        if (!test(pos)) return false;
+    }
+    return true;
+}
+
+bool
+ContentFilter::test(uint32_t pos) const
+{
+    assert(pos < _bits);
+    return uint8_t(_bytes[pos / 8]) & (1u << (pos % 8));
+}
+
+void
+ContentFilter::set(uint32_t pos, bool value)
+{
+    assert(pos < _bits);
+    auto& byte = reinterpret_cast<uint8_t&>(_bytes[pos / 8]);
+    if (value) byte |= (1u << (pos % 8));
+    else       byte &= ~(1u << (pos % 8));
+}
+
+std::vector<uint32_t>
+ContentFilter::diff(const ContentFilter& other) const
+{
+    assert(_bits == other._bits);
+
+    std::vector<uint32_t> ret;
+    for (std::size_t i = 0; i < _bytes.size(); ++i) {
+        uint8_t x = _bytes[i] ^ other._bytes[i];
+        for (unsigned b = 0; x; ++b, x >>= 1) {
+            if (x & 1) ret.push_back(i * 8 + b);
+        }
+    }
+    return ret;
+}
+
+CountingContentFilter::CountingContentFilter(std::size_t bits, unsigned hashes)
+    : _filter(bits, hashes)
+    , _counters(bits, 0)
+{}
+
+void
+CountingContentFilter::add(const ResourceId& rid)
+{
+    static const auto max_count = std::numeric_limits<uint8_t>::max();
+
+    for (auto pos : _filter.positions(ContentFilter::key(rid))) {
+        auto& c = _counters[pos];
+        if (c == max_count) continue;
+        if (c++ == 0) {
+            _filter.set(pos, true);
+            ++_version;
+        }
+    }
+}
+
+void
+CountingContentFilter::remove(const ResourceId& rid)
+{
+    static const auto max_count = std::numeric_limits<uint8_t>::max();
+
+    for (auto pos : _filter.positions(ContentFilter::key(rid))) {
+        auto& c = _counters[pos];
+        if (c == 0 || c == max_count) continue;
+        if (--c == 0) {
+            _filter.set(pos, false);
+            ++_version;
+        }
+    }
+}
+
+} // namespace ouinet::cache
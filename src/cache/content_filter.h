@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "resource_id.h"
+#include "../api.h"
+
+namespace ouinet::cache {
+
+// A Bloom filter of the resource ids held by a client,
+// advertised to peers in the LAN so that they only contact the client
+// for resources which it likely holds.
+//
+// The bits for a resource id are derived from the SHA1 digest of its hex string
+// (by double hashing), so filters built by different clients are compatible
+// as long as they use the same number of bits and hashes.
+class OUINET_COMMON_API ContentFilter {
+public:
+    // With these, the false positive rate is about 0.5% with 5000 resources
+    // and 5% with 10000 resources, and the filter takes 8 KiB
+    // (so it needs to be sent to peers in several datagrams).
+    static constexpr std::size_t default_bits = 1 << 16;
+    static constexpr unsigned default_hashes = 4;
+
+    // Limits for filters received from peers.
+    static constexpr std::size_t max_bits = 1 << 17;
+    static constexpr unsigned max_hashes = 16;
+
+    // Digest-derived values used to compute the bits of a resource id
+    // (so that it need not be hashed again for every filter).
+    struct Key {
+        uint32_t h1, h2;
+    };
+
+    static Key key(const ResourceId&);
+
+public:
+    ContentFilter( std::size_t bits = default_bits
+                 , unsigned hashes = default_hashes);
+
+    // Whether a filter with these parameters may be received from peers.
+    static bool valid(std::size_t bits, unsigned hashes);
+
+    // Build a filter from its bytes as returned by `bytes()`.
+    // Return nothing if parameters are out of bounds or bytes do not match them.
+    static std::optional<ContentFilter>
+    from_bytes(std::size_t bits, unsigned hashes, std::string_view bytes);
+
+    bool may_contain(const ResourceId& rid) const { return may_contain(key(rid)); }
+    bool may_contain(Key) const;
+
+    // Positions of the bits set for the key.
+    std::vector<uint32_t> positions(Key) const;
+
+    bool test(uint32_t pos) const;
+    void set(uint32_t pos, bool value);
+
+    // Positions of bits which differ from those of the given filter
+    // (which must have the same size).
+    std::vector<uint32_t> diff(const ContentFilter&) const;
+
+    std::size_t bits() const { return _bits; }
+    unsigned hashes() const { return _hashes; }
+
+    // The bits as raw bytes, least significant bit first.
+    const std::string& bytes() const { return _bytes; }
+
+    // Replace the bytes starting at the given offset,
+    // e.g. with a segment of the `bytes()` of another filter.
+    // Return false if they do not fit in the filter.
+    bool assign_bytes(std::size_t offset, std::string_view);
+
+private:
+    std::size_t _bits;
+    unsigned _hashes;
+    std::string _bytes;
+};
+
+// A counting Bloom filter, so that resources can be removed as well as added
+// while keeping an up-to-date `ContentFilter` to advertise.
+//
+// Counters saturate (and then never decrease) to keep them small.
+class OUINET_COMMON_API CountingContentFilter {
+public:
+    CountingContentFilter( std::size_t bits = ContentFilter::default_bits
+                         , unsigned hashes = ContentFilter::default_hashes);
+
+    // Adding (or removing) the same resource several times
+    // requires removing (or adding) it as many times.
+    void add(const ResourceId&);
+    void remove(const ResourceId&);
+
+    const ContentFilter& filter() const { return _filter; }
+
+    // Incremented whenever some bit of the filter changes.
+    uint64_t version() const { return _version; }
+
+private:
+    ContentFilter _filter;
+    std::vector<uint8_t> _counters;
+    uint64_t _version = 0;
+};
+
+} // namespace ouinet::cache
@@ -1,4 +1,5 @@
 #include "dht_groups.h"
+#include "store_journal.h"
 #include "../logger.h"
 #include "../util/file_io.h"
 #include "../util/bytes.h"
@@ -42,6 +43,14 @@ public:
     load_untrusted(fs::path root_dir, Async y)
     { return load(std::move(root_dir), false, y); }
 
+    // Use the given groups instead of loading them from storage.
+    [[nodiscard]]
+    static std::expected<std::unique_ptr<DhtGroupsImpl>, sys::error_code>
+    load_trusted(fs::path root_dir, DhtGroups::Groups, Async);
+
+    void set_journal(cache::StoreJournal* journal) { _journal = journal; }
+    const DhtGroups::Groups& stored_groups() const { return _groups; }
+
     std::set<GroupName> groups() const;
     std::set<DhtGroups::GroupName> pinned_groups();
     std::set<ResourceId> items(const GroupName&) const;
@@ -87,6 +96,7 @@ private:
     AsioExecutor _ex;
     fs::path _root_dir;
     Groups _groups;
+    cache::StoreJournal* _journal = nullptr;
     Cancel _lifetime_cancel;
 };
 
@@ -276,6 +286,26 @@ DhtGroupsImpl::load( fs::path root_dir
         (new DhtGroupsImpl(yield.get_executor(), std::move(root_dir), std::move(groups)));
 }
 
+/* static */
+std::expected<std::unique_ptr<DhtGroupsImpl>, sys::error_code>
+DhtGroupsImpl::load_trusted( fs::path root_dir
+                           , DhtGroups::Groups groups
+                           , Async yield)
+{
+    if (auto r = file_io::check_or_create_directory(root_dir); !r) {
+        _ERROR("Failed to create directory: ", root_dir, "; ec=", r.error());
+        return std::unexpected(r.error());
+    }
+
+    for (auto gi = groups.begin(); gi != groups.end();) {
+        if (gi->second.empty()) gi = groups.erase(gi);
+        else ++gi;
+    }
+
+    return std::unique_ptr<DhtGroupsImpl>
+        (new DhtGroupsImpl(yield.get_executor(), std::move(root_dir), std::move(groups)));
+}
+
 fs::path
 DhtGroupsImpl::group_path(const GroupName& group_name)
 {
@@ -440,6 +470,8 @@ DhtGroupsImpl::add( const GroupName& group_name
     //    return or_throw(yield, ec);
     //}
 
+    if (_journal) _journal->add_item(group_name, item_name);
+
     // Add the item to the group in memory.
     const auto& group_it = _groups.find(group_name);
     if (group_it == _groups.end()) {
@@ -470,6 +502,7 @@ std::set<DhtGroups::GroupName> DhtGroupsImpl::remove(const ResourceId& item_name
             // This case shouldn't happen, but let's sanitize it anyway.
             erased_groups.insert(group_name);
             try_remove(group_path(group_name));
+            if (_journal) _journal->remove_group(group_name);
             _groups.erase(gi);
             continue;
         }
@@ -486,6 +519,7 @@ std::set<DhtGroups::GroupName> DhtGroupsImpl::remove(const ResourceId& item_name
 
         items.erase(i);
         try_remove(item_path(group_name, item_name));
+        if (_journal) _journal->remove_item(group_name, item_name);
 
         if (items.empty()) {
             erased_groups.insert(group_name);
@@ -503,6 +537,7 @@ void DhtGroupsImpl::remove_group(const GroupName& gn)
     if (gi == _groups.end()) return;
 
     try_remove(group_path(gn));
+    if (_journal) _journal->remove_group(gn);
     _groups.erase(gi);
 }
 
@@ -581,6 +616,12 @@ public:
     bool unpin_group(const GroupName& gn, sys::error_code& ec) override
     { return _impl->unpin_group(gn, ec); }
 
+    void set_journal(cache::StoreJournal* journal) override
+    { _impl->set_journal(journal); }
+
+    Groups stored_groups() const override
+    { return _impl->stored_groups(); }
+
 private:
     std::unique_ptr<DhtGroupsImpl> _impl;
 };
@@ -593,6 +634,14 @@ ouinet::load_dht_groups(fs::path root_dir, Async yield)
     return std::make_unique<FullDhtGroups>(std::move(*gs));
 }
 
+std::expected<std::unique_ptr<DhtGroups>, sys::error_code>
+ouinet::load_dht_groups(fs::path root_dir, DhtGroups::Groups groups, Async yield)
+{
+    auto gs = DhtGroupsImpl::load_trusted(std::move(root_dir), std::move(groups), yield);
+    if (!gs) return std::unexpected(gs.error());
+    return std::make_unique<FullDhtGroups>(std::move(*gs));
+}
+
 class BackedDhtGroups : public FullDhtGroups {
 public:
     BackedDhtGroups( std::unique_ptr<DhtGroupsImpl> impl
@@ -657,3 +706,16 @@ ouinet::load_backed_dht_groups( fs::path root_dir
         ( std::move(*gs)
         , std::move(fallback_groups));
 }
+
+std::expected<std::unique_ptr<DhtGroups>, sys::error_code>
+ouinet::load_backed_dht_groups( fs::path root_dir
+                              , std::unique_ptr<BaseDhtGroups> fallback_groups
+                              , DhtGroups::Groups groups
+                              , Async yield)
+{
+    auto gs = DhtGroupsImpl::load_trusted( std::move(root_dir), std::move(groups), yield);
+    if (!gs) return std::unexpected(gs.error());
+    return std::make_unique<BackedDhtGroups>
+        ( std::move(*gs)
+        , std::move(fallback_groups));
+}
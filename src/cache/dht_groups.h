@@ -1,5 +1,6 @@
 #pragma once
 
+#include <map>
 #include <set>
 #include <boost/asio/spawn.hpp>
 #include <boost/filesystem.hpp>
@@ -14,6 +15,10 @@ class Async;
 class Cancel;
 using ouinet::util::AsioExecutor;
 
+namespace cache {
+    class StoreJournal;
+}
+
 class BaseDhtGroups {
 public:
     using GroupName = std::string;
@@ -33,9 +38,18 @@ std::expected<std::unique_ptr<BaseDhtGroups>, sys::error_code>
 load_static_dht_groups(fs::path root_dir, Async);
 
 class DhtGroups : public BaseDhtGroups {
+public:
+    using Groups = std::map<GroupName, std::set<cache::ResourceId>>;
+
 public:
     virtual ~DhtGroups() = default;
 
+    // Record changes to groups and their items in the given journal (if not null).
+    virtual void set_journal(cache::StoreJournal*) = 0;
+
+    // Groups and their items in this storage (not in fallback groups).
+    virtual Groups stored_groups() const = 0;
+
     [[nodiscard]]
     virtual std::expected<void, sys::error_code>
     add(const GroupName&, const cache::ResourceId&, Async) = 0;
@@ -61,6 +75,12 @@ public:
 std::expected<std::unique_ptr<DhtGroups>, sys::error_code>
 load_dht_groups(fs::path root_dir, Async);
 
+// Same as above, but use the given groups and items
+// (e.g. from a journal) instead of scanning `root_dir`.
+[[nodiscard]]
+std::expected<std::unique_ptr<DhtGroups>, sys::error_code>
+load_dht_groups(fs::path root_dir, DhtGroups::Groups, Async);
+
 // This is considered read-write and safe.
 // When iterating over groups, fallback groups are merged into read-write groups.
 // Read-write operations do not affect fallback groups.
@@ -69,4 +89,11 @@ load_dht_groups(fs::path root_dir, Async);
 std::expected<std::unique_ptr<DhtGroups>, sys::error_code>
 load_backed_dht_groups(fs::path root_dir, std::unique_ptr<BaseDhtGroups> fallback_groups, Async);
 
+// Same as above, but use the given groups and items
+// (e.g. from a journal) instead of scanning `root_dir`.
+[[nodiscard]]
+std::expected<std::unique_ptr<DhtGroups>, sys::error_code>
+load_backed_dht_groups( fs::path root_dir, std::unique_ptr<BaseDhtGroups> fallback_groups
+                      , DhtGroups::Groups, Async);
+
 } // namespace ouinet
@@ -4,6 +4,7 @@
 #include <set>
 #include <bittorrent/mainline_dht.h>
 #include "peer_lookup.h"
+#include "swarm_peer_cache.h"
 
 namespace std {
     template<> struct hash<ouinet::bittorrent::NodeID> {
@@ -21,11 +22,25 @@ class DhtLookup : public PeerLookup<std::set<asio::ip::udp::endpoint>> {
 public:
     DhtLookup(DhtLookup&&) = delete;
 
-    DhtLookup(std::weak_ptr<bittorrent::DhtBase> dht_w, std::string swarm_name)
+    // If `peer_cache` is given, peers found by lookups are saved in it,
+    // and those already in it are used until the first lookup finishes.
+    DhtLookup( std::weak_ptr<bittorrent::DhtBase> dht_w
+             , std::string swarm_name
+             , std::shared_ptr<SwarmPeerCache> peer_cache = nullptr)
         : PeerLookup(std::move(swarm_name))
         , _dht_w(dht_w)
+        , _peer_cache(std::move(peer_cache))
     {
         _lookup_strategy_name = "DHT BEP5";
+
+        if (!_peer_cache) return;
+
+        if (auto e = _peer_cache->get(infohash())) {
+            auto age = SwarmPeerCache::Clock::now() - e->found;
+            seed_result( e->peers
+                       , std::chrono::duration_cast<Clock::duration>(age)
+                       , std::chrono::duration_cast<Clock::duration>(_peer_cache->ttl()));
+        }
     }
 
     std::shared_ptr<bittorrent::DhtBase> get_dht_lock() {
@@ -41,11 +56,18 @@ protected:
             return std::unexpected(asio::error::operation_aborted);
         }
 
-        return dht->tracker_get_peers(infohash(), yield);
+        auto peers = dht->tracker_get_peers(infohash(), yield);
+
+        if (peers && _peer_cache) {
+            _peer_cache->put(infohash(), *peers);
+        }
+
+        return peers;
     }
 
 private:
     std::weak_ptr<bittorrent::DhtBase> _dht_w;
+    std::shared_ptr<SwarmPeerCache> _peer_cache;
 };
 
 } // namespaces
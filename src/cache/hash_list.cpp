@@ -4,6 +4,8 @@
 #include "parse/number.h"
 #include "util/compat.h"
 #include "logger.h"
+#include "../constants.h"
+#include <algorithm>
 #include <expected>
 
 using namespace std;
@@ -44,7 +46,7 @@ struct Parser {
 
     Data buffer;
 
-    void append_data(const Data& data) {
+    void append_data(const util::SharedBytes& data) {
         buffer.insert(buffer.end(), data.begin(), data.end());
     }
 
@@ -127,6 +129,11 @@ std::expected<HashList, sys::error_code> HashList::load(
 
     raw_head.result(*orig_status);
 
+    // Not covered by signatures, so remove it before verifying the head.
+    auto pipeline_depth_sv = raw_head[http_::response_pipeline_depth_hdr];
+    auto pipeline_depth = parse::number<size_t>(pipeline_depth_sv);
+    raw_head.erase(http_::response_pipeline_depth_hdr);
+
     auto head_o = SignedHead::verify_and_create(std::move(raw_head), pk);
 
     if (!head_o) {
@@ -211,6 +218,7 @@ std::expected<HashList, sys::error_code> HashList::load(
     }
 
     HashList hs{std::move(*head_o), std::move(blocks)};
+    hs.pipeline_depth = std::clamp<size_t>(pipeline_depth.value_or(1), 1, max_pipeline_depth);
 
     if (!hs.verify()) {
         return std::unexpected(bad_msg);
@@ -235,6 +243,8 @@ HashList::write(GenericStream& con, Async y) const
     h.set(ORIGINAL_STATUS, util::str(h.result_int()));
     h.result(http::status::ok);
     h.set(http::field::content_length, to_string(content_length));
+    if (pipeline_depth > 1)
+        h.set(http_::response_pipeline_depth_hdr, to_string(pipeline_depth));
 
     std::vector<asio::const_buffer> bufs;
     bufs.reserve(2 /* 2 = MAGIC + "\n" */ + blocks.size() * 2 /* 2 = signature + digest */);
@@ -13,7 +13,7 @@ namespace ouinet {
 
 namespace ouinet::cache {
 
-struct OUINET_CLIENT_API HashList {
+struct OUINET_COMMON_API HashList {
     using Digest    = util::SHA512::digest_type;
     using PubKey    = sign::PublicKey;
 
@@ -25,6 +25,15 @@ struct OUINET_CLIENT_API HashList {
     SignedHead         signed_head;
     std::vector<Block> blocks;
 
+    // Block requests which the peer sending the list accepts in flight
+    // on a single connection (not signed, see `http_::response_pipeline_depth_hdr`).
+    std::size_t pipeline_depth = 1;
+
+    // Bigger depths advertised by peers are reduced to this
+    // (like the default fetch window of `MultiPeerReader`,
+    // so a single peer cannot take more requests than are made at once).
+    static constexpr std::size_t max_pipeline_depth = 16;
+
     bool verify() const;
 
     static
@@ -24,8 +24,10 @@
 #include "../util.h"
 #include "../util/bytes.h"
 #include "../util/compat.h"
+#include "../util/crypto_pool.h"
 #include "../util/hash.h"
 #include "../util/quantized_buffer.h"
+#include "../util/shared_bytes.h"
 #include "../util/variant.h"
 
 namespace ouinet { namespace cache {
@@ -416,13 +418,40 @@ http_signature( const http::response_header<>& rsh
 
 using optional_part = std::optional<http_response::Part>;
 
+// Pooled buffers fit exactly one data block.
+static_assert(util::BytePool::default_slab_size == http_::response_data_block);
+
 struct SigningReader::Impl {
+    // Hashing and signing of data blocks happens in the crypto pool
+    // (one block at a time and in order), while the next block is read.
+    // This state is only used there until the last block is done.
+    struct BlockSigner {
+        const std::string injection_id;
+        const sign::SecretKey sk;
+        util::SHA256 body_hash;
+        ChainHasher chain_hasher;
+
+        BlockSigner(std::string id, sign::SecretKey key)
+            : injection_id(std::move(id)), sk(std::move(key))
+        {}
+
+        ChainHash sign_block(const util::SharedBytes& block) {
+            body_hash.update(block.buffer());
+            return chain_hasher.calculate_block(
+                    block.size(), util::sha512_digest(block.buffer()),
+                    ChainHasher::Signer{injection_id, sk});
+        }
+    };
+
     const http::request_header<> _rqh;
     const std::string _injection_id;
     const std::chrono::seconds::rep _injection_ts;
     const sign::SecretKey _sk;
     const std::string _httpsig_key_id;
-    ChainHasher _chain_hasher;
+    std::shared_ptr<BlockSigner> _block_signer;
+    util::CryptoPool::Lane _crypto_lane;
+    // For the last data block sent.
+    util::CryptoPool::Job<ChainHash> _block_job;
 
     Impl( http::request_header<> rqh
         , std::string injection_id
@@ -433,9 +462,16 @@ struct SigningReader::Impl {
         , _injection_ts(std::move(injection_ts))
         , _sk(std::move(sk))
         , _httpsig_key_id(SignedHead::encode_key_id(_sk.public_key()))
+        , _block_signer(std::make_shared<BlockSigner>(_injection_id, _sk))
     {
     }
 
+    void submit_block(util::SharedBytes block) {
+        _block_job = _crypto_lane.submit([s = _block_signer, b = std::move(block)] {
+            return s->sign_block(b);
+        });
+    }
+
     bool _do_inject = false;
     http::response_header<> _outh;
 
@@ -471,44 +507,39 @@ struct SigningReader::Impl {
     }
 
     size_t _body_length = 0;
-    size_t _block_offset = 0;
-    size_t _block_size_last = 0;
-    util::SHA256 _body_hash;
-    util::SHA512 _block_hash;
     // Simplest implementation: one output chunk per data block.
     util::quantized_buffer _qbuf{http_::response_data_block};
+    util::SharedBytesWriter _block_writer;
     std::queue<http_response::Part> _pending_parts;
 
     // If a whole data block has been processed,
     // return a chunk header and keep block as chunk body.
     optional_part
-    process_part(std::vector<uint8_t> inbuf, Cancel, asio::yield_context)
+    process_part(const util::SharedBytes& inbuf, Cancel, asio::yield_context y)
     {
-        // Just count transferred data and feed the hash.
+        // Just count transferred data.
         _body_length += inbuf.size();
-        if (_do_inject) _body_hash.update(inbuf);
-        _qbuf.put(asio::buffer(inbuf));
+        _qbuf.put(inbuf.buffer());
         auto block_buf =
             (inbuf.size() > 0) ? _qbuf.get() : _qbuf.get_rest();  // send rest if no more input
 
         if (block_buf.size() == 0)
             return std::nullopt;  // no data to send yet
         // Keep block as chunk body.
-        auto block_vec = util::bytes::to_vector<uint8_t>(block_buf);
-        _pending_parts.push(http_response::ChunkBody(std::move(block_vec), 0));
+        if (!_block_writer.pool())
+            _block_writer = util::SharedBytesWriter(util::BytePool::get(y.get_executor()));
+        auto block = _block_writer.copy(block_buf);
+        _pending_parts.push(http_response::ChunkBody(block, 0));
 
         http_response::ChunkHdr ch(block_buf.size(), {});
 
         if (_do_inject) {  // if injecting and sending data
-            if (_block_offset > 0) {  // add chunk extension for previous block
-                auto chain_hash = _chain_hasher.calculate_block(
-                        _block_size_last, _block_hash.close(),
-                        ChainHasher::Signer{_injection_id, _sk});
-
+            if (_block_job.valid()) {  // add chunk extension for previous block
+                // It was hashed and signed while this block was being read.
+                auto chain_hash = _block_job.wait(Async(y));
                 ch.exts = block_chunk_ext(chain_hash.chain_signature);
             }  // else CHASH[0]=SHA2-512(DHASH[0])
-            _block_hash.update(block_buf);
-            _block_offset += (_block_size_last = block_buf.size());
+            submit_block(std::move(block));
         }
 
         return http_response::Part(std::move(ch));  // pass data on, drop origin extensions
@@ -531,7 +562,7 @@ struct SigningReader::Impl {
         if (_is_done) return std::nullopt;  // avoid adding a last chunk indefinitely
 
         sys::error_code ec;
-        auto last_block_ch = process_part(std::vector<uint8_t>(), cancel, yield[ec]);
+        auto last_block_ch = process_part(util::SharedBytes(), cancel, yield[ec]);
         return_or_throw_on_error(yield, cancel, ec, std::nullopt);
         if (last_block_ch) return last_block_ch;
 
@@ -542,14 +573,16 @@ struct SigningReader::Impl {
             return http_response::Part(http_response::ChunkHdr());
         }
 
-        auto chain_hash = _chain_hasher.calculate_block(_block_size_last,
-                _block_hash.close(), ChainHasher::Signer{_injection_id, _sk});
+        if (!_block_job.valid()) submit_block({});  // empty body
+        auto chain_hash = _block_job.wait(Async(yield));
+        // No more blocks are being processed.
+        auto body_digest = _block_signer->body_hash.close();
 
         auto last_ch = http_response::ChunkHdr(
                 0, block_chunk_ext(chain_hash.chain_signature));
 
         auto trailer = cache::http_injection_trailer( _outh, std::move(_trailer_in)
-                                                    , _body_length, _body_hash.close()
+                                                    , _body_length, body_digest
                                                     , _sk
                                                     , _httpsig_key_id);
 
@@ -708,17 +741,75 @@ struct VerifyingReader::Impl {
     SignedHead _head;  // verified head; keep for later use
     boost::optional<size_t> _range_begin, _range_end;
     size_t _block_offset = 0;
-    std::vector<uint8_t> _block_data;
+    // The data block being received is accumulated in `_block_buf`,
+    // prepared from `_block_writer` for a whole block.
+    util::SharedBytesWriter _block_writer;
+    asio::mutable_buffer _block_buf;
+    size_t _block_size = 0;
+
+    // Hashing and verification of data blocks happens in the crypto pool
+    // (one block at a time and in order), while the next block is read.
+    // This state is only used there until the last block is done.
+    struct BlockVerifier {
+        const sign::PublicKey pk;
+        const std::string injection_id;
+        util::SHA256 body_hash;
+        ChainHasher chain_hasher;
+        opt_block_digest_t prev_block_dig;
+
+        struct Result {
+            bool ok;
+            opt_block_digest_t prev_block_dig;  // to send along the block signature
+        };
+
+        BlockVerifier(sign::PublicKey key, std::string id)
+            : pk(std::move(key)), injection_id(std::move(id))
+        {}
+
+        Result verify_block( const util::SharedBytes& block
+                           , const sign::Signature& sig
+                           , size_t offset
+                           , opt_block_digest_t range_prev_dig)
+        {
+            body_hash.update(block.buffer());
+
+            // TODO: implement `ouipsig`
+            // We lack the chain hash of the previous data blocks,
+            // it should have been included along this block's signature.
+            if (range_prev_dig) {
+                prev_block_dig = range_prev_dig;
+                chain_hasher.set_prev_chained_digest(*range_prev_dig);
+                chain_hasher.set_offset(offset);
+            }
+
+            auto chain_hash = chain_hasher.calculate_block(
+                    block.size(), util::sha512_digest(block.buffer()), sig);
+            if (!chain_hash.verify(pk, injection_id)) return {false, {}};
+
+            // Prepare hash for next data block: CHASH[i]=SHA2-512(CHASH[i-1] DHASH[i])
+            return {true, std::exchange(prev_block_dig, chain_hash.chain_digest)};
+        }
+    };
+
+    // A data block being verified, to be sent when done.
+    struct PendingBlock {
+        util::CryptoPool::Job<BlockVerifier::Result> job;
+        util::SharedBytes data;
+        size_t offset;
+        sign::Signature sig;
+        size_t next_size;  // of the chunk header that carried the signature
+    };
+
+    std::shared_ptr<BlockVerifier> _block_verifier;
+    util::CryptoPool::Lane _crypto_lane;
+    std::optional<PendingBlock> _pending_block;
 
-    ChainHasher _chain_hasher;
-    opt_block_digest_t _prev_block_dig;
     // Simplest implementation: one output chunk per data block.
-    // If a whole data block has been processed,
-    // return its chunk header and push the block as its chunk body.
+    // Once a whole data block has been verified,
+    // push it as a chunk body followed by the chunk header for the next one.
     std::queue<http_response::Part> _pending_parts;
 
     size_t _body_length = 0;
-    util::SHA256 _body_hash;
 
     bool _is_done = false;
 
@@ -812,7 +903,8 @@ struct VerifyingReader::Impl {
             _range_end = br->last + 1;
         }
 
-        _block_data.reserve(_head.block_size());
+        _block_writer = util::SharedBytesWriter(util::BytePool::get(y.get_executor()));
+        _block_verifier = std::make_shared<BlockVerifier>(_head.public_key(), _head.injection_id());
 
         // Return head with the status we got at the beginning.
         auto out_head = _head;
@@ -828,6 +920,35 @@ struct VerifyingReader::Impl {
         return http_response::Part(std::move(out_head));
     }
 
+    // Wait for the pending data block to be verified,
+    // then queue it to be sent followed by the next chunk header.
+    void
+    send_pending_block(asio::yield_context y)
+    {
+        auto block = std::move(*_pending_block);
+        _pending_block.reset();
+
+        auto result = block.job.wait(Async(y));
+        if (!result.ok) {
+            LOG_WARN("Failed to verify data block with offset ", block.offset, "; uri=", _head.uri());
+            return or_throw(y, sys::errc::make_error_code(sys::errc::bad_message));
+        }
+
+        // TODO: implement `ouipsig`
+        _pending_parts.push(http_response::ChunkBody(std::move(block.data), 0));
+        _pending_parts.push(http_response::ChunkHdr(
+                block.next_size, block_chunk_ext(block.sig, result.prev_block_dig)));
+    }
+
+    optional_part
+    pop_pending_part()
+    {
+        if (_pending_parts.empty()) return std::nullopt;
+        auto part = std::move(_pending_parts.front());
+        _pending_parts.pop();
+        return part;
+    }
+
     optional_part
     process_part(http_response::ChunkHdr inch, Cancel cancel, asio::yield_context y)
     {
@@ -841,9 +962,14 @@ struct VerifyingReader::Impl {
         // An empty data block is fine if this is the last chunk header
         // (a chunk for it will not be produced, though).
 
-        if (_block_data.size() == 0) {
+        if (_block_size == 0) {
             // This is the first chunk header
-            return http_response::Part{std::move(inch)};
+            if (!_pending_block) return http_response::Part{std::move(inch)};
+            sys::error_code ec;
+            send_pending_block(y[ec]);
+            if (ec) return or_throw(y, ec, std::nullopt);
+            _pending_parts.push(std::move(inch));
+            return pop_pending_part();
         }
 
         // Verify the whole data block.
@@ -856,52 +982,56 @@ struct VerifyingReader::Impl {
         // TODO: implement `ouipsig`
         // We lack the chain hash of the previous data blocks,
         // it should have been included along this block's signature.
+        opt_block_digest_t range_prev_dig;
         if (_range_begin && _block_offset > 0 && _block_offset == *_range_begin) {
-            assert(!_prev_block_dig);
-            _prev_block_dig = block_dig_from_exts(inch.exts);
-            if (!_prev_block_dig) {
+            range_prev_dig = block_dig_from_exts(inch.exts);
+            if (!range_prev_dig) {
                 LOG_WARN( "Missing chain hash for data block with offset "
                         , _block_offset - _head.block_size(), "; uri=", _head.uri());
                 return or_throw(y, sys::errc::make_error_code(sys::errc::bad_message), std::nullopt);
             }
-            _chain_hasher.set_prev_chained_digest(*_prev_block_dig);
-            _chain_hasher.set_offset(_block_offset);
         }
 
-        auto chain_hash = _chain_hasher.calculate_block(_block_data.size(), util::sha512_digest(_block_data), sign::Signature(*block_sig));
+        // Verify the block in the crypto pool while the next one is received,
+        // and send the previous one if it is already verified.
+        auto data = _block_writer.commit(std::exchange(_block_size, 0));
+        auto job = _crypto_lane.submit([ v = _block_verifier, data, sig = *block_sig
+                                       , offset = _block_offset, range_prev_dig ] {
+            return v->verify_block(data, sig, offset, range_prev_dig);
+        });
 
-        if (!chain_hash.verify(_head.public_key(), _head.injection_id())) {
-            LOG_WARN("Failed to verify data block with offset ", _block_offset, "; uri=", _head.uri());
-            return or_throw(y, sys::errc::make_error_code(sys::errc::bad_message), std::nullopt);
+        sys::error_code ec;
+        if (_pending_block) {
+            send_pending_block(y[ec]);
+            if (ec) return or_throw(y, ec, std::nullopt);
         }
 
-        // Prepare hash for next data block: CHASH[i]=SHA2-512(CHASH[i-1] DHASH[i])
-        _block_offset += _block_data.size();
-
-        // TODO: implement `ouipsig`
-        http_response::ChunkHdr ch(inch.size, block_chunk_ext(*block_sig, _prev_block_dig));
-        _pending_parts.push(std::move(ch));
+        _pending_block = PendingBlock{ std::move(job), std::move(data)
+                                     , _block_offset, *block_sig, inch.size};
+        _block_offset += _pending_block->data.size();
 
-        _prev_block_dig = chain_hash.chain_digest;
+        if (inch.size == 0) {  // last chunk, no more blocks to overlap with
+            send_pending_block(y[ec]);
+            if (ec) return or_throw(y, ec, std::nullopt);
+        }
 
-        // Chunk header for data block (with previous extensions),
-        // keep data block as chunk body.
-        http_response::ChunkBody cb(std::move(_block_data), 0);
-        return http_response::Part(std::move(cb));
+        return pop_pending_part();
     }
 
     optional_part
-    process_part(std::vector<uint8_t> ind, Cancel, asio::yield_context y)
+    process_part(const util::SharedBytes& ind, Cancel, asio::yield_context y)
     {
         _body_length += ind.size();
-        _body_hash.update(ind);
 
-        if (_block_data.size() + ind.size() > _head.block_size()) {
+        if (_block_size + ind.size() > _head.block_size()) {
             LOG_ERROR("Chunk data overflows data block boundary; uri=", _head.uri());
             return or_throw(y, sys::errc::make_error_code(sys::errc::bad_message), std::nullopt);
         }
 
-        _block_data.insert(_block_data.end(), ind.begin(), ind.end());
+        if (ind.empty()) return std::nullopt;
+        if (_block_size == 0) _block_buf = _block_writer.prepare(_head.block_size());
+        asio::buffer_copy(_block_buf + _block_size, ind.buffer());
+        _block_size += ind.size();
 
         // Data is returned when processing chunk headers.
         return std::nullopt;
@@ -938,6 +1068,12 @@ struct VerifyingReader::Impl {
         if (_is_done) return;  // avoid re-checking body indefinitely
         _is_done = true;
 
+        if (_pending_block) {
+            LOG_WARN("Body ended with unverified data block; uri=", _head.uri());
+            ec = sys::errc::make_error_code(sys::errc::bad_message);
+            return;
+        }
+
         // Check body length.
         auto h_body_length_h = _head[http_::response_data_size_hdr];
         auto h_body_length = parse::number<size_t>(h_body_length_h);
@@ -960,7 +1096,7 @@ struct VerifyingReader::Impl {
         // Get body digest value.
         if (_range_begin && (*_range_begin > 0 || *_range_end < *h_body_length))
             return;  // partial body, cannot check digest
-        auto b_digest = http_digest(_body_hash);
+        auto b_digest = http_digest(_block_verifier->body_hash);  // no blocks pending
         auto b_digest_s = split_string_pair(b_digest, '=');
 
         // Get digest values in head and compare (if algorithm matches).
@@ -3,6 +3,7 @@
 
 #include <array>
 #include <ctime>
+#include <set>
 #include <string>
 
 #include <boost/asio/buffer.hpp>
@@ -32,6 +33,7 @@
 #include "../util/str.h"
 #include "../util/variant.h"
 #include "signed_head.h"
+#include "sigs_file.h"
 #include "chain_hasher.h"
 
 #define _LOGPFX "HTTP store: "
@@ -97,6 +99,14 @@ block_sig_from_exts(boost::string_view xs)
     return xs.substr(sigstart, sigend - sigstart);
 }
 
+// How much of an incomplete response is already stored,
+// up to the last block which has a signature.
+struct ResumePoint {
+    std::size_t blocks;  // number of blocks with a signature
+    std::size_t data_size;  // size of their data
+    sigs_file::Record last;  // record of the last one
+};
+
 class SplittedWriter {
 public:
     SplittedWriter(const fs::path& dirp, const AsioExecutor& ex)
@@ -108,6 +118,7 @@ private:
 
     std::string uri;  // for warnings
     http_response::Head head;  // for merging in the trailer later on
+    bool head_written = false;
     boost::optional<async_file_handle> headf, bodyf, sigsf;
 
     std::size_t block_size;
@@ -116,6 +127,12 @@ private:
     util::SHA512 block_hash;
     ChainHasher chain_hasher;
 
+    // When resuming an incomplete response,
+    // incoming data and signatures which are already stored are skipped.
+    bool resuming = false;
+    std::size_t skip_bytes = 0;
+    std::size_t skip_sigs = 0;
+
     [[nodiscard]]
     inline
     std::expected<async_file_handle, sys::error_code>
@@ -126,12 +143,92 @@ private:
         return std::move(*f);
     }
 
+    // Write the whole head, replacing the one already written (if any).
+    [[nodiscard]]
+    std::expected<void, sys::error_code>
+    write_head(Async yield)
+    {
+        head_written = true;
+
+        // The stored head of a resumed response may be read meanwhile,
+        // and it must stay whole if writing fails,
+        // so replace it atomically instead of rewriting it.
+        if (resuming) {
+            auto af = util::atomic_file::make(ex, dirp / head_fname);
+            if (!af) return std::unexpected(af.error());
+            if (auto r = head.async_write(*af, yield); !r)
+                return std::unexpected(r.error());
+            sys::error_code ec;
+            af->commit(ec);
+            if (ec) return std::unexpected(ec);
+            return {};
+        }
+
+        if (!headf) {
+            auto hf = create_file(head_fname);
+            if (!hf) return std::unexpected(hf.error());
+            headf = std::move(*hf);
+        } else {
+            if (auto r = util::file_io::fseek(*headf, 0); !r)
+                return std::unexpected(r.error());
+            if (auto r = util::file_io::truncate(*headf, 0); !r)
+                return std::unexpected(r.error());
+        }
+
+        return head.async_write(*headf, yield);
+    }
+
 public:
+    // Continue writing the incomplete response stored under `dirp`
+    // right after the given point, which must have been computed for it.
+    //
+    // Anything stored beyond that point (e.g. data of a block
+    // whose signature was never received) is discarded.
+    //
+    // This must be called before writing any part.
+    [[nodiscard]]
+    std::expected<void, sys::error_code>
+    resume(const ResumePoint& rp)
+    {
+        assert(!head_written && !bodyf && !sigsf);
+
+        // Not all backends leave the position at the new end when truncating,
+        // so move there explicitly to avoid overwriting stored data.
+        auto bf = create_file(body_fname);
+        if (!bf) return std::unexpected(bf.error());
+        if (auto r = util::file_io::truncate(*bf, rp.data_size); !r)
+            return std::unexpected(r.error());
+        if (auto r = util::file_io::fseek(*bf, rp.data_size); !r)
+            return std::unexpected(r.error());
+
+        auto sigs_pos = sigs_file::record_position(rp.blocks);
+        auto sf = create_file(sigs_fname);
+        if (!sf) return std::unexpected(sf.error());
+        if (auto r = util::file_io::truncate(*sf, sigs_pos); !r)
+            return std::unexpected(r.error());
+        if (auto r = util::file_io::fseek(*sf, sigs_pos); !r)
+            return std::unexpected(r.error());
+
+        bodyf = std::move(*bf);
+        sigsf = std::move(*sf);
+
+        byte_count = rp.data_size;
+        block_count = rp.blocks;
+        chain_hasher.set_offset(rp.data_size);
+        chain_hasher.set_prev_chained_digest(rp.last.chained_digest);
+        chain_hasher.set_prev_chained_signature(sign::Signature(rp.last.signature));
+
+        resuming = true;
+        skip_bytes = rp.data_size;
+        skip_sigs = rp.blocks;
+        return {};
+    }
+
     [[nodiscard]]
     std::expected<void, sys::error_code>
     async_write_part(http_response::Head h, Async yield)
     {
-        assert(!headf);
+        assert(!head_written);
 
         // Get block size for future alignment checks.
         uri = std::string(h[http_::response_uri_hdr]);
@@ -153,12 +250,7 @@ public:
 
         // Dump the head without framing headers.
         head = http_injection_merge(std::move(h), {});
-
-        auto hf = create_file(head_fname);
-        if (!hf) return std::unexpected(hf.error());
-        headf = std::move(*hf);
-
-        return head.async_write(*headf, yield);
+        return write_head(yield);
     }
 
     [[nodiscard]]
@@ -169,59 +261,76 @@ public:
             auto sf = create_file(sigs_fname);
             if (!sf) return std::unexpected(sf.error());
             sigsf = std::move(*sf);
-        }
 
-        SigEntry e;
+            auto h = sigs_file::header();
+            if (auto r = util::file_io::write(*sigsf, asio::buffer(h), yield); !r)
+                return std::unexpected(r.error());
+        }
 
         // Only act when a chunk header with a signature is received;
         // upstream verification or the injector should have placed
         // them at the right chunk headers.
-        e.signature = std::string(block_sig_from_exts(ch.exts));
+        auto sig_b64 = block_sig_from_exts(ch.exts);
 
-        if (e.signature.empty()) return {};
+        if (sig_b64.empty()) return {};
 
-        auto sig = util::base64_decode<sign::Signature::Bytes>(e.signature);
+        auto sig = util::base64_decode<sign::Signature::Bytes>(sig_b64);
 
         if (!sig) return {};
 
+        if (skip_sigs > 0) {  // already stored
+            --skip_sigs;
+            return {};
+        }
+
+        sigs_file::Record rec;
+        rec.signature = *sig;
+
         // Check that signature is properly aligned with end of block
         // (except for the last block, which may be shorter).
-        e.offset = block_count * block_size;
+        rec.offset = block_count * block_size;
         block_count++;
         if (ch.size > 0 && byte_count != block_count * block_size) {
             _ERROR("Block signature is not aligned to block boundary; uri=", uri);
             return std::unexpected(asio::error::invalid_argument);
         }
 
-        auto block_digest = block_hash.close();
-
-        e.block_digest = util::base64_encode(block_digest);
-
-        // Encode the chained hash for the previous block.
-        if (chain_hasher.prev_chained_digest())
-            e.prev_chained_digest = util::base64_encode(*chain_hasher.prev_chained_digest());
+        rec.block_digest = block_hash.close();
 
-        // Prepare hash for next data block: CHASH[i]=SHA2-512(CHASH[i-1] BLOCK[i])
-        chain_hasher.calculate_block(ch.size, block_digest, sign::Signature(*sig));
+        // Compute the chained hash for this block: CHASH[i]=SHA2-512(SIG[i-1] CHASH[i-1] DHASH[i])
+        auto chash = chain_hasher.calculate_block(ch.size, rec.block_digest, sign::Signature(*sig));
+        rec.chained_digest = chash.chain_digest;
 
-        auto r = util::file_io::write(*sigsf, asio::buffer(e.str()), yield);
+        auto rec_bytes = rec.serialize();
+        auto r = util::file_io::write(*sigsf, asio::buffer(rec_bytes), yield);
         if (!r) return std::unexpected(r.error());
         return {};
     }
 
     [[nodiscard]]
     std::expected<void, sys::error_code>
-    async_write_part(std::vector<uint8_t> b, Async yield)
+    async_write_part(const util::SharedBytes& b, Async yield)
     {
+        // The data may still be in use elsewhere (e.g. being sent to the user agent),
+        // so just write from it instead of taking a copy.
+        auto data = b.buffer();
+
+        if (skip_bytes > 0) {  // already stored
+            auto skipped = std::min(skip_bytes, data.size());
+            skip_bytes -= skipped;
+            data += skipped;
+            if (data.size() == 0) return {};
+        }
+
         if (!bodyf) {
             auto bf = create_file(body_fname);
             if (!bf) return std::unexpected(bf.error());
             bodyf = std::move(*bf);
         }
 
-        byte_count += b.size();
-        block_hash.update(b);
-        auto r = util::file_io::write(*bodyf, asio::buffer(b), yield);
+        byte_count += data.size();
+        block_hash.update(data);
+        auto r = util::file_io::write(*bodyf, data, yield);
         if (!r) return std::unexpected(r.error());
         return {};
     }
@@ -230,31 +339,21 @@ public:
     std::expected<void, sys::error_code>
     async_write_part(http_response::Trailer t, Async yield)
     {
-        assert(headf);
+        assert(head_written);
 
         if (t.cbegin() == t.cend()) return {};
 
         // Extend the head with trailer headers and dump again.
         head = http_injection_merge(std::move(head), t);
-
-        if (auto r = util::file_io::fseek(*headf, 0); !r)
-            return std::unexpected(r.error());
-
-        if (auto r = util::file_io::truncate(*headf, 0); !r)
-            return std::unexpected(r.error());
-
-        if (auto r = head.async_write(*headf, yield); !r)
-            return std::unexpected(r.error());
-
-        return {};
+        return write_head(yield);
     }
 };
 
+[[nodiscard]]
+static
 std::expected<void, sys::error_code>
-http_store(http_response::AbstractReader& reader, const fs::path& dirp, Async yield)
+write_parts(SplittedWriter& writer, http_response::AbstractReader& reader, Async yield)
 {
-    SplittedWriter writer(dirp, yield.get_executor());
-
     while (true) {
         auto r = reader.async_read_part(yield);
         if (!r) return std::unexpected(r.error());
@@ -270,6 +369,103 @@ http_store(http_response::AbstractReader& reader, const fs::path& dirp, Async yi
     }
 }
 
+std::expected<void, sys::error_code>
+http_store(http_response::AbstractReader& reader, const fs::path& dirp, Async yield)
+{
+    SplittedWriter writer(dirp, yield.get_executor());
+    return write_parts(writer, reader, yield);
+}
+
+[[nodiscard]]
+static
+std::expected<http_response::Head, sys::error_code>
+read_head(http_response::AbstractReader& reader, Async yield)
+{
+    auto part = reader.async_read_part(yield);
+    if (!part) return std::unexpected(part.error());
+
+    auto head = *part ? (*part)->as_head() : nullptr;
+    if (!head) return std::unexpected(sys::errc::make_error_code(sys::errc::no_message));
+
+    return std::move(*head);
+}
+
+// Check whether the incomplete response stored under `dirp`
+// can be resumed with a response having the given head,
+// and return the point from which to resume it.
+[[nodiscard]]
+static
+std::expected<ResumePoint, sys::error_code>
+resume_point(const fs::path& dirp, const http_response::Head& head, Async yield)
+{
+    auto headf = util::file_io::open_readonly(yield.get_executor(), dirp / head_fname);
+    if (!headf) return std::unexpected(headf.error());
+
+    auto stored_head = ResourceReader::read_signed_head(*headf, yield);
+    if (!stored_head) return std::unexpected(stored_head.error());
+
+    // Data from a different injection may not match its signatures.
+    if ( stored_head->injection_id() != util::http_injection_id(head)
+       || (*stored_head)[http_::response_block_signatures_hdr] != head[http_::response_block_signatures_hdr])
+        return std::unexpected(asio::error::invalid_argument);
+
+    // Only complete responses get their data size in the head.
+    if (!(*stored_head)[http_::response_data_size_hdr].empty())
+        return std::unexpected(asio::error::already_open);
+
+    if (auto r = sigs_file::upgrade(dirp, yield); !r) return std::unexpected(r.error());
+
+    auto sigsm = sigs_file::MappedFile::open(dirp / sigs_fname);
+    if (!sigsm) return std::unexpected(sigsm.error());
+    if (sigsm->size() == 0) return std::unexpected(asio::error::no_data);
+
+    ResumePoint rp{ sigsm->size()
+                  , sigsm->size() * stored_head->block_size()
+                  , (*sigsm)[sigsm->size() - 1]};
+
+    // Signed blocks are full, except maybe the last one of a complete response.
+    sys::error_code ec;
+    auto body_size = fs::file_size(dirp / body_fname, ec);
+    if (ec) return std::unexpected(ec);
+    if (body_size < rp.data_size) return std::unexpected(asio::error::no_data);
+
+    return rp;
+}
+
+// Store a response with the given head (already read)
+// and the rest of parts coming from the given reader,
+// maybe resuming an incomplete response from the given point.
+[[nodiscard]]
+static
+std::expected<void, sys::error_code>
+store_with_head( http_response::Head head, http_response::AbstractReader& reader
+               , const fs::path& dirp, const ResumePoint* rp
+               , Async yield)
+{
+    SplittedWriter writer(dirp, yield.get_executor());
+
+    if (rp) {
+        if (auto r = writer.resume(*rp); !r) return std::unexpected(r.error());
+    }
+
+    if (auto r = writer.async_write_part(std::move(head), yield); !r)
+        return std::unexpected(r.error());
+
+    return write_parts(writer, reader, yield);
+}
+
+std::expected<void, sys::error_code>
+http_store_resume(http_response::AbstractReader& reader, const fs::path& dirp, Async yield)
+{
+    auto head = read_head(reader, yield);
+    if (!head) return std::unexpected(head.error());
+
+    auto rp = resume_point(dirp, *head, yield);
+    if (!rp) return std::unexpected(rp.error());
+
+    return store_with_head(std::move(*head), reader, dirp, &*rp, yield);
+}
+
 // Since content loaded from the local cache is not verified
 // before sending it to the requester,
 // we must make extra sure that we are not tricked into reading
@@ -594,9 +790,6 @@ http_store_load_hash_list(const fs::path& dir, Async yield)
     auto headf = util::file_io::open_readonly(exec, dir / head_fname);
     if (!headf) return std::unexpected(headf.error());
 
-    auto sigsf = util::file_io::open_readonly(exec, dir / sigs_fname);
-    if (!sigsf) return std::unexpected(sigsf.error());
-
     HashList hl;
 
     if (auto r = ResourceReader::read_signed_head(*headf, yield)) {
@@ -606,6 +799,27 @@ http_store_load_hash_list(const fs::path& dir, Async yield)
         return std::unexpected(r.error());
     }
 
+    // Binary signature files are mapped and their records used as is.
+    if (auto sigsm = sigs_file::MappedFile::open(dir / sigs_fname)) {
+        hl.blocks.reserve(sigsm->size());
+        for (std::size_t b = 0; b < sigsm->size(); ++b) {
+            auto rec = (*sigsm)[b];
+            hl.blocks.push_back({rec.block_digest, {rec.signature}});
+        }
+
+        if (hl.blocks.empty()) {
+            return std::unexpected(asio::error::not_found);
+        }
+
+        assert(hl.verify()); // Only in debug mode
+
+        return hl;
+    }
+
+    // Fall back to parsing the legacy text format.
+    auto sigsf = util::file_io::open_readonly(exec, dir / sigs_fname);
+    if (!sigsf) return std::unexpected(sigsf.error());
+
     std::string sig_buffer;
 
     while(true) {
@@ -850,6 +1064,9 @@ public:
     std::expected<void, sys::error_code>
     for_each(keep_func, Async) override;
 
+    std::expected<std::set<ResourceId>, sys::error_code>
+    list() const override;
+
     [[nodiscard]]
     std::expected<void, sys::error_code>
     store( const ResourceId& resource_id, http_response::AbstractReader&, Async) override;
@@ -876,14 +1093,40 @@ public:
     size(Async yield) const override
     { return read_store->size(yield); }
 
+    [[nodiscard]]
+    std::expected<std::size_t, sys::error_code>
+    entry_size(const ResourceId&) const override;
+
+    [[nodiscard]]
+    std::expected<void, sys::error_code>
+    remove(const ResourceId&) override;
+
     std::expected<HashList, sys::error_code>
     load_hash_list(const ResourceId& resource_id, Async yield) const override
-    { return read_store->load_hash_list(resource_id, yield); }
+    {
+        // Entries stored by older versions are upgraded on the fly,
+        // so that further loads can use the mapped binary signatures.
+        upgrade_sigs(path_from_resource_id(path, resource_id), yield);
+        return read_store->load_hash_list(resource_id, yield);
+    }
+
+protected:
+    static
+    void
+    upgrade_sigs(const fs::path& kpath, Async yield)
+    {
+        auto r = sigs_file::upgrade(kpath, yield);
+        if (!r) _WARN("Failed to upgrade signatures of cached response: ", kpath, "; ec=", r.error());
+        else if (*r) _DEBUG("Upgraded signatures of cached response: ", kpath);
+    }
 
 protected:
     fs::path path;
     AsioExecutor executor;
     std::unique_ptr<BaseHttpStore> read_store;
+
+    // Incomplete responses currently being extended in place.
+    std::set<ResourceId> resuming;
 };
 
 std::expected<void, sys::error_code>
@@ -931,6 +1174,8 @@ FullHttpStore::for_each(keep_func keep, Async yield)
                 continue;
             }
 
+            upgrade_sigs(p, yield);
+
             auto rr = http_store_reader(p, yield);
             if (!rr) {
                _WARN("Failed to open cached response: ", p, "; ec=", rr.error());
@@ -949,6 +1194,37 @@ FullHttpStore::for_each(keep_func keep, Async yield)
     return {};
 }
 
+std::expected<std::set<ResourceId>, sys::error_code>
+FullHttpStore::list() const
+{
+    std::set<ResourceId> ret;
+    sys::error_code ec;
+
+    // Same checks as in `for_each`, but silently skipping unknown entries.
+    for (fs::directory_iterator pit(path, ec); !ec && pit != fs::directory_iterator(); pit.increment(ec)) {
+        auto& pp = *pit;
+        if (!fs::is_directory(pp)) continue;
+
+        auto pp_name_s = pp.path().filename().native();
+        if (!boost::regex_match(pp_name_s.begin(), pp_name_s.end(), parent_name_rx)) continue;
+
+        for (fs::directory_iterator it(pp, ec); !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            auto& p = *it;
+            if (!fs::is_directory(p)) continue;
+
+            auto p_name_s = p.path().filename().native();
+            if (!boost::regex_match(p_name_s.begin(), p_name_s.end(), dir_name_rx)) continue;
+
+            if (auto resource_id = cache::ResourceId::from_hex(pp_name_s + p_name_s))
+                ret.insert(std::move(*resource_id));
+        }
+        if (ec) return std::unexpected(ec);
+    }
+    if (ec) return std::unexpected(ec);
+
+    return ret;
+}
+
 std::expected<void, sys::error_code>
 FullHttpStore::store(const ResourceId& resource_id, http_response::AbstractReader& reader, Async yield)
 {
@@ -960,12 +1236,27 @@ FullHttpStore::store(const ResourceId& resource_id, http_response::AbstractReade
     fs::create_directory(kpath_parent, ec);
     if (ec) return std::unexpected(ec);
 
+    auto head = read_head(reader, yield);
+    if (!head) return std::unexpected(head.error());
+
+    // An incomplete copy of the same response is extended in place,
+    // so that data already stored is not written again.
+    if (!resuming.contains(resource_id)) {
+        if (auto rp = resume_point(kpath, *head, yield)) {
+            _DEBUG( "Resuming incomplete stored response; resource_id=", resource_id
+                  , " blocks=", rp->blocks);
+            resuming.insert(resource_id);
+            auto on_exit = defer([&] { resuming.erase(resource_id); });
+            return store_with_head(std::move(*head), reader, kpath, &*rp, yield);
+        }
+    }
+
     // Replacing a directory is not an atomic operation,
     // so try to remove the existing entry before committing.
     auto dir = util::atomic_dir::make(kpath, ec);
     if (ec) return std::unexpected(ec);
 
-    if (auto r = http_store(reader, dir->temp_path(), yield); !r) {
+    if (auto r = store_with_head(std::move(*head), reader, dir->temp_path(), nullptr, yield); !r) {
         return std::unexpected(r.error());
     }
 
@@ -987,6 +1278,41 @@ FullHttpStore::store(const ResourceId& resource_id, http_response::AbstractReade
     }
 }
 
+std::expected<std::size_t, sys::error_code>
+FullHttpStore::entry_size(const ResourceId& resource_id) const
+{
+    auto kpath = path_from_resource_id(path, resource_id);
+
+    // Response directories are flat, no need to recurse.
+    sys::error_code ec;
+    fs::directory_iterator dit(kpath, ec);
+    if (ec) return std::unexpected(ec);
+
+    std::size_t total = 0;
+    for (; dit != fs::directory_iterator(); ++dit) {
+        auto is_file = fs::is_regular_file(dit->path(), ec);
+        if (ec) return std::unexpected(ec);
+        if (!is_file) continue;
+        auto file_size = fs::file_size(dit->path(), ec);
+        if (ec) return std::unexpected(ec);
+        total += file_size;
+    }
+    return total;
+}
+
+std::expected<void, sys::error_code>
+FullHttpStore::remove(const ResourceId& resource_id)
+{
+    auto kpath = path_from_resource_id(path, resource_id);
+
+    _DEBUG("Removing cached response: ", kpath);
+    sys::error_code ec;
+    fs::remove_all(kpath, ec);
+    if (ec) return std::unexpected(ec);
+    // The parent directory may be left empty.
+    return {};
+}
+
 std::unique_ptr<HttpStore>
 make_http_store(fs::path path, AsioExecutor ex)
 {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <functional>
+#include <set>
 #include <utility>
 
 #include <boost/asio/executor.hpp>
@@ -58,18 +59,29 @@ using reader_uptr = std::unique_ptr<http_response::AbstractReader>;
 //
 //   - `body`: This is the raw body data (flat, no chunking or other framing).
 //
-//   - `sigs`: This contains block signatures and chained hashes.  It consists of
-//     fixed length, LF-terminated lines with the following format
+//   - `sigs`: This contains block signatures and chained hashes in binary form.
+//     It starts with an 8-byte header `"OUISIGS" VERSION` (with `VERSION=1`)
+//     followed by fixed length records with the following format
 //     for blocks i=0,1...:
 //
-//         PAD016_LHEX(OFFSET[i])<SP>BASE64(SIG[i])<SP>BASE64(DHASH[i])<SP>BASE64(CHASH[i-1])
+//         BE64(OFFSET[i]) SIG[i] DHASH[i] CHASH[i]
 //
-//     Where `PAD016_LHEX(x)` represents `x` in lower-case hexadecimal, zero-padded to 16 characters,
-//     `BASE64(CHASH[-1])` is established as `BASE64('\0' * 64)` (for padding the first line),
+//     Where `BE64(x)` represents `x` as a big-endian, 64-bit unsigned integer,
+//     `SIG[i]` is the raw, 64-byte Ed25519 signature of the block,
 //     `SIG[-1]` and `CHASH[-1]` are established as the empty string (for `CHASH[0]` computation),
 //     `DHASH[i]=SHA2-512(DATA[i])` (block data hash)
 //     `CHASH[i]=SHA2-512(SIG[i-1] CHASH[i-1] DHASH[i])` (block chain hash).
 //
+//     Since every record is 200 bytes long, the one for block `i` is at `8 + 200*i`,
+//     and the file may be memory-mapped and indexed directly (see `sigs_file.h`).
+//
+//     Files in the legacy `data-v4` text format, with fixed length, LF-terminated lines
+//
+//         PAD016_LHEX(OFFSET[i])<SP>BASE64(SIG[i])<SP>BASE64(DHASH[i])<SP>BASE64(CHASH[i-1])
+//
+//     (where `BASE64(CHASH[-1])` is `BASE64('\0' * 64)`) are still supported for reading,
+//     and they are converted to the binary format as the store comes across them.
+//
 // Some reading functions below allow specifying a *content directory* that
 // holds an arbitrary hierarchy containing body data files
 // outside of the directory storing the response.
@@ -78,14 +90,25 @@ using reader_uptr = std::unique_ptr<http_response::AbstractReader>;
 // with forward slashes as path separators, without `.` or `..` components,
 // and without a final new line.
 // Such responses need to be stored using external tools.
-OUINET_CLIENT_API
+OUINET_COMMON_API
 [[nodiscard]]
 std::expected<void, sys::error_code>
 http_store(http_response::AbstractReader&, const fs::path&, Async);
-// TODO: This format is both inefficient for multi-peer downloads (Base64 decoding needed)
-// and inadequate for partial responses (`ouipsig` is in previous `sigs` file line, maybe missing).
-// A format with binary records or just SIG/DHASH/CHASH of the *current* block might be more convenient
-// (DHASH may be zero in the first record).
+
+// Same as above, but extend an incomplete response
+// already stored in the given directory, instead of writing a new one.
+//
+// The reader must provide the whole response from its beginning,
+// and it must come from the same injection as the stored one.
+// Data and signatures of blocks already stored with a signature are skipped,
+// then the rest of the response is appended to existing files.
+//
+// If the stored response is complete, or it can not be extended
+// with the given response, an error is reported and nothing is written.
+OUINET_COMMON_API
+[[nodiscard]]
+std::expected<void, sys::error_code>
+http_store_resume(http_response::AbstractReader&, const fs::path&, Async);
 
 // Return a new reader for a response under the given directory `dirp`.
 //
@@ -100,7 +123,7 @@ http_store(http_response::AbstractReader&, const fs::path&, Async);
 // but cause `boost::asio::error::connection_aborted` ("Software caused connection abort")
 // when no more body data is available.
 // To detect such cases beforehand, use `http_store_body_size`.
-OUINET_CLIENT_API
+OUINET_COMMON_API
 [[nodiscard]]
 std::expected<reader_uptr, sys::error_code>
 http_store_reader(const fs::path& dirp, Async);
@@ -114,7 +137,7 @@ http_store_reader(const fs::path& dirp, Async);
 // (e.g. to check that they are not outside of the content directory),
 // none are performed on `cdirp` itself.
 // Please make sure that `cdirp` is already in canonical form or some checks may fail.
-OUINET_CLIENT_API
+OUINET_COMMON_API
 [[nodiscard]]
 std::expected<reader_uptr, sys::error_code>
 http_store_reader(const fs::path& dirp, const fs::path& cdirp, Async);
@@ -134,7 +157,7 @@ http_store_reader(const fs::path& dirp, const fs::path& cdirp, Async);
 // If the range would cover data which is not stored,
 // a `boost::system::errc::invalid_seek` error is reported
 // (which may be interpreted as HTTP status `416 Range Not Satisfiable`).
-OUINET_CLIENT_API
+OUINET_COMMON_API
 [[nodiscard]]
 std::expected<reader_uptr, sys::error_code>
 http_store_range_reader( const fs::path& dirp
@@ -164,7 +187,7 @@ http_store_range_reader( const fs::path& dirp, const fs::path& cdirp
 // a `sys::errc::no_such_file_or_directory` error is reported.
 // If the response exists, but it is missing body data,
 // an `asio::error::no_data` error is reported.
-OUINET_CLIENT_API
+OUINET_COMMON_API
 [[nodiscard]]
 std::expected<std::size_t, sys::error_code>
 http_store_body_size(const fs::path& dirp, AsioExecutor);
@@ -178,12 +201,12 @@ http_store_body_size(const fs::path& dirp, AsioExecutor);
 // (e.g. to check that they are not outside of the content directory),
 // none are performed on `cdirp` itself.
 // Please make sure that `cdirp` is already in canonical form or some checks may fail.
-OUINET_CLIENT_API
+OUINET_COMMON_API
 [[nodiscard]]
 std::expected<std::size_t, sys::error_code>
 http_store_body_size( const fs::path& dirp, const fs::path& cdirp, AsioExecutor);
 
-OUINET_CLIENT_API
+OUINET_COMMON_API
 [[nodiscard]]
 std::expected<HashList, sys::error_code>
 http_store_load_hash_list(const fs::path&, Async);
@@ -267,12 +290,38 @@ public:
     virtual std::expected<void, sys::error_code>
     for_each(keep_func, Async) = 0;
 
+    // Return the ids of responses in storage (not in any fallback store).
+    //
+    // This is much cheaper than `for_each`, since only directory names are read,
+    // and it does not alter the store.
+    [[nodiscard]]
+    virtual std::expected<std::set<ResourceId>, sys::error_code>
+    list() const = 0;
+
+    // If an incomplete copy of the same response is already stored,
+    // it is extended in place (see `http_store_resume`).
     [[nodiscard]]
     virtual
     std::expected<void, sys::error_code>
     store(const ResourceId&, http_response::AbstractReader&, Async) = 0;
+
+    // Return the storage space used by the given stored response
+    // (not including any fallback store).
+    //
+    // This is cheaper than `size`, since only the files of that response are checked.
+    [[nodiscard]]
+    virtual std::expected<std::size_t, sys::error_code>
+    entry_size(const ResourceId&) const = 0;
+
+    // Remove the given response from storage (not from any fallback store).
+    //
+    // Removing a missing response is not considered an error.
+    [[nodiscard]]
+    virtual std::expected<void, sys::error_code>
+    remove(const ResourceId&) = 0;
 };
 
+OUINET_COMMON_API
 std::unique_ptr<HttpStore>
 make_http_store(fs::path path, AsioExecutor);
 
@@ -1,12 +1,15 @@
 #include <boost/asio/spawn.hpp>
 #include <boost/asio/ip/multicast.hpp>
 #include "local_peer_discovery.h"
+#include "local_peers.h"
 #include <util/random.h>
 #include <task.h>
 #include <parse/number.h>
 #include <parse/endpoint.h>
 #include <logger.h>
 #include <async_sleep.h>
+#include <algorithm>
+#include <optional>
 
 using namespace ouinet;
 using namespace std;
@@ -24,6 +27,12 @@ static const string MSG_PREFIX = "OUINET-LPD-V0:";
 static const string MSG_QUERY_CMD = "QUERY:";
 static const string MSG_REPLY_CMD = "REPLY:";
 static const string MSG_BYE_CMD   = "BYE:";
+// Changes to the local filter are sent at most this often
+// (see `cache::ContentFilterAnnouncer` for its messages,
+// which peers not knowing about them just ignore).
+static const auto filter_update_interval = chrono::seconds(5);
+
+using Clock = chrono::steady_clock;
 
 static bool consume(boost::string_view& sv, boost::string_view what) {
     if (!sv.starts_with(what)) {
@@ -49,7 +58,7 @@ consume_endpoints(boost::string_view& sv, asio::ip::address from) {
     return ret;
 }
 
-using PeerId = uint64_t;
+using PeerId = cache::LocalPeers::PeerId;
 
 namespace std {
     inline std::ostream& operator<<(std::ostream& os, std::set<udp::endpoint> const& map)
@@ -62,16 +71,12 @@ namespace std {
 }
 
 struct LocalPeerDiscovery::Impl {
-    struct Peer {
-        udp::endpoint discovery_ep;
-        set<udp::endpoint> advertised_eps;
-    };
-
     AsioExecutor _ex;
     udp::socket _socket;
     PeerId _id;
     set<udp::endpoint> _advertised_eps;
-    map<PeerId, Peer> _peers;
+    cache::LocalPeers _peers;
+    cache::ContentFilterAnnouncer _filter;
 
     Impl( const AsioExecutor& ex
         , uint64_t id
@@ -102,6 +107,7 @@ struct LocalPeerDiscovery::Impl {
 
         start_listening_to_broadcast(cancel);
         broadcast_search_query(cancel);
+        start_announcing_filter(cancel);
     }
 
     void say_bye() {
@@ -131,6 +137,32 @@ struct LocalPeerDiscovery::Impl {
         });
     }
 
+    void start_announcing_filter(Cancel& cancel) {
+        task::spawn_detached(_ex, [&, cancel = cancel] (asio::yield_context yield) mutable {
+            announce_filter(cancel, yield);
+        });
+    }
+
+    void announce_filter(Cancel& cancel, asio::yield_context yield) {
+        while (true) {
+            async_sleep(filter_update_interval, cancel, yield);
+            if (cancel) break;
+
+            for (auto& msg : _filter.update(Clock::now())) {
+                sys::error_code ec;
+                _socket.async_send_to( asio::buffer(filter_message(msg))
+                                     , multicast_ep
+                                     , yield[ec]);
+                if (cancel) return;
+                if (ec) {
+                    LOG_WARN("LocalPeerDiscovery: Failed to broadcast content filter;"
+                             " ec=", ec);
+                    break;
+                }
+            }
+        }
+    }
+
     void listen_to_broadcast(Cancel& cancel, asio::yield_context yield) {
         string data(256*128, '\0');
         udp::endpoint sender_ep;
@@ -183,6 +215,12 @@ struct LocalPeerDiscovery::Impl {
         return ss.str();
     }
 
+    string filter_message(const string& filter_msg) const {
+        ostringstream ss;
+        ss << MSG_PREFIX << _id << ":";
+        return ss.str() + filter_msg;
+    }
+
     void on_broadcast_receive( boost::string_view sv
                              , udp::endpoint from
                              , Cancel& cancel
@@ -201,6 +239,10 @@ struct LocalPeerDiscovery::Impl {
             handle_reply(sv, *opt_peer_id, from);
         } else if (consume(sv, MSG_BYE_CMD)) {
             handle_bye(sv, *opt_peer_id);
+        } else {
+            _peers.handle_filter_message( *opt_peer_id
+                                        , std::string_view(sv.data(), sv.size())
+                                        , Clock::now());
         }
     }
 
@@ -217,6 +259,12 @@ struct LocalPeerDiscovery::Impl {
         _socket.async_send_to( asio::buffer(reply_message())
                              , peer_ep
                              , yield[ec]);
+        if (ec || cancel) return;
+        // Do not make the new peer wait for the next broadcast.
+        for (auto& msg : _filter.whole_filter()) {
+            _socket.async_send_to(asio::buffer(filter_message(msg)), peer_ep, yield[ec]);
+            if (ec || cancel) return;
+        }
     }
 
     void handle_reply( boost::string_view sv
@@ -230,17 +278,15 @@ struct LocalPeerDiscovery::Impl {
 
     void handle_bye(boost::string_view sv, PeerId peer_id)
     {
-        auto i = _peers.find(peer_id);
+        auto eps = _peers.remove(peer_id);
 
-        if (i == _peers.end()) return;
+        if (!eps) return;
 
         if (get_logger().would_log(INFO)) {
             ostringstream ss;
-            for (auto ep : i->second.advertised_eps) { ss << ep << ";"; }
+            for (auto ep : *eps) { ss << ep << ";"; }
             LOG_INFO("LocalPeerDiscovery: Lost local ouinet peer(s) ", ss.str());
         }
-
-        _peers.erase(i);
     }
 
     void add_endpoints(PeerId peer_id, udp::endpoint peer_ep, set<udp::endpoint> eps)
@@ -250,22 +296,31 @@ struct LocalPeerDiscovery::Impl {
             for (auto ep : eps) { ss << ep << ";"; }
             LOG_INFO("LocalPeerDiscovery: Found local ouinet peer(s) ", ss.str());
         }
-        _peers[peer_id] = {peer_ep, std::move(eps)};
+        _peers.add(peer_id, peer_ep, std::move(eps));
     }
 };
 
 set<udp::endpoint> LocalPeerDiscovery::found_peers() const
 {
     if (!_impl) return {};
+    return _impl->_peers.found_peers();
+}
 
-    set<udp::endpoint> ret;
+vector<udp::endpoint>
+LocalPeerDiscovery::likely_holders(const cache::ResourceId& resource_id) const
+{
+    if (!_impl) return {};
+    return _impl->_peers.likely_holders(resource_id);
+}
 
-    for (auto& pair : _impl->_peers) {
-        auto& eps = pair.second.advertised_eps;
-        ret.insert(eps.begin(), eps.end());
-    }
+void LocalPeerDiscovery::add_resource(const cache::ResourceId& resource_id)
+{
+    if (_impl) _impl->_filter.add(resource_id);
+}
 
-    return ret;
+void LocalPeerDiscovery::remove_resource(const cache::ResourceId& resource_id)
+{
+    if (_impl) _impl->_filter.remove(resource_id);
 }
 
 LocalPeerDiscovery::LocalPeerDiscovery( const AsioExecutor& ex
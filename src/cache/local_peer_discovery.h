@@ -5,11 +5,17 @@
 #include <util/cancel.h>
 #include <boost/asio/ip/udp.hpp>
 #include <set>
+#include <vector>
+
+#include "resource_id.h"
 
 namespace ouinet {
 
 using ouinet::util::AsioExecutor;
 
+// Finds other clients in the LAN via multicast, and lets them know
+// which resources this client holds by periodically multicasting
+// a Bloom filter of their ids (see `cache::ContentFilter`).
 class LocalPeerDiscovery {
     using udp = asio::ip::udp;
     struct Impl;
@@ -21,6 +27,16 @@ public:
 
     std::set<udp::endpoint> found_peers() const;
 
+    // Found peers which may hold the resource: first those whose filter
+    // may contain it (most recently updated filters first),
+    // then those without a known filter.
+    std::vector<udp::endpoint> likely_holders(const cache::ResourceId&) const;
+
+    // Update the filter of resources advertised to other peers.
+    // Changes are sent to them in batches.
+    void add_resource(const cache::ResourceId&);
+    void remove_resource(const cache::ResourceId&);
+
     ~LocalPeerDiscovery();
 
     void stop();
@@ -0,0 +1,237 @@
+#include "local_peers.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include <parse/number.h>
+#include <logger.h>
+
+namespace ouinet::cache {
+
+using namespace std;
+
+static const string MSG_FILTER_CMD = "FILTER:";
+static const string MSG_DELTA_CMD  = "DELTA:";
+
+static bool consume(boost::string_view& sv, boost::string_view what) {
+    if (!sv.starts_with(what)) {
+        return false;
+    }
+    sv.remove_prefix(what.size());
+    return true;
+}
+
+//// ContentFilterAnnouncer
+
+vector<string>
+ContentFilterAnnouncer::update(Clock::time_point now)
+{
+    // Checked regardless of pending changes,
+    // since these may never stop coming.
+    bool refresh = !_published || now - _last_full >= refresh_interval;
+
+    if (_filter.version() != _sent_version) {
+        auto changed = _filter.filter().diff(_sent_filter);
+        auto from = _sent_version;
+        _sent_filter = _filter.filter();
+        _sent_version = _filter.version();
+        // Positions take up to 6 bytes each in a delta message.
+        if (!refresh && changed.size() * 6 < segment_size) {
+            return {delta_message(from, changed)};
+        }
+    } else if (!refresh) {
+        return {};
+    }
+
+    _last_full = now;
+    _published = true;
+    return whole_filter();
+}
+
+vector<string>
+ContentFilterAnnouncer::whole_filter() const
+{
+    if (!_published) return {};
+
+    auto& bytes = _sent_filter.bytes();
+    vector<string> ret;
+    for (size_t offset = 0; offset < bytes.size(); offset += segment_size) {
+        ostringstream ss;
+        ss << MSG_FILTER_CMD
+           << _sent_version << ":" << _sent_filter.bits() << ":" << _sent_filter.hashes() << ":"
+           << offset << ":";
+        ret.push_back(ss.str() + bytes.substr(offset, segment_size));
+    }
+    return ret;
+}
+
+// Changed positions take the filter from version `from` to the one last sent.
+string
+ContentFilterAnnouncer::delta_message(uint64_t from, const vector<uint32_t>& changed) const
+{
+    ostringstream ss;
+    ss << MSG_DELTA_CMD << from << ":" << _sent_version << ":";
+    for (auto pos : changed) { ss << pos << ";"; }
+    return ss.str();
+}
+
+//// LocalPeers
+
+void
+LocalPeers::add(PeerId peer_id, udp::endpoint discovery_ep, set<udp::endpoint> advertised_eps)
+{
+    auto& peer = _peers[peer_id];
+    peer.discovery_ep = discovery_ep;
+    peer.advertised_eps = std::move(advertised_eps);
+}
+
+optional<set<LocalPeers::udp::endpoint>>
+LocalPeers::remove(PeerId peer_id)
+{
+    auto i = _peers.find(peer_id);
+    if (i == _peers.end()) return nullopt;
+    auto ret = std::move(i->second.advertised_eps);
+    _peers.erase(i);
+    return ret;
+}
+
+bool
+LocalPeers::handle_filter_message(PeerId peer_id, std::string_view msg, Clock::time_point now)
+{
+    boost::string_view sv(msg.data(), msg.size());
+
+    bool is_filter = consume(sv, MSG_FILTER_CMD);
+    if (!is_filter && !consume(sv, MSG_DELTA_CMD)) return false;
+
+    auto i = _peers.find(peer_id);
+    if (i == _peers.end()) return true;  // wait for its query or reply
+
+    if (is_filter) handle_filter(i->second, sv, now);
+    else           handle_delta(i->second, sv, now);
+    return true;
+}
+
+void
+LocalPeers::handle_filter(Peer& peer, boost::string_view sv, Clock::time_point now)
+{
+    auto version = parse::number<uint64_t>(sv);
+    if (!version || !consume(sv, ":")) return;
+    auto bits = parse::number<size_t>(sv);
+    if (!bits || !consume(sv, ":")) return;
+    auto hashes = parse::number<unsigned>(sv);
+    if (!hashes || !consume(sv, ":")) return;
+    auto offset = parse::number<size_t>(sv);
+    if (!offset || !consume(sv, ":")) return;
+
+    if (peer.filter && *version <= peer.filter_version) {
+        // A resent filter which we already have.
+        if (*version == peer.filter_version) peer.filter_updated = now;
+        return;  // or a delayed datagram
+    }
+
+    if (!ContentFilter::valid(*bits, *hashes)) return;
+
+    auto& partial = peer.partial_filter;
+    if ( !partial || *version != peer.partial_version
+      || partial->bits() != *bits || partial->hashes() != *hashes) {
+        if (partial && *version < peer.partial_version) return;  // delayed
+        // Segments of an older version which never got complete are dropped.
+        partial.emplace(*bits, *hashes);
+        peer.partial_version = *version;
+        peer.partial_offsets.clear();
+        peer.partial_size = 0;
+    }
+
+    if (peer.partial_offsets.count(*offset)) return;  // duplicated
+    if (!partial->assign_bytes(*offset, std::string_view(sv.data(), sv.size()))) return;
+    peer.partial_offsets.insert(*offset);
+    peer.partial_size += sv.size();
+
+    if (peer.partial_size < partial->bytes().size()) return;
+
+    peer.filter = std::move(*partial);
+    peer.filter_version = *version;
+    peer.filter_updated = now;
+    partial.reset();
+}
+
+void
+LocalPeers::handle_delta(Peer& peer, boost::string_view sv, Clock::time_point now)
+{
+    if (!peer.filter) return;  // wait for the whole filter
+
+    auto from = parse::number<uint64_t>(sv);
+    if (!from || !consume(sv, ":")) return;
+    auto to = parse::number<uint64_t>(sv);
+    if (!to || !consume(sv, ":")) return;
+
+    if (*from != peer.filter_version) {
+        // We missed some update, so the filter may give false negatives.
+        // Treat the peer as not sending filters until the whole filter is sent again.
+        if (*to > peer.filter_version) {
+            LOG_DEBUG("LocalPeerDiscovery: Missed content filter update;"
+                      " peer=", peer.discovery_ep);
+            peer.filter.reset();
+        }
+        return;
+    }
+
+    auto filter = *peer.filter;
+    while (!sv.empty()) {
+        auto pos = parse::number<uint32_t>(sv);
+        if (!pos || !consume(sv, ";") || *pos >= filter.bits()) {
+            peer.filter.reset();
+            return;
+        }
+        filter.set(*pos, !filter.test(*pos));
+    }
+
+    peer.filter = std::move(filter);
+    peer.filter_version = *to;
+    peer.filter_updated = now;
+}
+
+set<LocalPeers::udp::endpoint>
+LocalPeers::found_peers() const
+{
+    set<udp::endpoint> ret;
+
+    for (auto& pair : _peers) {
+        auto& eps = pair.second.advertised_eps;
+        ret.insert(eps.begin(), eps.end());
+    }
+
+    return ret;
+}
+
+vector<LocalPeers::udp::endpoint>
+LocalPeers::likely_holders(const ResourceId& resource_id) const
+{
+    auto key = ContentFilter::key(resource_id);
+    vector<const Peer*> filtered, unfiltered;
+
+    for (auto& pair : _peers) {
+        auto& peer = pair.second;
+        if (!peer.filter) unfiltered.push_back(&peer);
+        else if (peer.filter->may_contain(key)) filtered.push_back(&peer);
+    }
+
+    stable_sort(filtered.begin(), filtered.end(), [] (const Peer* a, const Peer* b) {
+        return a->filter_updated > b->filter_updated;
+    });
+
+    vector<udp::endpoint> ret;
+    set<udp::endpoint> seen;
+
+    for (auto peers : {&filtered, &unfiltered}) {
+        for (auto peer : *peers) {
+            for (auto& ep : peer->advertised_eps) {
+                if (seen.insert(ep).second) ret.push_back(ep);
+            }
+        }
+    }
+
+    return ret;
+}
+
+} // namespace ouinet::cache
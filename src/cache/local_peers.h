@@ -0,0 +1,116 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <boost/asio/ip/udp.hpp>
+#include <boost/utility/string_view.hpp>
+
+#include "content_filter.h"
+#include "resource_id.h"
+#include "../namespaces.h"
+
+namespace ouinet::cache {
+
+// The content filter of this client as sent to LAN peers
+// (see `LocalPeerDiscovery`).
+//
+// The whole filter is sent in `FILTER` messages, one per segment of its bytes.
+// Later changes are sent in `DELTA` messages
+// with the positions of bits which changed between two versions.
+class ContentFilterAnnouncer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // The whole filter is sent at least this often,
+    // so that peers missing some update get back in sync.
+    static constexpr auto refresh_interval = std::chrono::seconds(60);
+
+    // The whole filter is sent in segments of (at most) this many bytes,
+    // and deltas with more changes than fit in one segment are not sent,
+    // so that datagrams fit in a usual MTU and are not fragmented
+    // (losing a fragment would lose the whole datagram).
+    static constexpr std::size_t segment_size = 1024;
+
+    void add(const ResourceId& rid) { _filter.add(rid); }
+    void remove(const ResourceId& rid) { _filter.remove(rid); }
+
+    // Messages to send to peers now, if any:
+    // the whole filter if it was never sent or it is time to refresh it,
+    // otherwise a delta with the changes since the previous call.
+    std::vector<std::string> update(Clock::time_point now);
+
+    // Messages with the whole filter as last sent (e.g. for a newly found peer).
+    //
+    // There are none until `update` first sends the filter,
+    // since peers would take an empty filter as this client holding nothing.
+    std::vector<std::string> whole_filter() const;
+
+private:
+    std::string delta_message(uint64_t from, const std::vector<uint32_t>& changed) const;
+
+private:
+    CountingContentFilter _filter;
+    // As last sent to peers (so that later deltas apply to it).
+    ContentFilter _sent_filter;
+    uint64_t _sent_version = 0;
+    bool _published = false;
+    Clock::time_point _last_full;
+};
+
+// Peers found in the LAN, along with the content filters received from them.
+class LocalPeers {
+public:
+    using udp = asio::ip::udp;
+    using Clock = std::chrono::steady_clock;
+    using PeerId = uint64_t;
+
+    // Add the peer or update its endpoints (keeping its filter).
+    void add(PeerId, udp::endpoint discovery_ep, std::set<udp::endpoint> advertised_eps);
+
+    // Return the advertised endpoints of the peer if it was known.
+    std::optional<std::set<udp::endpoint>> remove(PeerId);
+
+    // Handle a `FILTER` or `DELTA` message (as built by `ContentFilterAnnouncer`)
+    // from the given peer, which is ignored if not known yet.
+    //
+    // Return false if the message is of another type.
+    bool handle_filter_message(PeerId, std::string_view, Clock::time_point now);
+
+    std::set<udp::endpoint> found_peers() const;
+
+    // Found peers which may hold the resource: first those whose filter
+    // may contain it (most recently updated filters first),
+    // then those without a known filter.
+    std::vector<udp::endpoint> likely_holders(const ResourceId&) const;
+
+private:
+    struct Peer {
+        udp::endpoint discovery_ep;
+        std::set<udp::endpoint> advertised_eps;
+        // Unknown if the peer does not send filters
+        // or if we missed some update.
+        std::optional<ContentFilter> filter;
+        uint64_t filter_version = 0;
+        Clock::time_point filter_updated;
+        // A whole filter being received in segments.
+        std::optional<ContentFilter> partial_filter;
+        uint64_t partial_version = 0;
+        std::set<std::size_t> partial_offsets;
+        std::size_t partial_size = 0;
+    };
+
+    void handle_filter(Peer&, boost::string_view, Clock::time_point now);
+    void handle_delta(Peer&, boost::string_view, Clock::time_point now);
+
+private:
+    std::map<PeerId, Peer> _peers;
+};
+
+} // namespace ouinet::cache
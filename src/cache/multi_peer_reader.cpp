@@ -10,13 +10,14 @@
 #include "../http_util.h"
 #include "../session.h"
 #include "../util/async.h"
-#include "../util/async_job.h"
 #include "../util/condition_variable.h"
 #include "../util/crypto_stream.h"
 #include "../util/debug.h"
 #include "../util/intrusive_list.h"
+#include "../util/scheduler.h"
 #include "../util/sign.h"
 #include "../util/select.h"
+#include "../util/shared_bytes.h"
 #include "../util/watch_dog.h"
 #include "../async_sleep.h"
 #include "../constants.h"
@@ -28,7 +29,6 @@
 #include <chrono>
 #include <expected>
 #include <optional>
-#include <random>
 
 using namespace std;
 using namespace ouinet;
@@ -129,12 +129,27 @@ public:
     Cancel _lifetime_cancel;
     util::LogPath _log_path;
 
+    // Blocks are accumulated in buffers from the executor's pool.
+    util::SharedBytesWriter _block_writer;
+
+    // Several block requests may be in flight on `_connection`
+    // (up to the pipeline depth in the peer's hash list).
+    // Requests are sent in the order in which they were queued,
+    // and their responses are read in the same order,
+    // each request waiting for its turn.
+    size_t _queued_requests = 0;
+    size_t _send_turn = 0;
+    size_t _read_turn = 0;
+    ConditionVariable _turn_cv;
+
     Peer(AsioExecutor exec, const ResourceId& resource_id, const CryptoStreamKey& resource_key, sign::PublicKey cache_pk, util::LogPath log_path) :
         _exec(exec),
         _resource_id(resource_id),
         _resource_key(resource_key),
         _cache_pk(cache_pk),
-        _log_path(std::move(log_path))
+        _log_path(std::move(log_path)),
+        _block_writer(util::BytePool::get(_exec)),
+        _turn_cv(_exec)
     {
     }
 
@@ -152,6 +167,57 @@ public:
         return _hash_list.blocks.size();
     }
 
+    size_t pipeline_depth() const {
+        return _hash_list.pipeline_depth;
+    }
+
+    // Returns the turn of a new block request (see `fetch_block`).
+    size_t queue_request() {
+        return _queued_requests++;
+    }
+
+    // Send the request for the block and read its response
+    // when the given turn comes (as returned by `queue_request`).
+    //
+    // Once a request fails, the connection is closed,
+    // so that the requests which come after it fail too.
+    std::expected<std::optional<Block>, sys::error_code>
+    fetch_block(size_t turn, size_t block_id, Async yield)
+    {
+        if (auto e = wait_for_turn(_send_turn, turn, yield); !e) {
+            return std::unexpected(e.error());
+        }
+
+        auto sent = send_block_request(block_id, yield);
+        next_turn(_send_turn);
+
+        if (auto e = wait_for_turn(_read_turn, turn, yield); !e) {
+            return std::unexpected(e.error());
+        }
+
+        auto block = sent.and_then([&] { return read_block(block_id, yield); });
+        next_turn(_read_turn);
+
+        if (!block) _connection.close();
+        return block;
+    }
+
+    std::expected<void, sys::error_code>
+    wait_for_turn(const size_t& current, size_t turn, Async yield)
+    {
+        auto cl = _lifetime_cancel.connect([&] { yield.cancel(); });
+        while (current != turn) {
+            if (auto e = _turn_cv.wait(yield); !e) return e;
+        }
+        return {};
+    }
+
+    void next_turn(size_t& current)
+    {
+        ++current;
+        _turn_cv.notify();
+    }
+
     std::expected<void, sys::error_code>
     send_block_request(size_t block_id, Async yield)
     {
@@ -189,12 +255,40 @@ public:
             return std::unexpected(asio::error::not_connected);
         }
 
-        auto stream_e = determine_incoming_stream(_connection, yield);
-        if (!stream_e) {
-            return std::unexpected(stream_e.error());
+        auto blob_type = async_read_blob_type(_connection, yield);
+        if (!blob_type) {
+            return std::unexpected(blob_type.error());
+        }
+
+        // Like `determine_incoming_stream`, but keep the decrypting stream around
+        // to get the data read past the end of the response.
+        bool encrypted = (*blob_type == BlobType::cypher_text);
+        CryptoStream<StreamRef<GenericStream>> crypto_stream(_connection, _resource_key);
+        auto reader = encrypted
+            ? http_response::Reader(StreamRef<decltype(crypto_stream)>(crypto_stream))
+            : http_response::Reader(StreamRef<GenericStream>(_connection));
+
+        auto block = read_block(reader, block_id, yield);
+        if (!block) {
+            return block;
+        }
+
+        // Responses to other requests in flight may follow right away,
+        // so put back into the connection whatever was read past the end of this one.
+        auto unread = reader.buffered_data();
+        if (auto size = asio::buffer_size(unread)) {
+            sys::error_code ec;
+            if (encrypted) _connection.put_back(crypto_stream.last_read_encrypted(size), ec);
+            else _connection.put_back(unread, ec);
+            if (ec) return std::unexpected(ec);
         }
-        auto reader = http_response::Reader(std::move(*stream_e));
 
+        return block;
+    }
+
+    std::expected<std::optional<Block>, sys::error_code>
+    read_block(http_response::Reader& reader, size_t block_id, Async yield)
+    {
         auto cl = _lifetime_cancel.connect([&] { yield.cancel(); });
 
         auto head_e = reader.timed_async_read_part(READ_HEAD_TIMEOUT, yield);
@@ -229,6 +323,8 @@ public:
 
         Block block{{{}, 0},{0, {}}, std::nullopt};
         util::SHA512 block_hasher;
+        auto block_buf = _block_writer.prepare(first_chunk_hdr->size);
+        size_t block_size = 0;
 
         if (first_chunk_hdr->size) {
             // Read the block and the chunk header that comes after it.
@@ -245,23 +341,22 @@ public:
                     return std::unexpected(Errc::expected_chunk_body);
                 }
 
-                block_hasher.update(*chunk_body);
+                block_hasher.update(chunk_body->buffer());
 
-                if (block.chunk_body.size() + chunk_body->size() > http_::response_data_block_max) {
+                if (block_size + chunk_body->size() > block_buf.size()) {
                     return std::unexpected(Errc::block_is_too_big);
                 }
 
-                block.chunk_body.insert(
-                    block.chunk_body.end(),
-                    chunk_body->begin(),
-                    chunk_body->end()
-                );
+                asio::buffer_copy(block_buf + block_size, chunk_body->buffer());
+                block_size += chunk_body->size();
 
                 if (chunk_body->remain == 0) {
                     break;
                 }
             }
 
+            block.chunk_body = ChunkBody(_block_writer.commit(block_size), 0);
+
             part_e = reader.timed_async_read_part(READ_CHUNK_HDR_TIMEOUT, yield);
             if (!part_e) {
                 return std::unexpected(part_e.error());
@@ -402,28 +497,12 @@ public:
     }
 };
 
-struct MultiPeerReader::PreFetch {
-    using OptBlock = std::optional<MultiPeerReader::Block>;
-
-    size_t block_id;
-    Peer* peer;
-
-    PreFetch(size_t block_id, Peer* peer)
-        : block_id(block_id)
-        , peer(peer)
-    {}
-
-    virtual ~PreFetch() {}
-
-    virtual std::expected<OptBlock, sys::error_code> get_block(Async) = 0;
-};
-
 class MultiPeerReader::Peers {
 public:
     Peers(AsioExecutor exec
          , set<udp::endpoint> lan_my_eps
          , set<udp::endpoint> wan_my_eps
-         , set<udp::endpoint> lan_peer_eps
+         , vector<udp::endpoint> lan_peer_eps
          , sign::PublicKey cache_pk
          , const ResourceId& resource_id
          , const CryptoStreamKey& resource_key
@@ -432,6 +511,7 @@ public:
          , util::LogPath log_path)
         : _exec(exec)
         , _cv(_exec)
+        , _lan_scheduler(_exec, LAN_HASH_LIST_CONCURRENCY)
         , _cache_pk(std::move(cache_pk))
         , _lan_peer_eps(std::move(lan_peer_eps))
         , _lan_my_eps(std::move(lan_my_eps))
@@ -441,7 +521,6 @@ public:
         , _dht_lookup(std::move(peer_lookup))
         , _newest_proto_seen(std::move(newest_proto_seen))
         , _log_path(std::move(log_path))
-        , _random_generator(_random_device())
     {
         if (!_dht_lookup) {
             _cv.notify();
@@ -465,9 +544,7 @@ public:
                 LOG_DEBUG(yield, " Looking up peers...");
 
                 if (auto dht = _dht_lookup->get_dht_lock()) {
-                    for (auto ep : _lan_peer_eps) {
-                        add_candidate(ep, *dht);
-                    }
+                    add_lan_candidates(*dht);
                 }
 
                 // Keep looking up for peers until success or until `this` is destroyed.
@@ -505,7 +582,7 @@ public:
 
     Peers(AsioExecutor exec
          , set<udp::endpoint> lan_my_eps
-         , set<udp::endpoint> lan_peer_eps
+         , vector<udp::endpoint> lan_peer_eps
          , sign::PublicKey cache_pk
          , const ResourceId& resource_id
          , const CryptoStreamKey& resource_key
@@ -529,6 +606,7 @@ public:
          , util::LogPath log_path)
         : _exec(exec)
         , _cv(_exec)
+        , _lan_scheduler(_exec, LAN_HASH_LIST_CONCURRENCY)
         , _cache_pk(std::move(cache_pk))
         , _resource_id(resource_id)
         , _resource_key(resource_key)
@@ -536,7 +614,6 @@ public:
         , _i2p_session(std::move(i2p_session))
         , _newest_proto_seen(std::move(newest_proto_seen))
         , _log_path(std::move(log_path))
-        , _random_generator(_random_device())
     {
         spawn_detached(_exec, _lifetime_cancel, _log_path,  [this] (Async yield) mutable {
             auto i2p_dests = _i2p_lookup->get(yield);
@@ -623,31 +700,61 @@ public:
     }
 
     void add_candidate(udp::endpoint ep, const bittorrent::DhtBase& dht) {
-        if (!dht.is_peer_allowed(ep)) return;
-        if (_wan_my_eps.count(ep)) return;
+        if (auto peer = insert_candidate(ep, dht)) {
+            download_hash_list(ep, peer, nullptr);
+        }
+    }
 
-        auto ip = _all_udp_peers.insert({ep, unique_ptr<Peer>()});
+    // LAN peers are tried in the given order (likely holders first),
+    // only a few at a time, so that they are not all contacted at once.
+    // The next one is tried when a download succeeds, fails or times out.
+    void add_lan_candidates(const bittorrent::DhtBase& dht) {
+        for (auto ep : _lan_peer_eps) {
+            if (auto peer = insert_candidate(ep, dht)) {
+                download_hash_list(ep, peer, &_lan_scheduler);
+            }
+        }
+    }
 
-        auto peer_log_path = _log_path.tag(util::str(ep));
+    // Return null if the peer is not to be contacted or was already added.
+    Peer* insert_candidate(udp::endpoint ep, const bittorrent::DhtBase& dht) {
+        if (!dht.is_peer_allowed(ep)) return nullptr;
+        if (_wan_my_eps.count(ep)) return nullptr;
 
-        if (!ip.second) return; // Already inserted
+        auto ip = _all_udp_peers.insert({ep, unique_ptr<Peer>()});
+
+        if (!ip.second) return nullptr; // Already inserted
 
-        ip.first->second = make_unique<Peer>(_exec, _resource_id, _resource_key, _cache_pk, peer_log_path);
+        ip.first->second = make_unique<Peer>(_exec, _resource_id, _resource_key, _cache_pk, _log_path.tag(util::str(ep)));
         Peer* peer = ip.first->second.get();
 
         _candidate_peers.push_back(*peer);
 
+        return peer;
+    }
+
+    // If a scheduler is given, wait for a slot from it before contacting the peer
+    // (waiting downloads start in the order in which they were added).
+    void download_hash_list(udp::endpoint ep, Peer* peer, ouinet::Scheduler* scheduler) {
         spawn_detached(
             _exec,
             _lifetime_cancel,
-            peer_log_path,
+            _log_path.tag(util::str(ep)),
             [
                 this,
                 ep,
                 peer,
+                scheduler,
                 lan_my_eps = _lan_my_eps,
                 newest_proto_seen = _newest_proto_seen
             ] (Async yield) mutable {
+                std::optional<ouinet::Scheduler::Slot> slot;
+                if (scheduler) {
+                    auto s = scheduler->wait_for_slot(yield);
+                    if (!s) return;  // scheduler destroyed
+                    slot = std::move(*s);
+                }
+
                 LOG_DEBUG(yield, " Fetching hash list");
 
                 auto result = timeout(
@@ -735,40 +842,30 @@ public:
         return best_peer->_hash_list;
     }
 
-    std::expected<Peer*, sys::error_code> choose_peer_for_block(
-        const HashList& reference_hash_list,
-        size_t block_id,
-        Async yield
-    )
+    std::vector<Peer*> good_peers()
     {
-        auto e = wait_for_some_peers_to_respond(yield);
-        if (!e) {
-            return std::unexpected(e.error());
-
-        }
-
-        std::vector<Peer*> peers;
-
-        auto reference_block = reference_hash_list.get_block(block_id);
-
-        assert(reference_block);
-        if (!reference_block) {
-            return std::unexpected(Errc::no_peers);
-        }
+        std::vector<Peer*> ret;
+        for (auto& p : _good_peers) ret.push_back(&p);
+        return ret;
+    }
 
-        for (auto& p : _good_peers) {
-            auto opt_b = p._hash_list.get_block(block_id);
-            if (opt_b && opt_b->data_hash == reference_block->data_hash) {
-                peers.push_back(&p);
-            }
-        }
+    // Wait until peers change (or until `notify` is called).
+    std::expected<void, sys::error_code> wait_for_change(Async yield)
+    {
+        auto cc = _lifetime_cancel.connect([&] { yield.cancel(); });
+        return _cv.wait(yield);
+    }
 
-        if (peers.empty()) {
-            return std::unexpected(Errc::no_peers);
-        }
+    void notify()
+    {
+        _cv.notify();
+    }
 
-        std::uniform_int_distribution<size_t> distrib(0, peers.size() - 1);
-        return peers[distrib(_random_generator)];
+    // Spawn a coroutine which gets cancelled when peers are gone.
+    template<class F>
+    void spawn(util::LogPath log_path, F&& f)
+    {
+        spawn_detached(_exec, _lifetime_cancel, std::move(log_path), std::forward<F>(f));
     }
 
     ~Peers() {
@@ -776,7 +873,6 @@ public:
     }
 
     void unmark_as_good(Peer& p) {
-        assert(p._good_peer_hook.is_linked());
         if (p._good_peer_hook.is_linked()) p._good_peer_hook.unlink();
     }
 
@@ -791,9 +887,11 @@ private:
 
     AsioExecutor _exec;
     ConditionVariable _cv;
+    // Limits hash list downloads from LAN peers running at the same time.
+    ouinet::Scheduler _lan_scheduler;
 
     sign::PublicKey _cache_pk;
-    std::set<asio::ip::udp::endpoint> _lan_peer_eps;
+    std::vector<asio::ip::udp::endpoint> _lan_peer_eps;
     std::set<asio::ip::udp::endpoint> _lan_my_eps;
     std::set<asio::ip::udp::endpoint> _wan_my_eps;
     ResourceId _resource_id;
@@ -805,21 +903,19 @@ private:
     util::LogPath _log_path;
 
     Cancel _lifetime_cancel;
-
-    std::random_device _random_device;
-    std::mt19937 _random_generator;
 };
 
 MultiPeerReader::MultiPeerReader( AsioExecutor ex
                                 , ResourceId resource_id
                                 , CryptoStreamKey resource_key
                                 , sign::PublicKey cache_pk
-                                , std::set<asio::ip::udp::endpoint> lan_peer_eps
+                                , std::vector<asio::ip::udp::endpoint> lan_peer_eps
                                 , std::set<asio::ip::udp::endpoint> lan_my_eps
                                 , std::shared_ptr<unsigned> newest_proto_seen
                                 , util::LogPath log_path)
     : _executor(ex)
     , _log_path(std::move(log_path))
+    , _block_writer(util::BytePool::get(_executor))
 {
     _peers = make_unique<Peers>(ex
                                , std::move(lan_my_eps)
@@ -835,12 +931,13 @@ MultiPeerReader::MultiPeerReader( AsioExecutor ex
                                 , ResourceId resource_id
                                 , CryptoStreamKey resource_key
                                 , sign::PublicKey cache_pk
-                                , std::set<asio::ip::udp::endpoint> lan_peer_eps
+                                , std::vector<asio::ip::udp::endpoint> lan_peer_eps
                                 , std::shared_ptr<DhtLookup> peer_lookup
                                 , std::shared_ptr<unsigned> newest_proto_seen
                                 , util::LogPath log_path)
     : _executor(ex)
     , _log_path(std::move(log_path))
+    , _block_writer(util::BytePool::get(_executor))
 {
     _peers = make_unique<Peers>(ex
                                , peer_lookup->get_dht_lock()->local_endpoints()
@@ -864,6 +961,7 @@ MultiPeerReader::MultiPeerReader( AsioExecutor ex
                                 , util::LogPath log_path)
     : _executor(ex)
     , _log_path(log_path)
+    , _block_writer(util::BytePool::get(_executor))
 {
     _peers = make_unique<Peers>(ex
                                , std::move(cache_pk)
@@ -875,119 +973,166 @@ MultiPeerReader::MultiPeerReader( AsioExecutor ex
                                , log_path);
 }
 
-struct MultiPeerReader::PreFetchSequential : MultiPeerReader::PreFetch {
-    PreFetchSequential(size_t block_id, Peer* peer, AsioExecutor ex)
-        : PreFetch(block_id, peer)
-    {}
+void MultiPeerReader::unmark_as_good(Peer& peer)
+{
+    _peers->unmark_as_good(peer);
+    if (_scheduler) _scheduler->remove_peer(&peer);
+}
+
+void MultiPeerReader::seed(Seed seed)
+{
+    assert(!_head_sent);
+    _seed = std::move(seed);
+}
 
-    std::expected<OptBlock, sys::error_code>
-    get_block(Async yield) override {
-        return peer->send_block_request(block_id, yield)
-            .and_then([&] { return peer->read_block(block_id, yield); });
+void MultiPeerReader::set_fetch_window(size_t window)
+{
+    assert(!_head_sent);
+    _fetch_window = window;
+}
+
+// Let the scheduler know about new good peers,
+// and send the block requests that it assigns to them.
+void MultiPeerReader::start_fetch_jobs()
+{
+    for (auto peer : _peers->good_peers()) {
+        if (_scheduler->has_peer(peer)) continue;
+
+        _scheduler->add_peer(peer, [this, peer] (size_t block_id) {
+            auto block = peer->_hash_list.get_block(block_id);
+            auto reference_block = _reference_hash_list->get_block(block_id);
+            return block && reference_block && block->data_hash == reference_block->data_hash;
+        }, peer->pipeline_depth());
     }
-};
 
-struct MultiPeerReader::PreFetchParallel : MultiPeerReader::PreFetch {
-    using Job = AsyncJob<OptBlock>;
-    Job job;
+    for (auto [peer, block_id] : _scheduler->schedule(Clock::now())) {
+        // Requests to the same peer go out in the order they were assigned.
+        auto turn = peer->queue_request();
 
-    PreFetchParallel(size_t block_id, Peer* peer, AsioExecutor ex)
-        : PreFetch(block_id, peer)
-        , job(ex)
-    {
-        job.start([=] (Async yield) -> std::expected<OptBlock, sys::error_code> {
-            auto e = peer->send_block_request(block_id, yield);
-            if (!e) {
-                return std::unexpected(e.error());
+        _peers->spawn(peer->_log_path, [this, peer, block_id, turn] (Async yield) {
+            auto block = peer->fetch_block(turn, block_id, yield);
+
+            if (!block) {
+                LOG_DEBUG(yield, " Failed to fetch block ", block_id, "; ec=", block.error());
+                // Blocks assigned to this peer go to other peers.
+                unmark_as_good(*peer);
+            } else if (_scheduler->received(peer, block_id, Clock::now())) {
+                _fetched_blocks.emplace(block_id, std::move(*block));
             }
 
-            return peer->read_block(block_id, yield);
+            start_fetch_jobs();
+            _peers->notify();
         });
     }
-
-    std::expected<OptBlock, sys::error_code> get_block(Async yield) override {
-        job.wait_for_finish(yield);
-        return std::move(job.result());
-    }
-};
-
-void MultiPeerReader::unmark_as_good(Peer& peer)
-{
-    _peers->unmark_as_good(peer);
-    if (_pre_fetch && _pre_fetch->peer == &peer) {
-        _pre_fetch = nullptr;
-    }
 }
 
-std::expected<std::unique_ptr<MultiPeerReader::PreFetch>, sys::error_code>
-MultiPeerReader::new_fetch_job(size_t block_id, Peer* last_peer, Async yield)
+// Blocks are read in order, so the seed is dropped
+// as soon as a block can not be read from it.
+std::optional<MultiPeerReader::Block>
+MultiPeerReader::read_seed_block(size_t block_id, Async yield)
 {
-    if (block_id >= _reference_hash_list->blocks.size()) {
-        return nullptr;
-    }
+    if (!_seed) return std::nullopt;
 
-    auto next_peer_e = _peers->choose_peer_for_block(*_reference_hash_list, block_id, yield);
-    if (!next_peer_e) {
-        return std::unexpected(next_peer_e.error());
-    }
-    auto next_peer = std::move(*next_peer_e);
+    auto drop_seed = [&] (const auto& reason) -> std::optional<Block> {
+        LOG_DEBUG(yield, " Fetching from peers from block ", block_id
+                       , " on; reason=", reason);
+        _seed = std::nullopt;
+        return std::nullopt;
+    };
+
+    // The last block comes with the trailer, which is only available from peers.
+    auto& ref_blocks = _reference_hash_list->blocks;
+    if (block_id >= _seed->hash_list.blocks.size() || block_id + 1 >= ref_blocks.size())
+        return drop_seed("end of local data");
+
+    auto& ref_block = ref_blocks[block_id];
+    if (_seed->hash_list.blocks[block_id].data_hash != ref_block.data_hash)
+        return drop_seed("local data does not match");
+
+    // Skip the head and get the data of the next block.
+    // If it comes in a single chunk body, it is passed along as is,
+    // otherwise its parts are copied into a pooled buffer.
+    util::SharedBytes data;
+    asio::mutable_buffer block_buf;
+    size_t block_size = 0;
+    std::optional<size_t> size;
+    // Local data should have been verified when storing it,
+    // but check it anyway before sending it along.
+    util::SHA512 block_hasher;
+
+    while (!size || block_size < *size) {
+        auto part = _seed->reader->async_read_part(yield);
+        if (!part) return drop_seed(part.error());
+        if (!*part) return drop_seed("end of local response");
+
+        if (auto chunk_hdr = (*part)->as_chunk_hdr()) {
+            if (size || chunk_hdr->size == 0) return drop_seed("unexpected chunk header");
+            if (chunk_hdr->size > http_::response_data_block_max) return drop_seed("block is too big");
+            size = chunk_hdr->size;
+        }
+        else if (auto chunk_body = (*part)->as_chunk_body()) {
+            if (!size) return drop_seed("unexpected chunk body");
+            if (block_size + chunk_body->size() > *size) return drop_seed("corrupted local data");
 
-    PreFetch* pre_fetch;
+            block_hasher.update(chunk_body->buffer());
 
-    if (last_peer == nullptr || next_peer == last_peer) {
-        pre_fetch = new PreFetchSequential(block_id, next_peer, _executor);
-    } else {
-        pre_fetch = new PreFetchParallel(block_id, next_peer, _executor);
+            if (block_size == 0 && chunk_body->size() == *size) {
+                data = *chunk_body;
+            } else {
+                if (block_buf.size() == 0) block_buf = _block_writer.prepare(*size);
+                asio::buffer_copy(block_buf + block_size, chunk_body->buffer());
+            }
+            block_size += chunk_body->size();
+        }
     }
 
-    return std::unique_ptr<PreFetch>(pre_fetch);
+    if (block_hasher.close() != ref_block.data_hash)
+        return drop_seed("corrupted local data");
+
+    if (data.empty()) data = _block_writer.commit(block_size);
+
+    return Block{ {std::move(data), 0}
+                , {0, cache::block_chunk_ext(ref_block.chained_hash_signature)}
+                , std::nullopt};
 }
 
 // May return std::nullopt and no error if the response has no body (e.g. redirect msg)
 std::expected<std::optional<MultiPeerReader::Block>, sys::error_code>
 MultiPeerReader::fetch_block(size_t block_id, Async yield)
 {
-    //   Q0   Q1   R0   Q2   R1   Q3   R2
-    // |----|----|----|----|----|----|----|...
-
-    if (!_pre_fetch) {
-        auto e = new_fetch_job(block_id, nullptr, yield);
-        if (!e) {
-            return std::unexpected(e.error());
-        }
-        _pre_fetch = std::move(*e);
-
-        // new_fetch_job should always return non-null if block_id is valid.
-        assert(_pre_fetch);
+    // Peers are only involved once local blocks are exhausted,
+    // so no requests are sent for blocks available locally.
+    if (auto block = read_seed_block(block_id, yield)) {
+        return std::move(*block);
     }
 
-    auto fetch = std::move(_pre_fetch);
-
-    auto e = new_fetch_job(block_id + 1, fetch->peer, yield);
-    if (!e) {
-        return std::unexpected(e.error());
+    // Blocks from this one on are fetched from peers.
+    if (!_scheduler) {
+        _scheduler = make_unique<Scheduler>( block_id
+                                           , _reference_hash_list->blocks.size()
+                                           , _fetch_window);
     }
-    _pre_fetch = std::move(*e);
 
     while (true) {
-        auto block_e = fetch->get_block(yield);
-        if (!block_e) {
-            // Retry with another peer
-            unmark_as_good(*fetch->peer);
-
-            auto fetch_e = new_fetch_job(block_id, nullptr, yield);
-            if (!fetch_e) {
-                return std::unexpected(fetch_e.error());
-            }
-            fetch = std::move(*fetch_e);
-
-            // new_fetch_job should always return non-null if block_id is valid.
-            assert(fetch);
+        start_fetch_jobs();
+
+        auto fetched = _fetched_blocks.find(block_id);
+        if (fetched != _fetched_blocks.end()) {
+            auto block = std::move(fetched->second);
+            _fetched_blocks.erase(fetched);
+            _scheduler->delivered(block_id);
+            start_fetch_jobs();  // the window moved on
+            return block;
+        }
 
-            continue;
+        if (!_scheduler->is_available(block_id) && !_peers->still_waiting_for_candidates()) {
+            return std::unexpected(Errc::no_peers);
         }
 
-        return *block_e;
+        auto e = _peers->wait_for_change(yield);
+        if (!e) {
+            return std::unexpected(e.error());
+        }
     }
 }
 
@@ -1002,13 +1147,13 @@ MultiPeerReader::async_read_part(Async yield)
     auto result = async_read_part_impl(yield);
     if (!result) {
         _state = State::closed;
-        _peers = nullptr;
+        drop_peers();
         return std::unexpected(result.error());
     }
 
     if (!*result) {
         _state = State::done;
-        _peers = nullptr;
+        drop_peers();
     }
 
     return *result;
@@ -1094,7 +1239,16 @@ MultiPeerReader::async_read_part_impl(Async yield)
 void MultiPeerReader::close()
 {
     _state = State::closed;
-    _peers = nullptr;;
+    drop_peers();
+    _seed = std::nullopt;
+}
+
+void MultiPeerReader::drop_peers()
+{
+    // Blocks being fetched refer to peers.
+    _scheduler = nullptr;
+    _fetched_blocks.clear();
+    _peers = nullptr;
 }
 
 void MultiPeerReader::mark_done()
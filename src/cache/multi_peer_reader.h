@@ -1,13 +1,17 @@
 #pragma once
 
+#include <map>
 #include <set>
+#include <vector>
 #include <chrono>
 #include <boost/asio/ip/udp.hpp>
 #include "../response_reader.h"
 #include "../namespaces.h"
+#include "block_scheduler.h"
 #include "dht_lookup.h"
 #include "hash_list.h"
 #include "../util/log_path.h"
+#include "../util/shared_bytes.h"
 #include "../session.h"
 #include "resource_id.h"
 #include "util/crypto_stream_key.h"
@@ -20,19 +24,31 @@ private:
     class Peer;
     class Peers;
     struct Block;
-    struct PreFetch;
-    struct PreFetchSequential;
-    struct PreFetchParallel;
+
+    using Scheduler = BlockScheduler<Peer>;
 
     enum class State { active, done, closed };
 
 public:
+    // Blocks of the response which are already available locally,
+    // e.g. from an incomplete entry in the local cache.
+    struct Seed {
+        // Only covering the blocks available from `reader`.
+        HashList hash_list;
+        // A reader of the local copy (as provided by the HTTP store)
+        // which has not been read from yet.
+        std::unique_ptr<http_response::AbstractReader> reader;
+    };
+
     // Use this for local cache and LAN retrieval only.
+    //
+    // LAN peers are contacted in the given order,
+    // only `LAN_HASH_LIST_CONCURRENCY` of them at the same time.
     MultiPeerReader( AsioExecutor ex
                    , ResourceId
                    , CryptoStreamKey
                    , sign::PublicKey cache_pk
-                   , std::set<asio::ip::udp::endpoint> lan_peers
+                   , std::vector<asio::ip::udp::endpoint> lan_peers
                    , std::set<asio::ip::udp::endpoint> lan_my_endpoints
                    , std::shared_ptr<unsigned> newest_proto_seen
                    , util::LogPath);
@@ -42,7 +58,7 @@ public:
                    , ResourceId
                    , CryptoStreamKey
                    , sign::PublicKey cache_pk
-                   , std::set<asio::ip::udp::endpoint> lan_peers
+                   , std::vector<asio::ip::udp::endpoint> lan_peers
                    , std::shared_ptr<DhtLookup> peer_lookup
                    , std::shared_ptr<unsigned> newest_proto_seen
                    , util::LogPath);
@@ -60,6 +76,24 @@ public:
     MultiPeerReader(MultiPeerReader&&) = delete;
     MultiPeerReader(const MultiPeerReader&) = delete;
 
+    // Read blocks available in the given seed from it
+    // instead of fetching them from peers,
+    // as long as they match the hash list chosen from peers.
+    // The rest of blocks are fetched from peers as usual.
+    //
+    // This must be called before reading any part.
+    void seed(Seed);
+
+    // Fetch up to this many blocks from peers at the same time
+    // (including blocks already fetched but not read yet).
+    //
+    // This must be called before reading any part.
+    void set_fetch_window(size_t);
+
+    static constexpr size_t DEFAULT_FETCH_WINDOW = 16;
+
+    static constexpr size_t LAN_HASH_LIST_CONCURRENCY = 2;
+
     std::expected<std::optional<http_response::Part>, sys::error_code>
     async_read_part(Async) override;
 
@@ -84,12 +118,15 @@ private:
     std::expected<std::optional<Block>, sys::error_code>
     fetch_block(size_t block_id, Async);
 
+    std::optional<Block> read_seed_block(size_t block_id, Async);
+
     void unmark_as_good(Peer& peer);
 
     void mark_done();
 
-    std::expected<std::unique_ptr<PreFetch>, sys::error_code>
-    new_fetch_job(size_t block_id, Peer* last_peer, Async);
+    void start_fetch_jobs();
+
+    void drop_peers();
 
     static constexpr std::chrono::seconds BEP5_HASH_LIST_TIMEOUT{10};
     static constexpr std::chrono::seconds BEP3_HASH_LIST_TIMEOUT{30};
@@ -111,7 +148,15 @@ private:
 
     State _state = State::active;
 
-    std::unique_ptr<PreFetch> _pre_fetch;
+    size_t _fetch_window = DEFAULT_FETCH_WINDOW;
+    std::unique_ptr<Scheduler> _scheduler;
+    // Blocks fetched from peers, waiting to be read in order.
+    std::map<size_t, std::optional<Block>> _fetched_blocks;
+
+    std::optional<Seed> _seed;
+    // Seed blocks not read as a single chunk body are accumulated
+    // in buffers from the executor's pool.
+    util::SharedBytesWriter _block_writer;
 };
 
 } // namespaces
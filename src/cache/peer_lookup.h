@@ -21,11 +21,12 @@ protected:
         sys::error_code   ec = asio::error::no_data;
         Ret               value;
         Clock::time_point time;
+        // For how long after `time` the value is used without waiting for a new lookup.
+        Clock::duration   ttl = std::chrono::minutes(5);
 
         bool is_fresh() const {
-            using namespace std::chrono_literals;
             if (ec) return false;
-            return time + 5min >= Clock::now();
+            return time + ttl >= Clock::now();
         }
     };
 
@@ -47,7 +48,7 @@ public:
 
     std::expected<Ret, sys::error_code> get(Async yield) {
         // * Start a new job if one isn't already running
-        // * Use previously returned result if it's not older than 5mins
+        // * Use previously returned result if it's still fresh (5mins by default)
         // * Otherwise wait for the running job to finish
 
         if (!_job || !_job->is_running()) {
@@ -91,6 +92,18 @@ protected:
     // Children implement this to perform the actual peer lookup.
     virtual std::expected<Ret, sys::error_code> do_lookup(Async) = 0;
 
+    // Use a result obtained elsewhere (e.g. saved by a previous run),
+    // found `age` ago, for up to `ttl` since then
+    // or until a lookup succeeds.
+    void seed_result(Ret value, Clock::duration age, Clock::duration ttl) {
+        _last_result = Result{
+            .ec    = sys::error_code(),
+            .value = std::move(value),
+            .time  = Clock::now() - age,
+            .ttl   = ttl,
+        };
+    }
+
     // Used in log messages to identify the lookup strategy
     const char* _lookup_strategy_name = "Generic PeerLookup";
 
@@ -119,9 +132,11 @@ private:
                     return std::unexpected(result.error());
                 }
 
-                _last_result.ec = sys::error_code();
-                _last_result.value = std::move(result).value();
-                _last_result.time = Clock::now();
+                _last_result = Result{
+                    .ec    = sys::error_code(),
+                    .value = std::move(result).value(),
+                    .time  = Clock::now(),
+                };
 
                 return {};
             }
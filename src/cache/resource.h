@@ -11,6 +11,7 @@
 #include "../http_util.h"
 #include "http_sign.h"
 #include "signed_head.h"
+#include "sigs_file.h"
 #include "logger.h"
 #include <boost/format.hpp>
 #include <boost/beast/http/read.hpp>
@@ -28,6 +29,9 @@ struct Range {
 };
 
 // A signatures file entry with `OFFSET[i] SIGNATURE[i] BLOCK_DIGEST[i] CHASH[i-1]`.
+//
+// This is the representation used for the legacy text format of signature files,
+// and also what readers of stored responses use to build chunk extensions.
 // TODO: implement `ouipsig`
 struct SigEntry {
     std::size_t offset;
@@ -49,6 +53,18 @@ struct SigEntry {
                % (prev_chained_digest.empty() ? pad_digest() : prev_chained_digest)).str();
     }
 
+    // Build an entry from a binary record of block `i`
+    // and the chained hash of block `i-1` (if any).
+    static
+    SigEntry from_record( const sigs_file::Record& rec
+                        , const boost::optional<sigs_file::Record::Digest>& prev_chained_digest)
+    {
+        return SigEntry{ rec.offset
+                       , util::base64_encode(rec.signature)
+                       , util::base64_encode(rec.block_digest)
+                       , prev_chained_digest ? util::base64_encode(*prev_chained_digest) : ""};
+    }
+
     std::string chunk_exts() const
     {
         std::ostringstream exts;
@@ -239,8 +255,28 @@ private:
             return std::unexpected(r.error());
         }
 
+        auto first_block = block_offset / *block_size;
+
+        if (auto r = detect_sigs_format(yield); !r) {
+            return std::unexpected(r.error());
+        }
+
+        if (sigs_format == sigs_file::Format::binary) {
+            // Records have a fixed size, just get the one for the block
+            // before the first one (for its chained hash) and go on from there.
+            if (first_block == 0) return {};
+            auto pos = sigs_file::record_position(first_block - 1);
+            if (auto r = util::file_io::fseek(sigsf, pos); !r) {
+                return std::unexpected(r.error());
+            }
+            if (auto r = get_sig_entry(yield); !r) {
+                return std::unexpected(r.error());
+            }
+            return {};
+        }
+
         // Consume signatures before the first block.
-        for (unsigned b = 0; b < (block_offset / *block_size); ++b) {
+        for (unsigned b = 0; b < first_block; ++b) {
             if (auto r = get_sig_entry(yield); !r) {
                 return std::unexpected(r.error());
             }
@@ -249,6 +285,59 @@ private:
         return {};
     }
 
+    // Read the beginning of the signatures file to find out its format.
+    // Bytes read from a legacy text file are kept for parsing.
+    [[nodiscard]]
+    std::expected<void, sys::error_code>
+    detect_sigs_format(Async yield)
+    {
+        if (sigs_format || !sigsf.is_open()) return {};
+
+        sigs_file::Header h;
+        sys::error_code ec;
+        auto len = asio::async_read(sigsf, asio::buffer(h), yield.asio_yield()[ec]);
+        if (yield.is_cancelled()) throw Async::Cancelled();
+        if (ec == asio::error::eof) ec = {};
+        if (ec) return std::unexpected(ec);
+
+        sigs_format = sigs_file::detect_format(h.data(), len);
+        switch (*sigs_format) {
+        case sigs_file::Format::empty:
+        case sigs_file::Format::binary:
+            return {};
+        case sigs_file::Format::text:
+            sigs_buffer.assign(reinterpret_cast<const char*>(h.data()), len);
+            return {};
+        case sigs_file::Format::unknown:
+            break;
+        }
+        CACHE_RESOURCE_ERROR("Unknown format of signatures file; uri=", uri);
+        return std::unexpected(sys::errc::make_error_code(sys::errc::bad_message));
+    }
+
+    [[nodiscard]]
+    std::expected<boost::optional<SigEntry>, sys::error_code>
+    get_sig_record(Async yield)
+    {
+        sigs_file::Record::Bytes rb;
+        sys::error_code ec;
+        auto len = asio::async_read(sigsf, asio::buffer(rb), yield.asio_yield()[ec]);
+        if (yield.is_cancelled()) throw Async::Cancelled();
+        if (ec == asio::error::eof) ec = {};
+        if (ec) return std::unexpected(ec);
+
+        if (len == 0) return boost::none;
+        if (len < rb.size()) {
+            CACHE_RESOURCE_ERROR("Truncated signature record");
+            return std::unexpected(sys::errc::make_error_code(sys::errc::bad_message));
+        }
+
+        auto rec = sigs_file::Record::deserialize(rb.data());
+        auto entry = SigEntry::from_record(rec, prev_chained_digest);
+        prev_chained_digest = rec.chained_digest;
+        return entry;
+    }
+
 protected:
     [[nodiscard]]
     std::expected<boost::optional<SigEntry>, sys::error_code>
@@ -257,7 +346,18 @@ protected:
         assert(_is_head_done);
         if (!sigsf.is_open()) return boost::none;
 
-        return SigEntry::parse(sigsf, sigs_buffer, yield);
+        if (auto r = detect_sigs_format(yield); !r) {
+            return std::unexpected(r.error());
+        }
+
+        switch (*sigs_format) {
+        case sigs_file::Format::empty:
+            return boost::none;
+        case sigs_file::Format::binary:
+            return get_sig_record(yield);
+        default:
+            return SigEntry::parse(sigsf, sigs_buffer, yield);
+        }
     }
 
 private:
@@ -437,7 +537,9 @@ private:
 
     std::size_t block_offset = 0;
 
-    SigEntry::parse_buffer sigs_buffer;
+    boost::optional<sigs_file::Format> sigs_format;
+    SigEntry::parse_buffer sigs_buffer;  // for the legacy text format
+    boost::optional<sigs_file::Record::Digest> prev_chained_digest;  // for the binary format
 
     std::vector<uint8_t> body_buffer;
 
@@ -0,0 +1,133 @@
+#include "sigs_file.h"
+
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include "http_store.h"
+#include "resource.h"
+#include "../logger.h"
+#include "../util/atomic_file.h"
+#include "../util/compat.h"
+#include "../util/file_io.h"
+#include "../util/variant.h"
+#include "chain_hasher.h"
+
+#define _LOGPFX "HTTP store signatures: "
+#define _DEBUG(...) LOG_DEBUG(_LOGPFX, __VA_ARGS__)
+#define _WARN(...) LOG_WARN(_LOGPFX, __VA_ARGS__)
+
+namespace ouinet::cache::sigs_file {
+
+struct MappedFile::Impl {
+    boost::iostreams::mapped_file_source source;
+};
+
+MappedFile::MappedFile(std::unique_ptr<Impl> impl)
+    : _impl(std::move(impl))
+{
+    auto sz = _impl->source.size();
+    _data = reinterpret_cast<const uint8_t*>(_impl->source.data());
+    // An incomplete trailing record (e.g. from an interrupted write) is ignored.
+    _size = (sz - header_size) / record_size;
+}
+
+MappedFile::MappedFile(MappedFile&&) = default;
+MappedFile& MappedFile::operator=(MappedFile&&) = default;
+MappedFile::~MappedFile() = default;
+
+std::expected<MappedFile, sys::error_code>
+MappedFile::open(const fs::path& path)
+{
+    sys::error_code ec;
+    auto sz = fs::file_size(path, ec);
+    if (ec) return std::unexpected(ec);
+
+    // Empty files cannot be mapped,
+    // and files with no header cannot be in binary format anyway.
+    if (sz < header_size) return std::unexpected(asio::error::bad_descriptor);
+
+    auto impl = std::make_unique<Impl>();
+    try {
+        impl->source.open(path.string());
+    } catch (const std::exception& e) {
+        _WARN("Failed to map signatures file: ", path, "; err=", e.what());
+        return std::unexpected(sys::errc::make_error_code(sys::errc::io_error));
+    }
+    if (!impl->source.is_open()) {
+        return std::unexpected(sys::errc::make_error_code(sys::errc::io_error));
+    }
+
+    auto data = reinterpret_cast<const uint8_t*>(impl->source.data());
+    if (detect_format(data, impl->source.size()) != Format::binary) {
+        return std::unexpected(asio::error::bad_descriptor);
+    }
+
+    return MappedFile(std::move(impl));
+}
+
+std::expected<bool, sys::error_code>
+upgrade(const fs::path& dirp, Async yield)
+{
+    auto ex = yield.get_executor();
+    auto path = dirp / sigs_fname;
+
+    auto sigsf = util::file_io::open_readonly(ex, path);
+    if (!sigsf) {
+        if (sigsf.error() == sys::errc::no_such_file_or_directory) return false;
+        return std::unexpected(sigsf.error());
+    }
+
+    {
+        auto fsz = util::file_io::file_size(*sigsf);
+        if (!fsz) return std::unexpected(fsz.error());
+
+        Header h;
+        auto hsz = std::min(*fsz, h.size());
+        if (auto r = util::file_io::read(*sigsf, asio::buffer(h.data(), hsz), yield); !r)
+            return std::unexpected(r.error());
+        if (detect_format(h.data(), hsz) != Format::text) return false;
+
+        if (auto r = util::file_io::fseek(*sigsf, 0); !r)
+            return std::unexpected(r.error());
+    }
+
+    _DEBUG("Upgrading signatures file to binary format: ", path);
+
+    auto outf = util::atomic_file::make(ex, path);
+    if (!outf) return std::unexpected(outf.error());
+
+    auto h = header();
+    if (auto r = util::file_io::write(outf->lowest_layer(), asio::buffer(h), yield); !r)
+        return std::unexpected(r.error());
+
+    // Text entries carry the chained hash of the *previous* block,
+    // so the one for the current block needs to be computed.
+    ChainHasher chain_hasher;
+    SigEntry::parse_buffer buf;
+    while (true) {
+        auto entry_o = SigEntry::parse(*sigsf, buf, yield);
+        if (!entry_o) return std::unexpected(entry_o.error());
+        if (!*entry_o) break;
+        auto& entry = **entry_o;
+
+        auto sig = util::base64_decode<sign::Signature::Bytes>(entry.signature);
+        auto dhash = util::base64_decode<Record::Digest>(entry.block_digest);
+        if (!sig || !dhash) return std::unexpected(asio::error::bad_descriptor);
+
+        // Only the chained digest is of interest here, not the offset.
+        auto chash = chain_hasher.calculate_block(0, *dhash, sign::Signature{*sig});
+
+        Record rec{entry.offset, *sig, *dhash, chash.chain_digest};
+        auto rec_bytes = rec.serialize();
+        if (auto r = util::file_io::write(outf->lowest_layer(), asio::buffer(rec_bytes), yield); !r)
+            return std::unexpected(r.error());
+    }
+
+    sigsf->close();
+
+    auto rc = compat([&] (sys::error_code& ec) { outf->commit(ec); })();
+    if (!rc) return std::unexpected(rc.error());
+
+    return true;
+}
+
+} // namespace ouinet::cache::sigs_file
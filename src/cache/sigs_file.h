@@ -0,0 +1,167 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <memory>
+
+#include <boost/filesystem/path.hpp>
+
+#include "../util/hash.h"
+#include "../util/sign.h"
+#include "../namespaces.h"
+
+namespace ouinet {
+    class Async;
+}
+
+namespace ouinet::cache::sigs_file {
+
+// Binary format of the `sigs` file of a stored response
+// (see `http_store` in `http_store.h` for the description).
+//
+// Since records have a fixed size,
+// the record for block `i` is found at `header_size + i * record_size`,
+// so it can be located without reading previous records,
+// and the whole file can be memory-mapped and indexed directly.
+
+static const std::array<uint8_t, 7> magic{'O', 'U', 'I', 'S', 'I', 'G', 'S'};
+static const uint8_t current_version = 1;
+
+static const std::size_t header_size = magic.size() + 1;  // magic + version
+static const std::size_t record_size
+    = 8  // OFFSET
+    + sign::Signature::size  // SIG
+    + util::SHA512::size()  // DHASH
+    + util::SHA512::size();  // CHASH
+
+using Header = std::array<uint8_t, header_size>;
+
+inline
+Header header()
+{
+    Header h;
+    std::copy(magic.begin(), magic.end(), h.begin());
+    h[magic.size()] = current_version;
+    return h;
+}
+
+inline
+std::size_t record_position(std::size_t block)
+{
+    return header_size + block * record_size;
+}
+
+enum class Format {
+    empty,  // no data yet
+    text,  // legacy `data-v4` format (fixed length text lines)
+    binary,  // current binary format
+    unknown,  // unsupported binary format version or garbage
+};
+
+// Detect the format of a signatures file given (at least) its first `header_size` bytes.
+inline
+Format detect_format(const uint8_t* data, std::size_t size)
+{
+    if (size == 0) return Format::empty;
+    // Text lines start with a zero-padded, lower-case hexadecimal offset.
+    auto is_lhex = [] (uint8_t c) { return ('0' <= c && c <= '9') || ('a' <= c && c <= 'f'); };
+    if (is_lhex(data[0])) return Format::text;
+    if (size < header_size) return Format::unknown;
+    if (std::memcmp(data, magic.data(), magic.size()) != 0) return Format::unknown;
+    if (data[magic.size()] != current_version) return Format::unknown;
+    return Format::binary;
+}
+
+// A record for block `i` with `OFFSET[i] SIG[i] DHASH[i] CHASH[i]`.
+//
+// Please note that, unlike legacy text entries,
+// it contains the chained hash of the *current* block,
+// so that the `ouihash` chunk extension of block `i`
+// is taken from the record of block `i-1`.
+struct Record {
+    using Digest = util::SHA512::digest_type;
+    using Bytes = std::array<uint8_t, record_size>;
+
+    std::size_t offset;
+    sign::Signature::Bytes signature;
+    Digest block_digest;
+    Digest chained_digest;
+
+    Bytes serialize() const
+    {
+        Bytes b;
+        auto p = b.data();
+        uint64_t off = offset;
+        for (int i = 7; i >= 0; --i, off >>= 8) p[i] = off & 0xff;  // big endian
+        p += 8;
+        p = std::copy(signature.begin(), signature.end(), p);
+        p = std::copy(block_digest.begin(), block_digest.end(), p);
+        p = std::copy(chained_digest.begin(), chained_digest.end(), p);
+        assert(p == b.data() + b.size());
+        return b;
+    }
+
+    // `data` must point to at least `record_size` bytes.
+    static
+    Record deserialize(const uint8_t* data)
+    {
+        Record r;
+        uint64_t off = 0;
+        for (int i = 0; i < 8; ++i) off = (off << 8) | data[i];
+        r.offset = off;
+        data += 8;
+        std::memcpy(r.signature.data(), data, r.signature.size()); data += r.signature.size();
+        std::memcpy(r.block_digest.data(), data, r.block_digest.size()); data += r.block_digest.size();
+        std::memcpy(r.chained_digest.data(), data, r.chained_digest.size());
+        return r;
+    }
+};
+
+// A read-only, memory-mapped binary signatures file.
+//
+// Records are decoded directly from the mapped region,
+// no parsing or Base64 decoding is involved.
+class MappedFile {
+public:
+    [[nodiscard]]
+    static
+    std::expected<MappedFile, sys::error_code>
+    open(const fs::path&);
+
+    MappedFile(MappedFile&&);
+    MappedFile& operator=(MappedFile&&);
+    ~MappedFile();
+
+    // Number of complete records in the file.
+    std::size_t size() const { return _size; }
+
+    Record operator[](std::size_t block) const
+    {
+        assert(block < _size);
+        return Record::deserialize(_data + record_position(block));
+    }
+
+private:
+    struct Impl;
+
+    MappedFile(std::unique_ptr<Impl>);
+
+    std::unique_ptr<Impl> _impl;
+    const uint8_t* _data = nullptr;
+    std::size_t _size = 0;
+};
+
+// If the signatures file under the response directory `dirp`
+// is in the legacy text format, convert it to the binary format
+// and atomically replace the original file.
+//
+// Return whether conversion took place.
+// A missing signatures file is not considered an error.
+[[nodiscard]]
+std::expected<bool, sys::error_code>
+upgrade(const fs::path& dirp, Async);
+
+} // namespace ouinet::cache::sigs_file
@@ -0,0 +1,138 @@
+#include "store_index.h"
+#include "store_journal.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace ouinet::cache {
+
+StoreIndex::Rank
+StoreIndex::rank(const Entry& e) const
+{
+    return Rank{_policy == Policy::lfu ? e.hits : 0, e.accessed, e.seq};
+}
+
+void
+StoreIndex::insert(const ResourceId& rid, Entry e)
+{
+    uint64_t hits = 0;
+    if (auto ep = find(rid)) hits = ep->hits;
+
+    if (e.accessed == 0) e.accessed = std::time(nullptr);
+    e.hits = hits + 1;
+
+    if (_journal) _journal->put(rid, e);
+    do_insert(rid, e);
+}
+
+void
+StoreIndex::restore(const ResourceId& rid, Entry e)
+{
+    do_insert(rid, e);
+}
+
+void
+StoreIndex::do_insert(const ResourceId& rid, Entry e)
+{
+    auto ei = _entries.find(rid);
+    if (ei != _entries.end()) {
+        _ranking.erase(rank(ei->second));
+        _total_size -= ei->second.size;
+        _entries.erase(ei);
+    }
+
+    e.seq = _next_seq++;
+    _ranking.emplace(rank(e), rid);
+    _entries.emplace(rid, e);
+    _total_size += e.size;
+}
+
+bool
+StoreIndex::touch(const ResourceId& rid, std::time_t accessed)
+{
+    auto ei = _entries.find(rid);
+    if (ei == _entries.end()) return false;
+
+    auto& e = ei->second;
+    auto ri = _ranking.find(rank(e));
+    assert(ri != _ranking.end());
+
+    e.accessed = std::max(e.accessed, accessed);
+    e.hits++;
+    e.seq = _next_seq++;
+
+    // Reuse the node and its key.
+    auto node = _ranking.extract(ri);
+    node.key() = rank(e);
+    _ranking.insert(std::move(node));
+
+    if (_journal) _journal->touch(rid, e.accessed);
+    return true;
+}
+
+bool
+StoreIndex::erase(const ResourceId& rid)
+{
+    auto ei = _entries.find(rid);
+    if (ei == _entries.end()) return false;
+
+    _ranking.erase(rank(ei->second));
+    _total_size -= ei->second.size;
+    _entries.erase(ei);
+
+    if (_journal) _journal->erase(rid);
+    return true;
+}
+
+const StoreIndex::Entry*
+StoreIndex::find(const ResourceId& rid) const
+{
+    auto ei = _entries.find(rid);
+    if (ei == _entries.end()) return nullptr;
+    return &ei->second;
+}
+
+std::vector<ResourceId>
+StoreIndex::victims(std::size_t max_size, const keep_func& keep) const
+{
+    std::vector<ResourceId> ret;
+    auto total = _total_size;
+
+    for (auto ri = _ranking.begin(); ri != _ranking.end() && total > max_size; ++ri) {
+        auto& rid = ri->second;
+        if (keep && keep(rid)) continue;
+        total -= _entries.at(rid).size;
+        ret.push_back(rid);
+    }
+
+    return ret;
+}
+
+std::vector<ResourceId>
+StoreIndex::injected_before(std::time_t ts) const
+{
+    std::vector<ResourceId> ret;
+    for (auto& [rid, e] : _entries)
+        if (e.injected < ts) ret.push_back(rid);
+    return ret;
+}
+
+std::optional<StoreIndex::Policy>
+parse_eviction_policy(std::string_view s)
+{
+    if (s == "lru") return StoreIndex::Policy::lru;
+    if (s == "lfu") return StoreIndex::Policy::lfu;
+    return std::nullopt;
+}
+
+std::ostream&
+operator<<(std::ostream& os, StoreIndex::Policy p)
+{
+    switch (p) {
+        case StoreIndex::Policy::lru: return os << "lru";
+        case StoreIndex::Policy::lfu: return os << "lfu";
+    }
+    return os;
+}
+
+} // namespace ouinet::cache
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "resource_id.h"
+#include "../api.h"
+
+namespace ouinet::cache {
+
+class StoreJournal;
+
+// An in-memory index of the entries in the local HTTP store,
+// used to enforce a size budget on it without scanning the store.
+//
+// Entries are kept sorted by eviction preference:
+// least recently accessed first with the `lru` policy,
+// least frequently accessed first (then least recently) with the `lfu` policy.
+class OUINET_COMMON_API StoreIndex {
+public:
+    enum class Policy { lru, lfu };
+
+    struct Entry {
+        std::size_t size = 0;  // bytes used in storage
+        std::size_t body_size = 0;  // bytes of body data in storage
+        bool complete = false;  // whether all body data is in storage
+        std::time_t injected = 0;  // injection time stamp, 0 if unknown
+        std::time_t expires = 0;  // end of freshness, 0 if unknown or never fresh
+        std::time_t accessed = 0;  // time stamp of last access
+        uint64_t hits = 0;  // number of accesses
+        uint64_t seq = 0;  // tie breaker for accesses in the same second (not persisted)
+    };
+
+    // Return whether the entry must not be evicted.
+    using keep_func = std::function<bool(const ResourceId&)>;
+
+public:
+    StoreIndex(Policy policy = Policy::lru) : _policy(policy) {}
+
+    Policy policy() const { return _policy; }
+
+    // Record changes in the given journal (if not null).
+    void set_journal(StoreJournal* journal) { _journal = journal; }
+
+    // Add an entry, or replace it if already present.
+    //
+    // The entry is considered as accessed at its `accessed` time
+    // (or now if zero), and a replaced entry keeps its previous number of accesses.
+    void insert(const ResourceId&, Entry);
+
+    // Add an entry as previously saved (e.g. in a journal),
+    // keeping its access statistics.
+    //
+    // The change is not recorded in the journal.
+    void restore(const ResourceId&, Entry);
+
+    // Record an access to the entry, if present.
+    //
+    // Return whether the entry was found.
+    bool touch(const ResourceId&, std::time_t accessed = std::time(nullptr));
+
+    // Return whether the entry was found.
+    bool erase(const ResourceId&);
+
+    const Entry* find(const ResourceId&) const;
+
+    const std::map<ResourceId, Entry>& entries() const { return _entries; }
+
+    // Number of entries.
+    std::size_t size() const { return _entries.size(); }
+
+    // Sum of the sizes of all entries.
+    std::size_t total_size() const { return _total_size; }
+
+    // Return the entries to be evicted (in eviction order)
+    // for the total size not to exceed `max_size` (if possible).
+    //
+    // Entries for which `keep` returns true are skipped.
+    // The index itself is not modified.
+    std::vector<ResourceId>
+    victims(std::size_t max_size, const keep_func& keep) const;
+
+    // Return the entries injected before the given time stamp,
+    // including those with an unknown injection time.
+    std::vector<ResourceId>
+    injected_before(std::time_t) const;
+
+private:
+    // (hits or 0 for LRU, access time stamp, sequence number)
+    using Rank = std::tuple<uint64_t, std::time_t, uint64_t>;
+
+    Rank rank(const Entry&) const;
+
+    void do_insert(const ResourceId&, Entry);
+
+private:
+    Policy _policy;
+    StoreJournal* _journal = nullptr;
+    uint64_t _next_seq = 0;
+    std::size_t _total_size = 0;
+    std::map<ResourceId, Entry> _entries;
+    std::map<Rank, ResourceId> _ranking;
+};
+
+std::optional<StoreIndex::Policy> parse_eviction_policy(std::string_view);
+
+std::ostream& operator<<(std::ostream&, StoreIndex::Policy);
+
+} // namespace ouinet::cache
@@ -0,0 +1,441 @@
+#include "store_journal.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <iterator>
+#include <optional>
+
+#include <boost/crc.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include "../logger.h"
+#include "../util/bytes.h"
+
+#define _LOGPFX "Store journal: "
+#define _DEBUG(...) LOG_DEBUG(_LOGPFX, __VA_ARGS__)
+#define _WARN(...) LOG_WARN(_LOGPFX, __VA_ARGS__)
+
+namespace ouinet::cache {
+
+static const std::array<char, 7> magic{'O', 'U', 'I', 'S', 'I', 'D', 'X'};
+static const uint8_t current_version = 2;
+static const std::size_t header_size = magic.size() + 1 + 4;  // magic + version + tag
+static const std::size_t rid_size = 20;  // raw SHA1 digest
+
+// Appended changes beyond this amount
+// (or the amount of records in the snapshot if greater)
+// make compaction worth it.
+static const std::size_t min_records_to_compact = 4096;
+
+// Buffered accesses beyond this size are written without waiting for `flush`.
+static const std::size_t max_pending_size = 64 * 1024;
+
+enum RecordType : uint8_t {
+    rec_put = 1,  // RID SIZE BODY_SIZE COMPLETE INJECTED EXPIRES ACCESSED HITS
+    rec_touch = 2,  // RID ACCESSED
+    rec_erase = 3,  // RID
+    rec_add_item = 4,  // RID GROUP_NAME
+    rec_remove_item = 5,  // RID GROUP_NAME
+    rec_remove_group = 6,  // GROUP_NAME
+};
+
+//// Encoding
+
+static
+void
+put_uint(std::string& out, uint64_t n, std::size_t bytes)
+{
+    for (std::size_t i = bytes; i > 0; --i)
+        out.push_back(char((n >> (8 * (i - 1))) & 0xff));
+}
+
+static
+void
+put_rid(std::string& out, const ResourceId& rid)
+{
+    auto raw = util::bytes::from_hex(rid.hex_string());
+    assert(raw && raw->size() == rid_size);
+    out += *raw;
+}
+
+static
+std::string
+encode_record(uint8_t type, const std::string& payload)
+{
+    std::string rec;
+    rec.reserve(1 + 4 + payload.size() + 4);
+    put_uint(rec, type, 1);
+    put_uint(rec, payload.size(), 4);
+    rec += payload;
+
+    boost::crc_32_type crc;
+    crc.process_bytes(rec.data(), rec.size());
+    put_uint(rec, crc.checksum(), 4);
+    return rec;
+}
+
+static
+std::string
+encode_put(const ResourceId& rid, const StoreIndex::Entry& e)
+{
+    std::string p;
+    put_rid(p, rid);
+    put_uint(p, e.size, 8);
+    put_uint(p, e.body_size, 8);
+    put_uint(p, e.complete ? 1 : 0, 1);
+    put_uint(p, uint64_t(e.injected), 8);
+    put_uint(p, uint64_t(e.expires), 8);
+    put_uint(p, uint64_t(e.accessed), 8);
+    put_uint(p, e.hits, 8);
+    return p;
+}
+
+static
+std::string
+encode_item(const ResourceId& rid, const StoreJournal::GroupName& group)
+{
+    std::string p;
+    put_rid(p, rid);
+    p += group;
+    return p;
+}
+
+//// Decoding
+
+namespace {
+
+struct Reader {
+    std::string_view data;
+
+    bool get_uint(uint64_t& n, std::size_t bytes) {
+        if (data.size() < bytes) return false;
+        n = 0;
+        for (std::size_t i = 0; i < bytes; ++i)
+            n = (n << 8) | uint8_t(data[i]);
+        data.remove_prefix(bytes);
+        return true;
+    }
+
+    bool get_rid(std::optional<ResourceId>& rid) {
+        if (data.size() < rid_size) return false;
+        rid = ResourceId::from_hex(util::bytes::to_hex(boost::string_view(data.data(), rid_size)));
+        data.remove_prefix(rid_size);
+        return bool(rid);
+    }
+};
+
+} // namespace
+
+// Return whether the record was valid.
+static
+bool
+apply_record(StoreJournal::State& state, uint8_t type, std::string_view payload)
+{
+    Reader r{payload};
+    std::optional<ResourceId> rid;
+
+    switch (type) {
+        case rec_put: {
+            uint64_t size, body_size, complete, injected, expires, accessed, hits;
+            if (!( r.get_rid(rid)
+                && r.get_uint(size, 8) && r.get_uint(body_size, 8)
+                && r.get_uint(complete, 1)
+                && r.get_uint(injected, 8) && r.get_uint(expires, 8)
+                && r.get_uint(accessed, 8)
+                && r.get_uint(hits, 8)
+                && r.data.empty())) return false;
+            StoreIndex::Entry e;
+            e.size = size;
+            e.body_size = body_size;
+            e.complete = complete != 0;
+            e.injected = std::time_t(injected);
+            e.expires = std::time_t(expires);
+            e.accessed = std::time_t(accessed);
+            e.hits = hits;
+            state.entries.insert_or_assign(std::move(*rid), e);
+            return true;
+        }
+        case rec_touch: {
+            uint64_t accessed;
+            if (!(r.get_rid(rid) && r.get_uint(accessed, 8) && r.data.empty()))
+                return false;
+            auto ei = state.entries.find(*rid);
+            if (ei == state.entries.end()) return true;  // already erased
+            ei->second.accessed = std::max(ei->second.accessed, std::time_t(accessed));
+            ei->second.hits++;
+            return true;
+        }
+        case rec_erase: {
+            if (!(r.get_rid(rid) && r.data.empty())) return false;
+            state.entries.erase(*rid);
+            return true;
+        }
+        case rec_add_item: {
+            if (!r.get_rid(rid) || r.data.empty()) return false;
+            state.groups[std::string(r.data)].insert(std::move(*rid));
+            return true;
+        }
+        case rec_remove_item: {
+            if (!r.get_rid(rid) || r.data.empty()) return false;
+            auto gi = state.groups.find(std::string(r.data));
+            if (gi == state.groups.end()) return true;
+            gi->second.erase(*rid);
+            if (gi->second.empty()) state.groups.erase(gi);
+            return true;
+        }
+        case rec_remove_group: {
+            if (r.data.empty()) return false;
+            state.groups.erase(std::string(r.data));
+            return true;
+        }
+    }
+
+    return false;  // unknown record type
+}
+
+static fs::path open_marker_path(const fs::path& path)
+{
+    auto ret = path;
+    ret += ".open";
+    return ret;
+}
+
+std::expected<StoreJournal::State, sys::error_code>
+StoreJournal::load(const fs::path& path, uint32_t tag)
+{
+    using sys::errc::make_error_code;
+
+    if (!fs::exists(path))
+        return std::unexpected(make_error_code(sys::errc::no_such_file_or_directory));
+
+    std::string data;
+    {
+        boost::nowide::ifstream in(path, std::ios::binary);
+        if (!in) return std::unexpected(make_error_code(sys::errc::io_error));
+        data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        if (in.bad()) return std::unexpected(make_error_code(sys::errc::io_error));
+    }
+
+    Reader r{data};
+
+    if (r.data.size() < header_size || !std::equal(magic.begin(), magic.end(), r.data.begin()))
+        return std::unexpected(make_error_code(sys::errc::bad_message));
+    r.data.remove_prefix(magic.size());
+
+    uint64_t version, file_tag;
+    r.get_uint(version, 1);
+    r.get_uint(file_tag, 4);
+    if (version != current_version || file_tag != tag)
+        return std::unexpected(make_error_code(sys::errc::wrong_protocol_type));
+
+    State state;
+    state.unclean = fs::exists(open_marker_path(path));
+    std::size_t records = 0;
+
+    while (!r.data.empty()) {
+        auto rec_start = r.data;
+
+        uint64_t type, length, checksum;
+        if (!r.get_uint(type, 1) || !r.get_uint(length, 4) || r.data.size() < length + 4) {
+            _WARN("Ignoring truncated last record: ", path);
+            state.unclean = true;
+            break;
+        }
+        auto payload = r.data.substr(0, length);
+        r.data.remove_prefix(length);
+        r.get_uint(checksum, 4);
+
+        boost::crc_32_type crc;
+        crc.process_bytes(rec_start.data(), 1 + 4 + length);
+        if (crc.checksum() != checksum || !apply_record(state, type, payload)) {
+            _WARN("Invalid record found at offset ", rec_start.data() - data.data(), ": ", path);
+            return std::unexpected(make_error_code(sys::errc::bad_message));
+        }
+        ++records;
+    }
+
+    _DEBUG("Loaded ", records, " records with ", state.entries.size(), " entries"
+           " and ", state.groups.size(), " groups: ", path);
+    return state;
+}
+
+std::expected<std::unique_ptr<StoreJournal>, sys::error_code>
+StoreJournal::create(fs::path path, uint32_t tag, const State& state)
+{
+    std::unique_ptr<StoreJournal> journal(new StoreJournal(std::move(path), tag));
+    if (auto r = journal->write_snapshot(state); !r)
+        return std::unexpected(r.error());
+
+    boost::nowide::ofstream marker(open_marker_path(journal->_path), std::ios::binary | std::ios::trunc);
+    if (!marker) _WARN("Failed to create open journal marker: ", journal->_path);
+
+    return journal;
+}
+
+StoreJournal::StoreJournal(fs::path path, uint32_t tag)
+    : _path(std::move(path))
+    , _tag(tag)
+{}
+
+StoreJournal::~StoreJournal()
+{
+    flush();
+    if (_broken) return;  // the journal was removed
+
+    sys::error_code ec;
+    fs::remove(open_marker_path(_path), ec);
+}
+
+std::expected<void, sys::error_code>
+StoreJournal::compact(const State& state)
+{
+    return write_snapshot(state);
+}
+
+std::expected<void, sys::error_code>
+StoreJournal::write_snapshot(const State& state)
+{
+    using sys::errc::make_error_code;
+
+    auto temp_path = _path;
+    temp_path += ".tmp";
+
+    std::size_t records = 0;
+    {
+        boost::nowide::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        if (!out) return std::unexpected(make_error_code(sys::errc::io_error));
+
+        std::string buf(magic.begin(), magic.end());
+        put_uint(buf, current_version, 1);
+        put_uint(buf, _tag, 4);
+        out.write(buf.data(), buf.size());
+
+        for (auto& [rid, e] : state.entries) {
+            auto rec = encode_record(rec_put, encode_put(rid, e));
+            out.write(rec.data(), rec.size());
+            ++records;
+        }
+        for (auto& [group, items] : state.groups) {
+            for (auto& rid : items) {
+                auto rec = encode_record(rec_add_item, encode_item(rid, group));
+                out.write(rec.data(), rec.size());
+                ++records;
+            }
+        }
+
+        out.flush();
+        if (!out) {
+            sys::error_code ec;
+            fs::remove(temp_path, ec);
+            return std::unexpected(make_error_code(sys::errc::io_error));
+        }
+    }
+
+    // Appending to the old file would get lost after the rename.
+    _file.close();
+    // Buffered changes are already part of the given state.
+    _pending.clear();
+
+    sys::error_code ec;
+    fs::rename(temp_path, _path, ec);
+    if (ec) {
+        fs::remove(temp_path, ec);
+        _broken = true;
+        return std::unexpected(ec);
+    }
+
+    _file.open(_path, std::ios::binary | std::ios::app);
+    if (!_file) {
+        _broken = true;
+        return std::unexpected(make_error_code(sys::errc::io_error));
+    }
+
+    _snapshot_records = records;
+    _appended_records = 0;
+    _broken = false;
+    _DEBUG("Wrote snapshot with ", records, " records: ", _path);
+    return {};
+}
+
+bool
+StoreJournal::needs_compaction() const
+{
+    return _broken
+        || _appended_records > std::max(min_records_to_compact, _snapshot_records);
+}
+
+void
+StoreJournal::append(uint8_t type, const std::string& payload)
+{
+    if (_broken) return;
+
+    _pending += encode_record(type, payload);
+    ++_appended_records;
+
+    // Other changes must match what is in storage,
+    // but losing some accesses in a crash is harmless.
+    if (type != rec_touch || _pending.size() >= max_pending_size) flush();
+}
+
+void
+StoreJournal::flush()
+{
+    if (_broken || _pending.empty()) return;
+
+    _file.write(_pending.data(), _pending.size());
+    _file.flush();
+    _pending.clear();
+
+    if (!_file) {
+        // A partially written record would make further records unreachable.
+        _WARN("Failed to append to journal, removing it: ", _path);
+        _file.close();
+        sys::error_code ec;
+        fs::remove(_path, ec);
+        _broken = true;
+    }
+}
+
+void
+StoreJournal::put(const ResourceId& rid, const StoreIndex::Entry& e)
+{
+    append(rec_put, encode_put(rid, e));
+}
+
+void
+StoreJournal::touch(const ResourceId& rid, std::time_t accessed)
+{
+    std::string p;
+    put_rid(p, rid);
+    put_uint(p, uint64_t(accessed), 8);
+    append(rec_touch, p);
+}
+
+void
+StoreJournal::erase(const ResourceId& rid)
+{
+    std::string p;
+    put_rid(p, rid);
+    append(rec_erase, p);
+}
+
+void
+StoreJournal::add_item(const GroupName& group, const ResourceId& rid)
+{
+    append(rec_add_item, encode_item(rid, group));
+}
+
+void
+StoreJournal::remove_item(const GroupName& group, const ResourceId& rid)
+{
+    append(rec_remove_item, encode_item(rid, group));
+}
+
+void
+StoreJournal::remove_group(const GroupName& group)
+{
+    append(rec_remove_group, group);
+}
+
+} // namespace ouinet::cache
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <expected>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/nowide/fstream.hpp>
+
+#include "resource_id.h"
+#include "store_index.h"
+#include "../namespaces.h"
+
+namespace ouinet::cache {
+
+// A journaled index file with the state of the local cache
+// (stored responses and the groups they belong to),
+// so that it can be loaded at startup with a single sequential read
+// instead of scanning the whole HTTP store and DHT groups directories.
+//
+// The file starts with a snapshot of the whole state,
+// followed by records of changes appended as they happen.
+// Once changes pile up, the owner of the state should `compact` the journal
+// into a new snapshot.
+//
+// The file format is:
+//
+//     MAGIC VERSION TAG RECORD...
+//
+// where `MAGIC` is `OUISIDX`, `VERSION` is a byte with the format version,
+// and `TAG` is a caller-provided 32-bit number
+// (so that the journal is discarded if it changes).
+// Each `RECORD` is:
+//
+//     TYPE LENGTH PAYLOAD CRC32
+//
+// where `TYPE` is a byte, `LENGTH` is the 32-bit length of `PAYLOAD`,
+// and `CRC32` covers all previous fields of the record.
+// All numbers are big-endian.
+// A truncated last record (e.g. from a crash while appending) is ignored.
+//
+// While a journal is open, a marker file is kept next to it,
+// so that loading it tells whether it was closed cleanly.
+class StoreJournal {
+public:
+    using GroupName = std::string;
+    using Groups = std::map<GroupName, std::set<ResourceId>>;
+
+    struct State {
+        std::map<ResourceId, StoreIndex::Entry> entries;
+        Groups groups;
+        // Set by `load` if the journal was not closed cleanly
+        // (e.g. the process crashed), so storage may have changes
+        // which were not journaled.
+        bool unclean = false;
+    };
+
+public:
+    // Load the state saved in the journal file at `path`.
+    //
+    // A `sys::errc::no_such_file_or_directory` error is reported if it does not exist,
+    // a `sys::errc::bad_message` error if it is corrupted,
+    // and a `sys::errc::wrong_protocol_type` error if its version or tag do not match.
+    [[nodiscard]]
+    static
+    std::expected<State, sys::error_code>
+    load(const fs::path& path, uint32_t tag);
+
+    // Atomically replace the journal file at `path` with a snapshot of the given state,
+    // and open it for appending further changes.
+    [[nodiscard]]
+    static
+    std::expected<std::unique_ptr<StoreJournal>, sys::error_code>
+    create(fs::path path, uint32_t tag, const State&);
+
+    StoreJournal(const StoreJournal&) = delete;
+    StoreJournal& operator=(const StoreJournal&) = delete;
+
+    // Flush buffered changes and mark the journal as closed cleanly.
+    ~StoreJournal();
+
+    const fs::path& path() const { return _path; }
+
+    // Atomically replace the journal with a snapshot of the given state.
+    [[nodiscard]]
+    std::expected<void, sys::error_code>
+    compact(const State&);
+
+    // Whether enough changes have been appended since the last snapshot
+    // for compaction to be worth it.
+    bool needs_compaction() const;
+
+    // Appending changes does not report errors.
+    // If a change fails to be written, the journal file is removed,
+    // so that the state is rebuilt from storage on the next load.
+    //
+    // Accesses (`touch`) are buffered and only written once enough of them pile up,
+    // on `flush`, or along with any other change,
+    // so the owner should `flush` the journal periodically.
+    // Accesses lost in a crash just make the next load see older access times.
+
+    void put(const ResourceId&, const StoreIndex::Entry&);
+    void touch(const ResourceId&, std::time_t accessed);
+    void erase(const ResourceId&);
+
+    void add_item(const GroupName&, const ResourceId&);
+    void remove_item(const GroupName&, const ResourceId&);
+    void remove_group(const GroupName&);
+
+    // Write buffered changes to the journal file.
+    void flush();
+
+private:
+    StoreJournal(fs::path, uint32_t tag);
+
+    [[nodiscard]]
+    std::expected<void, sys::error_code>
+    write_snapshot(const State&);
+
+    void append(uint8_t type, const std::string& payload);
+
+private:
+    fs::path _path;
+    uint32_t _tag;
+    boost::nowide::ofstream _file;
+    std::string _pending;  // encoded records not yet written
+    std::size_t _snapshot_records = 0;
+    std::size_t _appended_records = 0;
+    bool _broken = false;
+};
+
+} // namespace ouinet::cache
@@ -0,0 +1,145 @@
+#include "swarm_peer_cache.h"
+
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/nowide/fstream.hpp>
+
+#include "../logger.h"
+#include "../parse/endpoint.h"
+#include "../parse/number.h"
+#include "../util/atomic_file.h"
+#include "../util/file_io.h"
+#include "../util/str.h"
+
+#define _LOGPFX "Swarm peer cache: "
+#define _DEBUG(...) LOG_DEBUG(_LOGPFX, __VA_ARGS__)
+
+namespace ouinet::cache {
+
+using udp = asio::ip::udp;
+
+static const std::string version_line = "ouinet-swarm-peers 1";
+
+SwarmPeerCache::SwarmPeerCache( fs::path path
+                              , Clock::duration ttl
+                              , std::size_t max_swarms)
+    : _path(std::move(path))
+    , _ttl(ttl)
+    , _entries(max_swarms)
+{}
+
+bool
+SwarmPeerCache::is_expired(const Entry& e, Clock::time_point now) const
+{
+    return e.found + _ttl < now;
+}
+
+std::expected<void, sys::error_code>
+SwarmPeerCache::load()
+{
+    using sys::errc::make_error_code;
+    using namespace std::chrono;
+
+    if (!fs::exists(_path))
+        return std::unexpected(make_error_code(sys::errc::no_such_file_or_directory));
+
+    boost::nowide::ifstream in(_path);
+    if (!in) return std::unexpected(make_error_code(sys::errc::io_error));
+
+    std::string line;
+    if (!std::getline(in, line) || line != version_line)
+        return std::unexpected(make_error_code(sys::errc::wrong_protocol_type));
+
+    auto now = Clock::now();
+    std::size_t loaded = 0;
+
+    // Lines go from least to most recently found,
+    // so that the latter are kept if there are too many.
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string infohash_s, found_s, ep_s;
+
+        if (!(fields >> infohash_s >> found_s)) continue;
+
+        auto infohash = bittorrent::NodeID::from_hex(infohash_s);
+        boost::string_view found_sw = found_s;
+        auto found_secs = parse::number<uint64_t>(found_sw);
+        if (!infohash || !found_secs) continue;
+
+        Entry e{{}, Clock::time_point(seconds(*found_secs))};
+        if (is_expired(e, now)) continue;
+
+        while (fields >> ep_s)
+            if (auto ep = parse::endpoint<udp>(ep_s)) e.peers.insert(*ep);
+
+        if (e.peers.empty()) continue;
+
+        _entries.put(infohash->to_hex(), std::move(e));
+        ++loaded;
+    }
+
+    if (in.bad()) return std::unexpected(make_error_code(sys::errc::io_error));
+
+    _DEBUG("Loaded peers of ", loaded, " swarms: ", _path);
+    return {};
+}
+
+std::expected<void, sys::error_code>
+SwarmPeerCache::store(Async yield) const
+{
+    using namespace std::chrono;
+
+    auto now = Clock::now();
+
+    std::vector<std::pair<const std::string*, const Entry*>> entries;
+    for (auto& [infohash, e] : _entries)
+        if (!is_expired(e, now)) entries.emplace_back(&infohash, &e);
+
+    std::sort(entries.begin(), entries.end(), [] (auto& l, auto& r) {
+        return l.second->found < r.second->found;
+    });
+
+    std::string data = version_line + '\n';
+
+    for (auto [infohash, e] : entries) {
+        data += util::str(*infohash, ' ', duration_cast<seconds>(e->found.time_since_epoch()).count());
+        for (auto& ep : e->peers) data += util::str(' ', ep);
+        data += '\n';
+    }
+
+    auto file = util::atomic_file::make(yield.get_executor(), _path);
+    if (!file) return std::unexpected(file.error());
+
+    if (auto r = util::file_io::write(file->lowest_layer(), asio::buffer(data), yield); !r)
+        return std::unexpected(r.error());
+
+    sys::error_code ec;
+    file->commit(ec);
+    if (ec) return std::unexpected(ec);
+
+    _DEBUG("Stored peers of ", entries.size(), " swarms: ", _path);
+    return {};
+}
+
+void
+SwarmPeerCache::put( const bittorrent::NodeID& infohash
+                   , Peers peers
+                   , Clock::time_point found)
+{
+    if (peers.empty()) return;
+    _entries.put(infohash.to_hex(), Entry{std::move(peers), found});
+}
+
+const SwarmPeerCache::Entry*
+SwarmPeerCache::get(const bittorrent::NodeID& infohash)
+{
+    auto e = _entries.get(infohash.to_hex());
+    if (!e || is_expired(*e, Clock::now())) return nullptr;
+    return e;
+}
+
+} // namespace ouinet::cache
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <expected>
+#include <set>
+#include <string>
+
+#include <boost/asio/ip/udp.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include "../bittorrent/node_id.h"
+#include "../util/async.h"
+#include "../util/lru_cache.h"
+#include "../namespaces.h"
+
+namespace ouinet::cache {
+
+// Peers recently found in the DHT for the most recently looked up swarms,
+// saved to a file so that after a restart the client can reach them
+// without waiting for the DHT to bootstrap and look them up again.
+//
+// Peers are only used for `ttl` after they were found.
+//
+// The file is a text file with a version line followed by one line per swarm:
+//
+//     <infohash> <seconds since the epoch when found> <endpoint>...
+class SwarmPeerCache {
+public:
+    using Clock = std::chrono::system_clock;
+    using Peers = std::set<asio::ip::udp::endpoint>;
+
+    struct Entry {
+        Peers peers;
+        Clock::time_point found;
+    };
+
+    static constexpr std::size_t default_max_swarms = 256;
+
+public:
+    SwarmPeerCache( fs::path path
+                  , Clock::duration ttl
+                  , std::size_t max_swarms = default_max_swarms);
+
+    SwarmPeerCache(const SwarmPeerCache&) = delete;
+    SwarmPeerCache& operator=(const SwarmPeerCache&) = delete;
+
+    // Add the unexpired entries saved in the file.
+    //
+    // A `sys::errc::no_such_file_or_directory` error is reported if it does not exist,
+    // and a `sys::errc::wrong_protocol_type` error if its version does not match.
+    [[nodiscard]]
+    std::expected<void, sys::error_code> load();
+
+    // Atomically replace the file with the unexpired entries.
+    [[nodiscard]]
+    std::expected<void, sys::error_code> store(Async) const;
+
+    void put( const bittorrent::NodeID& infohash
+            , Peers
+            , Clock::time_point found = Clock::now());
+
+    // The entry for the swarm if it has not expired, otherwise null.
+    const Entry* get(const bittorrent::NodeID& infohash);
+
+    Clock::duration ttl() const { return _ttl; }
+    std::size_t size() const { return _entries.size(); }
+
+private:
+    bool is_expired(const Entry&, Clock::time_point now) const;
+
+private:
+    fs::path _path;
+    Clock::duration _ttl;
+    // Keyed by hex-encoded infohash.
+    util::LruCache<std::string, Entry> _entries;
+};
+
+} // namespace ouinet::cache
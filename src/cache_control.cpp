@@ -24,11 +24,9 @@ namespace posix_time = boost::posix_time;
 // in the "Cache-Control" header field
 // of a request or response.
 static
-bool has_cache_control_directive( const Session& session
+bool has_cache_control_directive( const http::response_header<>& hdr
                                 , const beast::string_view& directive)
 {
-    auto& hdr = session.response_header();
-
     auto cache_control_i = hdr.find(http::field::cache_control);
     if (cache_control_i == hdr.end()) return false;
 
@@ -39,6 +37,13 @@ bool has_cache_control_directive( const Session& session
     return false;
 }
 
+static
+bool has_cache_control_directive( const Session& session
+                                , const beast::string_view& directive)
+{
+    return has_cache_control_directive(session.response_header(), directive);
+}
+
 template<class H>
 static
 const http::fields& fields_of(const H& hdr) {
@@ -150,6 +155,31 @@ bool CacheControl::is_expired( const http::response_header<>& response
     return now() > time_stamp + posix_time::seconds(*max_age);
 }
 
+/* static */
+std::time_t CacheControl::expiration_time( const http::response_header<>& response
+                                         , std::time_t injected)
+{
+    if (has_cache_control_directive(response, "private")) return 0;
+    if (is_temporary_result(response)) return 0;
+
+    auto cache_control_value = get(response, http::field::cache_control);
+
+    if (cache_control_value) {
+        if (auto max_age = get_max_age(*cache_control_value)) {
+            if (injected == 0) return 0;
+            return injected + *max_age;
+        }
+    }
+
+    auto expires = get(response, http::field::expires);
+    if (!expires) return 0;
+
+    auto exp_date = util::parse_date(*expires);
+    if (exp_date == posix_time::ptime()) return 0;
+
+    return posix_time::to_time_t(exp_date);
+}
+
 bool
 CacheControl::is_older_than_max_cache_age(const posix_time::ptime& time_stamp) const
 {
@@ -236,6 +266,23 @@ CacheControl::fetch(const CacheRequest& request, Async yield) {
         return std::unexpected(stored_result.error());
     }
 
+    // If a complete and fresh response is available in the local store,
+    // do not even start fetching it fresh.
+    // Peers are not looked up here, since nothing would be fetched fresh meanwhile.
+    if (auto body_size = probe_complete_and_fresh(request)) {
+        auto lyield = yield.tag("local_fresh");
+        LOG_DEBUG(lyield, " Complete, fresh response found in local store");
+
+        auto stored_result = do_fetch_stored(request, lyield, true);
+        if (stored_result && !needs_fresh(*stored_result)) {
+            LOG_DEBUG(lyield, " Response was served from cache: not expired");
+            if (on_fresh_fetch_skipped) on_fresh_fetch_skipped(*body_size);
+            return std::move(stored_result->response);
+        }
+
+        LOG_DEBUG(lyield, " Stored response not usable, attempting to fetch fresh and from cache");
+    }
+
     // Fetching from the distributed cache is often very slow and thus we need
     // to fetch from the origin im parallel and then return the first we get.
     std::optional<std::expected<Session, sys::error_code>> fresh_result;
@@ -362,11 +409,45 @@ CacheControl::fetch(const CacheRequest& request, Async yield) {
     }
 }
 
+//------------------------------------------------------------------------------
+// Return the body size of the response in the local store
+// if its index says that it is complete and may be served as is.
+std::optional<std::size_t>
+CacheControl::probe_complete_and_fresh(const CacheRequest& rq) const
+{
+    if (!probe_stored || !fetch_local) return std::nullopt;
+    if (rq.header().method() != http::verb::get) return std::nullopt;
+
+    auto entry = probe_stored(rq.to_retrieve_request());
+    if (!entry || !entry->complete) return std::nullopt;
+
+    if (entry->injected == 0
+        || is_older_than_max_cache_age(posix_time::from_time_t(entry->injected)))
+        return std::nullopt;
+
+    if (entry->expires <= std::time(nullptr)) return std::nullopt;
+
+    return entry->body_size;
+}
+
+// Whether a fresh response should be fetched instead of the given cached one.
+bool CacheControl::needs_fresh(const CacheEntry& entry) const
+{
+    return has_cache_control_directive(entry.response, "private")
+        || is_older_than_max_cache_age(entry.time_stamp)
+        || has_temporary_result(entry.response)
+        || is_expired(entry);
+}
+
 //------------------------------------------------------------------------------
 bool CacheControl::has_temporary_result(const Session& rs) const
 {
-    auto& hdr = rs.response_header();
+    return is_temporary_result(rs.response_header());
+}
 
+/* static */
+bool CacheControl::is_temporary_result(const http::response_header<>& hdr)
+{
     // TODO: More statuses
     return hdr.result() == http::status::found
         || hdr.result() == http::status::temporary_redirect;
@@ -402,13 +483,15 @@ CacheControl::do_fetch_fresh(const CacheRequest& rq, Async yield) {
 }
 
 std::expected<CacheControl::CacheEntry, sys::error_code>
-CacheControl::do_fetch_stored(const CacheRequest& rq, Async yield) {
-    if (!fetch_stored) {
+CacheControl::do_fetch_stored(const CacheRequest& rq, Async yield, bool local_only) {
+    auto& fetch = local_only ? fetch_local : fetch_stored;
+
+    if (!fetch) {
         LOG_DEBUG(yield, " No fetch stored_operation provided");
         return std::unexpected(asio::error::operation_not_supported);
     }
 
-    auto session = fetch_stored(rq.to_retrieve_request(), yield);
+    auto session = fetch(rq.to_retrieve_request(), yield);
 
     if (!session) return std::unexpected(session.error());
 
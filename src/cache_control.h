@@ -8,6 +8,7 @@
 #include "namespaces.h"
 #include "api.h"
 #include "session.h"
+#include "cache/store_index.h"
 
 namespace ouinet {
 using ouinet::util::AsioExecutor;
@@ -38,6 +39,16 @@ public:
         std::expected<Session, sys::error_code>(const CacheInjectRequest&, Async)
     >;
 
+    // Cheaply look up the metadata of a response in the local store
+    // (without loading it), none if not there.
+    using ProbeStored = std::function<
+        std::optional<cache::StoreIndex::Entry>(const CacheRetrieveRequest&)
+    >;
+
+    // Called with its body size when a stored response is served
+    // without attempting to fetch it fresh at all.
+    using FreshFetchSkipped = std::function<void(std::size_t)>;
+
 public:
     CacheControl(const AsioExecutor& ex, std::string server_name)
         : _ex(ex)
@@ -52,7 +63,12 @@ public:
     std::expected<Session, sys::error_code> fetch(const CacheRequest&, Async);
 
     FetchStored  fetch_stored;
+    // Only from the local store, for responses which `probe_stored`
+    // reports as complete and fresh.
+    FetchStored  fetch_local;
     FetchFresh   fetch_fresh;
+    ProbeStored  probe_stored;
+    FreshFetchSkipped  on_fresh_fetch_skipped;
 
     void max_cached_age(const boost::posix_time::time_duration&);
     boost::posix_time::time_duration max_cached_age() const;
@@ -69,6 +85,14 @@ public:
     bool is_expired( const http::response_header<>&
                    , boost::posix_time::ptime time_stamp);
 
+    // Return the time when a stored response with the given head
+    // injected at the given time stops being fresh,
+    // or zero if it should never be served without trying to fetch it fresh
+    // (e.g. it is private, or it has no explicit expiration).
+    static
+    std::time_t expiration_time( const http::response_header<>&
+                               , std::time_t injected);
+
 private:
     static
     bool is_expired(const CacheEntry&);
@@ -77,12 +101,20 @@ private:
     do_fetch_fresh(const CacheRequest&, Async);
 
     std::expected<CacheEntry, sys::error_code>
-    do_fetch_stored(const CacheRequest&, Async);
+    do_fetch_stored(const CacheRequest&, Async, bool local_only = false);
+
+    std::optional<std::size_t>
+    probe_complete_and_fresh(const CacheRequest&) const;
+
+    bool needs_fresh(const CacheEntry&) const;
 
     bool is_older_than_max_cache_age(const boost::posix_time::ptime&) const;
 
     bool has_temporary_result(const Session&) const;
 
+    static
+    bool is_temporary_result(const http::response_header<>&);
+
 private:
     AsioExecutor _ex;
     std::string _server_name;
@@ -31,6 +31,7 @@
 #include "default_timeout.h"
 #include "constants.h"
 #include "dispatcher.h"
+#include "fetch_coalescer.h"
 #include "util/storing_reader.h"
 #include "session.h"
 #include "create_udp_multiplexer.h"
@@ -112,6 +113,7 @@ public:
         , _ssl_certificate_cache(1000)
         , _cache_starting{get_executor()}
         , _front_end(_config)
+        , _fetch_coalescer(get_executor())
         , _origin_pools(OriginPools())
         , inj_ctx{asio::ssl::context::tls_client}
         , _log_path(std::move(log_path))
@@ -136,6 +138,20 @@ public:
 
         inj_ctx.set_verify_mode(asio::ssl::verify_peer);
 
+        // Sessions with injectors are stored by endpoint,
+        // those with origins by host name.
+        auto& inj_sessions = ssl::SessionCache::attach( inj_ctx
+                                                      , _config.tls_session_cache_size()
+                                                      , _config.tls_session_lifetime());
+
+        for (auto sessions : { &inj_sessions
+                             , ssl::SessionCache::find(_config.origin_ssl_ctx().native_handle()) }) {
+            if (!sessions) continue;
+            sessions->on_handshake([this] (bool resumed) {
+                _metrics.tls_handshake(resumed);
+            });
+        }
+
         if (_config.metrics() && _config.metrics()->enable_on_start) {
             enable_metrics();
         }
@@ -381,6 +397,9 @@ private:
     [[nodiscard]]
     std::expected<Session, sys::error_code>
     fetch_stored_in_dcache(const CacheRetrieveRequest& request, Async);
+    [[nodiscard]]
+    std::expected<Session, sys::error_code>
+    fetch_stored_locally(const CacheRetrieveRequest& request, Async);
 
 
     [[nodiscard]]
@@ -507,6 +526,14 @@ private:
     SysResult<Dispatcher::Response>
     maybe_wrap_in_storing_session(Dispatcher::Response, Async);
 
+    [[nodiscard]]
+    SysResult<Dispatcher::Response>
+    share_response(FetchCoalescer::Leader, Dispatcher::Response, Async);
+
+    [[nodiscard]]
+    SysResult<Dispatcher::Response>
+    dispatch_coalesced(Dispatcher&, const Request&, const Route&, Async);
+
     static void setup_upnp(
         AsioExecutor executor,
         uint16_t ext_port,
@@ -664,6 +691,7 @@ private:
     sys::error_code _cache_start_ec;
 
     ClientFrontEnd _front_end;
+    FetchCoalescer _fetch_coalescer;
     Cancel _shutdown_signal;
 
     // For debugging
@@ -903,6 +931,36 @@ Client::State::fetch_stored_in_dcache(const CacheRetrieveRequest& request, Async
     }
 }
 
+//------------------------------------------------------------------------------
+std::expected<Session, sys::error_code>
+Client::State::fetch_stored_locally(const CacheRetrieveRequest& request, Async yield)
+{
+    using R = SysResult<Session>;
+
+    return request.visit(overloaded {
+        [&] (const CachePeerRetrieveRequest& rq) -> R {
+            auto c = get_cache();
+            if (!c) return std::unexpected(asio::error::operation_not_supported);
+
+            auto s = c->load_local(rq, yield.tag("load_local"));
+
+            if (!s) return std::unexpected(s.error());
+
+            auto& hdr = s->response_header();
+
+            if (!util::http_proto_version_check_trusted(hdr, newest_proto_seen))
+                return std::unexpected(asio::error::not_found);
+
+            maybe_add_proto_version_warning(hdr);
+            return std::move(*s);
+        },
+        [&] (const CacheOuisyncRetrieveRequest&) -> R {
+            // Ouisync content is not kept in the local store.
+            return std::unexpected(asio::error::operation_not_supported);
+        }
+    });
+}
+
 //------------------------------------------------------------------------------
 
 std::expected<GenericStream, sys::error_code>
@@ -940,7 +998,8 @@ Client::State::connect_to_origin( const http::request_header<>& rq
     GenericStream stream;
 
     if (rq.target().starts_with("https:") || rq.target().starts_with("wss:")) {
-        auto sr = ssl::util::client_handshake(std::move(*sock), tls_ctx, host, yield);
+        auto session_key = ssl::util::origin_session_key(host, std::to_string(port));
+        auto sr = ssl::util::client_handshake(std::move(*sock), tls_ctx, host, session_key, yield);
 
         if (!sr) return std::unexpected(sr.error());
         stream = std::move(*sr);
@@ -1151,9 +1210,11 @@ Client::State::fetch_fresh_through_connect_proxy( const Rq& rq
 
             auto inj_con = std::move(*inj_e);
 
+            auto port = url->port.empty() ? "443" : url->port;
+
             // Build the actual request to send to the proxy.
             Request connreq = { http::verb::connect
-                                , url->host + ":" + (url->port.empty() ? "443" : url->port)
+                                , url->host + ":" + port
                                 , 11 /* HTTP/1.1 */};
 
             // HTTP/1.1 requires a ``Host:`` header in all requests:
@@ -1209,6 +1270,7 @@ Client::State::fetch_fresh_through_connect_proxy( const Rq& rq
                 con_e = ssl::util::client_handshake( std::move(inj_con)
                                                    , tls_ctx
                                                    , url->host
+                                                   , ssl::util::origin_session_key(url->host, port)
                                                    , yield);
             } else {
                 con_e = std::move(inj_con);
@@ -1559,11 +1621,111 @@ Client::State::maybe_wrap_in_storing_session(Dispatcher::Response response, Asyn
             },
             [&] (Response::Ouisync r) -> R {
                 return Response::Ouisync{std::move(r.session)};
+            },
+            [&] (Response::Coalesced r) -> R {
+                return Response::Coalesced{std::move(r.session)};
             }
         },
         std::move(response.value));
 }
 
+// Share the response of a fetch led by this request with identical requests
+// (see `FetchCoalescer`), if it comes from the distributed or local cache
+// or from the injector.
+SysResult<Dispatcher::Response>
+Client::State::share_response(FetchCoalescer::Leader leader, Dispatcher::Response response, Async yield) {
+    using Response = Dispatcher::Response;
+    using R = SysResult<Response>;
+
+    auto share = [&] <class Rs> (Rs r) -> R {
+        auto s = leader.share(std::move(r.session), yield);
+        if (!s) return std::unexpected(s.error());
+        r.session = std::move(*s);
+        return r;
+    };
+
+    auto keep = [&] (auto r) -> R {
+        leader.abandon();
+        return r;
+    };
+
+    return std::visit(overloaded {
+            [&] (Response::FrontEnd r) -> R { return keep(std::move(r)); },
+            [&] (Response::Origin r) -> R { return keep(std::move(r)); },
+            [&] (Response::DCache r) -> R { return share(std::move(r)); },
+            [&] (Response::LocalCache r) -> R { return share(std::move(r)); },
+            [&] (Response::PublicInjector r) -> R { return share(std::move(r)); },
+            [&] (Response::PrivateInjector r) -> R { return keep(std::move(r)); },
+            [&] (Response::Ouisync r) -> R { return share(std::move(r)); },
+            [&] (Response::Coalesced r) -> R { return keep(std::move(r)); }
+        },
+        std::move(response.value));
+}
+
+// Return the key under which concurrent fetches of the given request
+// can be coalesced, if they can.
+static
+std::optional<cache::ResourceId>
+coalescing_key(const Request& req, const Route& route)
+{
+    if (req.method() != http::verb::get) return std::nullopt;
+
+    // Conditional and range requests may get different responses.
+    for (auto field : { http::field::if_match
+                      , http::field::if_modified_since
+                      , http::field::if_none_match
+                      , http::field::if_range
+                      , http::field::if_unmodified_since
+                      , http::field::range }) {
+        if (req.count(field)) return std::nullopt;
+    }
+
+    // Only share responses which would be shared via the cache anyway,
+    // i.e. not those coming straight from the origin.
+    bool cache_route = std::visit(overloaded {
+            [] (const Route::PublicInjector&) { return true; },
+            [] (const Route::DCache&) { return true; },
+            [] (const Route::PublicInjectorOrDCache&) { return true; },
+            [] (const auto&) { return false; }
+        },
+        route.value);
+
+    if (!cache_route) return std::nullopt;
+
+    auto cache_req = util::to_cache_request(req.base());
+    if (!cache_req) return std::nullopt;
+
+    return cache::ResourceId::from_url(cache_req->target());
+}
+
+// Dispatch the request and store its response (if applicable),
+// unless an identical request is already in flight,
+// in which case its response is shared instead.
+SysResult<Dispatcher::Response>
+Client::State::dispatch_coalesced( Dispatcher& dispatcher
+                                 , const Request& req
+                                 , const Route& route
+                                 , Async yield) {
+    auto key = coalescing_key(req, route);
+    std::optional<FetchCoalescer::Leader> leader;
+
+    if (key) {
+        if (auto session = _fetch_coalescer.follow(*key, yield)) {
+            LOG_DEBUG(yield, " Sharing response of identical request in flight");
+            return Dispatcher::Response::Coalesced{std::move(*session)};
+        }
+        leader = _fetch_coalescer.lead(*key);
+    }
+
+    auto response = dispatcher.dispatch(req, route, yield);
+    if (!response) return response;
+
+    response = maybe_wrap_in_storing_session(std::move(*response), yield);
+    if (!response || !leader) return response;
+
+    return share_response(std::move(*leader), std::move(*response), yield);
+}
+
 //------------------------------------------------------------------------------
 static
 string base_domain_from_target(const beast::string_view& target)
@@ -1830,6 +1992,30 @@ void Client::State::serve_request(GenericStream&& con, Async yield_)
             return client_state.fetch_stored_in_dcache(rq, yield);
         }
 
+        SysResult<Session>
+        local_cache(const CacheRetrieveRequest& rq, Async yield) override {
+            return client_state.fetch_stored_locally(rq, yield);
+        }
+
+        std::optional<cache::StoreIndex::Entry>
+        probe_stored(const CacheRetrieveRequest& rq) override {
+            auto cache = client_state.get_cache();
+            if (!cache) return std::nullopt;
+
+            // Ouisync content is not kept in the local store.
+            bool is_peer_rq = rq.visit(overloaded {
+                [] (const CachePeerRetrieveRequest&) { return true; },
+                [] (const CacheOuisyncRetrieveRequest&) { return false; }
+            });
+            if (!is_peer_rq) return std::nullopt;
+
+            return cache->local_entry(rq.resource_id());
+        }
+
+        void fresh_fetch_skipped(std::size_t body_size) override {
+            client_state._metrics.fresh_fetch_skipped(body_size);
+        }
+
         boost::posix_time::time_duration max_cached_age() override {
             return client_state._config.max_cached_age();
         }
@@ -2021,7 +2207,7 @@ void Client::State::serve_request(GenericStream&& con, Async yield_)
             continue;
         }
 
-        auto response = dispatcher.dispatch(req, *route, yield);
+        auto response = dispatch_coalesced(dispatcher, req, *route, yield);
 
         if (!response) {
             LOG_DEBUG(yield, " Failed to receive a response: ", response.error());
@@ -2031,16 +2217,6 @@ void Client::State::serve_request(GenericStream&& con, Async yield_)
             continue;
         }
 
-        response = maybe_wrap_in_storing_session(std::move(*response), yield);
-
-        if (!response) {
-            LOG_DEBUG(yield, " Failed wrap response in StoringSession: ", response.error());
-            auto rs = retrieval_failure_response(req);
-            auto r = http::async_write(con, rs, yield);
-            if (!r || !req.keep_alive() || !rs.keep_alive()) break;
-            continue;
-        }
-
         LOG_DEBUG(yield, " Response: ", response->header());
 
         if (auto r = response->write(con, yield); !r) {
@@ -2092,11 +2268,15 @@ Client::State::setup_cache(Async yield)
                               , *_config.cache_http_pub_key()
                                 , _config.repo_root()/"bep5_http" //TODO gives this a more inclusive name covering bothe bep5 and bep3 caches
                               , _config.max_cached_age()
+                              , _config.max_cached_size()
+                              , _config.cache_eviction_policy()
                               , yield)
         : cache::Client::build( UdpEndpoints{common_udp_multiplexer().local_endpoint()}
                               , *_config.cache_http_pub_key()
                               , _config.repo_root()/"bep5_http"
                               , _config.max_cached_age()
+                              , _config.max_cached_size()
+                              , _config.cache_eviction_policy()
                               , _config.cache_static_path()
                               , _config.cache_static_content_path()
                               , yield)) {
@@ -143,6 +143,13 @@ boost::program_options::options_description ClientConfig::description_full()
         , "Path to the CA certificate store directory")
        ("tls-ca-cert-store-file", po::value<vector<string>>(&_tls_ca_cert_store_files)
         , "Add CA certificate store file")
+       ("tls-session-cache-size"
+        , po::value<size_t>(&_tls_session_cache_size)->default_value(256)
+        , "Keep up to this many TLS sessions with origins and injectors "
+          "to resume them in later connections (0: disabled)")
+       ("tls-session-lifetime"
+        , po::value<size_t>(&_tls_session_lifetime)->default_value(2 * 60 * 60)
+        , "Resume kept TLS sessions for up to this many seconds")
        ("front-end-ep"
         , po::value<string>()->default_value("127.0.0.1:8078")
         , "Front-end's endpoint (in <IP>:<PORT> format). Set port to 0 for random port assigned by OS.")
@@ -215,6 +222,14 @@ boost::program_options::options_description ClientConfig::description_full()
         , po::value<decltype(_max_cached_age.total_seconds())>()->default_value(_max_cached_age.total_seconds())
         , "Discard cached content older than this many seconds "
           "(0: discard all; -1: discard none)")
+       ("max-cached-size"
+        , po::value<size_t>()->default_value(0)
+        , "Discard cached content to keep its size under this many MiB "
+          "(0: no limit). Content in pinned groups is never discarded")
+       ("cache-eviction-policy"
+        , po::value<string>()->default_value("lru")
+        , "Which cached content to discard first when over its maximum size "
+          "{lru: least recently used, lfu: least frequently used}")
        ("max-simultaneous-announcements"
         , po::value<decltype(_max_simultaneous_announcements)>()->default_value(_max_simultaneous_announcements)
         , "Defines the number of simultaneous BEP5 announcements "
@@ -459,6 +474,18 @@ ClientConfig::ClientConfig(int argc, const char* argv[])
         _max_cached_age = boost::posix_time::seconds(*opt);
     }
 
+    if (auto opt = as_optional<size_t>(vm, "max-cached-size")) {
+        _max_cached_size = *opt * 1024 * 1024;
+    }
+
+    if (auto opt = as_optional<string>(vm, "cache-eviction-policy")) {
+        auto policy = cache::parse_eviction_policy(*opt);
+        if (!policy) {
+            throw error("Invalid cache eviction policy: ", *opt);
+        }
+        _cache_eviction_policy = *policy;
+    }
+
     if (auto opt = as_optional<decltype(_max_simultaneous_announcements)>(vm, "max-simultaneous-announcements")) {
         _max_simultaneous_announcements = *opt;
     }
@@ -789,6 +816,9 @@ ClientConfig::ClientConfig(int argc, const char* argv[])
     {
         _origin_ssl_ctx.set_verify_mode(asio::ssl::verify_peer);
         ssl::util::load_tls_ca_certificates(_origin_ssl_ctx, _tls_ca_cert_store_dir);
+        ssl::SessionCache::attach( _origin_ssl_ctx
+                                 , tls_session_cache_size()
+                                 , tls_session_lifetime());
         for (auto& verify_file : _tls_ca_cert_store_files) {
             sys::error_code ec;
             _origin_ssl_ctx.load_verify_file(verify_file, ec);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <set>
 #include <sstream>
 #include <vector>
@@ -21,6 +22,7 @@
 #include "ouiservice/i2p/address.h"
 #include "logger.h"
 #include "cache_type.h"
+#include "cache/store_index.h"
 
 namespace boost::program_options {
     class variables_map;
@@ -134,6 +136,15 @@ public:
         return _origin_ssl_ctx;
     }
 
+    // For TLS session resumption (see `ssl::SessionCache`).
+    size_t tls_session_cache_size() const {
+        return _tls_session_cache_size;
+    }
+
+    std::chrono::seconds tls_session_lifetime() const {
+        return std::chrono::seconds(_tls_session_lifetime);
+    }
+
     size_t i2p_hops_per_tunnel() const {
       return _i2p_hops_per_tunnel;
     }
@@ -169,6 +180,15 @@ public:
         return _max_cached_age;
     }
 
+    // In bytes, 0 means unlimited.
+    size_t max_cached_size() const {
+        return _max_cached_size;
+    }
+
+    cache::StoreIndex::Policy cache_eviction_policy() const {
+        return _cache_eviction_policy;
+    }
+
     size_t max_simultaneous_announcements() const {
         return _max_simultaneous_announcements;
     }
@@ -330,7 +350,7 @@ public:
 
 private:
     bool _is_log_file_enabled() const {
-        return get_logger().get_log_file() != nullptr;
+        return get_logger().is_logging_to_file();
     }
 
     void _is_log_file_enabled(bool v);
@@ -350,6 +370,8 @@ private:
     std::string _tls_ca_cert_store_dir;
     std::vector<std::string> _tls_ca_cert_store_files;
     asio::ssl::context _origin_ssl_ctx{asio::ssl::context::tls_client};
+    size_t _tls_session_cache_size = 256;
+    size_t _tls_session_lifetime = 2 * 60 * 60;  // seconds
 
     ExtraBtBsServers _bt_bootstrap_extras;
     bool _bt_bootstrap_no_default = false;
@@ -368,6 +390,9 @@ private:
 
     boost::posix_time::time_duration _max_cached_age
         = default_max_cached_age;
+    size_t _max_cached_size = 0;
+    cache::StoreIndex::Policy _cache_eviction_policy
+        = cache::StoreIndex::Policy::lru;
     size_t _max_simultaneous_announcements
         = default_max_simultaneous_announcements;
     uint64_t _max_req_body_size = 102400;
@@ -25,6 +25,7 @@
 #include <boost/format.hpp>
 #include <boost/regex.hpp>
 #include <cstddef>
+#include <fstream>
 #include <memory>
 #include <nlohmann/json.hpp>
 
@@ -253,11 +254,10 @@ void ClientFrontEnd::disable_log_to_file(ClientConfig& config) {
 
 static void load_log_file(ClientConfig& config, ostringstream& out_ss) {
     if (!config.is_log_file_enabled()) return;
-    std::fstream* logfile = get_logger().get_log_file();
-    assert(logfile && "No log file in spite of configuration saying so");
-    logfile->flush();
-    logfile->seekg(0);
-    std::copy( istreambuf_iterator<char>(*logfile)
+    assert(get_logger().is_logging_to_file() && "No log file in spite of configuration saying so");
+    get_logger().flush();
+    std::ifstream logfile(get_logger().current_log_file());
+    std::copy( istreambuf_iterator<char>(logfile)
              , istreambuf_iterator<char>()
              , ostreambuf_iterator<char>(out_ss));
 }
@@ -581,6 +581,14 @@ ClientFrontEnd::handle_portal( ClientConfig& config
                               " (i.e. not older than %s).<br>\n")
               % max_age.total_seconds() % past_as_string(max_age));
 
+        if (auto max_size = config.max_cached_size()) {
+            ss << ( boost::format("Content cached locally up to %.02f MiB"
+                                  " (discarding %s first).<br>\n")
+                  % (max_size / 1048576.)
+                  % (config.cache_eviction_policy() == cache::StoreIndex::Policy::lfu
+                     ? "least frequently used" : "least recently used"));
+        }
+
         auto local_size = cache_client->local_size(yield);
 
         ss << "Approximate size of content cached locally: ";
@@ -666,6 +674,7 @@ ClientFrontEnd::handle_api_status( ClientConfig& config
         {"injector_ready", injector_candidates_n(client) > 1},
         {"distributed_cache", config.is_cache_enabled(CacheType::Bep5Http{})},
         {"max_cached_age", config.max_cached_age().total_seconds()},
+        {"max_cached_size", config.max_cached_size()},
         {"ouinet_version", Version::VERSION_NAME},
         {"ouinet_build_id", Version::BUILD_ID},
         {"ouinet_protocol", http_::protocol_version_current},
@@ -2,10 +2,18 @@
 
 #include "http_util.h"
 #include "or_throw.h"
+#include "task.h"
 #include "util/async.h"
+#include "util/lru_cache.h"
+#include "util/wait_condition.h"
+
+#include <algorithm>
+#include <mutex>
+#include <optional>
+#include <vector>
 
-#include <boost/asio/connect.hpp>
 #include <boost/asio/spawn.hpp>
+#include <boost/asio/steady_timer.hpp>
 
 namespace ouinet {
 
@@ -27,23 +35,172 @@ connect_to_host( const string& host
     return connect_to_host(std::move(*lookup), yield);
 }
 
+// Happy Eyeballs (RFC 8305) parameters.
+static const auto connection_attempt_delay = std::chrono::milliseconds(250);
+static const auto family_memory_lifetime = std::chrono::minutes(10);
+static const size_t family_memory_size = 1024;
+
+// Remembers which address family last worked for each host,
+// to try it first next time.
+// It is shared by all threads.
+class FamilyMemory {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Whether IPv6 worked for the host, if known.
+    std::optional<bool> get(const string& host) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto e = _hosts.get(host);
+        if (!e) return std::nullopt;
+        if (Clock::now() - e->second > family_memory_lifetime) return std::nullopt;
+        return e->first;
+    }
+
+    void put(const string& host, bool is_v6) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _hosts.put(host, {is_v6, Clock::now()});
+    }
+
+    static FamilyMemory& global() {
+        static FamilyMemory memory;
+        return memory;
+    }
+
+private:
+    std::mutex _mutex;
+    util::LruCache<string, std::pair<bool, Clock::time_point>> _hosts{family_memory_size};
+};
+
+// Order endpoints by alternating address families,
+// starting with the one which worked last for the host (or IPv6).
+static
+std::vector<tcp::endpoint> sort_endpoints(const TcpLookup& lookup, std::optional<bool> prefer_v6)
+{
+    std::vector<tcp::endpoint> v6, v4;
+
+    for (const auto& e : lookup) {
+        auto ep = e.endpoint();
+        auto& eps = ep.address().is_v6() ? v6 : v4;
+        if (std::find(eps.begin(), eps.end(), ep) == eps.end()) eps.push_back(ep);
+    }
+
+    auto& first = prefer_v6.value_or(true) ? v6 : v4;
+    auto& second = (&first == &v6) ? v4 : v6;
+
+    std::vector<tcp::endpoint> ret;
+    ret.reserve(v6.size() + v4.size());
+
+    for (size_t i = 0; i < std::max(first.size(), second.size()); ++i) {
+        if (i < first.size()) ret.push_back(first[i]);
+        if (i < second.size()) ret.push_back(second[i]);
+    }
+
+    return ret;
+}
+
+// Connect following Happy Eyeballs (RFC 8305):
+// attempts to the endpoints (with alternating address families)
+// are started `connection_attempt_delay` apart,
+// or as soon as the previous one fails,
+// and the first one to succeed wins while the rest are closed.
 std::expected<tcp::socket, sys::error_code>
 connect_to_host(const TcpLookup& lookup, Async yield)
 {
-    tcp::socket socket(yield.get_executor());
+    auto exec = yield.get_executor();
+    auto host = lookup.empty() ? string() : lookup.begin()->host_name();
+    auto& memory = FamilyMemory::global();
+
+    const auto endpoints = sort_endpoints(lookup, memory.get(host));
 
-    auto disconnect_slot = yield.cancel_slot([&socket] {
+    if (endpoints.empty()) {
+        return std::unexpected(asio::error::not_found);
+    }
+
+    struct Attempt {
+        tcp::socket socket;
+        bool done = false;
+    };
+
+    // Attempts keep their addresses since space for all is reserved.
+    std::vector<Attempt> attempts;
+    attempts.reserve(endpoints.size());
+
+    std::optional<tcp::socket> winner;
+    sys::error_code last_ec;
+    size_t running = 0;
+    bool failed = false;  // an attempt failed since the last wait
+
+    asio::steady_timer timer(exec);
+    WaitCondition wc(exec);
+
+    auto close_all = [&] {
         sys::error_code ec;
-        socket.shutdown(tcp::socket::shutdown_both, ec);
-        socket.close(ec);
-    });
+        for (auto& a : attempts) if (!a.done) a.socket.close(ec);
+        timer.cancel();
+    };
+
+    auto disconnect_slot = yield.cancel_slot(close_all);
+
+    auto start_attempt = [&] {
+        auto& a = attempts.emplace_back(Attempt{tcp::socket(exec)});
+        auto ep = endpoints[attempts.size() - 1];
+        ++running;
+
+        task::spawn_detached(exec, [&, &a = a, ep, lock = wc.lock()] (asio::yield_context y) {
+            auto r = a.socket.async_connect(ep, Async(y));
+            a.done = true;
+            --running;
+
+            if (r && !winner) {
+                winner = std::move(a.socket);
+            } else {
+                if (!r) last_ec = r.error();
+                failed = true;
+                sys::error_code ec;
+                a.socket.close(ec);
+            }
+
+            timer.cancel();  // wake up the waiting loop below
+        });
+    };
 
-    // Make the connection on the IP address we get from a lookup
-    if (auto r = asio::async_connect(socket, lookup, yield); !r) {
-        return std::unexpected(r.error());
+    start_attempt();
+
+    while (!winner && !yield.is_cancelled()) {
+        bool more = attempts.size() < endpoints.size();
+
+        if (running == 0 && !more) break;  // all failed
+
+        if (more && (running == 0 || std::exchange(failed, false))) {
+            start_attempt();
+            continue;
+        }
+
+        timer.expires_after( more
+                           ? asio::steady_timer::duration(connection_attempt_delay)
+                           : asio::steady_timer::duration::max());
+
+        // Woken up early when an attempt finishes.
+        if (timer.async_wait(yield.suppress_cancel()) && more && !winner) {
+            start_attempt();
+        }
     }
 
-    return socket;
+    // Cancel the losers and wait for all attempts to finish.
+    close_all();
+    wc.wait(yield.suppress_cancel());
+
+    if (yield.is_cancelled()) throw Async::Cancelled();
+
+    if (!winner) {
+        return std::unexpected(last_ec ? last_ec : asio::error::host_not_found);
+    }
+
+    sys::error_code ec;
+    auto remote = winner->remote_endpoint(ec);
+    if (!ec && !host.empty()) memory.put(host, remote.address().is_v6());
+
+    return std::move(*winner);
 }
 
 std::expected<tcp::socket, sys::error_code>
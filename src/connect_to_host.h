@@ -28,6 +28,10 @@ connect_to_host( const std::string& host
                , Async yield);
 
 
+// Connect to one of the endpoints in `lookup` using Happy Eyeballs (RFC 8305):
+// IPv6 and IPv4 endpoints are tried alternately in staggered parallel attempts
+// (starting with the family which worked last for the host),
+// and the first connection to be established is used.
 OUINET_COMMON_API
 [[nodiscard]]
 std::expected<asio::ip::tcp::socket, sys::error_code>
@@ -1,6 +1,10 @@
 #pragma once
 
 #include <boost/asio/post.hpp>
+#include <chrono>
+#include <functional>
+#include <list>
+#include <memory>
 #include "generic_stream.h"
 #include "util/executor.h"
 #include "util/unique_function.h"
@@ -289,10 +293,17 @@ class IdleConnection {
 template<class StoredValue>
 class ConnectionPool {
     public:
+    using Clock = std::chrono::steady_clock;
+
     class Connection;
 
     using Connections = std::list<Connection>;
 
+    private:
+    struct State;
+
+    public:
+
     class Connection : public IdleConnection<GenericStream> {
         public:
 
@@ -313,13 +324,18 @@ class ConnectionPool {
             if (!_auto_add_back_to_pool) return;
             if (!IdleConnection::is_open()) return;
 
-            if (auto cs = _connections.lock()) {
+            if (auto state = _state.lock()) {
                 Connection c((IdleConnection<GenericStream>&&) *this);
                 c._value = std::move(_value);
-                push_back(*cs, std::move(c));
+                push_back(std::move(state), std::move(c));
             }
         }
 
+        // When the connection was last added to the pool.
+        Clock::time_point idle_since() const {
+            return _idle_since;
+        }
+
         void auto_add_back_to_pool(bool v) {
             _auto_add_back_to_pool = v;
         }
@@ -337,47 +353,117 @@ class ConnectionPool {
         private:
         friend class ConnectionPool;
         StoredValue _value;
-        std::weak_ptr<Connections> _connections;
+        std::weak_ptr<State> _state;
+        std::shared_ptr<void> _lease;  // while out of the pool
         bool _auto_add_back_to_pool = true;
+        Clock::time_point _idle_since;
     };
 
     ConnectionPool()
-        : _connections(std::make_shared<Connections>())
+        : _state(std::make_shared<State>())
+        , _lease(std::make_shared<char>())
     {}
 
     Connection wrap(GenericStream connection)
     {
         auto c = Connection(std::move(connection));
-        c._connections = _connections;
+        c._state = _state;
+        c._lease = _lease;
         return c;
     }
 
     void push_back(Connection connection)
     {
-        connection._connections.reset();
-        push_back(*_connections, std::move(connection));
+        connection._state.reset();
+        connection._lease.reset();
+        push_back(_state, std::move(connection));
     }
 
+    // Take the connection which has been idle for longest.
     Connection pop_front()
     {
-        assert(!_connections->empty());
+        assert(!_state->connections.empty());
+        return take(_state->connections.begin());
+    }
 
-        Connection connection = std::move(_connections->front());
-        _connections->pop_front();
-        connection.make_not_idle();
-        connection._connections = _connections;
+    // Take the connection which has been idle for shortest
+    // (which is the least likely to have been closed by the other end).
+    Connection pop_back()
+    {
+        assert(!_state->connections.empty());
+        return take(std::prev(_state->connections.end()));
+    }
 
-        return connection;
+    // Close the connection which has been idle for longest.
+    void close_front()
+    {
+        assert(!_state->connections.empty());
+        auto& connections = _state->connections;
+        connections.front().close();
+        connections.pop_front();
+    }
+
+    // Close connections which have been idle since before the given time,
+    // return how many.
+    size_t close_idle_since(Clock::time_point t)
+    {
+        size_t closed = 0;
+        auto& connections = _state->connections;
+        while (!connections.empty() && connections.front().idle_since() < t) {
+            close_front();
+            ++closed;
+        }
+        return closed;
+    }
+
+    // Call the given function after a connection is added to the pool
+    // (including when the destructor of a wrapped connection puts it back).
+    //
+    // The function may close connections in the pool,
+    // but it must not destroy the pool.
+    void on_push(std::function<void()> f)
+    {
+        _state->on_push = std::move(f);
     }
 
     bool empty() const
     {
-        return _connections->empty();
+        return _state->connections.empty();
+    }
+
+    size_t size() const
+    {
+        return _state->connections.size();
+    }
+
+    // How many connections obtained from `wrap` or `pop_*` are still alive
+    // (and may be put back in the pool).
+    size_t checked_out() const
+    {
+        return _lease.use_count() - 1;
     }
 
     private:
-    static void push_back(Connections& connections, Connection connection)
+    struct State {
+        Connections connections;  // least recently idle first
+        std::function<void()> on_push;
+    };
+
+    Connection take(typename Connections::iterator it)
+    {
+        Connection connection = std::move(*it);
+        _state->connections.erase(it);
+        connection.make_not_idle();
+        connection._state = _state;
+        connection._lease = _lease;
+
+        return connection;
+    }
+
+    static void push_back(std::shared_ptr<State> state, Connection connection)
     {
+        auto& connections = state->connections;
+        connection._idle_since = Clock::now();
         connections.push_back(std::move(connection));
 
         typename Connections::iterator it = connections.end();
@@ -390,10 +476,13 @@ class ConnectionPool {
             it->close();
             connections.erase(it);
         });
+
+        if (state->on_push) state->on_push();
     }
 
     private:
-    std::shared_ptr<Connections> _connections;
+    std::shared_ptr<State> _state;
+    std::shared_ptr<void> _lease;
 };
 
 } // namespace
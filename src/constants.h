@@ -78,6 +78,12 @@ static const std::string response_descriptor_hdr = header_prefix + "Descriptor";
 // Also, this is added with a link to descriptor storage.
 static const std::string response_descriptor_link_hdr = header_prefix + "Descriptor-Link";
 
+// A peer serving a hash list adds this (unsigned) header to the response
+// to show that it accepts up to that many block requests in flight
+// on the same connection, answering them in order (as in HTTP/1.1 pipelining).
+// Peers not sending it only get one request at a time.
+static const std::string response_pipeline_depth_hdr = header_prefix + "Pipeline-Depth";
+
 
 // Other headers (e.g. agent-only):
 
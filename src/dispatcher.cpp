@@ -25,6 +25,18 @@ Dispatcher::Dispatcher(asio::any_io_executor exec, Routes& routes)
         return routes.distributes_cache(rq, yield);
     };
 
+    cache_control->fetch_local = [&] (const CacheRetrieveRequest& rq, Async yield) {
+        return routes.local_cache(rq, yield);
+    };
+
+    cache_control->probe_stored = [&] (const CacheRetrieveRequest& rq) {
+        return routes.probe_stored(rq);
+    };
+
+    cache_control->on_fresh_fetch_skipped = [&] (std::size_t body_size) {
+        routes.fresh_fetch_skipped(body_size);
+    };
+
     cache_control->max_cached_age(routes.max_cached_age());
 }
 
@@ -257,7 +269,8 @@ get_inner(const Dispatcher::Response& response) {
             [] (const Response::LocalCache& v) -> R { return &v.session; },
             [] (const Response::PublicInjector& v) -> R { return &v.session; },
             [] (const Response::PrivateInjector& v) -> R { return &v.session; },
-            [] (const Response::Ouisync& v) -> R { return &v.session; }
+            [] (const Response::Ouisync& v) -> R { return &v.session; },
+            [] (const Response::Coalesced& v) -> R { return &v.session; }
        },
        response.value);
 }
@@ -280,7 +293,8 @@ get_inner(Dispatcher::Response& response) {
             [] (Response::LocalCache& v) -> R { return &v.session; },
             [] (Response::PublicInjector& v) -> R { return &v.session; },
             [] (Response::PrivateInjector& v) -> R { return &v.session; },
-            [] (Response::Ouisync& v) -> R { return &v.session; }
+            [] (Response::Ouisync& v) -> R { return &v.session; },
+            [] (Response::Coalesced& v) -> R { return &v.session; }
        },
        response.value);
 }
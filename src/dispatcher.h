@@ -4,6 +4,7 @@
 #include "route.h"
 #include "request.h"
 #include "namespaces.h"
+#include "cache/store_index.h"
 
 #include <variant>
 #include <boost/asio/any_io_executor.hpp>
@@ -30,6 +31,8 @@ public:
         struct PublicInjector { CacheRequest request; Session session; };
         struct PrivateInjector { Session session; };
         struct Ouisync { Session session; };
+        // Shared with an identical request in flight (see `FetchCoalescer`).
+        struct Coalesced { Session session; };
 
         using Alternatives = std::variant<
             FrontEnd,
@@ -38,7 +41,8 @@ public:
             LocalCache,
             PublicInjector,
             PrivateInjector,
-            Ouisync
+            Ouisync,
+            Coalesced
         >;
 
         template<class Rs>
@@ -84,6 +88,20 @@ public:
         virtual SysResult<Session>
         distributes_cache(const CacheRetrieveRequest&, Async) = 0;
 
+        // Like `distributes_cache`, but only a complete response
+        // in the local store (without looking up peers).
+        [[nodiscard]]
+        virtual SysResult<Session>
+        local_cache(const CacheRetrieveRequest&, Async) = 0;
+
+        // Cheap lookup of the metadata of a locally stored response.
+        virtual std::optional<cache::StoreIndex::Entry>
+        probe_stored(const CacheRetrieveRequest&) = 0;
+
+        // A stored response with the given body size
+        // was served without trying to fetch it fresh.
+        virtual void fresh_fetch_skipped(std::size_t body_size) = 0;
+
         virtual boost::posix_time::time_duration max_cached_age() = 0;
 
         virtual bool is_injector_starting() = 0;
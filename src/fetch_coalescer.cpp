@@ -0,0 +1,349 @@
+#include "fetch_coalescer.h"
+#include "util/condition_variable.h"
+#include "task.h"
+#include "logger.h"
+
+#include <deque>
+#include <set>
+
+#define _LOGPFX "FetchCoalescer: "
+#define _DEBUG(...) LOG_DEBUG(_LOGPFX, __VA_ARGS__)
+
+namespace ouinet {
+
+using Part = http_response::Part;
+
+static
+std::size_t
+body_size(const Part& part)
+{
+    if (auto body = part.as_body()) return body->size();
+    if (auto chunk_body = part.as_chunk_body()) return chunk_body->size();
+    return 0;
+}
+
+// The state of a fetch shared by its leader and followers.
+//
+// Parts in the buffer are identified by their position in the response
+// (the head being at position 0).
+struct FetchCoalescer::Fetch {
+    ConditionVariable changed;
+    std::size_t max_buffered;
+
+    std::deque<Part> parts;
+    std::size_t first = 0;  // position of `parts.front()`
+    std::size_t buffered = 0;  // body bytes appended so far
+
+    bool shared = false;  // the leader shared its response
+    bool done = false;  // the leader read the whole response
+    sys::error_code ec;  // the leader failed to read (or share) the response
+
+    // Position of the next part to be read by each follower.
+    std::multiset<std::size_t> positions;
+
+    // Stops reading the leader's response for followers alone
+    // (see `LeaderReader`).
+    Cancel drain_cancel;
+
+    Fetch(const util::AsioExecutor& exec, std::size_t max_buffered)
+        : changed(exec)
+        , max_buffered(max_buffered)
+    {}
+
+    bool joinable() const {
+        return !ec && buffered <= max_buffered;
+    }
+
+    std::size_t end() const {
+        return first + parts.size();
+    }
+
+    void push(Part part) {
+        buffered += body_size(part);
+        parts.push_back(std::move(part));
+        trim();
+        changed.notify();
+    }
+
+    void finish() {
+        done = true;
+        changed.notify();
+    }
+
+    void fail(sys::error_code e) {
+        if (done || ec) return;
+        ec = e;
+        changed.notify();
+    }
+
+    // Drop the parts already read by all followers,
+    // once new followers are no longer accepted.
+    void trim() {
+        if (joinable()) return;
+        auto min = positions.empty() ? end() : *positions.begin();
+        while (first < min) {
+            parts.pop_front();
+            ++first;
+        }
+    }
+};
+
+//--------------------------------------------------------------------
+
+// Reads the leader's session and appends the parts to the shared buffer.
+//
+// If the reader is destroyed before reading the whole response
+// (e.g. because the leader's user agent went away)
+// while there still are followers,
+// the rest of the response is read in the background for them.
+class FetchCoalescer::LeaderReader : public http_response::AbstractReader {
+public:
+    LeaderReader(Session session, std::shared_ptr<Fetch> fetch)
+        : _session(std::move(session))
+        , _fetch(std::move(fetch))
+    {}
+
+    std::expected<std::optional<Part>, sys::error_code>
+    async_read_part(Async yield) override {
+        return read_and_push(_session, *_fetch, yield);
+    }
+
+    bool is_done() const override {
+        return _fetch->done;
+    }
+
+    void close() override {
+        _session.close();
+        _fetch->fail(asio::error::operation_aborted);
+    }
+
+    asio::any_io_executor get_executor() override {
+        return _session.get_executor();
+    }
+
+    ~LeaderReader() {
+        if (!_fetch || _fetch->done || _fetch->ec) return;
+
+        if (_fetch->positions.empty()) {
+            _fetch->fail(asio::error::operation_aborted);
+            return;
+        }
+
+        auto exec = _session.get_executor();
+        task::spawn_detached(exec, [ session = std::move(_session)
+                                   , fetch = std::move(_fetch)
+                                   ] (asio::yield_context y) mutable {
+            Async yield(y, fetch->drain_cancel);
+            _DEBUG("Reading rest of response for followers");
+
+            try {
+                while (!fetch->done && !fetch->ec && !fetch->positions.empty()) {
+                    auto part = read_and_push(session, *fetch, yield);
+                    if (!part) break;
+                }
+                fetch->fail(asio::error::operation_aborted);
+            }
+            catch (Async::Cancelled const&) {
+                fetch->fail(asio::error::operation_aborted);
+            }
+        });
+    }
+
+private:
+    static
+    std::expected<std::optional<Part>, sys::error_code>
+    read_and_push(Session& session, Fetch& fetch, Async yield) {
+        auto part = session.async_read_part(yield);
+
+        if (!part) {
+            fetch.fail(part.error());
+            return part;
+        }
+
+        if (!*part) {
+            fetch.finish();
+            return part;
+        }
+
+        fetch.push(**part);
+        return part;
+    }
+
+private:
+    Session _session;
+    std::shared_ptr<Fetch> _fetch;
+};
+
+//--------------------------------------------------------------------
+
+// Reads the parts of the leader's response from the shared buffer.
+class FetchCoalescer::FollowerReader : public http_response::AbstractReader {
+public:
+    FollowerReader(std::shared_ptr<Fetch> fetch)
+        : _fetch(std::move(fetch))
+        , _position(_fetch->positions.insert(0))
+    {}
+
+    std::expected<std::optional<Part>, sys::error_code>
+    async_read_part(Async yield) override {
+        if (_closed) return std::unexpected(asio::error::operation_aborted);
+        if (_is_done) return std::nullopt;
+
+        auto& fetch = *_fetch;
+
+        while (*_position == fetch.end()) {
+            if (fetch.done) {
+                _is_done = true;
+                return std::nullopt;
+            }
+
+            if (fetch.ec) return std::unexpected(fetch.ec);
+
+            auto r = fetch.changed.wait(yield);
+            if (!r) return std::unexpected(r.error());
+            if (_closed) return std::unexpected(asio::error::operation_aborted);
+        }
+
+        assert(*_position >= fetch.first);
+        auto part = fetch.parts[*_position - fetch.first];
+
+        // Reuse the node.
+        auto node = fetch.positions.extract(_position);
+        node.value()++;
+        _position = fetch.positions.insert(std::move(node));
+        fetch.trim();
+
+        return part;
+    }
+
+    bool is_done() const override {
+        return _is_done;
+    }
+
+    void close() override {
+        detach();
+    }
+
+    asio::any_io_executor get_executor() override {
+        return _fetch->changed.get_executor();
+    }
+
+    ~FollowerReader() {
+        detach();
+    }
+
+private:
+    void detach() {
+        if (_closed) return;
+        _closed = true;
+
+        auto& fetch = *_fetch;
+        fetch.positions.erase(_position);
+
+        if (fetch.positions.empty()) {
+            fetch.drain_cancel();
+        }
+
+        fetch.trim();
+        // Wake up a read waiting for parts.
+        fetch.changed.notify();
+    }
+
+private:
+    std::shared_ptr<Fetch> _fetch;
+    std::multiset<std::size_t>::iterator _position;
+    bool _is_done = false;
+    bool _closed = false;
+};
+
+//--------------------------------------------------------------------
+
+std::expected<Session, sys::error_code>
+FetchCoalescer::Leader::share(Session session, Async yield)
+{
+    assert(_fetch && !_fetch->shared);
+
+    auto fetch = std::move(_fetch);
+    fetch->shared = true;
+
+    return Session::create(
+            std::make_unique<LeaderReader>(std::move(session), std::move(fetch)),
+            false,
+            yield);
+}
+
+void
+FetchCoalescer::Leader::abandon(sys::error_code ec)
+{
+    if (!_fetch) return;
+    auto fetch = std::move(_fetch);
+    fetch->fail(ec);
+}
+
+FetchCoalescer::Leader::~Leader()
+{
+    abandon();
+}
+
+//--------------------------------------------------------------------
+
+FetchCoalescer::FetchCoalescer(const util::AsioExecutor& exec, std::size_t max_buffered)
+    : _exec(exec)
+    , _max_buffered(max_buffered)
+{}
+
+std::optional<FetchCoalescer::Leader>
+FetchCoalescer::lead(const cache::ResourceId& rid)
+{
+    // Forget about fetches which are gone or cannot be joined.
+    std::erase_if(_fetches, [] (const auto& rid_fetch) {
+        auto fetch = rid_fetch.second.lock();
+        return !fetch || !fetch->joinable();
+    });
+
+    if (_fetches.contains(rid)) return std::nullopt;
+
+    auto fetch = std::make_shared<Fetch>(_exec, _max_buffered);
+    _fetches.emplace(rid, fetch);
+    return Leader(std::move(fetch));
+}
+
+std::expected<Session, sys::error_code>
+FetchCoalescer::follow(const cache::ResourceId& rid, Async yield)
+{
+    auto fi = _fetches.find(rid);
+    if (fi == _fetches.end())
+        return std::unexpected(asio::error::not_found);
+
+    auto fetch = fi->second.lock();
+
+    if (!fetch || !fetch->joinable()) {
+        _fetches.erase(fi);
+        return std::unexpected(asio::error::not_found);
+    }
+
+    // Attach now so that no parts are dropped while waiting.
+    auto reader = std::make_unique<FollowerReader>(fetch);
+
+    while (!fetch->shared) {
+        if (fetch->ec) return std::unexpected(fetch->ec);
+        auto r = fetch->changed.wait(yield);
+        if (!r) return std::unexpected(r.error());
+    }
+
+    _DEBUG("Following fetch of ", rid);
+    return Session::create(std::move(reader), false, yield);
+}
+
+std::size_t
+FetchCoalescer::size() const
+{
+    std::size_t ret = 0;
+    for (auto& [rid, fetch] : _fetches) {
+        auto f = fetch.lock();
+        if (f && f->joinable()) ++ret;
+    }
+    return ret;
+}
+
+} // namespace ouinet
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "session.h"
+#include "cache/resource_id.h"
+#include "util/executor.h"
+#include "api.h"
+
+#include <expected>
+#include <map>
+#include <memory>
+#include <optional>
+
+namespace ouinet {
+
+// Lets concurrent requests for the same resource share a single response,
+// so that they cost a single upstream transfer and a single store write.
+//
+// The first request for a resource becomes the *leader* of its fetch:
+// it is dispatched as usual, and the parts of its response
+// are kept in a shared buffer as the leader reads them.
+// Other requests for the same resource arriving while the fetch is in flight
+// become *followers*: instead of being dispatched,
+// they read the same parts from the shared buffer.
+//
+// Followers need the whole response from its beginning,
+// so they are only accepted until the amount of buffered body data
+// exceeds a limit. From then on, parts are dropped from the buffer
+// as soon as all its followers have read them.
+class OUINET_COMMON_API FetchCoalescer {
+private:
+    struct Fetch;
+    class LeaderReader;
+    class FollowerReader;
+
+public:
+    class Leader {
+    public:
+        Leader(Leader&&) = default;
+        Leader& operator=(Leader&&) = default;
+
+        // Return a session which reads the given `session`
+        // and shares the parts it reads with followers.
+        [[nodiscard]]
+        std::expected<Session, sys::error_code>
+        share(Session, Async);
+
+        // Let followers know that there is no response to share,
+        // so that they fetch the resource by themselves.
+        //
+        // This also happens when destroying a leader
+        // which did not share its response.
+        void abandon(sys::error_code = asio::error::operation_aborted);
+
+        ~Leader();
+
+    private:
+        friend class FetchCoalescer;
+        Leader(std::shared_ptr<Fetch> fetch) : _fetch(std::move(fetch)) {}
+
+        std::shared_ptr<Fetch> _fetch;
+    };
+
+    static constexpr std::size_t default_max_buffered = 1 << 20;  // 1 MiB
+
+public:
+    FetchCoalescer(const util::AsioExecutor&, std::size_t max_buffered = default_max_buffered);
+
+    FetchCoalescer(const FetchCoalescer&) = delete;
+    FetchCoalescer& operator=(const FetchCoalescer&) = delete;
+
+    // Start a new fetch for the given resource and return its leader,
+    // unless there already is a fetch for it which can be joined.
+    std::optional<Leader> lead(const cache::ResourceId&);
+
+    // Join the fetch for the given resource
+    // and wait for its leader to share its response.
+    //
+    // An error is returned if there is no fetch which can be joined,
+    // or if the leader failed to share its response.
+    [[nodiscard]]
+    std::expected<Session, sys::error_code>
+    follow(const cache::ResourceId&, Async);
+
+    // Number of fetches which can currently be joined.
+    std::size_t size() const;
+
+private:
+    util::AsioExecutor _exec;
+    std::size_t _max_buffered;
+    std::map<cache::ResourceId, std::weak_ptr<Fetch>> _fetches;
+};
+
+} // namespace ouinet
@@ -1,8 +1,17 @@
 #pragma once
 
 #include <utility>
+#include <vector>
 
+#ifdef __linux__
+#   include <errno.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+#include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
 #include "default_timeout.h"
 #include "generic_stream.h"
 #include "or_throw.h"
@@ -14,9 +23,106 @@ namespace ouinet {
 
 class Cancel;
 
+namespace full_duplex_detail {
+
+// Buffers used when data cannot be spliced
+// grow from the minimum size while reads fill them up.
+static const std::size_t min_buffer_size = 16 * 1024;
+static const std::size_t max_buffer_size = 256 * 1024;
+
+// Data is moved in pieces up to this size when splicing.
+static const std::size_t max_splice_size = 1024 * 1024;
+
+// The plain TCP socket under the given stream, if any and still open.
+inline asio::ip::tcp::socket* tcp_socket(GenericStream& s)
+{
+    return s.tcp_socket();
+}
+
+inline asio::ip::tcp::socket* tcp_socket(asio::ip::tcp::socket& s)
+{
+    return s.is_open() ? &s : nullptr;
+}
+
+template<class Stream>
+asio::ip::tcp::socket* tcp_socket(Stream&)
+{
+    return nullptr;
+}
+
+#ifdef __linux__
+// A pipe to splice data from one socket to another
+// without copying it to user space.
+class SplicePipe {
+public:
+    static std::expected<SplicePipe, sys::error_code> create()
+    {
+        int fds[2];
+        if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) != 0)
+            return std::unexpected(sys::error_code(errno, sys::system_category()));
+        // Try to fit bigger pieces of data (it is fine if it fails).
+        ::fcntl(fds[1], F_SETPIPE_SZ, int(max_splice_size));
+        return SplicePipe(fds[0], fds[1]);
+    }
+
+    SplicePipe(SplicePipe&& other)
+        : _read(std::exchange(other._read, -1))
+        , _write(std::exchange(other._write, -1))
+    {}
+
+    SplicePipe& operator=(SplicePipe&&) = delete;
+
+    ~SplicePipe()
+    {
+        if (_read != -1) ::close(_read);
+        if (_write != -1) ::close(_write);
+    }
+
+    // Move up to `max` bytes from `fd` into the pipe.
+    // Returns 0 on end of input, `would_block` if no data is available.
+    std::expected<std::size_t, sys::error_code> fill_from(int fd, std::size_t max)
+    {
+        return splice(fd, _write, max);
+    }
+
+    // Move up to `max` bytes from the pipe into `fd`.
+    // Returns `would_block` if no data can be sent yet.
+    std::expected<std::size_t, sys::error_code> drain_to(int fd, std::size_t max)
+    {
+        return splice(_read, fd, max);
+    }
+
+private:
+    SplicePipe(int read, int write) : _read(read), _write(write) {}
+
+    static
+    std::expected<std::size_t, sys::error_code> splice(int from, int to, std::size_t max)
+    {
+        for (;;) {
+            auto n = ::splice( from, nullptr, to, nullptr, max
+                             , SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n >= 0) return n;
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return std::unexpected(asio::error::would_block);
+            return std::unexpected(sys::error_code(errno, sys::system_category()));
+        }
+    }
+
+private:
+    int _read, _write;
+};
+#endif  // __linux__
+
+} // namespace full_duplex_detail
+
 // This assumes that there is no data already read from either connection,
 // but pending send.  If there is, please send it beforehand.
 //
+// If both connections are plain TCP sockets (on Linux),
+// data is spliced from one to the other without copying it to user space.
+// Otherwise it is read into buffers which grow as long as reads fill them up.
+//
 // A pair of counts is returned
 // for bytes successfully forwarded (from `a` to `b`, from `b` to `a`).
 template<class Stream1, class Stream2, class OnA2B, class OnB2A>
@@ -27,44 +133,138 @@ full_duplex( Stream1 a
            , OnB2A on_b2a
            , Async yield)
 {
+    namespace detail = full_duplex_detail;
+
     static const auto timeout = default_timeout::activity();
 
     sys::error_code ec;
 
-    const auto half_duplex = [&ec]( auto& in
-                                  , auto& out
-                                  , auto& fwd_bytes_in_out
-                                  , auto& on_transfer
-                                  , auto& wdog
-                                  , Async yield)
+    // Returns true if the operation with the given result may go on.
+    const auto check = [&ec] (const auto& r, const auto& wdog) {
+        if (!wdog.is_running()) {
+            if (!ec) ec = asio::error::timed_out;
+            return false;
+        }
+        if (!r.has_value()) {
+            if (!ec) ec = r.error();
+            return false;
+        }
+        return true;
+    };
+
+    [[maybe_unused]]
+    const auto closed = std::expected<void, sys::error_code>(
+            std::unexpected(asio::error::shut_down));
+
+    const auto buffered_half_duplex = [&check]( auto& in
+                                              , auto& out
+                                              , auto& fwd_bytes_in_out
+                                              , auto& on_transfer
+                                              , auto& wdog
+                                              , Async yield)
     {
-        std::array<uint8_t, 2048> data;
+        std::vector<uint8_t> data(detail::min_buffer_size);
 
         for (;;) {
             auto read_r = in.async_read_some(asio::buffer(data), yield);
-            if (!wdog.is_running()) {
-                if (!ec) ec = asio::error::timed_out;
-                break;
-            }
-            if (!read_r.has_value()) {
-                if (!ec) ec = read_r.error();
-                break;
-            }
+            if (!check(read_r, wdog)) break;
 
             auto write_r = asio::async_write(out, asio::buffer(data, *read_r), yield);
-            if (!wdog.is_running()) {
-                if (!ec) ec = asio::error::timed_out;
+            if (!check(write_r, wdog)) break;
+
+            fwd_bytes_in_out += *read_r;  // the data was successfully forwarded
+            on_transfer(*read_r);
+            wdog.expires_after(timeout);
+
+            // Bulk transfers get bigger buffers (and fewer round trips).
+            if (*read_r == data.size() && data.size() < detail::max_buffer_size)
+                data.resize(data.size() * 2);
+        }
+    };
+
+#ifdef __linux__
+    // Sockets are looked up again after every wait,
+    // since closing a stream may destroy its socket.
+    const auto splice_half_duplex = [&check, &closed]( auto& in
+                                                     , auto& out
+                                                     , detail::SplicePipe& pipe
+                                                     , auto& fwd_bytes_in_out
+                                                     , auto& on_transfer
+                                                     , auto& wdog
+                                                     , Async yield)
+    {
+        using tcp = asio::ip::tcp;
+
+        for (;;) {
+            auto in_s = detail::tcp_socket(in);
+            if (!in_s) {
+                check(closed, wdog);
                 break;
             }
-            if (!write_r.has_value()) {
-                if (!ec) ec = write_r.error();
-                break;
+
+            auto read_r = pipe.fill_from(in_s->native_handle(), detail::max_splice_size);
+            if (!read_r && read_r.error() == asio::error::would_block) {
+                auto wait_r = in_s->async_wait(tcp::socket::wait_read, yield);
+                if (!check(wait_r, wdog)) break;
+                continue;
+            }
+            if (read_r && *read_r == 0) read_r = std::unexpected(asio::error::eof);
+            if (!check(read_r, wdog)) break;
+
+            std::expected<void, sys::error_code> write_r;
+            for (auto pending = *read_r; pending > 0;) {
+                auto out_s = detail::tcp_socket(out);
+                if (!out_s) {
+                    write_r = closed;
+                    break;
+                }
+
+                auto sent_r = pipe.drain_to(out_s->native_handle(), pending);
+                if (!sent_r && sent_r.error() == asio::error::would_block) {
+                    write_r = out_s->async_wait(tcp::socket::wait_write, yield);
+                    if (!write_r || !wdog.is_running()) break;
+                    continue;
+                }
+                if (!sent_r) {
+                    write_r = std::unexpected(sent_r.error());
+                    break;
+                }
+                pending -= *sent_r;
             }
+            if (!check(write_r, wdog)) break;
 
             fwd_bytes_in_out += *read_r;  // the data was successfully forwarded
             on_transfer(*read_r);
             wdog.expires_after(timeout);
         }
+    };
+#endif  // __linux__
+
+    const auto half_duplex = [&]( auto& in
+                                , auto& out
+                                , auto& fwd_bytes_in_out
+                                , auto& on_transfer
+                                , auto& wdog
+                                , Async yield)
+    {
+        bool forwarded = false;
+#ifdef __linux__
+        auto in_s = detail::tcp_socket(in);
+        auto out_s = detail::tcp_socket(out);
+        if (in_s && out_s) {
+            sys::error_code nb_ec;
+            in_s->native_non_blocking(true, nb_ec);
+            if (!nb_ec) out_s->native_non_blocking(true, nb_ec);
+            auto pipe = detail::SplicePipe::create();
+            if (!nb_ec && pipe) {
+                splice_half_duplex(in, out, *pipe, fwd_bytes_in_out, on_transfer, wdog, yield);
+                forwarded = true;
+            }
+        }
+#endif  // __linux__
+        if (!forwarded)
+            buffered_half_duplex(in, out, fwd_bytes_in_out, on_transfer, wdog, yield);
+
         // On error, force the other half-duplex task to finish by closing both streams.
         // Otherwise, it will not notice until
         // (i) it reads and fails to write, or (ii) it times out on read.
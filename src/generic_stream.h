@@ -1,6 +1,7 @@
 #pragma once
 
 #include "namespaces.h"
+#include "util/unique_function.h"
 
 #include <boost/system/error_code.hpp>
 #include <boost/asio/buffer.hpp>
@@ -8,7 +9,14 @@
 #include <boost/asio/error.hpp>
 #include <boost/asio/post.hpp>
 #include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/associated_allocator.hpp>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/recycling_allocator.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <array>
 #include <functional>
+#include <memory>
+#include <type_traits>
 #include <vector>
 #include <iostream>
 
@@ -19,11 +27,47 @@ public:
     using executor_type = boost::asio::any_io_executor;
 
 private:
-    using OnRead  = std::function<void(sys::error_code, size_t)>;
-    using OnWrite = std::function<void(sys::error_code, size_t)>;
+    // Completion handlers up to this size are wrapped without allocating.
+    // Bigger ones (e.g. those of streams nested in other streams)
+    // use their associated allocator, which by default recycles memory.
+    static constexpr std::size_t handler_inline_size = 256;
+
+    using OnRead  = util::unique_function<void(sys::error_code, size_t), handler_inline_size>;
+    using OnWrite = util::unique_function<void(sys::error_code, size_t), handler_inline_size>;
+
+    // Buffers for a single operation, stored without allocating.
+    //
+    // Only up to `max_count` non-empty buffers of a sequence are kept,
+    // so the operation may transfer less than the whole sequence
+    // (which is fine for `async_{read,write}_some`).
+    template<class Buffer>
+    class Buffers {
+    public:
+        static constexpr std::size_t max_count = 16;
+
+        using value_type = Buffer;
+        using const_iterator = const Buffer*;
+
+        template<class BufferSequence>
+        void assign(const BufferSequence& bs) {
+            _count = 0;
+            auto end = asio::buffer_sequence_end(bs);
+            for (auto i = asio::buffer_sequence_begin(bs); i != end && _count < max_count; ++i) {
+                Buffer b(*i);
+                if (b.size() > 0) _buffers[_count++] = b;
+            }
+        }
+
+        const_iterator begin() const { return _buffers.data(); }
+        const_iterator end() const { return _buffers.data() + _count; }
 
-    using ReadBuffers  = std::vector<asio::mutable_buffer>;
-    using WriteBuffers = std::vector<asio::const_buffer>;
+    private:
+        std::array<Buffer, max_count> _buffers;
+        std::size_t _count = 0;
+    };
+
+    using ReadBuffers  = Buffers<asio::mutable_buffer>;
+    using WriteBuffers = Buffers<asio::const_buffer>;
 
     struct Base {
         virtual executor_type get_executor() = 0;
@@ -34,6 +78,8 @@ private:
         virtual void close() = 0;
         virtual bool is_open() const = 0;
 
+        virtual asio::ip::tcp::socket* tcp_socket() = 0;
+
         virtual ~Base() {}
 
         ReadBuffers  read_buffers;
@@ -80,6 +126,14 @@ private:
             return _impl.is_open();
         }
 
+        asio::ip::tcp::socket* tcp_socket() override {
+            if constexpr (std::is_same_v<Impl, asio::ip::tcp::socket>) {
+                return &_impl;
+            } else {
+                return nullptr;
+            }
+        }
+
     private:
         Impl _impl;
         Shutter _shutter;
@@ -153,8 +207,20 @@ public:
         return _shared->impl->is_open();
     }
 
-    // Put data in the given buffers back into the read buffers,
-    // so that it is returned on the next read operation.
+    // The underlying socket if this is a plain TCP stream
+    // (e.g. to operate on its native handle), null otherwise.
+    // It is also null while there is data put back into the stream,
+    // since reading from the socket directly would skip it.
+    // The pointer is no longer valid once the stream is closed.
+    asio::ip::tcp::socket* tcp_socket()
+    {
+        if (!is_open() || !_shared->put_back_data.empty()) return nullptr;
+        return _shared->impl->tcp_socket();
+    }
+
+    // Put a copy of the data in the given buffers back into the stream,
+    // so that it is returned by the next read operations
+    // (before any data put back earlier or still to be read).
     template<class ConstBufferSequence>
     void put_back(const ConstBufferSequence& bs, sys::error_code& ec)
     {
@@ -163,12 +229,10 @@ public:
             return;
         }
 
-        _shared->impl->read_buffers.resize(std::distance( asio::buffer_sequence_begin(bs)
-                                                        , asio::buffer_sequence_end(bs)));
-
-        std::copy( asio::buffer_sequence_begin(bs)
-                 , asio::buffer_sequence_end(bs)
-                 , _shared->impl->read_buffers.begin());
+        auto& data = _shared->put_back_data;
+        auto size = asio::buffer_size(bs);
+        data.insert(data.begin(), size, 0);
+        asio::buffer_copy(asio::buffer(data.data(), size), bs);
     }
 
     template< class MutableBufferSequence
@@ -186,13 +250,19 @@ public:
                 return;
             }
 
-            {
-                system::error_code ec;
-                put_back(bs, ec);
-                assert(!ec);
+            // Data put back into the stream goes first,
+            // without reading from the underlying implementation.
+            if (auto& data = _shared->put_back_data; !data.empty()) {
+                auto size = asio::buffer_copy(bs, asio::buffer(data));
+                data.erase(data.begin(), data.begin() + size);
+                auto ex = asio::get_associated_executor(completion_handler, _executor);
+                asio::post(ex, [h = std::move(completion_handler), size] () mutable {
+                    std::move(h)(system::error_code(), size);
+                });
+                return;
             }
 
-            auto handler = make_shared<decltype(completion_handler)>(std::move(completion_handler));
+            _shared->impl->read_buffers.assign(bs);
 
             // TODO: It should not be necessary to check whether the underlying
             // implementation has been closed (Asio itself doesn't guarantee
@@ -201,14 +271,20 @@ public:
             // socket it continues reading from it.
             // Test vector: uTP x TLS x bbc.com
             // (Same with the async_write_some operation)
-            _shared->impl->read_impl([h = std::move(handler), shared = _shared]
-                             (const system::error_code& ec, size_t size) {
-                                 if (!shared->impl || !shared->impl->is_open()) {
-                                    (*h)(asio::error::shut_down, 0);
-                                 } else {
-                                    (*h)(ec, size);
-                                 }
-                             });
+            auto alloc = asio::get_associated_allocator( completion_handler
+                                                       , asio::recycling_allocator<void>());
+
+            OnRead on_read(std::allocator_arg, alloc,
+                    [h = std::move(completion_handler), shared = _shared]
+                    (const system::error_code& ec, size_t size) mutable {
+                        if (!shared->impl || !shared->impl->is_open()) {
+                            std::move(h)(asio::error::shut_down, 0);
+                        } else {
+                            std::move(h)(ec, size);
+                        }
+                    });
+
+            _shared->impl->read_impl(std::move(on_read));
         };
 
         return boost::asio::async_initiate<
@@ -232,24 +308,23 @@ public:
                 return;
             }
 
-            auto handler = make_shared<decltype(completion_handler)>(std::move(completion_handler));
-
-            _shared->impl->write_buffers.resize(distance( asio::buffer_sequence_begin(bs)
-                                                        , asio::buffer_sequence_end(bs)));
-
-            copy( asio::buffer_sequence_begin(bs)
-                , asio::buffer_sequence_end(bs)
-                , _shared->impl->write_buffers.begin());
+            _shared->impl->write_buffers.assign(bs);
 
             // TODO: Same as the comment in async_read_some operation
-            _shared->impl->write_impl([h = std::move(handler), shared = _shared]
-                              (const system::error_code& ec, size_t size) {
-                                 if (!shared->impl || !shared->impl->is_open()) {
-                                    (*h)(asio::error::shut_down, 0);
-                                 } else {
-                                    (*h)(ec, size);
-                                 }
-                              });
+            auto alloc = asio::get_associated_allocator( completion_handler
+                                                       , asio::recycling_allocator<void>());
+
+            OnWrite on_write(std::allocator_arg, alloc,
+                    [h = std::move(completion_handler), shared = _shared]
+                    (const system::error_code& ec, size_t size) mutable {
+                        if (!shared->impl || !shared->impl->is_open()) {
+                            std::move(h)(asio::error::shut_down, 0);
+                        } else {
+                            std::move(h)(ec, size);
+                        }
+                    });
+
+            _shared->impl->write_impl(std::move(on_write));
         };
 
         return boost::asio::async_initiate<
@@ -265,6 +340,8 @@ private:
 
     struct Shared {
         std::unique_ptr<Base> impl;
+        // Data to be read before reading from `impl` again (see `put_back`).
+        std::vector<uint8_t> put_back_data;
 
         Shared(Base* impl) : impl(impl) {}
     };
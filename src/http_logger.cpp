@@ -1,4 +1,4 @@
-#include <iomanip>
+#include <ctime>
 #include "util/str.h"
 #include "http_logger.h"
 
@@ -7,13 +7,24 @@ static const long LOG_FILE_MAX_SIZE = 15 * 1024 * 1024;
 
 HTTPLogger ouinet::http_logger{};
 
+HTTPLogger::HTTPLogger()
+{
+    // Make sure that the writer outlives the logger.
+    LogWriter::global();
+}
+
 std::string HTTPLogger::get_datetime()
 {
     std::time_t now_time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-    std::tm now_tm = *std::localtime(&now_time);
-    std::stringstream now_str;
-    now_str << std::put_time(&now_tm, "%d/%b/%Y:%H:%M:%S %z");
-    return "[" + now_str.str() + "]";
+    std::tm now_tm;
+#ifdef _WIN32
+    localtime_s(&now_tm, &now_time);
+#else
+    localtime_r(&now_time, &now_tm);
+#endif
+    char now_str[64];
+    auto n = std::strftime(now_str, sizeof(now_str), "[%d/%b/%Y:%H:%M:%S %z]", &now_tm);
+    return std::string(now_str, n);
 }
 
 std::string HTTPLogger::get_header_value(const Request& rq, const http::field& field)
@@ -40,70 +51,49 @@ std::string HTTPLogger::get_request_line(const Request& rq) {
     std::string http_version = "HTTP/"
                              + std::to_string(rq.version() / 10) + '.'
                              + std::to_string(rq.version() % 10);
-    std::stringstream request_line;
-    request_line << "\"" << to_string(rq.method()) << " "
-                 << rq.target() << " " << http_version << "\"";
-    return request_line.str();
+    return util::str("\"", to_string(rq.method()), " ", rq.target(), " ", http_version, "\"");
 }
 
 void HTTPLogger::log_to_file(const std::string& fname)
 {
-    using std::ios;
-
     if (fname.empty()) {
         if (!log_filename.empty()) {
             ouinet::sys::error_code ignored_ec;
             ouinet::fs::remove(log_filename, ignored_ec);
         }
-        log_file = boost::none;
+        log_file = nullptr;
         return;
     }
 
     if (log_filename != fname || !log_file) {
         log_filename = fname;
-        log_file = std::fstream();
-
-        if (ouinet::fs::exists(log_filename)) {
-            log_file->open(log_filename, ios::in | ios::out | ios::ate);
-        } else {
-            // `trunc` causes the file to be created
-            log_file->open(log_filename, ios::in | ios::out | ios::trunc);
-        }
+        log_file = LogWriter::File::open(log_filename, LOG_FILE_MAX_SIZE);
 
-        if (!log_file->is_open()) {
+        if (!log_file) {
             std::cerr << "Failed to open log file " << fname  << "\n";
             log_filename = "";
-            log_file = boost::none;
         }
     }
 }
 
-std::fstream* HTTPLogger::get_log_file() {
-    if (!log_file) return nullptr;
-    return &*log_file;
-}
-
+// Records are written in the background, and dropped if the writer falls behind.
 void HTTPLogger::log(const std::string& host_id, const Request& rq, const Session& sess, size_t fwd_bytes)
 {
-    if (!log_file || !log_file->is_open()) return;
+    if (!log_file) return;
 
     auto& inh = sess.response_header();
 
     auto ua = get_header_value(rq, http::field::user_agent);
     auto referer = get_header_value(rq, http::field::referer);
 
-    if (log_file && log_file->is_open()) {
-        *log_file << host_id
-                << " - - " // unused fields: identd and userid
-                << get_datetime() << " "
-                << get_request_line(rq) << " "
-                << inh.result_int() << " "
-                << get_request_size(sess, fwd_bytes) << " "
-                << referer << " "
-                << ua << "\n";
-    }
+    auto line = util::str( host_id
+                         , " - - " // unused fields: identd and userid
+                         , get_datetime(), " "
+                         , get_request_line(rq), " "
+                         , inh.result_int(), " "
+                         , get_request_size(sess, fwd_bytes), " "
+                         , referer, " "
+                         , ua, "\n");
 
-    if (log_file->tellp() > LOG_FILE_MAX_SIZE) {
-        log_file->seekp(0);
-    }
+    LogWriter::global().push(log_file, std::move(line), LogWriter::Overflow::drop);
 }
@@ -5,11 +5,10 @@
 
 #include "api.h"
 #include "generic_stream.h"
+#include "log_writer.h"
 #include "namespaces.h"
 #include "session.h"
 
-#include <fstream>
-
 namespace ouinet {
 
 namespace http = ouinet::http;
@@ -20,10 +19,10 @@ using Session = ouinet::Session;
 class HTTPLogger {
 
 public:
-    HTTPLogger() = default;
+    HTTPLogger();
     void log_to_file(const std::string&);
     std::string current_log_file() { return log_filename; }
-    std::fstream* get_log_file();
+    bool is_logging_to_file() const { return bool(log_file); }
     void log(const std::string&, const Request&, const Session&, size_t);
 
 private:
@@ -33,7 +32,7 @@ private:
     static std::string get_request_line(const Request&);
 
     std::string log_filename;
-    boost::optional<std::fstream> log_file;
+    std::shared_ptr<LogWriter::File> log_file;
 };
 
 extern HTTPLogger http_logger;
@@ -10,6 +10,7 @@
 #include <ctime>
 #include <fstream>
 #include <string>
+#include <thread>
 
 
 #include "namespaces.h"
@@ -25,6 +26,7 @@
 #endif
 #include "full_duplex_forward.h"
 #include "injector.h"
+#include "injector_cache.h"
 #include "authenticate.h"
 #include "http_util.h"
 #include "http_logger.h"
@@ -71,10 +73,30 @@ static const fs::path OUINET_TLS_CERT_FILE = "tls-cert.pem";
 static const fs::path OUINET_TLS_KEY_FILE = "tls-key.pem";
 static const fs::path OUINET_TLS_DH_FILE = "tls-dh.pem";
 
+// Serves TCP connections on its own thread and `io_context`,
+// listening on the same ports as the main thread.
+struct Injector::Shard {
+    asio::io_context ctx;
+    Cancel cancel;
+    std::thread thread;
+};
+
 struct Injector::Inner {
     std::optional<CreateI2pSessionPromise::Future> _i2p_session_future;
+    std::vector<std::unique_ptr<Shard>> _shards;
 };
 
+// Listeners on several threads need the same port,
+// so pick one now if the system is to choose it.
+static
+tcp::endpoint choose_port(tcp::endpoint endpoint)
+{
+    if (endpoint.port() != 0) return endpoint;
+    asio::io_context ctx;
+    tcp::acceptor acceptor(ctx, endpoint);
+    return acceptor.local_endpoint();
+}
+
 // TODO: Get rid of this
 static bool g_allow_private_targets = false;
 
@@ -320,9 +342,12 @@ class InjectorCacheControl {
             if (!socket) return std::unexpected(socket.error());
 
             if (url->scheme == "https") {
+                auto session_key = ssl::util::origin_session_key
+                    (url->host, url->port.empty() ? "443" : url->port);
                 auto c = ssl::util::client_handshake( std::move(*socket)
                                                     , ssl_ctx
                                                     , url->host
+                                                    , session_key
                                                     , yield);
 
                 if (!c) return std::unexpected(c.error());
@@ -342,6 +367,7 @@ public:
     InjectorCacheControl( AsioExecutor executor
                         , asio::ssl::context& ssl_ctx
                         , OriginPools& origin_pools
+                        , InjectorCache& injector_cache
                         , const InjectorConfig& config
                         , uuid_generator& genuuid)
         : executor(std::move(executor))
@@ -349,14 +375,63 @@ public:
         , config(config)
         , genuuid(genuuid)
         , origin_pools(origin_pools)
+        , injector_cache(injector_cache)
     {
     }
 
 private:
+    // Send the request to the origin and read the head of its response,
+    // which is signed for GET and HEAD requests.
+    std::expected<Session, sys::error_code>
+    fetch_origin( const Request& cache_rq
+                , const shared_ptr<dns::Resolver>& dns_resolver
+                , Async yield)
+    {
+        auto orig_con = get_connection(cache_rq, dns_resolver, yield.tag("connect"));
+
+        if (!orig_con) {
+            LOG_DEBUG(yield, " Failed to get connection; ec=", orig_con.error());
+            return std::unexpected(orig_con.error());
+        }
+
+        // Send HTTP request to origin.
+        auto orig_rq = util::to_origin_request(cache_rq);
+        orig_rq.keep_alive(true);  // regardless of what client wants
+        if (auto r = util::http_request(*orig_con, orig_rq, yield.tag("request")); !r) {
+            LOG_DEBUG(yield, " Failed to send request; ec=", r.error());
+            return std::unexpected(r.error());
+        }
+
+        Session::reader_uptr sig_reader;
+        auto cache_rq_method = cache_rq.method();
+        if (cache_rq_method == http::verb::get || cache_rq_method == http::verb::head) {
+            auto insert_id = to_string(genuuid());
+            auto insert_ts = chrono::seconds(time(nullptr)).count();
+            sig_reader = make_unique<cache::SigningReader>
+                (std::move(*orig_con), cache_rq, std::move(insert_id), insert_ts, config.cache_private_key());
+        } else {
+            // Responses of unsafe or uncacheable requests should not be cached.
+            LOG_DEBUG(yield, " Not signing response: not a GET or HEAD request");
+            sig_reader = make_unique<http_response::Reader>(std::move(*orig_con));
+        }
+
+        auto orig_sess = Session::create(
+                std::move(sig_reader),
+                cache_rq_method == http::verb::head,
+                yield.tag("read_hdr"));
+
+        if (!orig_sess) {
+            LOG_DEBUG(yield, " Failed to process response head; ec=", orig_sess.error());
+        }
+
+        return orig_sess;
+    }
+
     std::expected<void, sys::error_code>
     inject_fresh( GenericStream& con
                 , const Request& cache_rq
                 , bool rq_keep_alive
+                , bool rq_revalidate
                 , shared_ptr<dns::Resolver> dns_resolver
                 , Async yield)
     {
@@ -376,43 +451,17 @@ private:
             // Start a short timeout for initial fetch.
             auto fetch_wd = watch_dog(executor, default_timeout::fetch_http(), [&] { timeout_yield.cancel(); });
 
-            auto orig_con = get_connection(cache_rq, dns_resolver, timeout_yield.tag("connect"));
+            auto fetch_fresh = [&] (Async y) {
+                return fetch_origin(cache_rq, dns_resolver, y);
+            };
 
-            if (!orig_con) {
-                LOG_DEBUG(yield, " Failed to get connection; ec=", orig_con.error());
-                return std::unexpected(orig_con.error());
-            }
+            // Responses already signed for identical requests may be reused.
+            auto key = InjectorCache::key(cache_rq);
+            auto orig_sess_r = key
+                ? injector_cache.fetch(*key, rq_revalidate, fetch_fresh, timeout_yield)
+                : fetch_fresh(timeout_yield);
 
-            // Send HTTP request to origin.
-            auto orig_rq = util::to_origin_request(cache_rq);
-            orig_rq.keep_alive(true);  // regardless of what client wants
-            if (auto r = util::http_request(*orig_con, orig_rq, timeout_yield.tag("request")); !r) {
-                LOG_DEBUG(yield, " Failed to send request; ec=", r.error());
-                return std::unexpected(r.error());
-            }
-
-            Session::reader_uptr sig_reader;
-            auto cache_rq_method = cache_rq.method();
-            if (cache_rq_method == http::verb::get || cache_rq_method == http::verb::head) {
-                auto insert_id = to_string(genuuid());
-                auto insert_ts = chrono::seconds(time(nullptr)).count();
-                sig_reader = make_unique<cache::SigningReader>
-                    (std::move(*orig_con), cache_rq, std::move(insert_id), insert_ts, config.cache_private_key());
-            } else {
-                // Responses of unsafe or uncacheable requests should not be cached.
-                LOG_DEBUG(yield, " Not signing response: not a GET or HEAD request");
-                sig_reader = make_unique<http_response::Reader>(std::move(*orig_con));
-            }
-
-            auto orig_sess_r = Session::create(
-                    std::move(sig_reader),
-                    cache_rq_method == http::verb::head,
-                    timeout_yield.tag("read_hdr"));
-
-            if (!orig_sess_r) {
-                LOG_DEBUG(yield, " Failed to process response head; ec=", orig_sess_r.error());
-                return std::unexpected(orig_sess_r.error());
-            }
+            if (!orig_sess_r) return std::unexpected(orig_sess_r.error());
 
             orig_sess = std::move(*orig_sess_r);
         }
@@ -468,6 +517,8 @@ public:
          , Async yield)
     {
         bool rq_keep_alive = rq.keep_alive();
+        // Caching headers are not part of the canonical request.
+        bool rq_revalidate = InjectorCache::wants_revalidation(rq);
 
         // Get DRUID before the Ouinet headers are removed.
         auto dr_it = rq.find(http_::request_druid_hdr);
@@ -482,7 +533,7 @@ public:
         }
 
         // Cache requests do not contain keep-alive information, hence the explicit argument.
-        return inject_fresh(con, *crq, rq_keep_alive, dns_resolver, yield);
+        return inject_fresh(con, *crq, rq_keep_alive, rq_revalidate, dns_resolver, yield);
     }
 
     [[nodiscard]]
@@ -518,6 +569,7 @@ private:
     const InjectorConfig& config;
     uuid_generator& genuuid;
     OriginPools& origin_pools;
+    InjectorCache& injector_cache;
     string druid{"-"};
 };
 
@@ -557,6 +609,7 @@ static void serve( InjectorConfig& config
                  , std::shared_ptr<dns::Resolver> dns_resolver
                  , GenericStream con
                  , OriginPools& origin_pools
+                 , InjectorCache& injector_cache
                  , uuid_generator& genuuid
                  , Async yield_)
 {
@@ -567,6 +620,7 @@ static void serve( InjectorConfig& config
     InjectorCacheControl cc( con.get_executor()
                            , config.origin_ssl_ctx()
                            , origin_pools
+                           , injector_cache
                            , config
                            , genuuid);
 
@@ -769,10 +823,27 @@ static void serve( InjectorConfig& config
 }
 
 //------------------------------------------------------------------------------
+// The part of `total` for the given shard out of `shards`,
+// with the main shard getting the remainder.
+static
+size_t shard_share(size_t total, unsigned shard, unsigned shards)
+{
+    auto share = total / shards;
+    return shard == 0 ? total - share * (shards - 1) : share;
+}
+
+//------------------------------------------------------------------------------
+// Accept and serve connections from the given server.
+//
+// With several threads, each runs this for its own `shard` out of `shards`
+// (zero being the main thread) with separate origin connections
+// and an even share of the signed response cache.
 static
 void listen( InjectorConfig& config
            , std::shared_ptr<dns::Resolver> dns_resolver
            , OuiServiceServer& proxy_server
+           , unsigned shard
+           , unsigned shards
            , Async yield)
 {
     uuid_generator genuuid;
@@ -795,6 +866,42 @@ void listen( InjectorConfig& config
 
     OriginPools origin_pools;
 
+    yield.spawn([ &origin_pools
+                , &config
+                , shard
+                , lock = shutdown_connections.lock()
+                ] (Async yield) {
+        while (true) {
+            async_sleep(std::chrono::minutes(5), yield);
+
+            auto s = origin_pools.stats();
+            LOG_INFO(yield, " Origin connection pools:"
+                    , " hits=", s.hits, " misses=", s.misses
+                    , " evicted=", s.evicted, " expired=", s.expired
+                    , " idle=", s.idle, " hosts=", s.hosts);
+
+            if (shard != 0) continue;  // shared by all shards
+
+            if (auto sessions = ssl::SessionCache::find(config.origin_ssl_ctx().native_handle())) {
+                auto t = sessions->stats();
+                LOG_INFO(yield, " Origin TLS handshakes:"
+                        , " full=", t.full_handshakes, " resumed=", t.resumed_handshakes
+                        , " sessions=", t.sessions);
+            }
+        }
+    });
+
+    InjectorCache injector_cache( exec
+                                , config.repo_root() / ( shard == 0
+                                                       ? "signed-cache"
+                                                       : util::str("signed-cache-", shard))
+                                , shard_share(config.cache_memory_size(), shard, shards)
+                                , shard_share(config.cache_disk_size(), shard, shards));
+
+    if (auto r = injector_cache.load(yield); !r) {
+        LOG_ERROR(yield, " Failed to load signed response cache; ec=", r.error());
+    }
+
     while (true) {
         auto connection = proxy_server.accept(yield);
 
@@ -811,6 +918,7 @@ void listen( InjectorConfig& config
             &dns_resolver,
             &genuuid,
             &origin_pools,
+            &injector_cache,
             connection_id,
             lock = shutdown_connections.lock()
         ] (Async yield) mutable {
@@ -818,6 +926,7 @@ void listen( InjectorConfig& config
                  , dns_resolver
                  , std::move(connection)
                  , origin_pools
+                 , injector_cache
                  , genuuid
                  , yield.tag(util::str('C', connection_id)));
         });
@@ -862,14 +971,25 @@ Injector::Injector(
 
     auto proxy_server = std::make_unique<OuiServiceServer>(_exec);
 
-    if (_config.tcp_endpoint()) {
-        tcp::endpoint endpoint = *_config.tcp_endpoint();
+    const unsigned threads = _config.threads();
+    const bool reuse_port = threads > 1;
+    auto tcp_endpoint = _config.tcp_endpoint();
+    auto tcp_tls_endpoint = _config.tcp_tls_endpoint();
+
+    if (reuse_port) {
+        LOG_INFO(log_path, " Serving TCP connections on ", threads, " threads");
+        if (tcp_endpoint) tcp_endpoint = choose_port(*tcp_endpoint);
+        if (tcp_tls_endpoint) tcp_tls_endpoint = choose_port(*tcp_tls_endpoint);
+    }
+
+    if (tcp_endpoint) {
+        tcp::endpoint endpoint = *tcp_endpoint;
         LOG_INFO(log_path, " TCP address: ", endpoint);
 
         util::create_state_file( _config.repo_root()/"endpoint-tcp"
                                , util::str(endpoint));
 
-        proxy_server->add(make_unique<ouiservice::TcpOuiServiceServer>(_exec, endpoint));
+        proxy_server->add(make_unique<ouiservice::TcpOuiServiceServer>(_exec, endpoint, reuse_port));
     }
 
     _ssl_context = std::make_unique<asio::ssl::context>(
@@ -878,13 +998,13 @@ Injector::Injector(
                 tls_certificate->pem_private_key(),
                 tls_certificate->pem_dh_param()));
 
-    if (_config.tcp_tls_endpoint()) {
-        tcp::endpoint endpoint = *_config.tcp_tls_endpoint();
+    if (tcp_tls_endpoint) {
+        tcp::endpoint endpoint = *tcp_tls_endpoint;
         LOG_INFO(log_path, " TCP/TLS address: ", endpoint);
         util::create_state_file( _config.repo_root()/"endpoint-tcp-tls"
                                , util::str(endpoint));
 
-        auto base = make_unique<ouiservice::TcpOuiServiceServer>(_exec, endpoint);
+        auto base = make_unique<ouiservice::TcpOuiServiceServer>(_exec, endpoint, reuse_port);
         proxy_server->add(make_unique<ouiservice::TlsOuiServiceServer>(_exec, std::move(base), *_ssl_context));
     }
 
@@ -1007,14 +1127,51 @@ Injector::Injector(
 
     LOG_INFO(log_path, " HTTP signing public key (Ed25519): ", _config.cache_private_key().public_key());
 
+    // Other threads only serve TCP, uTP and I2P are served by the main one.
+    const unsigned shards = (tcp_endpoint || tcp_tls_endpoint) ? threads : 1;
+
     task::spawn_detached(_exec, [
         this,
         proxy_server = std::move(proxy_server),
         cancel = _cancel,
+        shards,
         log_path
     ] (asio::yield_context yield) mutable {
-        listen(_config, _dns_resolver, *proxy_server, Async(yield, cancel, log_path));
+        listen(_config, _dns_resolver, *proxy_server, 0, shards, Async(yield, cancel, log_path));
     });
+
+    for (unsigned shard_id = 1; shard_id < shards; ++shard_id) {
+        auto shard = std::make_unique<Shard>();
+        AsioExecutor exec = shard->ctx.get_executor();
+
+        auto server = std::make_unique<OuiServiceServer>(exec);
+
+        if (tcp_endpoint) {
+            server->add(make_unique<ouiservice::TcpOuiServiceServer>(exec, *tcp_endpoint, true));
+        }
+
+        if (tcp_tls_endpoint) {
+            auto base = make_unique<ouiservice::TcpOuiServiceServer>(exec, *tcp_tls_endpoint, true);
+            server->add(make_unique<ouiservice::TlsOuiServiceServer>(exec, std::move(base), *_ssl_context));
+        }
+
+        task::spawn_detached(exec, [
+            this,
+            server = std::move(server),
+            cancel = shard->cancel,
+            shard_id,
+            shards,
+            log_path = log_path.tag(util::str('T', shard_id))
+        ] (asio::yield_context yield) mutable {
+            // The resolver is not shared between threads.
+            auto dns_resolver = std::make_shared<dns::Resolver>(_config.dns_config());
+            listen(_config, dns_resolver, *server, shard_id, shards, Async(yield, cancel, log_path));
+        });
+
+        shard->thread = std::thread([ctx = &shard->ctx] { ctx->run(); });
+
+        _inner->_shards.push_back(std::move(shard));
+    }
 }
 
 void Injector::stop() {
@@ -1024,10 +1181,18 @@ void Injector::stop() {
     }
     _cancel();
     _cancel = Cancel();
+
+    for (auto& shard : _inner->_shards) {
+        asio::post(shard->ctx, [&cancel = shard->cancel] { cancel(); });
+    }
 }
 
 Injector::~Injector() {
     stop();
+
+    for (auto& shard : _inner->_shards) {
+        if (shard->thread.joinable()) shard->thread.join();
+    }
 }
 
 std::expected<I2pAddress, sys::error_code> Injector::i2p_address(Async yield) {
@@ -70,6 +70,7 @@ public:
 
 private:
     struct Inner;
+    struct Shard;
 
     AsioExecutor _exec;
     InjectorConfig _config;
@@ -0,0 +1,621 @@
+#include "injector_cache.h"
+
+#include <ctime>
+#include <list>
+#include <map>
+#include <vector>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include "cache/http_store.h"
+#include "cache/store_index.h"
+#include "fetch_coalescer.h"
+#include "http_util.h"
+#include "logger.h"
+#include "parse/number.h"
+#include "split_string.h"
+#include "util/async.h"
+
+#define _LOGPFX "InjectorCache: "
+#define _DEBUG(...) LOG_DEBUG(_LOGPFX, __VA_ARGS__)
+#define _INFO(...)  LOG_INFO(_LOGPFX, __VA_ARGS__)
+#define _WARN(...)  LOG_WARN(_LOGPFX, __VA_ARGS__)
+
+namespace ouinet {
+
+using cache::ResourceId;
+using Part = http_response::Part;
+using Parts = std::vector<Part>;
+
+static
+std::size_t
+fields_size(const http::fields& fields)
+{
+    std::size_t size = 0;
+    for (auto& f : fields)
+        size += f.name_string().size() + f.value().size() + 4;  // ": " CRLF
+    return size;
+}
+
+// Approximate memory used by the part.
+static
+std::size_t
+part_size(const Part& part)
+{
+    if (auto head = part.as_head()) return fields_size(*head) + 32;
+    if (auto chunk_hdr = part.as_chunk_hdr()) return chunk_hdr->exts.size() + 16;
+    if (auto chunk_body = part.as_chunk_body()) return chunk_body->size();
+    if (auto body = part.as_body()) return body->size();
+    if (auto trailer = part.as_trailer()) return fields_size(*trailer);
+    return 0;
+}
+
+static
+std::time_t
+injection_time(const http::response_header<>& head)
+{
+    auto ts_sv = util::http_injection_ts(head);
+    auto ts = parse::number<std::time_t>(ts_sv);
+    return ts ? *ts : 0;  // missing or malformed
+}
+
+//--------------------------------------------------------------------
+
+struct InjectorCache::Impl : std::enable_shared_from_this<Impl> {
+    struct MemoryEntry {
+        std::shared_ptr<const Parts> parts;
+        std::size_t size;
+        std::time_t expires;
+        std::list<ResourceId>::iterator lru_pos;
+    };
+
+    util::AsioExecutor exec;
+    std::size_t max_memory;
+    std::size_t max_disk;
+    FetchCoalescer coalescer;
+
+    std::map<ResourceId, MemoryEntry> memory;
+    std::list<ResourceId> lru;  // most recently used first
+    std::size_t memory_size = 0;
+
+    std::unique_ptr<cache::HttpStore> store;  // null if disabled
+    fs::path store_dir;
+    cache::StoreIndex index;
+
+    Cancel lifetime_cancel;
+
+    Impl( const util::AsioExecutor& exec
+        , fs::path dir
+        , std::size_t max_memory
+        , std::size_t max_disk)
+        : exec(exec)
+        , max_memory(max_memory)
+        , max_disk(max_disk)
+        , coalescer(exec)
+        , store_dir(std::move(dir))
+    {
+        if (!store_dir.empty() && max_disk > 0)
+            store = cache::make_http_store(store_dir, exec);
+    }
+
+    // Wrap the session so that its response is cached once completely read.
+    std::expected<Session, sys::error_code>
+    record( const ResourceId&
+          , Session
+          , std::time_t expires
+          , bool to_disk
+          , Async);
+
+    std::expected<Session, sys::error_code>
+    memory_session(const ResourceId&, std::time_t now, Async);
+
+    std::expected<Session, sys::error_code>
+    disk_session(const ResourceId&, std::time_t now, Async);
+
+    void insert( const ResourceId&
+               , std::shared_ptr<const Parts>
+               , std::size_t size
+               , std::time_t expires
+               , bool to_disk);
+
+    void insert_in_memory( const ResourceId&
+                         , std::shared_ptr<const Parts>
+                         , std::size_t size
+                         , std::time_t expires);
+
+    void erase_from_memory(std::map<ResourceId, MemoryEntry>::iterator);
+
+    void store_on_disk( const ResourceId&
+                      , std::shared_ptr<const Parts>
+                      , std::time_t expires);
+
+    void evict_from_disk(const ResourceId&);
+};
+
+//--------------------------------------------------------------------
+
+// Returns the parts of a cached response.
+class InjectorCache::PartsReader : public http_response::AbstractReader {
+public:
+    PartsReader(util::AsioExecutor exec, std::shared_ptr<const Parts> parts)
+        : _exec(std::move(exec))
+        , _parts(std::move(parts))
+    {}
+
+    std::expected<std::optional<Part>, sys::error_code>
+    async_read_part(Async) override {
+        if (_closed) return std::unexpected(asio::error::operation_aborted);
+        if (_next == _parts->size()) {
+            _is_done = true;
+            return std::nullopt;
+        }
+        return (*_parts)[_next++];
+    }
+
+    bool is_done() const override { return _is_done; }
+    void close() override { _closed = true; }
+    asio::any_io_executor get_executor() override { return _exec; }
+
+private:
+    util::AsioExecutor _exec;
+    std::shared_ptr<const Parts> _parts;
+    std::size_t _next = 0;
+    bool _is_done = false;
+    bool _closed = false;
+};
+
+// Reads a session and keeps a copy of its parts,
+// which are added to the cache if the whole response is read
+// and it is not too big.
+class InjectorCache::RecordingReader : public http_response::AbstractReader {
+public:
+    RecordingReader( Session session
+                   , std::weak_ptr<Impl> impl
+                   , ResourceId key
+                   , std::time_t expires
+                   , bool to_disk)
+        : _session(std::move(session))
+        , _impl(std::move(impl))
+        , _key(std::move(key))
+        , _expires(expires)
+        , _to_disk(to_disk)
+        , _parts(std::make_unique<Parts>())
+    {}
+
+    std::expected<std::optional<Part>, sys::error_code>
+    async_read_part(Async yield) override {
+        auto part = _session.async_read_part(yield);
+
+        if (!part) {
+            _parts = nullptr;
+        } else if (!*part) {
+            finish();
+        } else {
+            record(**part);
+        }
+
+        return part;
+    }
+
+    bool is_done() const override { return _session.is_done(); }
+
+    void close() override {
+        _parts = nullptr;
+        _session.close();
+    }
+
+    asio::any_io_executor get_executor() override {
+        return _session.get_executor();
+    }
+
+private:
+    void record(const Part& part) {
+        if (!_parts) return;
+
+        _size += part_size(part);
+
+        if (_size > max_response_size) {
+            _DEBUG("Not caching response over ", max_response_size, " bytes; key=", _key);
+            _parts = nullptr;
+            return;
+        }
+
+        _parts->push_back(part);
+    }
+
+    void finish() {
+        if (!_parts) return;
+        auto impl = _impl.lock();
+        if (!impl) return;
+
+        impl->insert(_key, std::move(_parts), _size, _expires, _to_disk);
+    }
+
+private:
+    Session _session;
+    std::weak_ptr<Impl> _impl;
+    ResourceId _key;
+    std::time_t _expires;
+    bool _to_disk;
+
+    std::unique_ptr<Parts> _parts;  // null if not caching anymore
+    std::size_t _size = 0;
+};
+
+//--------------------------------------------------------------------
+
+std::expected<Session, sys::error_code>
+InjectorCache::Impl::record( const ResourceId& key
+                           , Session session
+                           , std::time_t expires
+                           , bool to_disk
+                           , Async yield)
+{
+    return Session::create(
+            std::make_unique<RecordingReader>( std::move(session), weak_from_this()
+                                             , key, expires, to_disk),
+            false,
+            yield);
+}
+
+std::expected<Session, sys::error_code>
+InjectorCache::Impl::memory_session(const ResourceId& key, std::time_t now, Async yield)
+{
+    auto ei = memory.find(key);
+    if (ei == memory.end()) return std::unexpected(asio::error::not_found);
+
+    if (ei->second.expires <= now) {
+        erase_from_memory(ei);
+        return std::unexpected(asio::error::not_found);
+    }
+
+    lru.splice(lru.begin(), lru, ei->second.lru_pos);
+
+    return Session::create(
+            std::make_unique<PartsReader>(exec, ei->second.parts),
+            false,
+            yield);
+}
+
+std::expected<Session, sys::error_code>
+InjectorCache::Impl::disk_session(const ResourceId& key, std::time_t now, Async yield)
+{
+    if (!store) return std::unexpected(asio::error::not_found);
+
+    auto e = index.find(key);
+    if (!e) return std::unexpected(asio::error::not_found);
+
+    auto expires = e->expires;
+    if (expires <= now) {
+        evict_from_disk(key);
+        return std::unexpected(asio::error::not_found);
+    }
+
+    auto reader = store->reader(key, yield);
+    if (!reader) {
+        _WARN("Failed to read stored response; key=", key, " ec=", reader.error());
+        evict_from_disk(key);
+        return std::unexpected(reader.error());
+    }
+
+    auto session = Session::create(std::move(*reader), false, yield);
+    if (!session) return session;
+
+    index.touch(key);
+
+    // Keep it in memory for the next time.
+    if (max_memory == 0) return session;
+    return record(key, std::move(*session), expires, false, yield);
+}
+
+void
+InjectorCache::Impl::insert( const ResourceId& key
+                           , std::shared_ptr<const Parts> parts
+                           , std::size_t size
+                           , std::time_t expires
+                           , bool to_disk)
+{
+    // A single response should not push most others out of memory.
+    if (size <= max_memory / 8)
+        insert_in_memory(key, parts, size, expires);
+
+    if (to_disk && store)
+        store_on_disk(key, std::move(parts), expires);
+}
+
+void
+InjectorCache::Impl::insert_in_memory( const ResourceId& key
+                                     , std::shared_ptr<const Parts> parts
+                                     , std::size_t size
+                                     , std::time_t expires)
+{
+    if (auto ei = memory.find(key); ei != memory.end())
+        erase_from_memory(ei);
+
+    lru.push_front(key);
+    memory.emplace(key, MemoryEntry{std::move(parts), size, expires, lru.begin()});
+    memory_size += size;
+
+    while (memory_size > max_memory) {
+        auto ei = memory.find(lru.back());
+        assert(ei != memory.end());
+        erase_from_memory(ei);
+    }
+}
+
+void
+InjectorCache::Impl::erase_from_memory(std::map<ResourceId, MemoryEntry>::iterator ei)
+{
+    memory_size -= ei->second.size;
+    lru.erase(ei->second.lru_pos);
+    memory.erase(ei);
+}
+
+void
+InjectorCache::Impl::store_on_disk( const ResourceId& key
+                                  , std::shared_ptr<const Parts> parts
+                                  , std::time_t expires)
+{
+    spawn_detached(exec, lifetime_cancel, [ self = shared_from_this()
+                                          , key
+                                          , parts = std::move(parts)
+                                          , expires
+                                          ] (Async yield) {
+        try {
+            PartsReader reader(self->exec, parts);
+            if (auto r = self->store->store(key, reader, yield); !r) {
+                _WARN("Failed to store response; key=", key, " ec=", r.error());
+                return;
+            }
+
+            auto size = self->store->entry_size(key);
+            if (!size) return;
+
+            cache::StoreIndex::Entry e;
+            e.size = *size;
+            e.complete = true;
+            e.expires = expires;
+            self->index.insert(key, e);
+
+            if (self->index.total_size() <= self->max_disk) return;
+
+            auto victims = self->index.victims(self->max_disk, [] (auto&) { return false; });
+            for (auto& victim : victims) self->evict_from_disk(victim);
+        }
+        catch (Async::Cancelled const&) {
+        }
+    });
+}
+
+void
+InjectorCache::Impl::evict_from_disk(const ResourceId& key)
+{
+    if (auto r = store->remove(key); !r)
+        _WARN("Failed to remove stored response; key=", key, " ec=", r.error());
+    index.erase(key);
+}
+
+//--------------------------------------------------------------------
+
+InjectorCache::InjectorCache( const util::AsioExecutor& exec
+                            , fs::path dir
+                            , std::size_t max_memory
+                            , std::size_t max_disk)
+    : _impl(std::make_shared<Impl>(exec, std::move(dir), max_memory, max_disk))
+{}
+
+InjectorCache::~InjectorCache()
+{
+    _impl->lifetime_cancel();
+}
+
+std::expected<void, sys::error_code>
+InjectorCache::load(Async yield)
+{
+    auto& impl = *_impl;
+    if (!impl.store) return {};
+
+    sys::error_code ec;
+    fs::create_directories(impl.store_dir, ec);
+    if (ec) return std::unexpected(ec);
+
+    auto now = std::time(nullptr);
+
+    auto r = impl.store->for_each([&] (const ResourceId& key, auto rr, Async yield)
+            -> std::expected<bool, sys::error_code> {
+        auto session = Session::create(std::move(rr), false, yield);
+        if (!session) return false;
+
+        auto& head = session->response_header();
+        auto lifetime = freshness_lifetime(head);
+        auto injected = injection_time(head);
+        if (!lifetime || injected == 0) return false;
+
+        auto expires = injected + lifetime->count();
+        if (expires <= now) return false;
+
+        auto size = impl.store->entry_size(key);
+        if (!size) return false;
+
+        cache::StoreIndex::Entry e;
+        e.size = *size;
+        e.complete = true;
+        e.injected = injected;
+        e.expires = expires;
+        impl.index.insert(key, e);
+        return true;
+    }, yield);
+
+    if (!r) return std::unexpected(r.error());
+
+    for (auto& victim : impl.index.victims(impl.max_disk, [] (auto&) { return false; }))
+        impl.evict_from_disk(victim);
+
+    _INFO("Loaded ", impl.index.size(), " stored responses, "
+         , impl.index.total_size(), " bytes");
+    return {};
+}
+
+/* static */
+std::optional<ResourceId>
+InjectorCache::key(const http::request_header<>& rq)
+{
+    if (rq.method() != http::verb::get) return std::nullopt;
+
+    // The origin may tailor its response to these.
+    if (rq.count(http::field::from) || rq.count(http::field::origin))
+        return std::nullopt;
+
+    return ResourceId::from_url(rq.target());
+}
+
+/* static */
+bool
+InjectorCache::wants_revalidation(const http::request_header<>& rq)
+{
+    using boost::iequals;
+
+    for (auto kv : SplitString(rq[http::field::cache_control], ',')) {
+        beast::string_view key, val;
+        std::tie(key, val) = split_string_pair(kv, '=');
+
+        if (iequals(key, "no-cache") || iequals(key, "no-store")) return true;
+        if (iequals(key, "max-age") && val == "0") return true;
+    }
+
+    for (auto v : SplitString(rq[http::field::pragma], ','))
+        if (iequals(v, "no-cache")) return true;
+
+    return false;
+}
+
+/* static */
+std::optional<std::chrono::seconds>
+InjectorCache::freshness_lifetime(const http::response_header<>& rs)
+{
+    using boost::iequals;
+    using std::chrono::seconds;
+
+    switch (rs.result()) {
+        case http::status::ok:
+        case http::status::moved_permanently:
+        case http::status::found:
+        case http::status::temporary_redirect:
+        case http::status::permanent_redirect:
+            break;
+        default:
+            return std::nullopt;
+    }
+
+    // The origin was not sent any credentials,
+    // so a cookie would be shared by everyone getting the response.
+    if (rs.count(http::field::set_cookie)) return std::nullopt;
+
+    if (rs[http::field::vary] == "*") return std::nullopt;
+
+    std::optional<int64_t> max_age, s_maxage;
+
+    for (auto kv : SplitString(rs[http::field::cache_control], ',')) {
+        beast::string_view key, val;
+        std::tie(key, val) = split_string_pair(kv, '=');
+
+        if ( iequals(key, "no-store")
+          || iequals(key, "no-cache")
+          || iequals(key, "private"))
+            return std::nullopt;
+
+        while (val.starts_with('"')) val.remove_prefix(1);
+        while (val.ends_with('"')) val.remove_suffix(1);
+
+        if (iequals(key, "s-maxage")) {
+            if (auto n = parse::number<uint32_t>(val)) s_maxage = *n;
+        } else if (iequals(key, "max-age")) {
+            if (auto n = parse::number<uint32_t>(val)) max_age = *n;
+        }
+    }
+
+    std::optional<int64_t> lifetime = s_maxage ? s_maxage : max_age;
+
+    if (!lifetime) {
+        auto expires = util::parse_date(rs[http::field::expires]);
+        auto date = util::parse_date(rs[http::field::date]);
+        if (expires.is_not_a_date_time() || date.is_not_a_date_time())
+            return std::nullopt;
+        lifetime = (expires - date).total_seconds();
+    }
+
+    auto age_sv = rs[http::field::age];
+    if (auto age = parse::number<uint32_t>(age_sv))
+        *lifetime -= *age;
+
+    if (*lifetime <= 0) return std::nullopt;
+    return seconds(*lifetime);
+}
+
+std::expected<Session, sys::error_code>
+InjectorCache::fetch( const ResourceId& key
+                    , bool revalidate
+                    , const FetchFresh& fetch_fresh
+                    , Async yield)
+{
+    auto& impl = *_impl;
+    auto now = std::time(nullptr);
+
+    if (!revalidate) {
+        if (auto s = impl.memory_session(key, now, yield)) {
+            LOG_DEBUG(yield, " Serving signed response cached in memory");
+            return s;
+        }
+
+        if (auto s = impl.disk_session(key, now, yield)) {
+            LOG_DEBUG(yield, " Serving signed response stored on disk");
+            return s;
+        }
+    }
+
+    if (auto s = impl.coalescer.follow(key, yield)) {
+        LOG_DEBUG(yield, " Sharing signed response of identical request in flight");
+        return s;
+    }
+
+    auto leader = impl.coalescer.lead(key);
+
+    auto session = fetch_fresh(yield);
+
+    if (!session) {
+        if (leader) leader->abandon(session.error());
+        return session;
+    }
+
+    auto lifetime = freshness_lifetime(session->response_header());
+
+    if (!lifetime) {
+        // The response may be private or specific to this request
+        // (e.g. setting cookies), so do not share it either.
+        if (leader) leader->abandon();
+        return session;
+    }
+
+    auto injected = injection_time(session->response_header());
+    auto expires = (injected ? injected : now) + lifetime->count();
+    session = impl.record(key, std::move(*session), expires, true, yield);
+    if (!session) return session;
+
+    if (!leader) return session;
+    return leader->share(std::move(*session), yield);
+}
+
+std::size_t
+InjectorCache::memory_size() const
+{
+    return _impl->memory_size;
+}
+
+std::size_t
+InjectorCache::disk_size() const
+{
+    return _impl->index.total_size();
+}
+
+} // namespace ouinet
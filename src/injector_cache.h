@@ -0,0 +1,101 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <expected>
+#include <functional>
+#include <memory>
+#include <optional>
+
+#include <boost/beast/http/message.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include "cache/resource_id.h"
+#include "session.h"
+#include "util/executor.h"
+#include "namespaces.h"
+
+namespace ouinet {
+
+// Keeps responses already fetched from origins and signed by the injector,
+// so that identical requests arriving while they are still fresh
+// are served without connecting to the origin and signing them again.
+//
+// Complete responses are kept in memory (the least recently used ones
+// being dropped beyond `max_memory` bytes) and, if a directory is given,
+// also in an HTTP store under it (evicting beyond `max_disk` bytes),
+// which survives restarts.
+// Responses are only kept while they are fresh according to the origin
+// (see `freshness_lifetime`).
+//
+// Concurrent requests for a response which is not cached
+// share a single origin fetch (see `FetchCoalescer`).
+class InjectorCache {
+public:
+    using FetchFresh = std::function<std::expected<Session, sys::error_code>(Async)>;
+
+    // Bigger responses are forwarded but not cached.
+    static constexpr std::size_t max_response_size = 16 << 20;  // 16 MiB
+
+public:
+    // A zero `max_memory` disables the memory cache,
+    // and an empty `dir` or a zero `max_disk` the disk cache.
+    InjectorCache( const util::AsioExecutor&
+                 , fs::path dir
+                 , std::size_t max_memory
+                 , std::size_t max_disk);
+
+    InjectorCache(const InjectorCache&) = delete;
+    InjectorCache& operator=(const InjectorCache&) = delete;
+
+    ~InjectorCache();
+
+    // Index the responses stored on disk, removing those which are no longer fresh.
+    [[nodiscard]]
+    std::expected<void, sys::error_code> load(Async);
+
+    // The key to cache the response to the given canonical request under,
+    // none if its response should not be shared with other requests.
+    static
+    std::optional<cache::ResourceId>
+    key(const http::request_header<>&);
+
+    // Whether the given request (before making it canonical) asks
+    // for a response which is not served from a cache without revalidation.
+    static
+    bool
+    wants_revalidation(const http::request_header<>&);
+
+    // For how long the given response can be served from a shared cache
+    // since it was received, none if it should not be cached at all.
+    static
+    std::optional<std::chrono::seconds>
+    freshness_lifetime(const http::response_header<>&);
+
+    // Return a fresh cached response for the given key if available
+    // (and `revalidate` is false).
+    // Otherwise share the response of a fetch for the same key in flight,
+    // or call `fetch_fresh` and cache its response (if cacheable)
+    // as it is read from the returned session.
+    [[nodiscard]]
+    std::expected<Session, sys::error_code>
+    fetch( const cache::ResourceId&
+         , bool revalidate
+         , const FetchFresh& fetch_fresh
+         , Async);
+
+    // Bytes used by responses cached in memory.
+    std::size_t memory_size() const;
+
+    // Bytes used by responses stored on disk.
+    std::size_t disk_size() const;
+
+private:
+    struct Impl;
+    class RecordingReader;
+    class PartsReader;
+
+    std::shared_ptr<Impl> _impl;
+};
+
+} // namespace ouinet
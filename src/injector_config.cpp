@@ -1,5 +1,7 @@
 #include "injector_config.h"
 
+#include <algorithm>
+#include <thread>
 #include <vector>
 #include <boost/nowide/fstream.hpp>
 #include "bep5_swarms.h"
@@ -46,6 +48,13 @@ boost::program_options::options_description InjectorConfig::options_description(
         ("open-file-limit"
          , po::value<unsigned int>()
          , "To increase the maximum number of open files")
+        ("threads"
+         , po::value<unsigned int>()->default_value(1)
+         , "Number of threads serving TCP connections, each with its own "
+           "origin connections and an even share of the signed response cache "
+           "(the main thread, which also serves uTP, I2P and BitTorrent, "
+           "gets any remainder; with no TCP endpoints only the main thread is used "
+           "and gets the whole cache) (0: one per CPU core)")
 
         // Transport options
         ("listen-on-tcp", po::value<string>(), "IP:PORT endpoint on which we'll listen (cleartext)")
@@ -83,16 +92,31 @@ boost::program_options::options_description InjectorConfig::options_description(
          , "Path to the CA certificate store directory")
         ("tls-ca-cert-store-file", po::value<std::vector<string>>(&_tls_ca_cert_store_files)
          , "Path to the CA certificate store file")
+        ("tls-session-cache-size"
+         , po::value<size_t>(&_tls_session_cache_size)->default_value(1024)
+         , "Keep up to this many TLS sessions with origins "
+           "to resume them in later connections (0: disabled)")
+        ("tls-session-lifetime"
+         , po::value<size_t>(&_tls_session_lifetime)->default_value(2 * 60 * 60)
+         , "Resume kept TLS sessions for up to this many seconds")
         // Cache options
         ("ed25519-private-key", po::value<string>()
          , "Ed25519 private key for cache-related signatures (hex-encoded)")
+        ("cache-memory-size"
+         , po::value<size_t>()->default_value(64)
+         , "Keep fresh signed responses in memory to serve identical requests "
+           "without fetching them again, up to this many MiB (0: disabled)")
+        ("cache-disk-size"
+         , po::value<size_t>()->default_value(1024)
+         , "Also keep fresh signed responses under the repository directory, "
+           "up to this many MiB (0: disabled)")
         ;
 
     return desc;
 }
 
 bool InjectorConfig::_is_http_log_file_enabled() const {
-    return http_logger.get_log_file() != nullptr;
+    return http_logger.is_logging_to_file();
 }
 
 void InjectorConfig::_is_http_log_file_enabled(bool v) {
@@ -194,6 +218,9 @@ InjectorConfig::InjectorConfig(int argc, const char**argv)
     }
 
 
+    _threads = vm["threads"].as<unsigned int>();
+    if (_threads == 0) _threads = std::max(1u, std::thread::hardware_concurrency());
+
     if (vm.count("open-file-limit")) {
         _open_file_limit = vm["open-file-limit"].as<unsigned int>();
     }
@@ -301,6 +328,9 @@ InjectorConfig::InjectorConfig(int argc, const char**argv)
         _utp_tls_endpoint = ep;
     }
 
+    _cache_memory_size = vm["cache-memory-size"].as<size_t>() * 1024 * 1024;
+    _cache_disk_size = vm["cache-disk-size"].as<size_t>() * 1024 * 1024;
+
     // Please note that generating keys takes a long time
     // and it may cause time outs in CI tests.
     setup_ed25519_private_key( vm.count("ed25519-private-key")
@@ -315,6 +345,9 @@ InjectorConfig::InjectorConfig(int argc, const char**argv)
     {
         _origin_ssl_ctx.set_verify_mode(asio::ssl::verify_peer);
         ssl::util::load_tls_ca_certificates(_origin_ssl_ctx, _tls_ca_cert_store_dir);
+        ssl::SessionCache::attach( _origin_ssl_ctx
+                                 , _tls_session_cache_size
+                                 , std::chrono::seconds(_tls_session_lifetime));
         for (auto& verify_file : _tls_ca_cert_store_files) {
             sys::error_code ec;
             _origin_ssl_ctx.load_verify_file(verify_file, ec);
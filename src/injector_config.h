@@ -70,6 +70,10 @@ public:
     boost::optional<size_t> open_file_limit() const
     { return _open_file_limit; }
 
+    // At least one.
+    unsigned threads() const
+    { return _threads; }
+
     boost::filesystem::path repo_root() const
     { return _repo_root; }
 
@@ -122,6 +126,14 @@ public:
     sign::SecretKey cache_private_key() const
     { return _ed25519_private_key; }
 
+    // In bytes, zero if disabled.
+    size_t cache_memory_size() const
+    { return _cache_memory_size; }
+
+    // In bytes, zero if disabled.
+    size_t cache_disk_size() const
+    { return _cache_disk_size; }
+
     asio::ssl::context& origin_ssl_ctx() {
         return _origin_ssl_ctx;
     }
@@ -141,12 +153,15 @@ private:
     bool _bt_allow_martians = false;
     uint32_t _udp_mux_rx_limit = udp_mux_rx_limit_injector;
     boost::optional<size_t> _open_file_limit;
+    unsigned _threads = 1;
     bool _listen_on_i2p = false;
     size_t _i2p_hops_per_tunnel = 3;
 
     std::string _tls_ca_cert_store_dir;
     std::vector<std::string> _tls_ca_cert_store_files;
     asio::ssl::context _origin_ssl_ctx{asio::ssl::context::tls_client};
+    size_t _tls_session_cache_size = 1024;
+    size_t _tls_session_lifetime = 2 * 60 * 60;  // seconds
 
     boost::optional<asio::ip::tcp::endpoint> _tcp_endpoint;
     boost::optional<asio::ip::tcp::endpoint> _tcp_tls_endpoint;
@@ -159,6 +174,8 @@ private:
     boost::optional<boost::regex> _target_rx;
     bool _allow_private_targets = false;
     sign::SecretKey _ed25519_private_key;
+    size_t _cache_memory_size = 0;
+    size_t _cache_disk_size = 0;
 
     dns::Config _dns_config;
 };
@@ -0,0 +1,317 @@
+#include "log_writer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <iostream>
+
+#include <fcntl.h>
+#ifdef _WIN32
+#  include <io.h>
+#  include <sys/stat.h>
+#  include <boost/nowide/convert.hpp>
+#else
+#  include <unistd.h>
+#endif
+
+namespace ouinet {
+
+// Minimal wrappers over the POSIX and Windows file descriptor calls.
+#ifdef _WIN32
+static int open_file(const std::string& path)
+{
+    // The path is UTF-8.
+    return ::_wopen( boost::nowide::widen(path).c_str()
+                   , _O_RDWR | _O_CREAT | _O_BINARY | _O_NOINHERIT
+                   , _S_IREAD | _S_IWRITE);
+}
+
+static int64_t seek_file(int fd, int64_t offset, int whence)
+{
+    return ::_lseeki64(fd, offset, whence);
+}
+
+static int64_t write_file(int fd, const char* p, size_t n)
+{
+    return ::_write(fd, p, unsigned(std::min<size_t>(n, INT_MAX)));
+}
+
+static void close_file(int fd)
+{
+    ::_close(fd);
+}
+#else
+static int open_file(const std::string& path)
+{
+    return ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+}
+
+static int64_t seek_file(int fd, int64_t offset, int whence)
+{
+    return ::lseek(fd, offset, whence);
+}
+
+static int64_t write_file(int fd, const char* p, size_t n)
+{
+    return ::write(fd, p, n);
+}
+
+static void close_file(int fd)
+{
+    ::close(fd);
+}
+#endif
+
+// Records written with a single wake up of the writer thread (at most).
+static const size_t max_batch = 256;
+
+static void write_all(int fd, const std::string& data)
+{
+    const char* p = data.data();
+    size_t left = data.size();
+
+    while (left > 0) {
+        auto n = write_file(fd, p, left);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;  // nowhere to report it
+        }
+        p += n;
+        left -= n;
+    }
+}
+
+//--------------------------------------------------------------------
+// File
+
+LogWriter::File::File(int fd, size_t max_size, size_t offset)
+    : _fd(fd)
+    , _stream(nullptr)
+    , _max_size(max_size)
+    , _offset(offset)
+{
+}
+
+LogWriter::File::File(std::ostream& stream)
+    : _fd(-1)
+    , _stream(&stream)
+    , _max_size(0)
+    , _offset(0)
+{
+}
+
+LogWriter::File::~File()
+{
+    if (_fd >= 0) close_file(_fd);
+}
+
+std::shared_ptr<LogWriter::File>
+LogWriter::File::open(const std::string& path, size_t max_size)
+{
+    int fd = open_file(path);
+    if (fd < 0) return nullptr;
+
+    auto end = seek_file(fd, 0, SEEK_END);
+    if (end < 0) {
+        close_file(fd);
+        return nullptr;
+    }
+
+    return std::shared_ptr<File>(new File(fd, max_size, end));
+}
+
+std::shared_ptr<LogWriter::File>
+LogWriter::File::standard_error()
+{
+    static std::shared_ptr<File> file(new File(std::cerr));
+    return file;
+}
+
+//--------------------------------------------------------------------
+// LogWriter
+
+static size_t round_up_pow2(size_t n)
+{
+    size_t p = 2;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+LogWriter::LogWriter(size_t capacity)
+    : _mask(round_up_pow2(capacity) - 1)
+    , _cells(new Cell[_mask + 1])
+{
+    for (size_t i = 0; i <= _mask; ++i) {
+        _cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    _thread = std::thread([this] { run(); });
+}
+
+LogWriter::~LogWriter()
+{
+    _stop = true;
+    _pushed.fetch_add(1, std::memory_order_release);
+    _pushed.notify_one();
+    _thread.join();
+}
+
+LogWriter& LogWriter::global()
+{
+    static LogWriter writer;
+    return writer;
+}
+
+// This is a bounded multi-producer queue as described in
+// <https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue>:
+// a cell may be written when its sequence number equals the push position,
+// and read when it equals the pop position plus one.
+bool LogWriter::try_push(Record& record)
+{
+    Cell* cell;
+    size_t pos = _head.load(std::memory_order_relaxed);
+
+    for (;;) {
+        cell = &_cells[pos & _mask];
+        size_t seq = cell->seq.load(std::memory_order_acquire);
+        auto dif = intptr_t(seq) - intptr_t(pos);
+
+        if (dif == 0) {
+            if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (dif < 0) {
+            return false;  // full
+        } else {
+            pos = _head.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->record = std::move(record);
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool LogWriter::pop(Record& record)
+{
+    Cell* cell;
+    size_t pos = _tail.load(std::memory_order_relaxed);
+
+    for (;;) {
+        cell = &_cells[pos & _mask];
+        size_t seq = cell->seq.load(std::memory_order_acquire);
+        auto dif = intptr_t(seq) - intptr_t(pos + 1);
+
+        if (dif == 0) {
+            if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (dif < 0) {
+            return false;  // empty
+        } else {
+            pos = _tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    record = std::move(cell->record);
+    cell->record = {};
+    cell->seq.store(pos + _mask + 1, std::memory_order_release);
+    return true;
+}
+
+bool LogWriter::push(std::shared_ptr<File> file, std::string text, Overflow overflow)
+{
+    Record record{std::move(file), std::move(text)};
+
+    for (;;) {
+        auto written = _written.load(std::memory_order_acquire);
+
+        if (try_push(record)) break;
+
+        if (overflow == Overflow::drop) {
+            record.file->_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // Make sure that the writer is awake, and wait for it to make room.
+        _pushed.notify_one();
+        _written.wait(written, std::memory_order_acquire);
+    }
+
+    _pushed.fetch_add(1, std::memory_order_release);
+    _pushed.notify_one();
+    return true;
+}
+
+void LogWriter::flush()
+{
+    auto target = _pushed.load(std::memory_order_acquire);
+
+    for (;;) {
+        auto written = _written.load(std::memory_order_acquire);
+        if (int32_t(written - target) >= 0) return;
+        _written.wait(written, std::memory_order_acquire);
+    }
+}
+
+void LogWriter::run()
+{
+    std::vector<Record> batch;
+    batch.reserve(max_batch);
+
+    for (;;) {
+        auto pushed = _pushed.load(std::memory_order_acquire);
+
+        Record record;
+        while (batch.size() < max_batch && pop(record)) {
+            batch.push_back(std::move(record));
+        }
+
+        if (!batch.empty()) {
+            auto n = batch.size();
+            write_batch(batch);
+            batch.clear();
+            _written.fetch_add(uint32_t(n), std::memory_order_release);
+            _written.notify_all();
+            continue;
+        }
+
+        if (_stop) return;
+
+        _pushed.wait(pushed, std::memory_order_acquire);
+    }
+}
+
+void LogWriter::write_batch(std::vector<Record>& batch)
+{
+    std::string buffer;
+
+    for (size_t i = 0; i < batch.size();) {
+        auto& file = *batch[i].file;
+        buffer.clear();
+
+        if (auto dropped = file._dropped.exchange(0, std::memory_order_relaxed)) {
+            buffer += "[" + std::to_string(dropped) + " log records dropped]\n";
+        }
+
+        // Consecutive records for the same file are written together.
+        for (; i < batch.size() && batch[i].file.get() == &file; ++i) {
+            buffer += batch[i].text;
+        }
+
+        if (file._stream) {
+            file._stream->write(buffer.data(), buffer.size());
+            file._stream->flush();
+            continue;
+        }
+
+        write_all(file._fd, buffer);
+
+        if (file._max_size == 0) continue;
+
+        file._offset += buffer.size();
+        if (file._offset > file._max_size) {
+            seek_file(file._fd, 0, SEEK_SET);
+            file._offset = 0;
+        }
+    }
+}
+
+} // namespace ouinet
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "api.h"
+
+namespace ouinet {
+
+// Writes log records to files from a background thread,
+// so that logging does not block the calling thread on I/O.
+//
+// Records are pushed into a bounded ring buffer without taking locks,
+// and the writer thread drains it in batches,
+// with a single `write(2)` per file for consecutive records of a batch.
+//
+// When the buffer is full, records pushed with `Overflow::drop` are dropped
+// (and the number of dropped records is written to their file later on),
+// while those pushed with `Overflow::wait` wait for the writer to make room.
+class OUINET_COMMON_API LogWriter {
+public:
+    enum class Overflow { drop, wait };
+
+    // A file to write records to, closed when no longer referenced
+    // (by users or queued records).
+    class File {
+    public:
+        // Returns null on error. Writing wraps around to the beginning
+        // of the file once it exceeds `max_size` bytes (if not zero).
+        static std::shared_ptr<File> open(const std::string& path, size_t max_size = 0);
+
+        // The standard error stream, written through `std::cerr`
+        // so that redirections of its buffer (as on Android) are honored.
+        static std::shared_ptr<File> standard_error();
+
+        ~File();
+
+    private:
+        friend class LogWriter;
+
+        File(int fd, size_t max_size, size_t offset);
+        File(std::ostream&);
+
+        const int _fd;  // -1 when writing to `_stream`
+        std::ostream* const _stream;
+        const size_t _max_size;
+        size_t _offset;  // only used by the writer thread
+        std::atomic<size_t> _dropped{0};
+    };
+
+    explicit LogWriter(size_t capacity = default_capacity);
+
+    LogWriter(const LogWriter&) = delete;
+    LogWriter& operator=(const LogWriter&) = delete;
+
+    // Writes queued records and stops the writer thread.
+    ~LogWriter();
+
+    // Queue `text` to be written to `file`.
+    // Returns `false` if the record was dropped.
+    bool push(std::shared_ptr<File> file, std::string text, Overflow);
+
+    // Wait until records pushed before the call have been written.
+    void flush();
+
+    // The writer used by the process loggers.
+    static LogWriter& global();
+
+    static constexpr size_t default_capacity = 8192;
+
+private:
+    struct Record {
+        std::shared_ptr<File> file;
+        std::string text;
+    };
+
+    // A slot of the ring buffer; `seq` tells whether it may be written
+    // or read in the current lap (see `try_push` and `pop`).
+    struct Cell {
+        std::atomic<size_t> seq;
+        Record record;
+    };
+
+    bool try_push(Record&);
+    bool pop(Record&);
+    void run();
+    void write_batch(std::vector<Record>&);
+
+private:
+    const size_t _mask;
+    std::unique_ptr<Cell[]> _cells;
+    alignas(64) std::atomic<size_t> _head{0};  // next cell to push to
+    alignas(64) std::atomic<size_t> _tail{0};  // next cell to pop from
+    // Bumped on pushes and writes, used to wake up the writer and flushers.
+    alignas(64) std::atomic<uint32_t> _pushed{0};
+    std::atomic<uint32_t> _written{0};
+    std::atomic<bool> _stop{false};
+    std::thread _thread;
+};
+
+} // namespace ouinet
@@ -18,16 +18,17 @@
 
 #include <sys/time.h>
 
+#include <charconv>
 #include <string>
 #include <iostream>
-#include <fstream>
-#include <iomanip> // std::setprecision
 
 #include <boost/system/error_code.hpp>
 #include <boost/filesystem.hpp>
 #include "namespaces.h"
 #include "logger.h"
 
+using ouinet::LogWriter;
+
 static const long LOG_FILE_MAX_SIZE = 15 * 1024 * 1024;
 
 const std::string log_level_announce[] =       {"SILLY"        , "DEBUG"     , "VERBOSE"   , "INFO"      , "WARN"        , "ERROR"      , "ABORT"};
@@ -92,49 +93,34 @@ Logger::Logger(log_level_t threshold)
     log_to_stderr = true;
     log_filename = "";
     log_ts_base = {0, 0};
+    // Make sure that the writer outlives the logger.
+    LogWriter::global();
 }
 
 void Logger::log_to_file(std::string fname)
 {
-    using std::ios;
-
     if (fname.empty()) {
         if (!log_filename.empty()) {
             ouinet::sys::error_code ignored_ec;
             ouinet::fs::remove(log_filename, ignored_ec);
         }
-        log_file = boost::none;
+        log_file = nullptr;
         return;
     }
 
     if (log_filename != fname || !log_file) {
         log_filename = fname;
+        log_file = LogWriter::File::open(log_filename, LOG_FILE_MAX_SIZE);
 
-        log_file = std::fstream();
-
-        if (ouinet::fs::exists(log_filename)) {
-            log_file->open(log_filename, ios::in | ios::out | ios::ate);
-        } else {
-            // `trunc` causes the file to be created
-            log_file->open(log_filename, ios::in | ios::out | ios::trunc);
-        }
-
-        if (!log_file->is_open()) {
+        if (!log_file) {
             std::cerr << "Failed to open log file " << fname  << "\n";
             log_filename = "";
-            log_file = boost::none;
         } else {
-            static const char* start_s = "\nOUINET START\n";
-            *log_file << start_s;
+            LogWriter::global().push(log_file, "\nOUINET START\n", LogWriter::Overflow::wait);
         }
     }
 }
 
-std::fstream* Logger::get_log_file() {
-    if (!log_file) return nullptr;
-    return &*log_file;
-}
-
 // Update the logger's threshold.
 // If an invalid level is provided, do not update.
 void Logger::set_threshold(log_level_t level)
@@ -156,63 +142,61 @@ static const char* pad(log_level_t level) {
     return "";
 }
 
-namespace {
-    struct Printer {
-        using string_view = boost::string_view;
-
-        log_level_t level;
-        bool with_color;
-        boost::optional<double> ts;
-        string_view msg;
-        string_view fun;
-
-        Printer(log_level_t level, bool with_color, boost::optional<double> ts, string_view msg, string_view fun)
-            : level(level)
-            , with_color(with_color)
-            , ts(ts)
-            , msg(msg)
-            , fun(fun)
-        {}
-
-        friend std::ostream& operator<<(std::ostream& os, const Printer& p) {
-            static const char* color_end = "\033[0m";
-
-            if (p.ts) {
-                // Prevent scientific notation
-                os << std::fixed << std::showpoint << std::setprecision(4);
-                os << *p.ts << ": ";
-            }
+// Append a decorated log line to `out`
+// (avoiding iostreams, which are comparatively slow).
+static void format_line( std::string& out
+                       , log_level_t level
+                       , bool with_color
+                       , boost::optional<double> ts
+                       , boost::string_view msg
+                       , boost::string_view fun)
+{
+    static const char* color_end = "\033[0m";
+
+    if (ts) {
+        // Prevent scientific notation
+        char buf[32];
+        auto r = std::to_chars(buf, buf + sizeof(buf), *ts, std::chars_format::fixed, 4);
+        out.append(buf, r.ptr);
+        out += ": ";
+    }
 
-            if (p.with_color) {
-                os << log_level_color_prefix[p.level];
-            }
+    if (with_color) {
+        out += log_level_color_prefix[level];
+    }
 
-            os << "[" << log_level_announce[p.level];
+    out += "[";
+    out += log_level_announce[level];
 
-            if (log_level_colored_msg[p.level] || !p.with_color) {
-                os << "] ";
-            } else {
-                os << "]" << color_end << " ";
-            }
+    if (log_level_colored_msg[level] || !with_color) {
+        out += "] ";
+    } else {
+        out += "]";
+        out += color_end;
+        out += " ";
+    }
 
-            os << pad(p.level);
+    out += pad(level);
 
-            if (!p.fun.empty()) {
-                os << p.fun << ": ";
-            }
+    if (!fun.empty()) {
+        out.append(fun.data(), fun.size());
+        out += ": ";
+    }
 
-            os << p.msg;
+    out.append(msg.data(), msg.size());
 
-            if (p.with_color && log_level_colored_msg[p.level]) {
-                os << color_end;
-            }
+    if (with_color && log_level_colored_msg[level]) {
+        out += color_end;
+    }
 
-            return os;
-        }
-    };
+    out += "\n";
 }
 
 // Standard log function. Prints nice colors for each level.
+//
+// Lines are written by the global `LogWriter` in the background.
+// If it falls behind, messages below `WARN` are dropped
+// (and their number logged later), while others wait to be queued.
 void Logger::log(log_level_t level, const std::string& msg, boost::string_view function_name)
 {
     if (level < SILLY || level > ABORT || level < threshold) {
@@ -231,22 +215,32 @@ void Logger::log(log_level_t level, const std::string& msg, boost::string_view f
 
     if (_stamp_with_time || log_file) ts = log_get_timestamp();
 
+    auto overflow = level >= WARN ? LogWriter::Overflow::wait
+                                  : LogWriter::Overflow::drop;
+    auto& writer = LogWriter::global();
+
     if (log_to_stderr) {
-        if (_stamp_with_time)
-            std::cerr << Printer(level, with_color, ts, msg, function_name) << "\n";
-        else
-            std::cerr << Printer(level, with_color, boost::none, msg, function_name) << "\n";
+        std::string line;
+        line.reserve(msg.size() + 64);
+        format_line( line, level, with_color
+                   , _stamp_with_time ? ts : boost::none
+                   , msg, function_name);
+        writer.push(LogWriter::File::standard_error(), std::move(line), overflow);
     }
 
-    if (log_file && log_file->is_open()) {
-        *log_file << Printer(level, false, ts, msg, function_name) << "\n";
-
-        if (log_file->tellp() > LOG_FILE_MAX_SIZE) {
-            log_file->seekp(0);
-        }
+    if (log_file) {
+        std::string line;
+        line.reserve(msg.size() + 64);
+        format_line(line, level, false, ts, msg, function_name);
+        writer.push(log_file, std::move(line), overflow);
     }
 }
 
+void Logger::flush()
+{
+    LogWriter::global().flush();
+}
+
 // Convenience methods
 
 void Logger::silly(const std::string& msg, boost::string_view function_name)
@@ -282,6 +276,7 @@ void Logger::error(const std::string& msg, boost::string_view function_name)
 void Logger::abort(const std::string& msg, boost::string_view function_name)
 {
     log(ABORT, msg, function_name);
+    flush();
     exit(1);
 }
 
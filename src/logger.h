@@ -16,9 +16,11 @@
 #define SRC_LOGGER_H_
 
 #include <fstream>
+#include <memory>
 
 #include "util/str.h"
 #include "api.h"
+#include "log_writer.h"
 
 #include <boost/optional/optional.hpp>
 #include <boost/utility/string_view.hpp>
@@ -87,7 +89,7 @@ class OUINET_COMMON_API Logger
     log_level_t threshold;
     bool log_to_stderr;
     std::string log_filename;
-    boost::optional<std::fstream> log_file;
+    std::shared_ptr<ouinet::LogWriter::File> log_file;
 
   public:
     std::string state_to_text[0xFF]; // TOTAL_NO_OF_STATES
@@ -100,7 +102,7 @@ class OUINET_COMMON_API Logger
 
     // Get the current log file name
     std::string current_log_file() { return log_filename; }
-    std::fstream* get_log_file();
+    bool is_logging_to_file() const { return bool(log_file); }
 
     // Get the current threshold
     log_level_t get_threshold() const { return threshold;}
@@ -113,6 +115,9 @@ class OUINET_COMMON_API Logger
 
     void log(log_level_t level, const std::string& msg, boost::string_view function_name = "");
 
+    // Wait until messages logged so far have been written.
+    void flush();
+
     void silly  (const std::string& msg, boost::string_view function_name = "");
     void debug  (const std::string& msg, boost::string_view function_name = "");
     void verbose(const std::string& msg, boost::string_view function_name = "");
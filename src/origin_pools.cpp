@@ -0,0 +1,193 @@
+#include "origin_pools.h"
+
+#include <algorithm>
+
+namespace ouinet {
+
+OriginPools::OriginPools(Limits limits)
+    : _state(std::make_unique<State>())
+{
+    _state->limits = limits;
+}
+
+boost::optional<OriginPools::Connection>
+OriginPools::get_connection(const RequestHdr& rq)
+{
+    auto opt_pool_key = make_pool_key(rq);
+
+    assert(opt_pool_key);
+
+    if (!opt_pool_key) return boost::none;
+
+    auto& state = *_state;
+    auto now = Clock::now();
+    state.expire(now);
+
+    auto pool_i = state.pools.find(*opt_pool_key);
+
+    if (pool_i == state.pools.end() || pool_i->second.connections.empty()) {
+        ++state.stats.misses;
+        return boost::none;
+    }
+
+    auto& pool = pool_i->second;
+    state.touch(pool, now);
+
+    ++state.stats.hits;
+    if (state.idle > 0) --state.idle;
+
+    return pool.connections.pop_back();
+}
+
+OriginPools::Connection
+OriginPools::wrap(const RequestHdr& rq, GenericStream connection)
+{
+    auto opt_pool_key = make_pool_key(rq);
+
+    assert(opt_pool_key);
+    if (!opt_pool_key) return Connection();
+
+    auto& state = *_state;
+    auto now = Clock::now();
+    state.expire(now);
+
+    auto& pool = state.find_or_create_pool(*opt_pool_key);
+    state.touch(pool, now);
+
+    return pool.connections.wrap(std::move(connection));
+}
+
+void
+OriginPools::insert_connection(const RequestHdr& rq, Connection con)
+{
+    auto opt_pool_key = make_pool_key(rq);
+
+    assert(opt_pool_key);
+
+    if (!opt_pool_key) return;
+
+    _state->find_or_create_pool(*opt_pool_key).connections.push_back(std::move(con));
+}
+
+OriginPools::Stats
+OriginPools::stats() const
+{
+    auto stats = _state->stats;
+    stats.idle = _state->count_idle();
+    stats.hosts = _state->pools.size();
+    return stats;
+}
+
+boost::optional<OriginPools::PoolKey>
+OriginPools::make_pool_key(const RequestHdr& hdr)
+{
+    auto host = hdr[http::field::host];
+
+    assert(!host.empty());
+
+    if (host.empty()) return boost::none;
+
+    bool is_ssl = hdr.target().starts_with("https:");
+
+    return PoolKey{is_ssl, std::string_view(host.data(), host.size())};
+}
+
+//--------------------------------------------------------------------
+
+OriginPools::Pool&
+OriginPools::State::find_or_create_pool(const PoolKey& key)
+{
+    auto pool_i = pools.find(key);
+    if (pool_i != pools.end()) return pool_i->second;
+
+    pool_i = pools.emplace(PoolId{key.is_ssl, std::string(key.host)}, Pool{}).first;
+
+    auto& pool = pool_i->second;
+    pool.id = &pool_i->first;
+    pool.last_used = Clock::now();
+    pool.lru_pos = lru.insert(lru.end(), &pool);
+    pool.connections.on_push([this, &pool] { on_push(pool); });
+
+    return pool;
+}
+
+void
+OriginPools::State::touch(Pool& pool, Clock::time_point now)
+{
+    pool.last_used = now;
+    lru.splice(lru.end(), lru, pool.lru_pos);
+}
+
+// Called whenever a connection becomes idle.
+// This must not remove any pool, since it may be called from one.
+void
+OriginPools::State::on_push(Pool& pool)
+{
+    touch(pool, Clock::now());
+    ++idle;
+
+    while (pool.connections.size() > limits.max_idle_per_host) {
+        pool.connections.close_front();
+        --idle;
+        ++stats.evicted;
+    }
+
+    if (idle <= limits.max_idle) return;
+
+    // Some connections may have been closed by their origins.
+    idle = count_idle();
+
+    // The pool of this connection is the most recently used,
+    // so it is the last one to lose connections.
+    for (auto victim = lru.begin(); idle > limits.max_idle && victim != lru.end();) {
+        auto& connections = (*victim)->connections;
+
+        if (connections.empty()) {
+            ++victim;
+            continue;
+        }
+
+        connections.close_front();
+        --idle;
+        ++stats.evicted;
+    }
+}
+
+// Close connections which have been idle for too long,
+// and remove pools which have not been used since
+// (unless some of their connections are still in use, so that they can go back).
+void
+OriginPools::State::expire(Clock::time_point now)
+{
+    auto period = std::min<Clock::duration>(limits.idle_timeout, std::chrono::seconds(1));
+    if (now < last_expiry + period) return;
+    last_expiry = now;
+
+    auto min_idle_since = now - limits.idle_timeout;
+
+    for (auto pool_i = lru.begin(); pool_i != lru.end();) {
+        auto& pool = **pool_i;
+
+        stats.expired += pool.connections.close_idle_since(min_idle_since);
+
+        if ( pool.connections.empty() && pool.connections.checked_out() == 0
+           && pool.last_used < min_idle_since) {
+            pool_i = lru.erase(pool_i);
+            pools.erase(*pool.id);
+        } else {
+            ++pool_i;
+        }
+    }
+
+    idle = count_idle();
+}
+
+size_t
+OriginPools::State::count_idle() const
+{
+    size_t n = 0;
+    for (auto& [_, pool] : pools) n += pool.connections.size();
+    return n;
+}
+
+} // namespace
@@ -1,107 +1,113 @@
 #pragma once
 
 #include "connection_pool.h"
+#include <boost/beast/http/message.hpp>
 #include <boost/optional.hpp>
 
+#include <chrono>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "api.h"
+
 namespace ouinet {
 
-class OriginPools {
+// Keeps idle connections to origins for reuse, one pool per origin.
+//
+// Both the number of idle connections to each origin and their total number
+// are bounded, the latter by closing connections to the least recently used
+// origins first. Connections idle for longer than a timeout are also closed
+// (whenever the pools are used).
+class OUINET_COMMON_API OriginPools {
 private:
-    using RequestHdr = beast::http::header<true>; 
+    using RequestHdr = beast::http::header<true>;
+    using Clock = std::chrono::steady_clock;
 
 public:
     struct PoolId {
         bool is_ssl;
         std::string host;
+    };
 
-        bool operator<(const PoolId& other) const {
-            return tie(is_ssl, host) < tie(other.is_ssl, other.host);
-        }
+    struct Limits {
+        size_t max_idle = 256;
+        size_t max_idle_per_host = 8;
+        Clock::duration idle_timeout = std::chrono::seconds(60);
+    };
+
+    struct Stats {
+        uint64_t hits = 0;  // requests which reused an idle connection
+        uint64_t misses = 0;  // requests which needed a new connection
+        uint64_t evicted = 0;  // idle connections closed to stay within limits
+        uint64_t expired = 0;  // idle connections closed after the idle timeout
+        size_t idle = 0;  // idle connections currently kept
+        size_t hosts = 0;  // origins currently with a pool
     };
 
     using Connection = ConnectionPool<bool>::Connection;
 
 public:
+    OriginPools() : OriginPools(Limits{}) {}
+    OriginPools(Limits);
+
+    OriginPools(OriginPools&&) = default;
+    OriginPools& operator=(OriginPools&&) = default;
+
     Connection wrap(const RequestHdr&, GenericStream);
 
     boost::optional<Connection> get_connection(const RequestHdr& rq);
 
     void insert_connection(const RequestHdr& rq, Connection);
 
-private:
-    boost::optional<PoolId> make_pool_id(const RequestHdr& hdr);
+    Stats stats() const;
 
 private:
-    std::map<PoolId, ConnectionPool<bool>> _pools;
-};
-
-inline
-boost::optional<OriginPools::Connection>
-OriginPools::get_connection(const RequestHdr& rq)
-{
-    auto opt_pool_id = make_pool_id(rq);
-
-    assert(opt_pool_id);
-
-    if (!opt_pool_id) return boost::none;
-
-    auto pool_i = _pools.find(*opt_pool_id);
-
-    if (pool_i == _pools.end()) return boost::none;
-
-    if (pool_i->second.empty()) {
-        _pools.erase(pool_i);
-        return boost::none;
-    }
-
-    auto ret = pool_i->second.pop_front();
-
-    if (pool_i->second.empty()) {
-        _pools.erase(pool_i);
-    }
-
-    return ret;
-}
-
-inline
-OriginPools::Connection
-OriginPools::wrap(const RequestHdr& rq, GenericStream connection)
-{
-    auto opt_pool_id = make_pool_id(rq);
-
-    assert(opt_pool_id);
-    if (!opt_pool_id) return Connection();
-
-    return _pools[*opt_pool_id].wrap(std::move(connection));
-}
-
-inline
-void
-OriginPools::insert_connection(const RequestHdr& rq, Connection con)
-{
-    auto opt_pool_id = make_pool_id(rq);
-
-    assert(opt_pool_id);
-
-    if (!opt_pool_id) return;
+    // A pool ID which refers to the host in a request, to look up pools without copying it.
+    struct PoolKey {
+        bool is_ssl;
+        std::string_view host;
+    };
 
-    _pools[*opt_pool_id].push_back(std::move(con));
-}
+    struct PoolLess {
+        using is_transparent = void;
 
-inline
-boost::optional<OriginPools::PoolId>
-OriginPools::make_pool_id(const RequestHdr& hdr)
-{
-    auto host = hdr[http::field::host];
+        template<class L, class R>
+        bool operator()(const L& l, const R& r) const {
+            return std::pair<bool, std::string_view>(l.is_ssl, l.host)
+                 < std::pair<bool, std::string_view>(r.is_ssl, r.host);
+        }
+    };
 
-    assert(!host.empty());
+    struct Pool {
+        const PoolId* id;
+        ConnectionPool<bool> connections;
+        Clock::time_point last_used;
+        std::list<Pool*>::iterator lru_pos;
+    };
 
-    if (host.empty()) return boost::none;
+    // Kept behind a pointer so that pools can refer to it after moving `OriginPools`.
+    struct State {
+        Limits limits;
+        Stats stats;
+        std::map<PoolId, Pool, PoolLess> pools;
+        std::list<Pool*> lru;  // least recently used first
+        size_t idle = 0;  // may include connections closed by origins since the last count
+        Clock::time_point last_expiry;
+
+        Pool& find_or_create_pool(const PoolKey&);
+        void touch(Pool&, Clock::time_point now);
+        void on_push(Pool&);
+        void expire(Clock::time_point now);
+        size_t count_idle() const;
+    };
 
-    bool is_ssl = hdr.target().starts_with("https:");
+    static boost::optional<PoolKey> make_pool_key(const RequestHdr&);
 
-    // TODO: Can we avoid converting to string?
-    return PoolId{is_ssl, std::string(host)};
-}
+private:
+    std::unique_ptr<State> _state;
+};
 
 } // namespace
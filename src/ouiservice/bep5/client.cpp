@@ -688,7 +688,7 @@ Bep5Client::connect(Async yield, bool use_tls, Target target)
                 lock = wc.lock()
             ] (Async yield) mutable {
                 LOG_DEBUG(yield, " Connecting to ", peer->swarm_type, "; ep=", peer->endpoint, "...");
-                auto con = self->connect_single(*peer->client, use_tls, yield);
+                auto con = self->connect_single(*peer->client, peer->endpoint, use_tls, yield);
                 if (!con) {
                     return;
                 }
@@ -723,7 +723,10 @@ Bep5Client::connect(Async yield, bool use_tls, Target target)
 }
 
 std::expected<GenericStream, sys::error_code>
-Bep5Client::connect_single(OuiServiceClient& cli, bool use_tls, Async yield)
+Bep5Client::connect_single( OuiServiceClient& cli
+                          , const asio::ip::udp::endpoint& ep
+                          , bool use_tls
+                          , Async yield)
 {
     auto con = cli.connect(yield);
     if (!con.has_value()) return std::unexpected(con.error());
@@ -736,7 +739,11 @@ Bep5Client::connect_single(OuiServiceClient& cli, bool use_tls, Async yield)
         return std::unexpected(asio::error::bad_descriptor);
     }
 
-    return ssl::util::client_handshake(std::move(*con), *_injector_tls_ctx, "" , yield);
+    // The injector has no certificate host name to check,
+    // but its sessions can be resumed for the same endpoint.
+    return ssl::util::client_handshake( std::move(*con), *_injector_tls_ctx
+                                      , "", util::str(ep)
+                                      , yield);
 }
 
 Bep5Client::~Bep5Client()
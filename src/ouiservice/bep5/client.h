@@ -92,7 +92,10 @@ public:
 private:
     void status_loop(Async);
 
-    std::expected<GenericStream, sys::error_code> connect_single(OuiServiceClient&, bool use_tls, Async);
+    std::expected<GenericStream, sys::error_code> connect_single( OuiServiceClient&
+                                                               , const asio::ip::udp::endpoint&
+                                                               , bool use_tls
+                                                               , Async);
 
 private:
     std::shared_ptr<bittorrent::DhtBase> _dht;
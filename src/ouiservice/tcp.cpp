@@ -6,10 +6,13 @@
 namespace ouinet {
 namespace ouiservice {
 
-TcpOuiServiceServer::TcpOuiServiceServer(asio::any_io_executor ex, asio::ip::tcp::endpoint endpoint):
+TcpOuiServiceServer::TcpOuiServiceServer( asio::any_io_executor ex
+                                        , asio::ip::tcp::endpoint endpoint
+                                        , bool reuse_port):
     _ex(std::move(ex)),
     _acceptor(_ex),
-    _endpoint(endpoint)
+    _endpoint(endpoint),
+    _reuse_port(reuse_port)
 {}
 
 sys::error_code TcpOuiServiceServer::start_listen(Async)
@@ -21,6 +24,19 @@ sys::error_code TcpOuiServiceServer::start_listen(Async)
 
     _acceptor.set_option(asio::socket_base::reuse_address(true));
 
+    if (_reuse_port) {
+#ifdef SO_REUSEPORT
+        using reuse_port = asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+        _acceptor.set_option(reuse_port(true), ec);
+#else
+        ec = asio::error::operation_not_supported;
+#endif
+        if (ec) {
+            _acceptor.close();
+            return ec;
+        }
+    }
+
     _acceptor.bind(_endpoint, ec);
     if (ec) {
         _acceptor.close();
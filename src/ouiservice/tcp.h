@@ -16,7 +16,11 @@ namespace ouiservice {
 class OUINET_COMMON_API TcpOuiServiceServer : public OuiServiceImplementationServer
 {
     public:
-    TcpOuiServiceServer(asio::any_io_executor, asio::ip::tcp::endpoint endpoint);
+    // With `reuse_port`, other servers (e.g. on other threads) may listen
+    // on the same endpoint, and the system spreads connections among them.
+    TcpOuiServiceServer( asio::any_io_executor
+                       , asio::ip::tcp::endpoint endpoint
+                       , bool reuse_port = false);
 
     [[nodiscard]]
     sys::error_code start_listen(Async) override;
@@ -30,6 +34,7 @@ class OUINET_COMMON_API TcpOuiServiceServer : public OuiServiceImplementationSer
     asio::any_io_executor _ex;
     asio::ip::tcp::acceptor _acceptor;
     asio::ip::tcp::endpoint _endpoint;
+    bool _reuse_port;
 };
 
 class OUINET_COMMON_API TcpOuiServiceClient : public OuiServiceClient
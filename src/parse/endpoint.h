@@ -25,7 +25,14 @@ endpoint(boost::string_view& s, sys::error_code& ec)
         return {};
     }
 
-    auto addr = asio::ip::make_address(util::to_std(s.substr(0, pos)), ec);
+    auto addr_s = s.substr(0, pos);
+
+    // IPv6 addresses are written as `[ADDR]:PORT`.
+    if (addr_s.starts_with('[') && addr_s.ends_with(']')) {
+        addr_s = addr_s.substr(1, addr_s.size() - 2);
+    }
+
+    auto addr = asio::ip::make_address(util::to_std(addr_s), ec);
 
     if (ec) return {};
 
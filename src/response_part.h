@@ -10,6 +10,7 @@
 #include <boost/asio/write.hpp>
 #include <boost/variant.hpp>
 
+#include "util/shared_bytes.h"
 #include "util/variant.h"
 #include "util/watch_dog.h"
 #include "namespaces.h"
@@ -97,20 +98,23 @@ struct OUINET_COMMON_API Head : public http::response_header<> {
     { return detail::async_write(this, s, d, yield); }
 };
 
-struct Body : public std::vector<uint8_t> {
-    using Base = std::vector<uint8_t>;
+// Body data is shared among copies of body parts (see `util::SharedBytes`),
+// so parts may be forwarded to several consumers without copying their data.
+struct Body : public util::SharedBytes {
+    using Base = util::SharedBytes;
 
-    Body(Base data) : Base(std::move(data)) {}
+    Body(util::SharedBytes data) : Base(std::move(data)) {}
 
     Body(const Body&) = default;
     Body(Body&&) = default;
     Body& operator=(const Body&) = default;
+    Body& operator=(Body&&) = default;
 
     template<class S>
     [[nodiscard]]
     std::expected<void, sys::error_code> async_write(S& s, Async yield) const
     {
-        return detail::async_write(s, asio::buffer(*this), yield);
+        return detail::async_write(s, buffer(), yield);
     }
 
     template<class S, class Duration>
@@ -167,24 +171,25 @@ struct ChunkHdr {
     { return detail::async_write(this, s, d, yield); }
 };
 
-struct ChunkBody : public std::vector<uint8_t> {
+struct ChunkBody : public util::SharedBytes {
     size_t remain;
 
-    using Base = std::vector<uint8_t>;
+    using Base = util::SharedBytes;
 
-    ChunkBody(Base data, size_t remain)
+    ChunkBody(util::SharedBytes data, size_t remain)
         : Base(std::move(data))
         , remain(remain) {}
 
     ChunkBody(const ChunkBody&) = default;
     ChunkBody(ChunkBody&&) = default;
     ChunkBody& operator=(const ChunkBody&) = default;
+    ChunkBody& operator=(ChunkBody&&) = default;
 
     template<class S>
     [[nodiscard]]
     std::expected<void, sys::error_code> async_write(S& s, Async yield) const
     {
-        auto r = asio::async_write(s, asio::buffer(*this), yield);
+        auto r = asio::async_write(s, buffer(), yield);
 
         if (!r) return std::unexpected(r.error());
 
@@ -39,7 +39,7 @@ void Reader::setup_parser()
 
     _on_chunk_body = [&] (auto remain, auto data, auto& ec) -> size_t {
         assert(!_next_part);
-        _next_part = ChunkBody( std::vector<uint8_t>(data.begin(), data.end())
+        _next_part = ChunkBody( _body_writer.copy(asio::buffer(data.data(), data.size()))
                               , remain - data.size());
         return data.size();
     };
@@ -64,6 +64,9 @@ Reader::async_read_part(Async yield) {
     auto lifetime_cancelled = _lifetime_cancel.connect([&] { yield.cancel(); });
     auto cancelled = yield.cancel_slot([&] { _in.close(); });
 
+    if (!_body_writer.pool())
+        _body_writer = util::SharedBytesWriter(util::BytePool::get(yield.get_executor()));
+
     // Receive HTTP response head from input side and parse it
     // -------------------------------------------------------
     if (!_parser.is_header_done()) {
@@ -112,10 +115,10 @@ Reader::async_read_part(Async yield) {
             return std::nullopt;
         }
 
-        char buf[http_forward_block];
+        auto buf = _body_writer.prepare(http_forward_block);
 
-        _parser.get().body().data = buf;
-        _parser.get().body().size = sizeof(buf);
+        _parser.get().body().data = buf.data();
+        _parser.get().body().size = buf.size();
 
         auto result = http::async_read_some(_in, _buffer, _parser, yield);
 
@@ -127,14 +130,14 @@ Reader::async_read_part(Async yield) {
             }
         }
 
-        size_t s = sizeof(buf) - _parser.get().body().size;
+        size_t s = buf.size() - _parser.get().body().size;
 
         if (s == 0 && _parser.is_done()) {
             _is_done = true;
             return std::nullopt;
         }
 
-        return Part(Body(std::vector<uint8_t>(buf, buf + s)));
+        return Part(Body(_body_writer.commit(s)));
     }
 }
 
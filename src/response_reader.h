@@ -5,6 +5,7 @@
 #include "generic_stream.h"
 #include "response_part.h"
 #include "util/cancel.h"
+#include "util/shared_bytes.h"
 #include "namespaces.h"
 #include "api.h"
 
@@ -73,6 +74,11 @@ public:
 
     GenericStream& stream() { return _in; }
 
+    // Data read from the stream but not parsed yet.
+    // Once the response is done, this is data past its end
+    // (e.g. the beginning of the next response on the same connection).
+    auto buffered_data() const { return _buffer.data(); }
+
     void restart()
     {
         // It is only valid to call restart() if we've finished reading
@@ -114,6 +120,9 @@ private:
 
     std::optional<Part> _next_part;
 
+    // Body data is read into buffers from the executor's pool (see `async_read_part`).
+    util::SharedBytesWriter _body_writer;
+
     bool _is_done;
 };
 
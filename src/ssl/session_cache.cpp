@@ -0,0 +1,172 @@
+#include "session_cache.h"
+
+#include <algorithm>
+#include <memory>
+
+namespace ouinet::ssl {
+
+using namespace std;
+
+// Indices of the cache in the `SSL_CTX` owning it,
+// and of the session key in each `SSL` using it.
+
+static void free_cache(void*, void* ptr, CRYPTO_EX_DATA*, int, long, void*)
+{
+    delete static_cast<SessionCache*>(ptr);
+}
+
+static void free_key(void*, void* ptr, CRYPTO_EX_DATA*, int, long, void*)
+{
+    delete static_cast<string*>(ptr);
+}
+
+static int cache_index()
+{
+    static const int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, free_cache);
+    return index;
+}
+
+static int key_index()
+{
+    static const int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, free_key);
+    return index;
+}
+
+SessionCache::SessionCache(size_t max_sessions, chrono::seconds lifetime)
+    : _max_sessions(max_sessions)
+    , _lifetime(lifetime)
+{}
+
+SessionCache::~SessionCache()
+{
+    for (auto& e : _entries) SSL_SESSION_free(e.session);
+}
+
+SessionCache&
+SessionCache::attach(asio::ssl::context& ctx, size_t max_sessions, chrono::seconds lifetime)
+{
+    auto native = ctx.native_handle();
+    auto cache = new SessionCache(max_sessions, lifetime);
+
+    // Freeing the previous cache is up to us.
+    delete find(native);
+    SSL_CTX_set_ex_data(native, cache_index(), cache);
+
+    // Sessions are only kept by us, since the internal cache of OpenSSL
+    // is not used for client sessions.
+    SSL_CTX_set_session_cache_mode( native
+                                  , SSL_SESS_CACHE_CLIENT
+                                  | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(native, on_new_session);
+
+    return *cache;
+}
+
+SessionCache*
+SessionCache::find(SSL_CTX* ctx)
+{
+    return static_cast<SessionCache*>(SSL_CTX_get_ex_data(ctx, cache_index()));
+}
+
+void
+SessionCache::prepare(SSL* ssl, const string& key)
+{
+    if (key.empty() || _max_sessions == 0) return;
+
+    // Owned by `ssl`, since sessions may be established after the handshake
+    // (e.g. TLS 1.3 tickets).
+    SSL_set_ex_data(ssl, key_index(), new string(key));
+
+    lock_guard<mutex> lock(_mutex);
+
+    auto i = _index.find(key);
+    if (i == _index.end()) return;
+
+    auto e = i->second;
+
+    if (e->expires <= Clock::now()) {
+        erase(e);
+        return;
+    }
+
+    SSL_set_session(ssl, e->session);
+
+    // TLS 1.3 tickets should not be used more than once,
+    // the server sends new ones after the handshake.
+    if (SSL_SESSION_get_protocol_version(e->session) >= TLS1_3_VERSION) {
+        erase(e);
+    }
+}
+
+void
+SessionCache::handshake_done(SSL* ssl)
+{
+    bool resumed = SSL_session_reused(ssl);
+    OnHandshake on_handshake;
+
+    {
+        lock_guard<mutex> lock(_mutex);
+        ++(resumed ? _stats.resumed_handshakes : _stats.full_handshakes);
+        on_handshake = _on_handshake;
+    }
+
+    if (on_handshake) on_handshake(resumed);
+}
+
+void
+SessionCache::on_handshake(OnHandshake f)
+{
+    lock_guard<mutex> lock(_mutex);
+    _on_handshake = std::move(f);
+}
+
+SessionCache::Stats
+SessionCache::stats() const
+{
+    lock_guard<mutex> lock(_mutex);
+    auto stats = _stats;
+    stats.sessions = _entries.size();
+    return stats;
+}
+
+int
+SessionCache::on_new_session(SSL* ssl, SSL_SESSION* session)
+{
+    auto cache = find(SSL_get_SSL_CTX(ssl));
+    auto key = static_cast<string*>(SSL_get_ex_data(ssl, key_index()));
+
+    if (!cache || !key) return 0;
+
+    // Returning 1 keeps the reference to `session`.
+    return cache->store(*key, session) ? 1 : 0;
+}
+
+bool
+SessionCache::store(const string& key, SSL_SESSION* session)
+{
+    if (!SSL_SESSION_is_resumable(session)) return false;
+
+    auto lifetime = min<chrono::seconds>( _lifetime
+                                        , chrono::seconds(SSL_SESSION_get_timeout(session)));
+
+    lock_guard<mutex> lock(_mutex);
+
+    if (auto i = _index.find(key); i != _index.end()) erase(i->second);
+
+    auto e = _entries.insert(_entries.end(), Entry{key, session, Clock::now() + lifetime});
+    _index.emplace(key, e);
+
+    while (_entries.size() > _max_sessions) erase(_entries.begin());
+
+    return true;
+}
+
+void
+SessionCache::erase(Entries::iterator e)
+{
+    SSL_SESSION_free(e->session);
+    _index.erase(e->key);
+    _entries.erase(e);
+}
+
+} // namespace
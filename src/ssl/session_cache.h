@@ -0,0 +1,98 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <openssl/ssl.h>
+#include <boost/asio/ssl/context.hpp>
+
+#include "../namespaces.h"
+#include "api.h"
+
+namespace ouinet::ssl {
+
+// Keeps TLS sessions established by a client context,
+// so that later connections to the same server can resume them
+// (with a session ID or ticket) instead of doing a full handshake.
+//
+// Sessions are kept under a key given for each connection
+// (usually the server host name or endpoint), up to `max_sessions`
+// (dropping the least recently stored ones) and for at most `lifetime`
+// (or less if the server says so).
+//
+// A cache is attached to a context with `attach` and owned by it.
+// `util::client_handshake` uses the cache attached to its context (if any).
+class OUINET_COMMON_API SessionCache {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stats {
+        uint64_t full_handshakes = 0;
+        uint64_t resumed_handshakes = 0;
+        size_t sessions = 0;
+    };
+
+    // Called after each successful handshake with whether it was resumed.
+    using OnHandshake = std::function<void(bool resumed)>;
+
+public:
+    // Attach a new cache to the given client context (replacing any previous one)
+    // and return it.  A zero `max_sessions` disables resumption.
+    static SessionCache& attach( asio::ssl::context&
+                               , size_t max_sessions
+                               , std::chrono::seconds lifetime);
+
+    // The cache attached to the given context, null if none.
+    static SessionCache* find(SSL_CTX*);
+
+    SessionCache(const SessionCache&) = delete;
+    SessionCache& operator=(const SessionCache&) = delete;
+
+    ~SessionCache();
+
+    // Prepare a connection before its handshake:
+    // offer a session stored under the given key, if any,
+    // and store sessions established by it under that key.
+    // An empty key disables both.
+    void prepare(SSL*, const std::string& key);
+
+    // Account for a successful handshake of a prepared connection.
+    void handshake_done(SSL*);
+
+    void on_handshake(OnHandshake);
+
+    Stats stats() const;
+
+private:
+    SessionCache(size_t max_sessions, std::chrono::seconds lifetime);
+
+    struct Entry {
+        std::string key;
+        SSL_SESSION* session;
+        Clock::time_point expires;
+    };
+
+    using Entries = std::list<Entry>;  // least recently stored first
+
+    static int on_new_session(SSL*, SSL_SESSION*);
+
+    bool store(const std::string& key, SSL_SESSION*);
+    void erase(Entries::iterator);
+
+private:
+    const size_t _max_sessions;
+    const std::chrono::seconds _lifetime;
+
+    mutable std::mutex _mutex;
+    Entries _entries;
+    std::unordered_map<std::string, Entries::iterator> _index;
+    Stats _stats;
+    OnHandshake _on_handshake;
+};
+
+} // namespace
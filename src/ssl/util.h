@@ -11,6 +11,7 @@
 
 #include "generic_stream.h"
 #include "or_throw.h"
+#include "session_cache.h"
 #include "util/ssl_stream.h"
 #include "util/async.h"
 #include "api.h"
@@ -51,12 +52,16 @@ static inline std::string read_bio(BIO* bio) {
 //
 // The verification is done for the given `host` name (if non-empty),
 // using SNI.  Verification against a valid CA is done in any case.
+//
+// If a `SessionCache` is attached to the context, a session stored
+// under `session_key` (if non-empty) is resumed, and new sessions are stored there.
 template<class Stream>
 static inline
 std::expected<ouinet::GenericStream, sys::error_code>
 client_handshake( Stream&& con
                 , boost::asio::ssl::context& ssl_context
                 , const std::string& host
+                , const std::string& session_key
                 , Async yield)
 {
     using namespace std;
@@ -78,14 +83,41 @@ client_handshake( Stream&& con
 
     if (ec) return std::unexpected(ec);
 
+    auto session_cache = SessionCache::find(ssl_context.native_handle());
+    if (session_cache) session_cache->prepare(ssl_sock->native_handle(), session_key);
+
     auto slot = yield.cancel_slot([&] { ssl_sock->next_layer().close(); });
     auto r = ssl_sock->async_handshake(ssl::stream_base::client, yield);
 
     if (!r) return std::unexpected(r.error());
 
+    if (session_cache) session_cache->handshake_done(ssl_sock->native_handle());
+
     return GenericStream(std::move(ssl_sock));
 }
 
+// As above, without resuming sessions.
+template<class Stream>
+static inline
+std::expected<ouinet::GenericStream, sys::error_code>
+client_handshake( Stream&& con
+                , boost::asio::ssl::context& ssl_context
+                , const std::string& host
+                , Async yield)
+{
+    return client_handshake( std::forward<Stream>(con), ssl_context
+                           , host, std::string(), yield);
+}
+
+// The key to store sessions with the origin at the given `host` and `port` under
+// (servers on different ports of the same host need not share sessions).
+static inline
+std::string
+origin_session_key(const std::string& host, const std::string& port)
+{
+    return host + ':' + port;
+}
+
 static inline
 boost::asio::ssl::context
 get_server_context( const std::string& cert_chain
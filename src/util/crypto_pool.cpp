@@ -0,0 +1,25 @@
+#include "crypto_pool.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace ouinet::util {
+
+CryptoPool::CryptoPool(unsigned threads)
+    : _threads(std::max(1u, threads))
+    , _pool(_threads)
+{
+}
+
+CryptoPool::~CryptoPool()
+{
+    _pool.join();
+}
+
+CryptoPool& CryptoPool::global()
+{
+    static CryptoPool pool(std::thread::hardware_concurrency());
+    return pool;
+}
+
+} // namespace ouinet::util
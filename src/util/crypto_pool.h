@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cassert>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+
+#include <boost/asio/any_completion_handler.hpp>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/thread_pool.hpp>
+
+#include "async.h"
+#include "../api.h"
+#include "../namespaces.h"
+
+namespace ouinet::util {
+
+// Runs CPU bound work (like hashing and signing data blocks)
+// on a pool of threads, so that it does not hold the coroutine doing I/O.
+//
+// Usage:
+//
+//     CryptoPool::Lane lane;
+//     auto job = lane.submit([data] { return sha512_digest(data); });
+//     ... // more I/O while the digest is computed
+//     auto digest = job.wait(yield);
+//
+// Work submitted to the same lane runs in submission order
+// and never concurrently, so it may use state which is shared among
+// the lane's work items and not touched elsewhere until they are done.
+class OUINET_COMMON_API CryptoPool {
+public:
+    template<class T> class Job;
+    class Lane;
+
+    explicit CryptoPool(unsigned threads);
+
+    CryptoPool(const CryptoPool&) = delete;
+    CryptoPool& operator=(const CryptoPool&) = delete;
+
+    // Waits for submitted work to finish.
+    ~CryptoPool();
+
+    unsigned threads() const { return _threads; }
+
+    // The pool shared by the whole process, with a thread per CPU core.
+    static CryptoPool& global();
+
+private:
+    const unsigned _threads;
+    asio::thread_pool _pool;
+};
+
+// The result of work submitted to a lane.
+template<class T>
+class CryptoPool::Job {
+public:
+    Job() = default;
+
+    // Whether there is a result to wait for.
+    bool valid() const { return bool(_state); }
+
+    // Wait for the work to be done and get its result,
+    // after which the job is no longer valid.
+    //
+    // The wait is not interrupted on cancellation,
+    // work items are expected to be short.
+    T wait(Async yield)
+    {
+        assert(_state);
+        auto state = std::move(_state);
+
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (state->result) return std::move(*state->result);
+        }
+
+        asio::async_initiate<Async, void(sys::error_code)>(
+            [state] (auto handler) {
+                std::unique_lock<std::mutex> lock(state->mutex);
+                if (!state->result) {
+                    state->handler = std::move(handler);
+                    return;
+                }
+                lock.unlock();
+                complete(std::move(handler));
+            },
+            yield);
+
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return std::move(*state->result);
+    }
+
+private:
+    friend class Lane;
+
+    using Handler = asio::any_completion_handler<void(sys::error_code)>;
+
+    struct State {
+        std::mutex mutex;
+        std::optional<T> result;
+        Handler handler;  // waiting for the result, if any
+    };
+
+    Job(std::shared_ptr<State> state) : _state(std::move(state)) {}
+
+    // Resume the waiter in its own executor.
+    static void complete(Handler handler)
+    {
+        auto exec = asio::get_associated_executor(handler);
+        asio::post(exec, [h = std::move(handler)] () mutable {
+            h(sys::error_code());
+        });
+    }
+
+    std::shared_ptr<State> _state;
+};
+
+// Runs submitted work in order, one item at a time.
+class CryptoPool::Lane {
+public:
+    explicit Lane(CryptoPool& pool = CryptoPool::global())
+        : _strand(asio::make_strand(pool._pool.get_executor()))
+    {}
+
+    // Run `f()` in the pool after previously submitted work.
+    template<class F>
+    Job<std::invoke_result_t<F&>> submit(F f)
+    {
+        using J = Job<std::invoke_result_t<F&>>;
+        auto state = std::make_shared<typename J::State>();
+
+        asio::post(_strand, [f = std::move(f), state] () mutable {
+            auto result = f();
+
+            typename J::Handler handler;
+            {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->result.emplace(std::move(result));
+                handler = std::move(state->handler);
+            }
+            if (handler) J::complete(std::move(handler));
+        });
+
+        return J(std::move(state));
+    }
+
+private:
+    asio::strand<asio::thread_pool::executor_type> _strand;
+};
+
+} // namespace ouinet::util
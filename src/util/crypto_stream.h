@@ -33,6 +33,7 @@ private:
     struct Shared {
         const EVP_CIPHER* cypher;
         BufferRx buffer_rx;
+        size_t buffer_rx_size = 0;  // from the last read
         BufferTx buffer_tx;
         CryptoStreamKey key;
         std::optional<Iv> encrypt_iv; // Lazily initialized
@@ -182,6 +183,7 @@ public:
                         return;
                     }
                     case decrypt: {
+                        shared->buffer_rx_size = n;
                         size_t to_decrypt = n;
 
                         for (auto outbuf_i = asio::buffer_sequence_begin(buffers);
@@ -218,6 +220,18 @@ public:
         return &_shared->stream;
     } 
 
+    // The encrypted data read from the inner stream
+    // for the last `size` bytes returned by the last read operation.
+    //
+    // This allows putting data which was read but not used back into the inner stream
+    // (e.g. when it belongs to another message following this one),
+    // after which this stream should not be read from anymore.
+    asio::const_buffer last_read_encrypted(size_t size) const {
+        assert(_shared && size <= _shared->buffer_rx_size);
+        auto end = _shared->buffer_rx.data() + _shared->buffer_rx_size;
+        return asio::buffer(end - size, size);
+    }
+
 private:
     executor_type _executor;
     std::shared_ptr<Shared> _shared;
@@ -54,6 +54,7 @@ OUINET_COMMON_API
 std::expected<size_t, sys::error_code>
 file_remaining_size(async_file_handle&);
 
+// The position is left at the new end of the file.
 OUINET_COMMON_API
 [[nodiscard]]
 std::expected<void, sys::error_code>
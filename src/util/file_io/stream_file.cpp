@@ -84,11 +84,10 @@ truncate(async_file_handle& f, size_t new_length)
 {
     sys::error_code ec;
     f.resize(new_length);
-    // Move to cursor to the end only when the previous position was in the truncated area
-    if (new_length < f.seek(0, async_file_handle::seek_basis::seek_cur, ec))
-        f.seek(static_cast<int64_t>(new_length),
-               async_file_handle::seek_set,
-               ec);
+    // Leave the cursor at the new end, like the POSIX implementation.
+    f.seek(static_cast<int64_t>(new_length),
+           async_file_handle::seek_set,
+           ec);
     if (ec) return std::unexpected(ec);
     return {};
 }
@@ -0,0 +1,324 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/execution/context.hpp>
+#include <boost/asio/execution_context.hpp>
+#include <boost/asio/query.hpp>
+
+namespace ouinet::util {
+
+class BytePool;
+
+namespace detail {
+
+// The storage behind `SharedBytes`, with an intrusive reference count
+// so that sharing it needs no allocations.
+struct ByteSlab {
+    std::atomic<std::size_t> refs{0};
+    std::vector<uint8_t> data;
+    // The pool to return the slab to once unused, if any.
+    std::shared_ptr<BytePool> pool;
+
+    static void release(ByteSlab*) noexcept;  // see below
+};
+
+} // namespace detail
+
+// An immutable sequence of bytes whose storage is shared among its copies.
+//
+// Copying it just increments a reference count,
+// so the same data may be forwarded to several consumers
+// (e.g. the user agent and the cache)
+// without allocating or copying it for each of them.
+//
+// The bytes may be just a part of their storage
+// (see `slice` and `SharedBytesWriter`).
+class SharedBytes {
+public:
+    using value_type = uint8_t;
+    using const_iterator = const uint8_t*;
+    using iterator = const_iterator;
+
+    SharedBytes() = default;
+
+    // Take ownership of the given data, no bytes are copied.
+    SharedBytes(std::vector<uint8_t> data)
+    {
+        if (data.empty()) return;
+        _size = data.size();
+        _slab = new detail::ByteSlab;
+        _slab->data = std::move(data);
+        ++_slab->refs;
+    }
+
+    SharedBytes(std::initializer_list<uint8_t> data)
+        : SharedBytes(std::vector<uint8_t>(data))
+    {}
+
+    SharedBytes(const SharedBytes& other)
+        : _slab(other._slab), _offset(other._offset), _size(other._size)
+    {
+        if (_slab) ++_slab->refs;
+    }
+
+    SharedBytes(SharedBytes&& other) noexcept
+        : _slab(std::exchange(other._slab, nullptr))
+        , _offset(std::exchange(other._offset, 0))
+        , _size(std::exchange(other._size, 0))
+    {}
+
+    SharedBytes& operator=(const SharedBytes& other) {
+        SharedBytes(other).swap(*this);
+        return *this;
+    }
+
+    SharedBytes& operator=(SharedBytes&& other) noexcept {
+        SharedBytes(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    ~SharedBytes() {
+        if (_slab) detail::ByteSlab::release(_slab);
+    }
+
+    void swap(SharedBytes& other) noexcept {
+        std::swap(_slab, other._slab);
+        std::swap(_offset, other._offset);
+        std::swap(_size, other._size);
+    }
+
+    const uint8_t* data() const { return _slab ? _slab->data.data() + _offset : nullptr; }
+    std::size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    const_iterator begin() const { return data(); }
+    const_iterator end() const { return data() + size(); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    uint8_t operator[](std::size_t i) const { return data()[i]; }
+
+    boost::asio::const_buffer buffer() const { return {data(), size()}; }
+
+    // Get `size` bytes starting at `offset`, sharing their storage.
+    SharedBytes slice(std::size_t offset, std::size_t size) const {
+        assert(offset + size <= _size);
+        if (size == 0) return {};
+        return SharedBytes(_slab, _offset + offset, size);
+    }
+
+    bool operator==(const SharedBytes& other) const {
+        return std::equal(begin(), end(), other.begin(), other.end());
+    }
+
+private:
+    friend class SharedBytesWriter;
+
+    SharedBytes(detail::ByteSlab* slab, std::size_t offset, std::size_t size)
+        : _slab(slab), _offset(offset), _size(size)
+    {
+        ++_slab->refs;
+    }
+
+private:
+    detail::ByteSlab* _slab = nullptr;
+    std::size_t _offset = 0;
+    std::size_t _size = 0;
+};
+
+// Keeps storage of unused `SharedBytes` (in slabs of a fixed size)
+// for reuse, so that streaming data needs no allocations once warm.
+//
+// At most `max_free` unused slabs are kept.
+// The pool may be used from several threads,
+// and it must be owned by a `std::shared_ptr`.
+class BytePool : public std::enable_shared_from_this<BytePool> {
+public:
+    // The size of a signed data block (`http_::response_data_block`).
+    static constexpr std::size_t default_slab_size = 65536;
+    static constexpr std::size_t default_max_free = 64;
+
+    BytePool( std::size_t slab_size = default_slab_size
+            , std::size_t max_free = default_max_free)
+        : _slab_size(slab_size)
+        , _max_free(max_free)
+    {
+        _free.reserve(_max_free);
+    }
+
+    BytePool(const BytePool&) = delete;
+    BytePool& operator=(const BytePool&) = delete;
+
+    ~BytePool() {
+        for (auto slab : _free) delete slab;
+    }
+
+    std::size_t slab_size() const { return _slab_size; }
+
+    // Number of unused slabs currently kept.
+    std::size_t free_slabs() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _free.size();
+    }
+
+    // The pool shared by all users of the execution context of `exec`.
+    template<class Executor>
+    static std::shared_ptr<BytePool> get(const Executor& exec) {
+        auto& ctx = boost::asio::query(exec, boost::asio::execution::context);
+        return boost::asio::use_service<Service>(ctx).pool;
+    }
+
+private:
+    friend struct detail::ByteSlab;
+    friend class SharedBytesWriter;
+
+    class Service : public boost::asio::execution_context::service {
+    public:
+        static inline boost::asio::execution_context::id id;
+
+        explicit Service(boost::asio::execution_context& ctx)
+            : boost::asio::execution_context::service(ctx)
+            , pool(std::make_shared<BytePool>())
+        {}
+
+        void shutdown() override {}
+
+        const std::shared_ptr<BytePool> pool;
+    };
+
+    // Get an unused slab with a single reference.
+    detail::ByteSlab* acquire() {
+        detail::ByteSlab* slab = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_free.empty()) {
+                slab = _free.back();
+                _free.pop_back();
+            }
+        }
+        if (!slab) {
+            slab = new detail::ByteSlab;
+            slab->data.resize(_slab_size);
+        }
+        // Free slabs do not keep the pool alive.
+        slab->pool = shared_from_this();
+        slab->refs = 1;
+        return slab;
+    }
+
+    void recycle(detail::ByteSlab* slab) noexcept {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_free.size() < _max_free) {
+                _free.push_back(slab);
+                return;
+            }
+        }
+        delete slab;
+    }
+
+private:
+    const std::size_t _slab_size;
+    const std::size_t _max_free;
+    mutable std::mutex _mutex;
+    std::vector<detail::ByteSlab*> _free;
+};
+
+inline
+void detail::ByteSlab::release(ByteSlab* slab) noexcept {
+    if (slab->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    if (auto pool = std::move(slab->pool)) {
+        pool->recycle(slab);
+    } else {
+        delete slab;
+    }
+}
+
+// Produces `SharedBytes` by writing data into slabs from a pool,
+// several of them possibly sharing the same slab.
+//
+// Usage: write (up to) `n` bytes into the buffer returned by `prepare(n)`,
+// then get the first `m` bytes written as `SharedBytes` with `commit(m)`.
+//
+// Without a pool, or for data not fitting in a slab,
+// storage is allocated as needed.
+class SharedBytesWriter {
+public:
+    SharedBytesWriter() = default;
+
+    explicit SharedBytesWriter(std::shared_ptr<BytePool> pool)
+        : _pool(std::move(pool))
+    {}
+
+    SharedBytesWriter(SharedBytesWriter&& other) noexcept
+        : _pool(std::move(other._pool))
+        , _slab(std::exchange(other._slab, nullptr))
+        , _offset(std::exchange(other._offset, 0))
+    {}
+
+    SharedBytesWriter& operator=(SharedBytesWriter&& other) noexcept {
+        reset();
+        _pool = std::move(other._pool);
+        _slab = std::exchange(other._slab, nullptr);
+        _offset = std::exchange(other._offset, 0);
+        return *this;
+    }
+
+    ~SharedBytesWriter() { reset(); }
+
+    const std::shared_ptr<BytePool>& pool() const { return _pool; }
+
+    boost::asio::mutable_buffer prepare(std::size_t n) {
+        if (!_slab || _slab->data.size() - _offset < n) {
+            reset();
+            if (_pool && n <= _pool->slab_size()) {
+                _slab = _pool->acquire();
+            } else {
+                _slab = new detail::ByteSlab;
+                _slab->data.resize(n);
+                _slab->refs = 1;
+            }
+        }
+        return {_slab->data.data() + _offset, n};
+    }
+
+    SharedBytes commit(std::size_t n) {
+        if (n == 0) return {};
+        assert(_slab && _offset + n <= _slab->data.size());
+        SharedBytes ret(_slab, _offset, n);
+        _offset += n;
+        return ret;
+    }
+
+    // Copy the given data into `SharedBytes`.
+    SharedBytes copy(boost::asio::const_buffer data) {
+        auto buf = prepare(data.size());
+        if (data.size() > 0) std::memcpy(buf.data(), data.data(), data.size());
+        return commit(data.size());
+    }
+
+private:
+    void reset() {
+        if (!_slab) return;
+        detail::ByteSlab::release(std::exchange(_slab, nullptr));
+        _offset = 0;
+    }
+
+private:
+    std::shared_ptr<BytePool> _pool;
+    detail::ByteSlab* _slab = nullptr;  // referenced by the writer itself
+    std::size_t _offset = 0;
+};
+
+} // namespace ouinet::util
@@ -59,6 +59,7 @@ struct StoringReader::Impl : std::enable_shared_from_this<Impl> {
             return part;
         }
     
+        // Body data is shared with the copy pushed to the cache, not copied.
         std::ignore = queue.async_push(*part, yield);
 
         if (!*part) {
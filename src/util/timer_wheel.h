@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace ouinet::util {
+
+// A hashed timer wheel (Varghese & Lauck): each value is put in the slot of
+// the tick it is scheduled for, so scheduling and expiring values does not
+// depend on how many of them there are.  Values scheduled further away than
+// one turn of the wheel stay in their slot for as many turns as needed.
+//
+// Values never expire before their time, and at most one tick after it.
+template<class T, class Clock = std::chrono::steady_clock>
+class TimerWheel {
+public:
+    using TimePoint = typename Clock::time_point;
+    using Duration = typename Clock::duration;
+
+    TimerWheel(Duration tick, size_t slot_count, TimePoint start = Clock::now())
+        : _tick(tick)
+        , _start(start)
+        , _slots(std::max<size_t>(slot_count, 1))
+    {}
+
+    void schedule(TimePoint at, T value)
+    {
+        auto tick = tick_after(at);
+        ++_size;
+
+        if (tick <= _now) {
+            _due.push_back(std::move(value));
+            return;
+        }
+
+        _slots[tick % _slots.size()].push_back({tick, std::move(value)});
+    }
+
+    // Moves the values due at `now` (or before) to `out`.
+    void expire(TimePoint now, std::vector<T>& out)
+    {
+        _size -= _due.size();
+        for (auto& v : _due) out.push_back(std::move(v));
+        _due.clear();
+
+        if (now < _start) return;
+
+        uint64_t target = (now - _start) / _tick;
+        if (target <= _now) return;
+
+        // No need to go through a slot more than once.
+        auto last = std::min<uint64_t>(target, _now + _slots.size());
+
+        for (auto t = _now + 1; t <= last; ++t) {
+            auto& slot = _slots[t % _slots.size()];
+
+            for (size_t i = 0; i < slot.size();) {
+                if (slot[i].tick > target) { ++i; continue; }
+                out.push_back(std::move(slot[i].value));
+                slot[i] = std::move(slot.back());
+                slot.pop_back();
+                --_size;
+            }
+        }
+
+        _now = target;
+    }
+
+    // When the earliest of the scheduled values becomes due.
+    std::optional<TimePoint> next_expiry() const
+    {
+        if (_size == 0) return std::nullopt;
+        if (!_due.empty()) return time_of(_now);
+
+        for (auto t = _now + 1; t <= _now + _slots.size(); ++t) {
+            for (auto& i : _slots[t % _slots.size()]) {
+                if (i.tick == t) return time_of(t);
+            }
+        }
+
+        // Nothing within this turn of the wheel.
+        auto min = UINT64_MAX;
+        for (auto& slot : _slots) {
+            for (auto& i : slot) min = std::min(min, i.tick);
+        }
+        return time_of(min);
+    }
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+private:
+    struct Item {
+        uint64_t tick;
+        T value;
+    };
+
+    uint64_t tick_after(TimePoint at) const
+    {
+        if (at <= _start) return 0;
+        return (at - _start + _tick - Duration(1)) / _tick;
+    }
+
+    TimePoint time_of(uint64_t tick) const
+    {
+        return _start + _tick * tick;
+    }
+
+private:
+    Duration _tick;
+    TimePoint _start;
+    // Values up to this tick have already expired.
+    uint64_t _now = 0;
+    std::vector<std::vector<Item>> _slots;
+    // Values which were due when scheduled.
+    std::vector<T> _due;
+    size_t _size = 0;
+};
+
+} // namespace ouinet::util
@@ -1,5 +1,11 @@
 #pragma once
 
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
 namespace ouinet { namespace util {
 
 /*
@@ -7,73 +13,178 @@ namespace ouinet { namespace util {
  * copy-constructible, but only move constructible. Convenient for storing
  * asio handlers, which are not necessarily copy constructible.
  *
+ * Callables of up to `InlineSize` bytes are stored in place
+ * (so that wrapping them does not allocate),
+ * bigger ones are allocated on the heap
+ * (with the given allocator, if any).
+ *
  * Does not have all the bells and whistles of std::function.
  * Feel free to add them.
  *
- * Shamelessly based on:
- * https://stackoverflow.com/questions/28179817/how-can-i-store-generic-packaged-tasks-in-a-container
- *
  * TODO: C++23 has `non_copyable_function` with which we could replace this one.
  */
 
-template<class T> class unique_function;
+template<class T, std::size_t InlineSize = 4 * sizeof(void*)> class unique_function;
 
-// TODO: Small object allocator optimization
-template<class Result, class... Args>
-class unique_function<Result(Args...)> {
+template<class Result, class... Args, std::size_t InlineSize>
+class unique_function<Result(Args...), InlineSize> {
     public:
     unique_function() {}
 
     unique_function(std::nullptr_t) {}
     unique_function& operator=(std::nullptr_t)
     {
-        _impl = nullptr;
+        reset();
         return *this;
     }
 
     unique_function(const unique_function&) = delete;
     unique_function& operator=(const unique_function&) = delete;
 
-    unique_function(unique_function&&) = default;
-    unique_function& operator=(unique_function&&) = default;
+    unique_function(unique_function&& other) noexcept
+    {
+        take(other);
+    }
+
+    unique_function& operator=(unique_function&& other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            take(other);
+        }
+        return *this;
+    }
 
     template<class F>
-    unique_function(F&& f):
-        _impl(std::make_unique<impl<F>>( std::forward<F>(f) ))
+    requires (!std::is_same_v<std::decay_t<F>, unique_function>)
+    unique_function(F&& f)
+        : unique_function(std::allocator_arg, std::allocator<void>(), std::forward<F>(f))
     {}
 
+    template<class Alloc, class F>
+    requires (!std::is_same_v<std::decay_t<F>, unique_function>)
+    unique_function(std::allocator_arg_t, const Alloc& alloc, F&& f)
+    {
+        using D = std::decay_t<F>;
+
+        if constexpr (is_inline<D>) {
+            ::new (static_cast<void*>(&_storage)) D(std::forward<F>(f));
+        } else {
+            using Box = boxed<D, Alloc>;
+            using Traits = typename box_traits<D, Alloc>::traits;
+            typename box_traits<D, Alloc>::allocator a(alloc);
+            Box* box = Traits::allocate(a, 1);
+            try {
+                Traits::construct(a, box, std::forward<F>(f), alloc);
+            } catch (...) {
+                Traits::deallocate(a, box, 1);
+                throw;
+            }
+            ::new (static_cast<void*>(&_storage)) Box*(box);
+        }
+        _vtable = &vtable_for<D, Alloc>;
+    }
+
+    ~unique_function()
+    {
+        reset();
+    }
+
     operator bool() const
     {
-        return (bool)_impl;
+        return _vtable != nullptr;
     }
 
     Result operator()(Args... args)
     {
-        return _impl->invoke(std::forward<Args>(args)...);
+        return _vtable->invoke(&_storage, std::forward<Args>(args)...);
     }
 
     private:
-    struct impl_base {
-        virtual ~impl_base() {}
-        virtual Result invoke(Args&&... args) = 0;
+    template<class F>
+    static constexpr bool is_inline
+        =  sizeof(F) <= InlineSize
+        && alignof(F) <= alignof(std::max_align_t)
+        && std::is_nothrow_move_constructible_v<F>;
+
+    struct vtable {
+        Result (*invoke)(void*, Args&&...);
+        // Move the callable to uninitialized storage and destroy the source.
+        void (*relocate)(void* from, void* to) noexcept;
+        void (*destroy)(void*) noexcept;
     };
 
-    template<class F>
-    struct impl : public impl_base {
-        F _f;
+    // A callable allocated on the heap, along with its allocator.
+    template<class F, class Alloc>
+    struct boxed {
+        template<class G>
+        boxed(G&& g, const Alloc& a) : f(std::forward<G>(g)), alloc(a) {}
+
+        F f;
+        Alloc alloc;
+    };
+
+    template<class F, class Alloc>
+    struct box_traits {
+        using allocator = typename std::allocator_traits<Alloc>
+            ::template rebind_alloc<boxed<F, Alloc>>;
+        using traits = std::allocator_traits<allocator>;
+    };
 
-        impl(F&& f):
-            _f(std::move(f))
-        {}
+    template<class F, class Alloc>
+    static F& get(void* s)
+    {
+        if constexpr (is_inline<F>) {
+            return *std::launder(static_cast<F*>(s));
+        } else {
+            return (*std::launder(static_cast<boxed<F, Alloc>**>(s)))->f;
+        }
+    }
 
-        Result invoke(Args&&... args) override
-        {
-            return _f(std::forward<Args>(args)...);
+    template<class F, class Alloc>
+    static constexpr vtable vtable_for = {
+        [] (void* s, Args&&... args) -> Result {
+            return get<F, Alloc>(s)(std::forward<Args>(args)...);
+        },
+        [] (void* from, void* to) noexcept {
+            if constexpr (is_inline<F>) {
+                auto& f = get<F, Alloc>(from);
+                ::new (to) F(std::move(f));
+                f.~F();
+            } else {
+                using Box = boxed<F, Alloc>;
+                ::new (to) Box*(*static_cast<Box**>(from));
+            }
+        },
+        [] (void* s) noexcept {
+            if constexpr (is_inline<F>) {
+                get<F, Alloc>(s).~F();
+            } else {
+                using Traits = typename box_traits<F, Alloc>::traits;
+                auto box = *static_cast<boxed<F, Alloc>**>(s);
+                typename box_traits<F, Alloc>::allocator a(box->alloc);
+                Traits::destroy(a, box);
+                Traits::deallocate(a, box, 1);
+            }
         }
     };
 
+    void take(unique_function& other) noexcept
+    {
+        if (!other._vtable) return;
+        other._vtable->relocate(&other._storage, &_storage);
+        _vtable = std::exchange(other._vtable, nullptr);
+    }
+
+    void reset() noexcept
+    {
+        if (!_vtable) return;
+        std::exchange(_vtable, nullptr)->destroy(&_storage);
+    }
+
     private:
-    std::unique_ptr<impl_base> _impl;
+    alignas(std::max_align_t) unsigned char _storage[InlineSize < sizeof(void*) ? sizeof(void*) : InlineSize];
+    const vtable* _vtable = nullptr;
 };
 
 }} // namespaces
@@ -0,0 +1,230 @@
+// Compares the cost of dispatching received DHT messages (KRPC)
+// by their `y` and `t` keys when decoding each one into a `BencodedValue`
+// (with the previous decoder, which worked on a copy of the message,
+// and with the current one) and when only parsing a `BencodedView`.
+//
+// The messages are a mix of queries, replies and errors
+// similar to those received by a public DHT node.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <vector>
+
+#include "bittorrent/bencoding.h"
+#include "parse/number.h"
+
+using namespace std;
+using namespace ouinet::bittorrent;
+
+static size_t allocations = 0;
+
+void* operator new(size_t size)
+{
+    ++allocations;
+    if (auto p = malloc(size)) return p;
+    throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// The decoder as it was before `BencodedView`.
+namespace previous {
+
+static boost::optional<int64_t> parse_int(string& encoded)
+{
+    boost::string_view sw = encoded;
+    auto opt_num = ouinet::parse::number<int64_t>(sw);
+    if (!opt_num) return boost::none;
+    encoded.erase(0, encoded.size() - sw.size());
+    return opt_num;
+}
+
+static boost::optional<string> parse_string(string& encoded)
+{
+    auto size = parse_int(encoded);
+    if (!size || encoded[0] != ':') return boost::none;
+    encoded.erase(0, 1);
+    if (encoded.size() < size_t(*size) || *size > length_limit) return boost::none;
+    string value = encoded.substr(0, *size);
+    encoded.erase(0, *size);
+    return value;
+}
+
+static boost::optional<BencodedValue> parse_value(string& encoded, uint8_t depth)
+{
+    if (encoded.size() == 0 || depth > depth_limit) return boost::none;
+
+    if (encoded[0] == 'i') {
+        encoded.erase(0, 1);
+        auto value = parse_int(encoded);
+        if (!value || encoded.size() == 0 || encoded[0] != 'e') return boost::none;
+        encoded.erase(0, 1);
+        return BencodedValue(*value);
+    } else if ('0' <= encoded[0] && encoded[0] <= '9') {
+        auto value = parse_string(encoded);
+        if (!value) return boost::none;
+        return BencodedValue(std::move(*value));
+    } else if (encoded[0] == 'l') {
+        encoded.erase(0, 1);
+        BencodedList output;
+        while (encoded.size() > 0 && encoded[0] != 'e') {
+            auto value = parse_value(encoded, depth + 1);
+            if (!value) return boost::none;
+            output.push_back(std::move(*value));
+        }
+        if (encoded.size() == 0) return boost::none;
+        encoded.erase(0, 1);
+        return BencodedValue(output);
+    } else if (encoded[0] == 'd') {
+        encoded.erase(0, 1);
+        BencodedMap output;
+        while (encoded.size() > 0 && encoded[0] != 'e') {
+            auto key = parse_string(encoded);
+            if (!key) return boost::none;
+            auto value = parse_value(encoded, depth + 1);
+            if (!value) return boost::none;
+            output[std::move(*key)] = std::move(*value);
+        }
+        if (encoded.size() == 0) return boost::none;
+        encoded.erase(0, 1);
+        return BencodedValue(output);
+    }
+    return boost::none;
+}
+
+static boost::optional<BencodedValue> decode(boost::string_view encoded)
+{
+    auto encoded_s = string(encoded);
+    return parse_value(encoded_s, 1);
+}
+
+} // namespace previous
+
+static vector<string> krpc_traffic(size_t count)
+{
+    mt19937 rng(42);
+
+    auto bytes = [&] (size_t n) {
+        string s(n, '\0');
+        for (auto& c : s) c = char(rng());
+        return s;
+    };
+
+    vector<string> ret;
+
+    for (size_t i = 0; i < count; ++i) {
+        BencodedMap msg{{"t", bytes(2)}, {"v", "LT\x01\x02"}};
+
+        switch (i % 6) {
+            case 0: // ping
+                msg["y"] = "q"; msg["q"] = "ping";
+                msg["a"] = BencodedMap{{"id", bytes(20)}};
+                break;
+            case 1: // get_peers
+                msg["y"] = "q"; msg["q"] = "get_peers";
+                msg["a"] = BencodedMap{{"id", bytes(20)}, {"info_hash", bytes(20)}};
+                break;
+            case 2: // announce_peer
+                msg["y"] = "q"; msg["q"] = "announce_peer";
+                msg["a"] = BencodedMap{ {"id", bytes(20)}, {"info_hash", bytes(20)}
+                                      , {"port", 6881}, {"token", bytes(8)}
+                                      , {"implied_port", 1}};
+                break;
+            case 3: // find_node reply
+                msg["y"] = "r"; msg["ip"] = bytes(6);
+                msg["r"] = BencodedMap{{"id", bytes(20)}, {"nodes", bytes(8 * 26)}};
+                break;
+            case 4: { // get_peers reply with peers
+                BencodedList values;
+                for (int j = 0; j < 8; ++j) values.push_back(bytes(6));
+                msg["y"] = "r"; msg["ip"] = bytes(6);
+                msg["r"] = BencodedMap{ {"id", bytes(20)}, {"token", bytes(8)}
+                                      , {"nodes", bytes(8 * 26)}, {"values", values}};
+                break;
+            }
+            default: // error
+                msg["y"] = "e";
+                msg["e"] = BencodedList{203, "Protocol Error"};
+                break;
+        }
+
+        ret.push_back(bencoding_encode(msg));
+    }
+
+    return ret;
+}
+
+struct Result {
+    double ns_per_message;
+    double allocations_per_message;
+};
+
+template<class Dispatch>
+static Result run(const char* name, const vector<string>& traffic, Dispatch dispatch)
+{
+    static const size_t rounds = 50;
+
+    size_t queries = 0;
+    auto allocs_before = allocations;
+    auto start = chrono::steady_clock::now();
+
+    for (size_t r = 0; r < rounds; ++r) {
+        for (auto& msg : traffic) {
+            if (dispatch(boost::string_view(msg))) ++queries;
+        }
+    }
+
+    auto took = chrono::steady_clock::now() - start;
+    auto count = double(rounds * traffic.size());
+
+    if (queries != rounds * (traffic.size() / 2)) {
+        cerr << name << ": unexpected number of queries" << endl;
+        abort();
+    }
+
+    Result result{ chrono::duration<double, nano>(took).count() / count
+                 , (allocations - allocs_before) / count };
+
+    cout << name << ": " << result.ns_per_message << " ns/message, "
+         << result.allocations_per_message << " allocations/message" << endl;
+
+    return result;
+}
+
+// Whether the message is a query (with a transaction ID).
+static bool is_query(const BencodedValue& v)
+{
+    auto map = v.as_map();
+    if (!map || !map->count("t")) return false;
+    auto y = map->find("y");
+    return y != map->end() && y->second == "q";
+}
+
+int main()
+{
+    auto traffic = krpc_traffic(6000);
+
+    run("previous decoder", traffic, [] (boost::string_view msg) {
+        auto v = previous::decode(msg);
+        return v && is_query(*v);
+    });
+
+    run("bencoding_decode", traffic, [] (boost::string_view msg) {
+        auto v = bencoding_decode(msg);
+        return v && is_query(*v);
+    });
+
+    auto view = run("BencodedView", traffic, [] (boost::string_view msg) {
+        auto v = BencodedView::parse(msg);
+        if (!v || !v->find("t")) return false;
+        auto y = v->find("y");
+        return y && y->as_string_view() == boost::string_view("q");
+    });
+
+    // Dispatching should not need to allocate.
+    return view.allocations_per_message == 0 ? 0 : 1;
+}
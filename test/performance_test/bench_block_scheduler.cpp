@@ -0,0 +1,128 @@
+// Simulates fetching a response from peers with different latencies
+// using `BlockScheduler` with different windows,
+// and reports the resulting throughput.
+//
+// Each peer takes a fixed time to send each block,
+// plus a round trip for each request,
+// and handles up to its pipeline depth of requests in flight.
+// A window of 2 with no pipelining roughly matches the previous behaviour
+// of prefetching one block ahead.
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "cache/block_scheduler.h"
+
+using namespace std;
+using namespace std::chrono_literals;
+using namespace ouinet::cache;
+
+struct Peer;
+using Scheduler = BlockScheduler<Peer>;
+using Clock = Scheduler::Clock;
+
+struct Peer {
+    chrono::milliseconds block_time;
+    chrono::milliseconds round_trip = 0ms;
+    size_t pipeline_depth = 1;
+    // Blocks which take much longer than usual to arrive.
+    map<size_t, chrono::milliseconds> stalls = {};
+    // When the peer is done sending the blocks requested so far.
+    Clock::time_point busy_until = {};
+};
+
+static const size_t block_count = 256;
+static const size_t block_size = 64 * 1024;
+
+// Returns the time taken to deliver all blocks.
+static Clock::duration simulate(vector<Peer>& peers, size_t window)
+{
+    Scheduler scheduler(0, block_count, window);
+    for (auto& p : peers) {
+        scheduler.add_peer(&p, [] (size_t) { return true; }, p.pipeline_depth);
+    }
+
+    auto start = Clock::now();
+    auto now = start;
+
+    multimap<Clock::time_point, Scheduler::Assignment> arrivals;
+
+    auto schedule = [&] {
+        for (auto a : scheduler.schedule(now)) {
+            auto& p = *a.peer;
+            auto stall = p.stalls.find(a.block_id);
+            auto took = stall != p.stalls.end() ? stall->second : p.block_time;
+            // Blocks are sent one after the other, once their request arrives.
+            p.busy_until = max(now + p.round_trip, p.busy_until) + took;
+            arrivals.emplace(p.busy_until, a);
+        }
+    };
+
+    schedule();
+
+    size_t next_block = 0;
+    while (next_block < block_count) {
+        if (arrivals.empty()) {
+            cerr << "No requests in flight" << endl;
+            abort();
+        }
+
+        auto arrival = arrivals.begin();
+        now = arrival->first;
+        scheduler.received(arrival->second.peer, arrival->second.block_id, now);
+        arrivals.erase(arrival);
+
+        while (next_block < block_count && scheduler.is_received(next_block)) {
+            scheduler.delivered(next_block++);
+        }
+
+        schedule();
+    }
+
+    return now - start;
+}
+
+static double run(const char* name, vector<Peer> peers, size_t window)
+{
+    auto took = simulate(peers, window);
+    auto secs = chrono::duration<double>(took).count();
+    auto kib_s = block_count * block_size / 1024 / secs;
+    cout << name << ", window " << window << ": "
+         << secs << " s (" << kib_s << " KiB/s)" << endl;
+    return kib_s;
+}
+
+int main()
+{
+    vector<Peer> peers{{30ms}, {60ms}, {120ms}, {250ms}};
+
+    vector<Peer> stalling_peers = peers;
+    stalling_peers[0].stalls = {{10, 10s}, {100, 10s}};
+
+    bool ok = true;
+
+    // A single peer over a high-latency link (e.g. I2P).
+    {
+        auto name = "1 peer, 400 ms round trip";
+        auto lockstep = run(name, {{20ms, 400ms}}, 16);
+        auto pipelined = run((name + ", pipelined"s).c_str(), {{20ms, 400ms, 4}}, 16);
+        // Sending requests ahead should pay off.
+        if (pipelined < 2 * lockstep) ok = false;
+    }
+
+    for (auto* scenario : {&peers, &stalling_peers}) {
+        auto name = scenario == &peers ? "4 peers" : "4 peers, one stalling";
+        double single = 0, widest = 0;
+        for (size_t window : {1, 2, 4, 8, 16}) {
+            auto kib_s = run(name, *scenario, window);
+            if (window == 1) single = kib_s;
+            widest = kib_s;
+        }
+        // Fetching from several peers at once should pay off.
+        if (widest < 1.5 * single) ok = false;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+// Counts heap allocations per MiB of response body data
+// read and forwarded to both the user agent and the cache,
+// with a fresh vector per part (as body parts used to be)
+// and with pooled shared buffers.
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+
+#include "response_part.h"
+#include "util/shared_bytes.h"
+
+using namespace std;
+using namespace ouinet;
+
+static size_t allocations = 0;
+
+void* operator new(size_t size)
+{
+    ++allocations;
+    if (auto p = malloc(size)) return p;
+    throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static const size_t read_size = 16384;  // as `http_response::Reader`
+static const size_t total_size = 64 * 1024 * 1024;
+static const size_t mib = 1024 * 1024;
+
+struct VectorBody : vector<uint8_t> {
+    using vector<uint8_t>::vector;
+};
+
+// Returns the number of allocations done.
+template<class ReadPart>
+static size_t stream(ReadPart read_part)
+{
+    vector<uint8_t> input(read_size, 'x');
+    size_t forwarded = 0, stored = 0;
+
+    auto before = allocations;
+    for (size_t done = 0; done < total_size; done += read_size) {
+        auto part = read_part(input);
+        auto store_part = part;  // a copy is queued for the cache
+        forwarded += part.size();
+        stored += store_part.size();
+    }
+    if (forwarded != total_size || stored != total_size) abort();
+    return allocations - before;
+}
+
+static void report(const char* name, size_t allocs)
+{
+    cout << name << ": " << (double(allocs) / (total_size / mib))
+         << " allocations/MiB" << endl;
+}
+
+int main()
+{
+    asio::io_context ctx;
+
+    auto vector_allocs = stream([] (const vector<uint8_t>& in) {
+        return VectorBody(in.begin(), in.end());
+    });
+    report("vector per part", vector_allocs);
+
+    util::SharedBytesWriter writer(util::BytePool::get(ctx.get_executor()));
+    auto read_pooled = [&] (const vector<uint8_t>& in) {
+        return http_response::Body(writer.copy(asio::buffer(in)));
+    };
+
+    // Let the pool warm up.
+    stream(read_pooled);
+
+    auto pooled_allocs = stream(read_pooled);
+    report("pooled shared buffers", pooled_allocs);
+
+    // Steady-state streaming should not allocate at all.
+    return pooled_allocs == 0 ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+// Measures the throughput of `full_duplex` forwarding over loopback,
+// between plain TCP sockets (spliced on Linux)
+// and between streams which need buffered forwarding.
+
+#include <chrono>
+#include <iostream>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+#include "full_duplex_forward.h"
+#include "generic_stream.h"
+#include "task.h"
+
+using namespace std;
+using namespace ouinet;
+
+using tcp = asio::ip::tcp;
+using Clock = chrono::steady_clock;
+
+static const size_t total_size = 1024 * 1024 * 1024;
+static const size_t write_size = 1024 * 1024;
+
+// A TCP socket that `full_duplex` does not recognize as such.
+struct OpaqueSocket {
+    using executor_type = tcp::socket::executor_type;
+
+    tcp::socket socket;
+
+    executor_type get_executor() { return socket.get_executor(); }
+    bool is_open() const { return socket.is_open(); }
+    void close() { sys::error_code ec; socket.close(ec); }
+
+    template<class Buffers, class Token>
+    auto async_read_some(const Buffers& bs, Token&& t)
+    { return socket.async_read_some(bs, std::forward<Token>(t)); }
+
+    template<class Buffers, class Token>
+    auto async_write_some(const Buffers& bs, Token&& t)
+    { return socket.async_write_some(bs, std::forward<Token>(t)); }
+};
+
+static pair<tcp::socket, tcp::socket> connected_pair(asio::io_context& ctx)
+{
+    tcp::acceptor acceptor(ctx, tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    tcp::socket s1(ctx), s2(ctx);
+    s1.connect(acceptor.local_endpoint());
+    acceptor.accept(s2);
+    return {std::move(s1), std::move(s2)};
+}
+
+// Sends `total_size` bytes from a source socket
+// through `full_duplex` between two streams to a sink socket,
+// and returns the throughput in MB/s.
+template<class MakeStream>
+static double run(MakeStream make_stream)
+{
+    asio::io_context ctx;
+
+    auto [src, fwd_in] = connected_pair(ctx);
+    auto [fwd_out, dst] = connected_pair(ctx);
+
+    size_t forwarded = 0, received = 0;
+    auto start = Clock::now();
+
+    task::spawn_detached(ctx, [&] (asio::yield_context yield) {
+        full_duplex( make_stream(std::move(fwd_in))
+                   , make_stream(std::move(fwd_out))
+                   , [&] (size_t n) { forwarded += n; }
+                   , [&] (size_t) {}
+                   , Async(yield));
+    });
+
+    task::spawn_detached(ctx, [&] (asio::yield_context yield) {
+        vector<uint8_t> data(write_size, 'x');
+        for (size_t sent = 0; sent < total_size; sent += data.size()) {
+            if (!asio::async_write(src, asio::buffer(data), Async(yield))) break;
+        }
+        sys::error_code ec;
+        src.close(ec);
+    });
+
+    task::spawn_detached(ctx, [&] (asio::yield_context yield) {
+        vector<uint8_t> data(write_size);
+        for (;;) {
+            auto r = dst.async_read_some(asio::buffer(data), Async(yield));
+            if (!r) break;
+            received += *r;
+        }
+    });
+
+    ctx.run();
+
+    chrono::duration<double> secs = Clock::now() - start;
+    if (received != total_size || forwarded != total_size) {
+        cerr << "Forwarded " << forwarded << " and received " << received
+             << " out of " << total_size << " bytes" << endl;
+        return 0;
+    }
+    return total_size / secs.count() / 1e6;
+}
+
+int main()
+{
+    auto spliced = run([] (tcp::socket s) { return GenericStream(std::move(s)); });
+    cout << "TCP sockets: " << spliced << " MB/s" << endl;
+
+    auto buffered = run([] (tcp::socket s) { return GenericStream(OpaqueSocket{std::move(s)}); });
+    cout << "Other streams: " << buffered << " MB/s" << endl;
+
+    return (spliced > 0 && buffered > 0) ? 0 : 1;
+}
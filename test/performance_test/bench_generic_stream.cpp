@@ -0,0 +1,139 @@
+// Counts heap allocations per `async_read_some` on a `GenericStream`
+// wrapping a plain TCP socket and wrapping TLS over another `GenericStream`
+// (as used for tunnels to injectors).
+
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <thread>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/asio/write.hpp>
+
+#include "generic_stream.h"
+#include "ssl/ca_certificate.h"
+#include "ssl/util.h"
+#include "util/ssl_stream.h"
+
+using namespace std;
+using namespace ouinet;
+
+using tcp = asio::ip::tcp;
+
+static size_t allocations = 0;
+
+void* operator new(size_t size)
+{
+    ++allocations;
+    if (auto p = malloc(size)) return p;
+    throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static const size_t warmup_reads = 100;
+static const size_t measured_reads = 1000;
+
+static pair<tcp::socket, tcp::socket> connected_pair(asio::io_context& ctx)
+{
+    tcp::acceptor acceptor(ctx, tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    tcp::socket s1(ctx), s2(ctx);
+    s1.connect(acceptor.local_endpoint());
+    acceptor.accept(s2);
+    return {std::move(s1), std::move(s2)};
+}
+
+// Reads single bytes from `stream` (already sent to it), one after the other,
+// and returns the number of allocations per read after warming up.
+//
+// Reads are started from completion handlers (as in any real use),
+// so that Asio may recycle memory for its operations.
+static double read_bytes(asio::io_context& ctx, GenericStream& stream)
+{
+    size_t done = 0, before = 0;
+    char c;
+
+    std::function<void(sys::error_code, size_t)> on_read;
+    on_read = [&] (sys::error_code ec, size_t size) {
+        if (ec || size != 1) {
+            cerr << "Read failed: " << ec.message() << endl;
+            abort();
+        }
+        if (++done == warmup_reads) before = allocations;
+        if (done == warmup_reads + measured_reads) return;
+        stream.async_read_some(asio::buffer(&c, 1), std::ref(on_read));
+    };
+
+    asio::post(ctx, [&] {
+        stream.async_read_some(asio::buffer(&c, 1), std::ref(on_read));
+    });
+    ctx.restart();
+    ctx.run();
+
+    if (done != warmup_reads + measured_reads) abort();
+    return double(allocations - before) / measured_reads;
+}
+
+static double run_tcp()
+{
+    asio::io_context ctx;
+    auto [client, server] = connected_pair(ctx);
+
+    GenericStream stream(std::move(client));
+    asio::write(server, asio::buffer(string(warmup_reads + measured_reads, 'x')));
+
+    return read_bytes(ctx, stream);
+}
+
+static double run_tls()
+{
+    asio::io_context ctx;
+    auto [client, server] = connected_pair(ctx);
+
+    CACertificate cert("localhost");
+    auto server_ssl_ctx = ouinet::ssl::util::get_server_context( cert.pem_certificate()
+                                                               , cert.pem_private_key()
+                                                               , cert.pem_dh_param());
+    asio::ssl::context client_ssl_ctx{asio::ssl::context::tls_client};
+    client_ssl_ctx.set_verify_mode(asio::ssl::verify_none);
+
+    asio::ssl::stream<tcp::socket> server_tls(std::move(server), server_ssl_ctx);
+    SslStream<GenericStream> client_tls(GenericStream(std::move(client)), client_ssl_ctx);
+
+    // Send one record per read so that each one needs to go to the socket.
+    thread server_thread([&] {
+        server_tls.handshake(asio::ssl::stream_base::server);
+        for (size_t i = 0; i < warmup_reads + measured_reads; ++i)
+            asio::write(server_tls, asio::buffer("x", 1));
+    });
+
+    client_tls->async_handshake(asio::ssl::stream_base::client, [] (sys::error_code ec) {
+        if (ec) {
+            cerr << "Handshake failed: " << ec.message() << endl;
+            abort();
+        }
+    });
+    ctx.run();
+    server_thread.join();
+
+    GenericStream stream(std::move(client_tls));
+
+    return read_bytes(ctx, stream);
+}
+
+int main()
+{
+    auto tcp_allocs = run_tcp();
+    cout << "GenericStream(tcp::socket): " << tcp_allocs << " allocations/read" << endl;
+
+    auto tls_allocs = run_tls();
+    cout << "GenericStream(SslStream<GenericStream>): " << tls_allocs << " allocations/read" << endl;
+
+    // Steady-state reads should not allocate at all.
+    return (tcp_allocs == 0 && tls_allocs == 0) ? 0 : 1;
+}
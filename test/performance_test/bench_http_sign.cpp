@@ -0,0 +1,153 @@
+// Measures the throughput of signing origin responses with `SigningReader`
+// and of verifying them with `VerifyingReader`, over loopback,
+// for bodies of different sizes.
+//
+// Data blocks are hashed and signed (or verified) in the crypto pool
+// while the next block is being read.
+
+#include <chrono>
+#include <iostream>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+#include "cache/http_sign.h"
+#include "response_reader.h"
+#include "task.h"
+#include "util/async.h"
+#include "util/crypto_pool.h"
+#include "util/random.h"
+#include "util/str.h"
+
+using namespace std;
+using namespace ouinet;
+
+using tcp = asio::ip::tcp;
+using Clock = chrono::steady_clock;
+
+static const size_t write_size = 1024 * 1024;
+
+static pair<tcp::socket, tcp::socket> connected_pair(asio::io_context& ctx)
+{
+    tcp::acceptor acceptor(ctx, tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    tcp::socket s1(ctx), s2(ctx);
+    s1.connect(acceptor.local_endpoint());
+    acceptor.accept(s2);
+    return {std::move(s1), std::move(s2)};
+}
+
+static http::request_header<> request_header() {
+    http::request_header<> rqh;
+    rqh.method(http::verb::get);
+    rqh.target("https://example.com/foo");
+    rqh.version(11);
+    rqh.set(http::field::host, "example.com");
+    return rqh;
+}
+
+static string response_head(size_t body_size) {
+    return util::str(
+        "HTTP/1.1 200 OK\r\n"
+        "Date: Mon, 15 Jan 2018 20:31:50 GMT\r\n"
+        "Content-Type: application/octet-stream\r\n"
+        "Content-Length: ", body_size, "\r\n"
+        "\r\n");
+}
+
+static void drain(tcp::socket& socket, Async yield) {
+    vector<char> buf(write_size);
+    while (asio::async_read(socket, asio::buffer(buf), yield)) {}
+}
+
+// Read all parts from the reader and write them to `out` (if open).
+// Return the number of body bytes read.
+static size_t forward( http_response::AbstractReader& reader
+                     , tcp::socket& out
+                     , Async yield) {
+    size_t body_size = 0;
+    for (;;) {
+        auto part = reader.async_read_part(yield);
+        if (!part) throw sys::system_error(part.error());
+        if (!*part) break;
+        if (auto b = (*part)->as_chunk_body()) body_size += b->size();
+        if (out.is_open() && !(*part)->async_write(out, yield)) break;
+    }
+    return body_size;
+}
+
+// Send an origin response with a body of `body_size` bytes
+// through a `SigningReader` and optionally a `VerifyingReader`,
+// and return the throughput in MB/s.
+static double run(size_t body_size, bool verify)
+{
+    asio::io_context ctx;
+    auto exec = ctx.get_executor();
+
+    auto [origin_w, origin_r] = connected_pair(ctx);
+    auto [signed_w, signed_r] = connected_pair(ctx);
+
+    auto sk = sign::SecretKey::generate();
+    auto pk = sk.public_key();
+    size_t received = 0;
+
+    auto start = Clock::now();
+
+    task::spawn_detached(exec, [&] (asio::yield_context y) {
+        Async yield(y);
+        auto head = response_head(body_size);
+        asio::async_write(origin_w, asio::buffer(head), yield);
+        auto data = util::random::printable_ascii(write_size);
+        for (size_t sent = 0; sent < body_size; sent += data.size()) {
+            auto n = min(data.size(), body_size - sent);
+            if (!asio::async_write(origin_w, asio::buffer(data.data(), n), yield)) break;
+        }
+        origin_w.close();
+    });
+
+    task::spawn_detached(exec, [&] (asio::yield_context y) {
+        Async yield(y);
+        cache::SigningReader reader( std::move(origin_r), request_header()
+                                   , "bench", 1516048310, sk);
+        auto n = forward(reader, signed_w, yield);
+        if (!verify) received = n;
+        signed_w.close();
+    });
+
+    task::spawn_detached(exec, [&] (asio::yield_context y) {
+        Async yield(y);
+        if (!verify) return drain(signed_r, yield);
+        cache::VerifyingReader reader(std::move(signed_r), pk);
+        tcp::socket none(ctx);
+        received = forward(reader, none, yield);
+    });
+
+    ctx.run();
+
+    if (received != body_size) {
+        cerr << "Received " << received << " bytes out of " << body_size << endl;
+        return 0;
+    }
+
+    auto secs = chrono::duration<double>(Clock::now() - start).count();
+    return body_size / secs / 1e6;
+}
+
+int main()
+{
+    cout << "Crypto pool threads: " << util::CryptoPool::global().threads() << endl;
+
+    bool ok = true;
+    for (size_t mib : {1, 16, 256, 1024}) {
+        size_t size = mib * 1024 * 1024;
+        auto signed_mbps = run(size, false);
+        auto verified_mbps = run(size, true);
+        cout << mib << " MiB: "
+             << signed_mbps << " MB/s signed, "
+             << verified_mbps << " MB/s signed and verified" << endl;
+        ok = ok && signed_mbps > 0 && verified_mbps > 0;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+// Measures how many injection requests per second an injector serves
+// over TCP with different numbers of threads (`--threads`).
+//
+// Every request is fetched from a local origin and signed
+// (responses are not cacheable), so the injector is CPU bound
+// and requests per second should grow with threads up to the number of cores.
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/beast/http.hpp>
+
+#include "bittorrent/mock_dht.h"
+#include "http_util.h"
+#include "injector.h"
+#include "namespaces.h"
+#include "task.h"
+#include "util/async.h"
+#include "util/random.h"
+#include "util/str.h"
+#include "../util/test_dir.h"
+
+using namespace std;
+using namespace ouinet;
+
+using tcp = asio::ip::tcp;
+using Clock = chrono::steady_clock;
+
+static const auto run_time = chrono::seconds(3);
+static const size_t connections_per_load_thread = 16;
+static const size_t body_size = 64 * 1024;
+
+// Serves the same (non-cacheable) response to every request.
+class Origin {
+public:
+    Origin(unsigned threads)
+        : _acceptor(_ctx, tcp::endpoint(asio::ip::address_v4::loopback(), 0))
+        , _body(util::random::printable_ascii(body_size))
+    {
+        task::spawn_detached(_ctx, [this] (asio::yield_context yield) { accept(yield); });
+        for (unsigned i = 0; i < threads; ++i) _threads.emplace_back([this] { _ctx.run(); });
+    }
+
+    ~Origin() {
+        asio::post(_ctx, [this] { _acceptor.close(); _ctx.stop(); });
+        for (auto& t : _threads) t.join();
+    }
+
+    tcp::endpoint endpoint() const { return _acceptor.local_endpoint(); }
+
+private:
+    void accept(asio::yield_context yield) {
+        for (;;) {
+            tcp::socket socket(_ctx);
+            if (!_acceptor.async_accept(socket, Async(yield))) return;
+            task::spawn_detached(_ctx, [this, s = std::move(socket)] (asio::yield_context yield) mutable {
+                serve(s, yield);
+            });
+        }
+    }
+
+    void serve(tcp::socket& socket, asio::yield_context yield) {
+        beast::flat_buffer buffer;
+        for (;;) {
+            http::request<http::empty_body> rq;
+            if (!http::async_read(socket, buffer, rq, Async(yield))) return;
+
+            http::response<http::string_body> rs{http::status::ok, rq.version()};
+            rs.set(http::field::content_type, "text/plain");
+            rs.body() = _body;
+            rs.keep_alive(rq.keep_alive());
+            rs.prepare_payload();
+            if (!http::async_write(socket, rs, Async(yield))) return;
+        }
+    }
+
+    asio::io_context _ctx;
+    tcp::acceptor _acceptor;
+    string _body;
+    vector<thread> _threads;
+};
+
+static tcp::endpoint free_endpoint() {
+    asio::io_context ctx;
+    tcp::acceptor acceptor(ctx, tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    return acceptor.local_endpoint();
+}
+
+static http::request<http::empty_body> injection_request(const tcp::endpoint& origin) {
+    auto host = util::str(origin);
+    auto target = util::str("http://", host, "/");
+
+    http::request<http::empty_body> rq{http::verb::get, target, 11};
+    rq.set(http::field::host, host);
+    rq.set(http_::request_group_hdr, target);
+    rq.keep_alive(true);
+    return *util::to_injector_request(std::move(rq));
+}
+
+// Send requests to the injector over `connections_per_load_thread` connections
+// from each of `load_threads` threads for `run_time`,
+// return how many got a complete response.
+static size_t load(const tcp::endpoint& injector, const tcp::endpoint& origin, unsigned load_threads) {
+    atomic<size_t> responses{0};
+    auto deadline = Clock::now() + run_time;
+    auto rq = injection_request(origin);
+
+    vector<thread> threads;
+    for (unsigned t = 0; t < load_threads; ++t) {
+        threads.emplace_back([&] {
+            asio::io_context ctx;
+            for (size_t c = 0; c < connections_per_load_thread; ++c) {
+                task::spawn_detached(ctx, [&] (asio::yield_context yield) {
+                    tcp::socket socket(ctx);
+                    if (!socket.async_connect(injector, Async(yield))) return;
+                    beast::flat_buffer buffer;
+                    while (Clock::now() < deadline) {
+                        if (!http::async_write(socket, rq, Async(yield))) return;
+                        http::response_parser<http::string_body> parser;
+                        parser.body_limit(body_size * 2);
+                        if (!http::async_read(socket, buffer, parser, Async(yield))) return;
+                        if (parser.get().result() != http::status::ok) return;
+                        ++responses;
+                    }
+                });
+            }
+            ctx.run();
+        });
+    }
+
+    for (auto& t : threads) t.join();
+    return responses;
+}
+
+static double run(unsigned threads, const fs::path& repo, const tcp::endpoint& origin, unsigned load_threads) {
+    asio::io_context ctx;
+    auto injector_ep = free_endpoint();
+
+    vector<string> args{
+        "./no_injector_exec",
+        "--repo", repo.string(),
+        "--log-level=ERROR",
+        util::str("--listen-on-tcp=", injector_ep),
+        util::str("--threads=", threads),
+        "--allow-private-targets",
+        "--cache-memory-size=0",
+        "--cache-disk-size=0",
+        "--bt-bootstrap-no-default",
+    };
+    vector<const char*> argv;
+    for (auto& a : args) argv.push_back(a.c_str());
+
+    Injector injector( InjectorConfig(argv.size(), argv.data())
+                     , ctx
+                     , util::LogPath("injector")
+                     , make_shared<bittorrent::MockDht>( "injector", ctx.get_executor()
+                                                       , make_shared<bittorrent::MockDht::Swarms>()));
+
+    thread main_thread([&] { ctx.run(); });
+
+    // Let listeners start.
+    this_thread::sleep_for(chrono::milliseconds(500));
+
+    auto responses = load(injector_ep, origin, load_threads);
+
+    asio::post(ctx, [&] { injector.stop(); });
+    main_thread.join();
+
+    return double(responses) / chrono::duration<double>(run_time).count();
+}
+
+int main()
+{
+    TestDir root(fs::temp_directory_path() / "ouinet-cpp-tests" / "bench_injector_threads" / fs::unique_path());
+
+    unsigned cores = max(1u, thread::hardware_concurrency());
+    Origin origin(max(1u, cores / 4));
+
+    vector<unsigned> thread_counts;
+    for (unsigned n = 1; n <= cores && n <= 16; n *= 2) thread_counts.push_back(n);
+
+    double first = 0;
+    for (auto n : thread_counts) {
+        // The load generator needs some cores as well.
+        auto rps = run(n, root.path() / "injector", origin.endpoint(), max(1u, min(n, cores / 2)));
+        if (first == 0) first = rps;
+        cout << n << " threads: " << rps << " requests/s"
+             << " (x" << (first > 0 ? rps / first : 0) << ")" << endl;
+    }
+
+    return first > 0 ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+// Measures the latency of logging calls at each level, as seen by the
+// calling thread, with the logger writing to a file:
+//
+//   * Levels below the threshold are filtered out by the logging macros
+//     before formatting the message.
+//   * Other levels only format the line and queue it for the background
+//     writer, which writes it in a batch with other lines.
+//
+// Several threads log at the same time, as in a multi-threaded injector.
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "logger.h"
+#include "namespaces.h"
+
+using namespace std;
+using namespace ouinet;
+
+using Clock = chrono::steady_clock;
+
+static const size_t calls_per_thread = 100000;
+static const size_t threads = 4;
+
+// Only logs to the file (so that the benchmark output is readable).
+struct FileLogger : public Logger {
+    FileLogger(log_level_t threshold) : Logger(threshold) {
+        log_to_stderr = false;
+    }
+};
+
+// Same as `OUI_LOG_*` but for the given logger.
+#define BENCH_LOG(logger, level, ...) \
+    do { if ((logger).get_threshold() <= level) (logger).log(level, util::str(__VA_ARGS__), __func__); } while (false)
+
+static vector<double> run_thread(FileLogger& logger, log_level_t level, size_t id)
+{
+    vector<double> latencies;
+    latencies.reserve(calls_per_thread);
+
+    for (size_t i = 0; i < calls_per_thread; ++i) {
+        auto start = Clock::now();
+        BENCH_LOG(logger, level, "thread ", id, ": message number ", i, " with some payload");
+        latencies.push_back(chrono::duration<double, nano>(Clock::now() - start).count());
+    }
+
+    return latencies;
+}
+
+int main()
+{
+    auto path = fs::temp_directory_path() / fs::unique_path("ouinet-bench-%%%%-%%%%.log");
+
+    FileLogger logger(INFO);
+    logger.log_to_file(path.string());
+    if (!logger.is_logging_to_file()) {
+        cerr << "Failed to open log file " << path << endl;
+        return 1;
+    }
+
+    cout << "Threads: " << threads << ", threshold: " << logger.get_threshold() << endl;
+
+    for (auto level : {SILLY, DEBUG, VERBOSE, INFO, WARN, ERROR_LEVEL}) {
+        vector<vector<double>> results(threads);
+        vector<thread> workers;
+
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] { results[t] = run_thread(logger, level, t); });
+        }
+        for (auto& w : workers) w.join();
+
+        auto flush_start = Clock::now();
+        logger.flush();
+        auto flush_ms = chrono::duration<double, milli>(Clock::now() - flush_start).count();
+
+        vector<double> all;
+        for (auto& r : results) all.insert(all.end(), r.begin(), r.end());
+        sort(all.begin(), all.end());
+
+        double sum = 0;
+        for (auto l : all) sum += l;
+
+        cout << level << ": "
+             << sum / all.size() << " ns mean, "
+             << all[all.size() * 99 / 100] << " ns p99, "
+             << all.back() << " ns max, "
+             << flush_ms << " ms to flush" << endl;
+    }
+
+    logger.log_to_file("");
+    return 0;
+}
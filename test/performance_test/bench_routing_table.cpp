@@ -0,0 +1,151 @@
+// Measures the cost of keeping the DHT routing tables of a node with several
+// local endpoints (`MainlineDht` keeps one `DhtNode`, hence one table, per
+// endpoint), mixing IPv4 and IPv6 ones:
+//
+//   * Offering many contacts to each table with `try_add_node`, as replies
+//     from a busy node would. A table only keeps up to `BUCKET_SIZE` nodes per
+//     bucket, so most contacts just go through the bucket lookup.
+//   * Finding the nodes closest to random targets with
+//     `find_closest_routing_nodes`, compared with sorting all of the nodes in
+//     the table by their distance to the target (which it must agree with).
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <boost/asio/ip/udp.hpp>
+
+#include "bittorrent/routing_table.h"
+
+using namespace std;
+using namespace ouinet;
+using namespace ouinet::bittorrent;
+
+using Clock = chrono::steady_clock;
+using udp = asio::ip::udp;
+
+static const size_t lookups = 2000;
+
+static mt19937_64 rng(42);
+
+static NodeID random_id()
+{
+    NodeID id;
+    for (size_t i = 0; i < NodeID::bit_size; ++i) id.set_bit(i, rng() % 2);
+    return id;
+}
+
+// A random ID which differs from `id` first at a random bit
+// amongst the leading ones, so that contacts fall in every bucket.
+static NodeID id_in_some_bucket(const NodeID& id)
+{
+    auto ret = random_id();
+    size_t prefix = rng() % 24;
+    for (size_t i = 0; i < prefix; ++i) ret.set_bit(i, id.bit(i));
+    ret.set_bit(prefix, !id.bit(prefix));
+    return ret;
+}
+
+static udp::endpoint random_endpoint(bool v6)
+{
+    if (v6) {
+        asio::ip::address_v6::bytes_type bytes{0x20, 0x01, 0x0d, 0xb8};
+        for (size_t i = 4; i < bytes.size(); ++i) bytes[i] = rng();
+        return { asio::ip::address_v6(bytes), uint16_t(1024 + rng() % 60000) };
+    }
+
+    return { asio::ip::address_v4(uint32_t(rng())), uint16_t(1024 + rng() % 60000) };
+}
+
+static vector<NodeContact> closest_by_sorting( const RoutingTable& rt
+                                             , const NodeID& target
+                                             , size_t count)
+{
+    auto all = rt.dump_contacts();
+    vector<NodeContact> ret(all.begin(), all.end());
+
+    sort(ret.begin(), ret.end(), [&] (auto& l, auto& r) {
+        return (l.id ^ target) < (r.id ^ target);
+    });
+
+    if (ret.size() > count) ret.resize(count);
+    return ret;
+}
+
+static bool bench(size_t endpoint_count, size_t contact_count)
+{
+    vector<unique_ptr<RoutingTable>> tables;
+    vector<vector<NodeContact>> contacts(endpoint_count);
+
+    for (size_t e = 0; e < endpoint_count; ++e) {
+        auto node_id = random_id();
+        tables.push_back(make_unique<RoutingTable>(node_id, [] (const NodeContact&) {}));
+
+        for (size_t i = 0; i < contact_count; ++i) {
+            contacts[e].push_back({ id_in_some_bucket(node_id), random_endpoint(e % 2) });
+        }
+    }
+
+    auto start = Clock::now();
+    for (size_t e = 0; e < endpoint_count; ++e) {
+        for (auto& c : contacts[e]) tables[e]->try_add_node(c, true);
+    }
+    auto add_took = Clock::now() - start;
+
+    size_t kept = 0;
+    for (auto& rt : tables) kept += rt->dump_contacts().size();
+
+    vector<NodeID> targets;
+    for (size_t i = 0; i < lookups; ++i) targets.push_back(random_id());
+
+    vector<vector<NodeContact>> found;
+
+    start = Clock::now();
+    for (auto& rt : tables) {
+        for (auto& t : targets) {
+            found.push_back(rt->find_closest_routing_nodes(t, RoutingTable::BUCKET_SIZE));
+        }
+    }
+    auto find_took = Clock::now() - start;
+
+    vector<vector<NodeContact>> expected;
+
+    start = Clock::now();
+    for (auto& rt : tables) {
+        for (auto& t : targets) {
+            expected.push_back(closest_by_sorting(*rt, t, RoutingTable::BUCKET_SIZE));
+        }
+    }
+    auto sort_took = Clock::now() - start;
+
+    bool ok = found == expected;
+
+    auto ns_per = [] (Clock::duration d, size_t n) {
+        return chrono::duration<double, nano>(d).count() / n;
+    };
+
+    cout << endpoint_count << " endpoints, " << contact_count << " contacts each: "
+         << kept / endpoint_count << " nodes kept per table, "
+         << ns_per(add_took, endpoint_count * contact_count) << " ns per add, "
+         << ns_per(find_took, endpoint_count * lookups) << " ns per lookup ("
+         << ns_per(sort_took, endpoint_count * lookups) << " ns sorting all nodes)"
+         << (ok ? "" : " MISMATCH") << endl;
+
+    return ok;
+}
+
+int main()
+{
+    bool ok = true;
+
+    for (size_t endpoints : {1, 2, 4}) {
+        for (size_t contacts : {10000, 50000, 100000}) {
+            ok = bench(endpoints, contacts) && ok;
+        }
+    }
+
+    return ok ? 0 : 1;
+}
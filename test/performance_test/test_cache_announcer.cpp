@@ -1,92 +1,169 @@
-#include <iostream>
+// Measures the cost of keeping many groups announced with `Bep5Announcer`:
+//
+//   * Adding and removing groups, which used to scan a list of all of them.
+//   * Announcing all of them once to a simulated DHT which takes a fixed time
+//     per swarm, reporting how the announcer batches them. The more leading
+//     bits consecutive infohashes in a batch share, the more of the lookup of
+//     one swarm is reused by the next one (see `DhtNode::tracker_announce_batch`).
+
+#include <algorithm>
 #include <chrono>
-#include <boost/asio/steady_timer.hpp>
-#include <boost/asio/signal_set.hpp>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
 
-#include "../test/util/bittorrent_utils.cpp"
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
 
-#define protected public
-#include "cache/announcer.cpp"
+#include "async_sleep.h"
+#include "bittorrent/dht.h"
+#include "cache/announcer.h"
 
-using namespace chrono;
+using namespace std;
+using namespace std::chrono_literals;
 using namespace ouinet;
 using namespace ouinet::bittorrent;
-using namespace ouinet::cache;
-using namespace ouinet::util;
-using namespace std;
 
 using Clock = chrono::steady_clock;
 
-const size_t N_GROUPS = 128;
-const size_t TEST_SIMULTANEOUS_ANNOUNCEMENTS = 64;
+static const size_t simultaneous_announcements = 64;
+
+class SimulatedDht : public DhtBase {
+public:
+    SimulatedDht(Executor exec, Clock::duration time_per_swarm)
+        : _exec(exec)
+        , _time_per_swarm(time_per_swarm)
+    {}
+
+    void set_endpoints(const std::set<UdpEndpoint>&) override {}
+
+    Promise<UdpEndpoint>::Future add_endpoint(asio_utp::udp_multiplexer m) override {
+        Promise<UdpEndpoint> promise(_exec);
+        promise.set_value(m.local_endpoint());
+        return promise.get_future();
+    }
+
+    std::set<UdpEndpoint> local_endpoints() const override { return {}; }
+    std::set<UdpEndpoint> wan_endpoints() const override { return {}; }
+
+    std::expected<std::set<UdpEndpoint>, sys::error_code>
+    tracker_announce(NodeID infohash, std::optional<int> port, Async yield) override {
+        auto announced = tracker_announce_batch({infohash}, port, yield);
+        if (!announced) return std::unexpected(announced.error());
+        return std::set<UdpEndpoint>();
+    }
+
+    std::expected<std::set<NodeID>, sys::error_code>
+    tracker_announce_batch(std::vector<NodeID> infohashes, std::optional<int>, Async yield) override {
+        ++batches;
+
+        std::sort(infohashes.begin(), infohashes.end());
+
+        for (size_t i = 0; i < infohashes.size(); ++i) {
+            async_sleep(_time_per_swarm, yield);
+            announced.insert(infohashes[i]);
+            if (i == 0) continue;
+            shared_bits += common_prefix_bits(infohashes[i - 1], infohashes[i]);
+            ++consecutive;
+        }
 
-shared_ptr<MainlineDht> btdht;
-std::unique_ptr<Bep5Announcer> announcer;
-Clock::time_point start;
-Clock::time_point now;
+        return std::set<NodeID>(infohashes.begin(), infohashes.end());
+    }
+
+    std::expected<std::set<UdpEndpoint>, sys::error_code>
+    tracker_get_peers(NodeID, Async) override { return {}; }
+
+    Executor get_executor() override { return _exec; }
+    bool all_ready() const override { return true; }
+    bool is_bootstrapped() const override { return true; }
+    void wait_all_ready(Async) override {}
+    void stop() override {}
+    bool is_peer_allowed(const UdpEndpoint&) const override { return true; }
+
+    static size_t common_prefix_bits(const NodeID& a, const NodeID& b) {
+        size_t n = 0;
+        while (n < NodeID::bit_size && a.bit(n) == b.bit(n)) ++n;
+        return n;
+    }
+
+    std::set<NodeID> announced;
+    size_t batches = 0;
+    size_t shared_bits = 0;
+    size_t consecutive = 0;
+
+private:
+    Executor _exec;
+    Clock::duration _time_per_swarm;
+};
+
+static string group_name(size_t n) {
+    return "group-" + to_string(n);
+}
 
-void start_btdht(asio::io_context& ctx, BtUtils& btu) {
-    task::spawn_detached(ctx, [&] (asio::yield_context yield) {
-        vector<asio::ip::address> ifaddrs{asio::ip::make_address("0.0.0.0")};
-        btdht = btu.bittorrent_dht(yield, ifaddrs);
-    });
+static void bench_add_remove(size_t group_count)
+{
+    asio::io_context ctx;
+    auto dht = make_shared<SimulatedDht>(ctx.get_executor(), 0s);
+    cache::Bep5Announcer announcer(dht, simultaneous_announcements, util::LogPath{});
+
+    // The announcement loop does not run, so all the time goes to
+    // keeping track of groups.
+    auto start = Clock::now();
+    for (size_t n = 0; n < group_count; ++n) announcer.add(group_name(n));
+    for (size_t n = 0; n < group_count; ++n) announcer.add(group_name(n));
+    for (size_t n = 0; n < group_count; ++n) announcer.remove(group_name(n));
+    auto took = Clock::now() - start;
+
+    cout << group_count << " groups: "
+         << chrono::duration<double, micro>(took).count() / (3 * group_count)
+         << " us per add/remove" << endl;
 }
 
-void start_announcer_loop(asio::io_context& ctx) {
-    task::spawn_detached(ctx, [&] (asio::yield_context yield) {
-        announcer = std::make_unique<Bep5Announcer>(btdht, TEST_SIMULTANEOUS_ANNOUNCEMENTS, util::LogPath{});
+static bool bench_announce(size_t group_count)
+{
+    asio::io_context ctx;
+    auto dht = make_shared<SimulatedDht>(ctx.get_executor(), 1ms);
+    auto announcer = make_unique<cache::Bep5Announcer>(dht, simultaneous_announcements, util::LogPath{});
+
+    for (size_t n = 0; n < group_count; ++n) announcer->add(group_name(n));
 
-        start = Clock::now();
-        for (size_t n = 0; n < N_GROUPS; n++) {
-            announcer->add("group-" + std::to_string(n));
-        }
-    });
-}
+    auto start = Clock::now();
 
-void monitor_announcements(asio::io_context& ctx, BtUtils& btu) {
-    task::spawn_detached(ctx, [&] (asio::yield_context yield) {
-        using namespace std::chrono;
-        sys::error_code ec;
-        asio::steady_timer timer(ctx);
-        size_t announcing_attempts{0};
-        size_t last_announcing_attempts{0};
-
-        while (announcing_attempts < N_GROUPS) {
-            announcing_attempts = 0;
-            for (auto iter = announcer->_loop->entries.begin(); iter != announcer->_loop->entries.end(); ++iter)
-                if (iter->first.attempted_update())
-                    ++announcing_attempts;
-
-            timer.expires_after(chrono::seconds(1));
-            timer.async_wait(yield[ec]);
-            now = Clock::now();
-            auto elapsed = duration_cast<seconds>(now - start).count();
-
-            if (announcing_attempts > last_announcing_attempts) {
-                last_announcing_attempts = announcing_attempts;
-                std::cout << announcing_attempts << " of " << N_GROUPS << " entries announced after " \
-                      << elapsed << " seconds" << std::endl;
-            }
+    asio::steady_timer timer(ctx);
+    std::function<void()> check = [&] {
+        if (dht->announced.size() == group_count || Clock::now() - start > 60s) {
+            announcer.reset();
+            ctx.stop();
+            return;
         }
+        timer.expires_after(1ms);
+        timer.async_wait([&] (sys::error_code) { check(); });
+    };
+    check();
+
+    ctx.run();
 
-        btu.stop();
-        raise(SIGINT);
-    });
+    auto took = Clock::now() - start;
+
+    cout << group_count << " groups announced in "
+         << chrono::duration_cast<chrono::milliseconds>(took).count() << "ms"
+         << " with " << dht->batches << " DHT calls"
+         << " (" << double(group_count) / max<size_t>(dht->batches, 1) << " swarms/call"
+         << ", " << double(dht->shared_bits) / max<size_t>(dht->consecutive, 1)
+         << " leading bits shared by consecutive infohashes)" << endl;
+
+    return dht->announced.size() == group_count;
 }
 
-int main(int argc, const char** argv)
+int main()
 {
-    asio::io_context ctx;
-    BtUtils btu{ctx};
+    for (size_t n : {1000, 10000, 50000}) bench_add_remove(n);
 
-    start_btdht(ctx, btu);
-    start_announcer_loop(ctx);
-    monitor_announcements(ctx, btu);
+    bool ok = true;
+    for (size_t n : {128, 1024, 4096}) ok = bench_announce(n) && ok;
 
-    boost::asio::signal_set signals(ctx, SIGINT);
-    signals.async_wait([&](const boost::system::error_code& error , int signal_number) {
-        ctx.stop();
-    });
-
-    ctx.run();
+    return ok ? 0 : 1;
 }
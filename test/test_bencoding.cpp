@@ -1,6 +1,8 @@
 #define BOOST_TEST_MODULE bencoding
 #include <boost/test/unit_test.hpp>
 
+#include <random>
+
 #include <bittorrent/bencoding.h>
 
 BOOST_AUTO_TEST_SUITE(bencoding)
@@ -8,6 +10,10 @@ BOOST_AUTO_TEST_SUITE(bencoding)
 using boost::optional;
 using ouinet::bittorrent::bencoding_encode;
 using ouinet::bittorrent::bencoding_decode;
+using ouinet::bittorrent::BencodedList;
+using ouinet::bittorrent::BencodedMap;
+using ouinet::bittorrent::BencodedValue;
+using ouinet::bittorrent::BencodedView;
 using ouinet::bittorrent::depth_limit;
 using ouinet::bittorrent::length_limit;
 
@@ -101,4 +107,120 @@ BOOST_AUTO_TEST_CASE(test_decoding_limits)
     BOOST_CHECK_EQUAL(test_list_depth(depth_limit + 1), false);
 }
 
+BOOST_AUTO_TEST_CASE(test_view)
+{
+    std::string msg = "d1:ad2:id3:abc6:target3:xyze1:q9:find_node1:t2:aa1:y1:qe--";
+
+    auto view = BencodedView::parse(msg);
+    BOOST_REQUIRE(view);
+    BOOST_REQUIRE(view->is_map());
+    // Trailing data is ignored.
+    BOOST_REQUIRE_EQUAL(view->encoded(), msg.substr(0, msg.size() - 2));
+
+    BOOST_REQUIRE_EQUAL(*view->find("y")->as_string_view(), "q");
+    BOOST_REQUIRE_EQUAL(*view->find("q")->as_string_view(), "find_node");
+    BOOST_REQUIRE(!view->find("r"));
+    BOOST_REQUIRE(!view->find("y")->find("y"));
+    BOOST_REQUIRE(!view->find("t")->as_int());
+
+    auto args = view->find("a");
+    BOOST_REQUIRE(args && args->is_map());
+    BOOST_REQUIRE_EQUAL(*args->find("target")->as_string_view(), "xyz");
+
+    // Strings refer to the parsed data.
+    BOOST_REQUIRE(args->find("id")->as_string_view()->data() == msg.data() + 11);
+
+    std::vector<std::string> keys;
+    view->for_each_entry([&] (auto key, auto) { keys.emplace_back(key); });
+    BOOST_REQUIRE((keys == std::vector<std::string>{"a", "q", "t", "y"}));
+
+    auto list = BencodedView::parse("li-42e0:le3:abce");
+    BOOST_REQUIRE(list && list->is_list());
+    std::vector<BencodedView> items;
+    list->for_each_item([&] (auto item) { items.push_back(item); });
+    BOOST_REQUIRE_EQUAL(items.size(), 4);
+    BOOST_REQUIRE_EQUAL(*items[0].as_int(), -42);
+    BOOST_REQUIRE_EQUAL(*items[1].as_string_view(), "");
+    BOOST_REQUIRE(items[2].is_list());
+    BOOST_REQUIRE_EQUAL(*items[3].as_string_view(), "abc");
+
+    // The last repeated key wins, as when decoding.
+    auto repeated = BencodedView::parse("d1:ai1e1:ai2ee");
+    BOOST_REQUIRE_EQUAL(*repeated->find("a")->as_int(), 2);
+    BOOST_REQUIRE_EQUAL(*bencoding_decode("d1:ai1e1:ai2ee")->as_map()->at("a").as_int(), 2);
+
+    for (auto bad : {"", "d", "l", "i12", "ie", "i1x", "4:abc", "-1:a", "+1:a", "d1:ae", "di1ei2ee", "x"}) {
+        BOOST_CHECK_MESSAGE(!BencodedView::parse(bad), bad);
+    }
+}
+
+static BencodedValue random_value(std::mt19937& rng, unsigned depth)
+{
+    auto pick = [&] (unsigned n) { return std::uniform_int_distribution<unsigned>(0, n - 1)(rng); };
+
+    auto random_string = [&] {
+        std::string s(pick(depth ? 8 : 30), '\0');
+        for (auto& c : s) c = char(pick(256));
+        return s;
+    };
+
+    switch (depth < 4 ? pick(4) : pick(2)) {
+        case 0: return int64_t(rng()) - int64_t(rng());
+        case 1: return random_string();
+        case 2: {
+            BencodedList l;
+            for (auto n = pick(5); n; --n) l.push_back(random_value(rng, depth + 1));
+            return l;
+        }
+        default: {
+            BencodedMap m;
+            for (auto n = pick(5); n; --n) m[random_string()] = random_value(rng, depth + 1);
+            return m;
+        }
+    }
+}
+
+// Parse random valid values and corrupted versions of them:
+// invalid input must be rejected (without reading past its end),
+// and whatever is accepted must survive a round trip.
+BOOST_AUTO_TEST_CASE(test_decoding_fuzz)
+{
+    std::mt19937 rng(1234);
+    auto pick = [&] (size_t n) { return std::uniform_int_distribution<size_t>(0, n - 1)(rng); };
+    static const char special[] = "ilde0123456789:-";
+
+    for (int i = 0; i < 5000; ++i) {
+        auto value = random_value(rng, 0);
+        auto encoded = bencoding_encode(value);
+
+        auto decoded = bencoding_decode(encoded);
+        BOOST_REQUIRE(decoded);
+        BOOST_REQUIRE_EQUAL(bencoding_encode(*decoded), encoded);
+
+        // Copy to an exactly sized buffer, so that sanitizers
+        // catch reads past the end of the input.
+        auto mutated = std::make_unique<char[]>(encoded.size());
+        std::copy(encoded.begin(), encoded.end(), mutated.get());
+        size_t size = encoded.size();
+
+        switch (pick(3)) {
+            case 0: size = pick(size); break;
+            case 1: mutated[pick(size)] = special[pick(sizeof(special) - 1)]; break;
+            default: mutated[pick(size)] = char(pick(256)); break;
+        }
+
+        boost::string_view input(mutated.get(), size);
+        auto view = BencodedView::parse(input);
+        auto redecoded = bencoding_decode(input);
+        BOOST_REQUIRE_EQUAL(bool(view), bool(redecoded));
+        if (!view) continue;
+
+        BOOST_REQUIRE(view->encoded().data() == input.data());
+        BOOST_REQUIRE_EQUAL(bencoding_encode(*redecoded), bencoding_encode(view->to_value()));
+        auto again = bencoding_decode(bencoding_encode(*redecoded));
+        BOOST_REQUIRE(again);
+        BOOST_REQUIRE_EQUAL(bencoding_encode(*again), bencoding_encode(*redecoded));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,209 @@
+#define BOOST_TEST_MODULE block_scheduler
+#include <boost/test/unit_test.hpp>
+
+#include <set>
+
+#include <cache/block_scheduler.h>
+
+BOOST_AUTO_TEST_SUITE(ouinet_block_scheduler)
+
+using namespace std;
+using namespace std::chrono_literals;
+using namespace ouinet::cache;
+
+struct Peer {};
+
+using Scheduler = BlockScheduler<Peer>;
+using Clock = Scheduler::Clock;
+
+static bool has_all(size_t) { return true; }
+
+static set<size_t> blocks_of(const vector<Scheduler::Assignment>& as, Peer* peer)
+{
+    set<size_t> ret;
+    for (auto& a : as) if (a.peer == peer) ret.insert(a.block_id);
+    return ret;
+}
+
+BOOST_AUTO_TEST_CASE(test_window) {
+    Peer p1, p2, p3;
+    Scheduler scheduler(0, 10, 2);
+
+    scheduler.add_peer(&p1, has_all);
+    scheduler.add_peer(&p2, has_all);
+    scheduler.add_peer(&p3, has_all);
+
+    auto now = Clock::now();
+
+    // Only two blocks in the window, one request per peer.
+    auto as = scheduler.schedule(now);
+    BOOST_REQUIRE_EQUAL(as.size(), 2);
+    BOOST_REQUIRE_EQUAL(as[0].block_id, 0);
+    BOOST_REQUIRE_EQUAL(as[1].block_id, 1);
+    BOOST_REQUIRE(as[0].peer != as[1].peer);
+
+    // The window does not move until the first block is delivered.
+    now += Scheduler::default_block_time;
+    BOOST_REQUIRE(scheduler.received(as[1].peer, 1, now));
+    BOOST_REQUIRE(scheduler.schedule(now).empty());
+
+    BOOST_REQUIRE(scheduler.received(as[0].peer, 0, now));
+    scheduler.delivered(0);
+    scheduler.delivered(1);
+    BOOST_REQUIRE_EQUAL(scheduler.window_start(), 2);
+
+    as = scheduler.schedule(now);
+    BOOST_REQUIRE_EQUAL(as.size(), 2);
+    BOOST_REQUIRE_EQUAL(as[0].block_id, 2);
+    BOOST_REQUIRE_EQUAL(as[1].block_id, 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_fastest_first) {
+    Peer slow, fast;
+    Scheduler scheduler(0, 10, 4);
+
+    scheduler.add_peer(&slow, has_all);
+    scheduler.add_peer(&fast, has_all);
+
+    auto now = Clock::now();
+
+    auto as = scheduler.schedule(now);
+    BOOST_REQUIRE_EQUAL(as.size(), 2);
+    auto slow_block = blocks_of(as, &slow);
+    auto fast_block = blocks_of(as, &fast);
+    BOOST_REQUIRE(scheduler.received(&slow, *slow_block.begin(), now + 500ms));
+    BOOST_REQUIRE(scheduler.received(&fast, *fast_block.begin(), now + 50ms));
+
+    // Both idle now, the fast peer gets the first pending block.
+    as = scheduler.schedule(now + 500ms);
+    BOOST_REQUIRE_EQUAL(as.size(), 2);
+    BOOST_REQUIRE(as[0].peer == &fast);
+    BOOST_REQUIRE_EQUAL(as[0].block_id, 2);
+    BOOST_REQUIRE(as[1].peer == &slow);
+    BOOST_REQUIRE_EQUAL(as[1].block_id, 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_has_block) {
+    Peer p1, p2;
+    Scheduler scheduler(0, 4, 4);
+
+    scheduler.add_peer(&p1, [] (size_t b) { return b % 2 == 0; });
+    scheduler.add_peer(&p2, [] (size_t b) { return b == 3; });
+
+    BOOST_REQUIRE(scheduler.is_available(0));
+    BOOST_REQUIRE(!scheduler.is_available(1));
+
+    auto as = scheduler.schedule(Clock::now());
+    BOOST_REQUIRE(blocks_of(as, &p1) == set<size_t>{0});
+    BOOST_REQUIRE(blocks_of(as, &p2) == set<size_t>{3});
+}
+
+BOOST_AUTO_TEST_CASE(test_failed_peer) {
+    Peer p1, p2;
+    Scheduler scheduler(0, 2, 2);
+
+    scheduler.add_peer(&p1, has_all);
+    scheduler.add_peer(&p2, has_all);
+
+    auto now = Clock::now();
+
+    auto as = scheduler.schedule(now);
+    BOOST_REQUIRE_EQUAL(as.size(), 2);
+    BOOST_REQUIRE(scheduler.received(&p2, *blocks_of(as, &p2).begin(), now + 10ms));
+
+    // The block of the failed peer goes to the other one.
+    auto failed_block = *blocks_of(as, &p1).begin();
+    scheduler.failed(&p1, failed_block);
+    scheduler.remove_peer(&p1);
+    BOOST_REQUIRE(!scheduler.has_peer(&p1));
+
+    as = scheduler.schedule(now + 10ms);
+    BOOST_REQUIRE_EQUAL(as.size(), 1);
+    BOOST_REQUIRE(as[0].peer == &p2);
+    BOOST_REQUIRE_EQUAL(as[0].block_id, failed_block);
+}
+
+BOOST_AUTO_TEST_CASE(test_endgame) {
+    Peer p1, p2;
+    Scheduler scheduler(0, 2, 2);
+
+    scheduler.add_peer(&p1, has_all);
+    scheduler.add_peer(&p2, has_all);
+
+    auto now = Clock::now();
+
+    auto as = scheduler.schedule(now);
+    BOOST_REQUIRE_EQUAL(as.size(), 2);
+    auto b1 = *blocks_of(as, &p1).begin();
+    auto b2 = *blocks_of(as, &p2).begin();
+    BOOST_REQUIRE(scheduler.received(&p2, b2, now + Scheduler::default_block_time));
+
+    // Not stalled yet.
+    BOOST_REQUIRE(scheduler.schedule(now + Scheduler::default_block_time).empty());
+
+    // Stalled, the idle peer requests it too.
+    auto later = now + Scheduler::default_block_time * (Scheduler::stall_factor + 1);
+    as = scheduler.schedule(later);
+    BOOST_REQUIRE_EQUAL(as.size(), 1);
+    BOOST_REQUIRE(as[0].peer == &p2);
+    BOOST_REQUIRE_EQUAL(as[0].block_id, b1);
+
+    // Only the first copy counts.
+    BOOST_REQUIRE(scheduler.received(&p2, b1, later + 100ms));
+    BOOST_REQUIRE(!scheduler.received(&p1, b1, later + 200ms));
+}
+
+BOOST_AUTO_TEST_CASE(test_faster_peer_takes_over) {
+    Peer slow, fast;
+    Scheduler scheduler(0, 4, 2);
+
+    scheduler.add_peer(&slow, has_all);
+    scheduler.add_peer(&fast, has_all);
+
+    auto now = Clock::now();
+
+    auto as = scheduler.schedule(now);
+    BOOST_REQUIRE_EQUAL(as.size(), 2);
+    BOOST_REQUIRE(scheduler.received(&fast, *blocks_of(as, &fast).begin(), now + 100ms));
+    BOOST_REQUIRE(scheduler.received(&slow, *blocks_of(as, &slow).begin(), now + 2s));
+    scheduler.delivered(0);
+    scheduler.delivered(1);
+
+    now += 2s;
+    as = scheduler.schedule(now);
+    BOOST_REQUIRE(blocks_of(as, &fast) == set<size_t>{2});
+    BOOST_REQUIRE(blocks_of(as, &slow) == set<size_t>{3});
+
+    // Once idle, the fast peer is expected to get the last block
+    // long before the slow one does.
+    BOOST_REQUIRE(scheduler.received(&fast, 2, now + 100ms));
+    as = scheduler.schedule(now + 100ms);
+    BOOST_REQUIRE_EQUAL(as.size(), 1);
+    BOOST_REQUIRE(as[0].peer == &fast);
+    BOOST_REQUIRE_EQUAL(as[0].block_id, 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_pipelined_peer) {
+    Peer p1, p2;
+    Scheduler scheduler(0, 10, 8);
+
+    scheduler.add_peer(&p1, has_all, 3);
+    scheduler.add_peer(&p2, has_all);
+
+    auto now = Clock::now();
+
+    auto as = scheduler.schedule(now);
+    BOOST_REQUIRE_EQUAL(as.size(), 4);
+    BOOST_REQUIRE_EQUAL(blocks_of(as, &p1).size(), 3);
+    BOOST_REQUIRE_EQUAL(blocks_of(as, &p2).size(), 1);
+    BOOST_REQUIRE(scheduler.schedule(now).empty());
+
+    // Once a block arrives, the peer gets the next pending one.
+    BOOST_REQUIRE(scheduler.received(&p1, *blocks_of(as, &p1).begin(), now + 100ms));
+    as = scheduler.schedule(now + 100ms);
+    BOOST_REQUIRE_EQUAL(as.size(), 1);
+    BOOST_REQUIRE(as[0].peer == &p1);
+    BOOST_REQUIRE_EQUAL(as[0].block_id, 4);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
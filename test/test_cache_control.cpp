@@ -298,6 +298,117 @@ BOOST_AUTO_TEST_CASE(test_maxage)
     BOOST_CHECK_EQUAL(origin_check, 2u);
 }
 
+BOOST_AUTO_TEST_CASE(test_expiration_time)
+{
+    const time_t injected = 1000000;
+
+    http::response_header<> hdr;
+    hdr.result(http::status::ok);
+    BOOST_CHECK_EQUAL(CacheControl::expiration_time(hdr, injected), 0);
+
+    hdr.set(http::field::expires, "Sun, 06 Nov 1994 08:49:37 GMT");
+    BOOST_CHECK_EQUAL(CacheControl::expiration_time(hdr, injected), 784111777);
+
+    // `max-age` takes precedence over `Expires`.
+    hdr.set(http::field::cache_control, "public, max-age=60");
+    BOOST_CHECK_EQUAL(CacheControl::expiration_time(hdr, injected), injected + 60);
+    BOOST_CHECK_EQUAL(CacheControl::expiration_time(hdr, 0), 0);
+
+    hdr.set(http::field::cache_control, "private, max-age=60");
+    BOOST_CHECK_EQUAL(CacheControl::expiration_time(hdr, injected), 0);
+
+    hdr.set(http::field::cache_control, "max-age=60");
+    hdr.result(http::status::found);
+    BOOST_CHECK_EQUAL(CacheControl::expiration_time(hdr, injected), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_fresh_local_skips_fetch)
+{
+    asio::io_context ctx;
+    auto exec = ctx.get_executor();
+
+    CacheControl cc(exec, "test");
+
+    unsigned local_check = 0;
+    unsigned cache_check = 0;
+    unsigned origin_check = 0;
+    size_t skipped_bytes = 0;
+
+    async_test(ctx, [&](auto yield) {
+        bool complete = true;
+        bool local_ok = true;
+        auto created = current_time() - seconds(30);
+
+        cc.probe_stored = [&](auto rq) {
+            cache::StoreIndex::Entry e;
+            e.body_size = 42;
+            e.complete = complete;
+            e.injected = posix_time::to_time_t(created);
+            e.expires = e.injected + 60;
+            return std::optional(e);
+        };
+
+        cc.on_fresh_fetch_skipped = [&](size_t body_size) {
+            skipped_bytes += body_size;
+        };
+
+        auto stored = [&](auto yield) {
+            Response rs{http::status::ok, CacheRequest::HTTP_VERSION};
+            rs.set("X-Test", "from-cache");
+            rs.set(http::field::cache_control, "max-age=60");
+            set_timestamp(rs, created);
+            return make_session(rs, yield);
+        };
+
+        cc.fetch_local = [&](auto rq, auto yield) -> std::expected<Session, sys::error_code> {
+            local_check++;
+            if (!local_ok) return std::unexpected(asio::error::not_found);
+            return stored(yield);
+        };
+
+        cc.fetch_stored = [&](auto rq, auto yield) {
+            cache_check++;
+            return stored(yield);
+        };
+
+        cc.fetch_fresh = [&](auto rq, auto yield) {
+            origin_check++;
+
+            Response rs{http::status::ok, CacheRequest::HTTP_VERSION};
+            rs.set("X-Test", "from-origin");
+            auto session = make_session(rs, yield);
+
+            // Insert short delay to ensure `fetch_stored` completes first
+            async_sleep(10ms, yield);
+
+            return session;
+        };
+
+        // The local copy may also turn out to be unreadable.
+        const std::pair<bool, bool> cases[] = {{true, true}, {false, true}, {true, false}};
+        for (auto [c, l] : cases) {
+            complete = c;
+            local_ok = l;
+
+            Request normal_req{http::verb::get, "http://foo", 11};
+            normal_req.set(http_::request_group_hdr, dht_group);
+
+            auto req = unwrap(CacheRequest::from(CacheType::Bep5Http{}, normal_req));
+            auto session = unwrap(cc.fetch(req, yield));
+            auto hdr = session.response_header();
+            BOOST_REQUIRE_EQUAL(hdr["X-Test"], "from-cache");
+        }
+    });
+    ctx.run();
+
+    // Only the local store was used for the complete response,
+    // otherwise it was fetched fresh and from the cache in parallel.
+    BOOST_CHECK_EQUAL(local_check, 2u);
+    BOOST_CHECK_EQUAL(cache_check, 2u);
+    BOOST_CHECK_EQUAL(origin_check, 2u);
+    BOOST_CHECK_EQUAL(skipped_bytes, 42u);
+}
+
 BOOST_AUTO_TEST_CASE(test_http10_expires)
 {
     asio::io_context ctx;
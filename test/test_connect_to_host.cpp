@@ -0,0 +1,194 @@
+#define BOOST_TEST_MODULE connect_to_host
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <sys/socket.h>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/spawn.hpp>
+
+#include <async_sleep.h>
+#include <connect_to_host.h>
+#include <task.h>
+#include <util/async.h>
+#include <util/cancel.h>
+
+#include <namespaces.h>
+
+namespace utf = boost::unit_test;
+
+BOOST_AUTO_TEST_SUITE(ouinet_connect_to_host, * utf::timeout(20))
+
+using namespace std;
+using namespace std::chrono_literals;
+using namespace ouinet;
+using tcp = asio::ip::tcp;
+using Clock = chrono::steady_clock;
+
+// Accepts connections (without the application accepting them).
+struct Listener {
+    tcp::acceptor acceptor;
+
+    Listener(asio::io_context& ctx, asio::ip::address addr)
+        : acceptor(ctx, tcp::endpoint(addr, 0))
+    {}
+
+    tcp::endpoint endpoint() const { return acceptor.local_endpoint(); }
+};
+
+// A listener whose backlog is full, so that the system drops new connection
+// requests and connection attempts stall (like with an unreachable host).
+struct BlackHole {
+    tcp::acceptor acceptor;
+    vector<tcp::socket> fill;
+
+    BlackHole(asio::io_context& ctx, asio::ip::address addr)
+        : acceptor(ctx)
+    {
+        tcp::endpoint ep(addr, 0);
+        acceptor.open(ep.protocol());
+        acceptor.bind(ep);
+        acceptor.listen(0);
+
+        for (int i = 0; i < 4; ++i) {
+            auto& s = fill.emplace_back(ctx);
+            s.open(ep.protocol());
+            s.non_blocking(true);
+            // Asio would wait for the connection to be established.
+            auto fill_ep = endpoint();
+            std::ignore = ::connect(s.native_handle(), fill_ep.data(), fill_ep.size());
+        }
+    }
+
+    tcp::endpoint endpoint() const { return acceptor.local_endpoint(); }
+};
+
+static tcp::endpoint closed_endpoint(asio::io_context& ctx) {
+    tcp::acceptor acceptor(ctx, tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    return acceptor.local_endpoint();
+}
+
+static tcp::resolver::results_type lookup(const string& host, vector<tcp::endpoint> eps) {
+    return tcp::resolver::results_type::create(eps.begin(), eps.end(), host, "0");
+}
+
+static void run_spawned(asio::io_context& ctx, std::function<void(Async)> f) {
+    task::spawn_detached(ctx, [f = std::move(f)] (asio::yield_context yield) {
+        try {
+            f(Async(yield));
+        }
+        catch (const std::exception& e) {
+            BOOST_ERROR(string("Test ended with exception: ") + e.what());
+        }
+    });
+
+    ctx.run();
+}
+
+BOOST_AUTO_TEST_CASE(test_black_hole_first) {
+    asio::io_context ctx;
+    BlackHole bh1(ctx, asio::ip::address_v4::loopback());
+    BlackHole bh2(ctx, asio::ip::address_v4::loopback());
+    Listener good(ctx, asio::ip::address_v4::loopback());
+
+    run_spawned(ctx, [&] (Async yield) {
+        auto start = Clock::now();
+        auto socket = connect_to_host(lookup("black-hole-first.test", { bh1.endpoint()
+                                                                      , bh2.endpoint()
+                                                                      , good.endpoint()}), yield);
+        auto elapsed = Clock::now() - start;
+
+        BOOST_REQUIRE(socket);
+        BOOST_CHECK_EQUAL(socket->remote_endpoint(), good.endpoint());
+        // Two staggered attempts stalled before the good one.
+        BOOST_CHECK(elapsed >= 500ms);
+        BOOST_CHECK(elapsed < 2s);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_refused) {
+    asio::io_context ctx;
+    auto closed1 = closed_endpoint(ctx);
+    auto closed2 = closed_endpoint(ctx);
+    Listener good(ctx, asio::ip::address_v4::loopback());
+
+    run_spawned(ctx, [&] (Async yield) {
+        // Failed attempts do not wait for the attempt delay.
+        auto start = Clock::now();
+        auto socket = connect_to_host(lookup("refused.test", {closed1, good.endpoint()}), yield);
+        BOOST_REQUIRE(socket);
+        BOOST_CHECK_EQUAL(socket->remote_endpoint(), good.endpoint());
+        BOOST_CHECK(Clock::now() - start < 200ms);
+
+        socket = connect_to_host(lookup("refused.test", {closed1, closed2}), yield);
+        BOOST_REQUIRE(!socket);
+        BOOST_CHECK_EQUAL(socket.error(), asio::error::connection_refused);
+
+        socket = connect_to_host(lookup("refused.test", {}), yield);
+        BOOST_REQUIRE(!socket);
+    });
+}
+
+// Some test environments (e.g. containers) have no IPv6 loopback.
+static boost::test_tools::assertion_result has_ipv6_loopback(utf::test_unit_id) {
+    asio::io_context ctx;
+    tcp::acceptor acceptor(ctx);
+    sys::error_code ec;
+    tcp::endpoint ep(asio::ip::address_v6::loopback(), 0);
+    acceptor.open(ep.protocol(), ec);
+    if (!ec) acceptor.bind(ep, ec);
+
+    boost::test_tools::assertion_result ret(!ec);
+    if (ec) ret.message() << "cannot bind to the IPv6 loopback: " << ec.message();
+    return ret;
+}
+
+BOOST_AUTO_TEST_CASE(test_family_memory, * utf::precondition(has_ipv6_loopback)) {
+    asio::io_context ctx;
+    BlackHole bh6(ctx, asio::ip::address_v6::loopback());
+    Listener good4(ctx, asio::ip::address_v4::loopback());
+
+    run_spawned(ctx, [&] (Async yield) {
+        // Even if listed after IPv4, IPv6 is tried first.
+        auto lk = lookup("family-memory.test", {good4.endpoint(), bh6.endpoint()});
+
+        auto start = Clock::now();
+        auto socket = connect_to_host(lk, yield);
+        BOOST_REQUIRE(socket);
+        BOOST_CHECK_EQUAL(socket->remote_endpoint(), good4.endpoint());
+        BOOST_CHECK(Clock::now() - start >= 250ms);
+
+        // Then IPv4 is tried first for the same host.
+        start = Clock::now();
+        socket = connect_to_host(lk, yield);
+        BOOST_REQUIRE(socket);
+        BOOST_CHECK(Clock::now() - start < 200ms);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_cancel) {
+    asio::io_context ctx;
+    BlackHole bh1(ctx, asio::ip::address_v4::loopback());
+    BlackHole bh2(ctx, asio::ip::address_v4::loopback());
+
+    run_spawned(ctx, [&] (Async yield) {
+        auto lk = lookup("cancel.test", {bh1.endpoint(), bh2.endpoint()});
+
+        auto start = Clock::now();
+        auto socket = connect_to_host(lk, 600ms, yield);
+        BOOST_REQUIRE(!socket);
+        BOOST_CHECK_EQUAL(socket.error(), asio::error::timed_out);
+        BOOST_CHECK(Clock::now() - start < 2s);
+
+        Cancel cancel;
+        yield.spawn([&] (Async y) {
+            async_sleep(100ms, y);
+            cancel();
+        });
+        BOOST_CHECK_THROW( std::ignore = connect_to_host(lk, Async(yield.asio_yield(), cancel))
+                         , Async::Cancelled);
+    });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
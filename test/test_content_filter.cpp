@@ -0,0 +1,121 @@
+#define BOOST_TEST_MODULE content_filter
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+
+#include <cache/content_filter.h>
+
+BOOST_AUTO_TEST_SUITE(ouinet_content_filter)
+
+using namespace std;
+using namespace ouinet::cache;
+
+static ResourceId rid(const string& url)
+{
+    return ResourceId::from_url(url);
+}
+
+static ResourceId rid(size_t i)
+{
+    return rid("https://example.com/" + to_string(i));
+}
+
+BOOST_AUTO_TEST_CASE(test_add_remove) {
+    CountingContentFilter counting;
+    auto a = rid("https://example.com/a");
+    auto b = rid("https://example.com/b");
+
+    BOOST_CHECK(!counting.filter().may_contain(a));
+    BOOST_CHECK_EQUAL(counting.version(), 0u);
+
+    counting.add(a);
+    counting.add(b);
+    BOOST_CHECK(counting.filter().may_contain(a));
+    BOOST_CHECK(counting.filter().may_contain(b));
+    BOOST_CHECK(counting.version() > 0);
+
+    // Bits shared by both are kept.
+    auto v = counting.version();
+    counting.remove(a);
+    BOOST_CHECK(!counting.filter().may_contain(a));
+    BOOST_CHECK(counting.filter().may_contain(b));
+    BOOST_CHECK(counting.version() > v);
+
+    // Counting several additions.
+    counting.add(b);
+    counting.remove(b);
+    BOOST_CHECK(counting.filter().may_contain(b));
+    counting.remove(b);
+    BOOST_CHECK(!counting.filter().may_contain(b));
+    BOOST_CHECK(counting.filter().diff(ContentFilter()).empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_false_positives) {
+    CountingContentFilter counting;
+    const size_t n = 5000;
+
+    for (size_t i = 0; i < n; ++i) counting.add(rid(i));
+
+    // No false negatives.
+    for (size_t i = 0; i < n; ++i)
+        BOOST_REQUIRE(counting.filter().may_contain(rid(i)));
+
+    size_t positives = 0;
+    for (size_t i = n; i < 2 * n; ++i)
+        if (counting.filter().may_contain(rid(i))) ++positives;
+
+    // About 0.5% expected.
+    BOOST_CHECK_LT(positives, n / 50);
+}
+
+BOOST_AUTO_TEST_CASE(test_bytes_and_diff) {
+    CountingContentFilter counting(1024, 3);
+    for (size_t i = 0; i < 50; ++i) counting.add(rid(i));
+
+    // As received by a peer.
+    auto& local = counting.filter();
+    auto remote = ContentFilter::from_bytes(local.bits(), local.hashes(), local.bytes());
+    BOOST_REQUIRE(remote);
+    BOOST_CHECK(remote->diff(local).empty());
+    for (size_t i = 0; i < 50; ++i) BOOST_CHECK(remote->may_contain(rid(i)));
+
+    // Apply changes as a delta.
+    for (size_t i = 0; i < 10; ++i) counting.remove(rid(i));
+    for (size_t i = 50; i < 60; ++i) counting.add(rid(i));
+
+    for (auto pos : counting.filter().diff(*remote))
+        remote->set(pos, !remote->test(pos));
+
+    BOOST_CHECK(remote->diff(counting.filter()).empty());
+    for (size_t i = 10; i < 60; ++i) BOOST_CHECK(remote->may_contain(rid(i)));
+
+    // Invalid parameters.
+    BOOST_CHECK(!ContentFilter::from_bytes(1024, 3, local.bytes().substr(1)));
+    BOOST_CHECK(!ContentFilter::from_bytes(1024, 0, local.bytes()));
+    BOOST_CHECK(!ContentFilter::from_bytes(ContentFilter::max_bits * 2, 3, string(ContentFilter::max_bits / 4, '\0')));
+}
+
+BOOST_AUTO_TEST_CASE(test_segments) {
+    CountingContentFilter counting;
+    for (size_t i = 0; i < 100; ++i) counting.add(rid(i));
+
+    // As received by a peer in several datagrams.
+    auto& local = counting.filter();
+    const size_t segment = 1000;  // not a divisor of the size
+    ContentFilter remote;
+    for (size_t off = 0; off < local.bytes().size(); off += segment)
+        BOOST_REQUIRE(remote.assign_bytes(off, local.bytes().substr(off, segment)));
+
+    BOOST_CHECK(remote.diff(local).empty());
+
+    // Out of bounds.
+    auto size = local.bytes().size();
+    BOOST_CHECK(remote.assign_bytes(size, ""));
+    BOOST_CHECK(!remote.assign_bytes(size, "x"));
+    BOOST_CHECK(!remote.assign_bytes(size - 1, "xy"));
+    BOOST_CHECK(!remote.assign_bytes(size + 1, ""));
+    BOOST_CHECK(remote.diff(local).empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,77 @@
+#define BOOST_TEST_MODULE crypto_pool
+#include <boost/test/unit_test.hpp>
+
+#include <thread>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/spawn.hpp>
+
+#include <util/crypto_pool.h>
+#include <task.h>
+
+#include <namespaces.h>
+
+namespace utf = boost::unit_test;
+
+BOOST_AUTO_TEST_SUITE(ouinet_crypto_pool, * utf::timeout(10))
+
+using namespace std;
+using namespace ouinet;
+using util::CryptoPool;
+
+BOOST_AUTO_TEST_CASE(test_lane_order) {
+    asio::io_context ctx;
+    CryptoPool pool(4);
+
+    task::spawn_detached(ctx, [&] (asio::yield_context yield) {
+        CryptoPool::Lane lane(pool);
+        // Only used by the lane's work items.
+        auto done = make_shared<vector<int>>();
+
+        vector<CryptoPool::Job<size_t>> jobs;
+        for (int i = 0; i < 100; ++i) {
+            jobs.push_back(lane.submit([done, i] {
+                done->push_back(i);
+                return done->size();
+            }));
+        }
+
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            BOOST_REQUIRE(jobs[i].valid());
+            BOOST_CHECK_EQUAL(jobs[i].wait(Async(yield)), i + 1);
+            BOOST_CHECK(!jobs[i].valid());
+        }
+
+        BOOST_REQUIRE_EQUAL(done->size(), 100u);
+        for (int i = 0; i < 100; ++i) BOOST_CHECK_EQUAL((*done)[i], i);
+    });
+
+    ctx.run();
+}
+
+BOOST_AUTO_TEST_CASE(test_wait) {
+    asio::io_context ctx;
+    CryptoPool pool(2);
+
+    task::spawn_detached(ctx, [&] (asio::yield_context yield) {
+        CryptoPool::Lane lane(pool);
+        auto caller = this_thread::get_id();
+
+        // The waiter is resumed in its own thread.
+        auto slow = lane.submit([] {
+            this_thread::sleep_for(chrono::milliseconds(100));
+            return this_thread::get_id();
+        });
+        BOOST_CHECK(slow.wait(Async(yield)) != caller);
+        BOOST_CHECK(this_thread::get_id() == caller);
+
+        // The result may be ready before waiting.
+        auto fast = lane.submit([] { return string("done"); });
+        this_thread::sleep_for(chrono::milliseconds(100));
+        BOOST_CHECK_EQUAL(fast.wait(Async(yield)), "done");
+    });
+
+    ctx.run();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
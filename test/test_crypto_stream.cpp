@@ -131,5 +131,47 @@ BOOST_AUTO_TEST_CASE(test_crypto_stream) {
     ctx.run();
 }
 
+BOOST_AUTO_TEST_CASE(test_put_back_read_past_end) {
+    asio::io_context ctx;
+
+    asio::spawn(ctx, [&] (asio::yield_context yield) {
+        auto [socket1, socket2] = util::connected_pair(yield);
+
+        auto key = *CryptoStreamKey::generate_random();
+
+        GenericStream s1(std::move(socket1));
+        GenericStream s2(std::move(socket2));
+
+        // Two messages on the same connection, each one encrypted on its own.
+        std::string msg1 = "brown fox", msg2 = "jumps over the lazy dog";
+        CryptoStream<StreamRef<GenericStream>> tx1(s1, key), tx2(s1, key);
+        asio::async_write(tx1, asio::buffer(msg1), yield);
+        asio::async_write(tx2, asio::buffer(msg2), yield);
+
+        // Read the first message along with whatever comes after it.
+        CryptoStream<StreamRef<GenericStream>> rx1(s2, key);
+        std::string received;
+        while (received.size() < msg1.size()) {
+            std::string buffer(64, 0);
+            auto n = rx1.async_read_some(asio::buffer(buffer), yield);
+            received += buffer.substr(0, n);
+        }
+        BOOST_REQUIRE_EQUAL(received.substr(0, msg1.size()), msg1);
+
+        sys::error_code ec;
+        auto unread = received.size() - msg1.size();
+        s2.put_back(rx1.last_read_encrypted(unread), ec);
+        BOOST_REQUIRE(!ec);
+
+        CryptoStream<StreamRef<GenericStream>> rx2(s2, key);
+        std::string buffer(msg2.size(), 0);
+        asio::async_read(rx2, asio::buffer(buffer), yield);
+        BOOST_REQUIRE_EQUAL(buffer, msg2);
+    },
+    check_exception);
+
+    ctx.run();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
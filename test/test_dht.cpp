@@ -9,6 +9,7 @@
 #include <util/compat.h>
 #include <util/debug.h>
 #include <util/hash.h>
+#include <util/str.h>
 
 #define private public
 #include <bittorrent/dht_storage.h>
@@ -130,6 +131,55 @@ BOOST_AUTO_TEST_CASE(test_bootstrap)
     ctx.run();
 }
 
+static DhtNode::RoutingSnapshot
+round_trip(const DhtNode::RoutingSnapshot& snapshot)
+{
+    return unwrap(DhtNode::RoutingSnapshot::parse(snapshot.serialize()));
+}
+
+BOOST_AUTO_TEST_CASE(test_routing_snapshot_round_trip)
+{
+    auto make_ep = [] (const char* addr, uint16_t port) {
+        return udp::endpoint(asio::ip::make_address(addr), port);
+    };
+
+    for (auto family : {"v4", "v6"}) {
+        bool v4 = string(family) == "v4";
+
+        DhtNode::RoutingSnapshot snapshot;
+        snapshot.saved = time_point_cast<seconds>(system_clock::now());
+        snapshot.wan_endpoint = v4 ? make_ep("203.0.113.7", 6881)
+                                   : make_ep("2001:db8::7", 6881);
+        snapshot.node_id = util::sha1_digest("self");
+
+        for (int i = 0; i < 3; ++i) {
+            auto ep = v4 ? make_ep("198.51.100.1", 1000 + i)
+                         : make_ep("2001:db8::1", 1000 + i);
+            snapshot.nodes.push_back({
+                { util::sha1_digest(util::str("node", i)), ep },
+                seconds(10 * i),
+                i });
+        }
+
+        BOOST_TEST_CONTEXT("family " << family) {
+            auto loaded = round_trip(snapshot);
+
+            BOOST_REQUIRE(loaded.saved == snapshot.saved);
+            BOOST_REQUIRE_EQUAL(loaded.wan_endpoint, snapshot.wan_endpoint);
+            BOOST_REQUIRE(loaded.node_id == snapshot.node_id);
+            BOOST_REQUIRE_EQUAL(loaded.nodes.size(), snapshot.nodes.size());
+
+            for (size_t i = 0; i < snapshot.nodes.size(); ++i) {
+                auto& l = loaded.nodes[i];
+                auto& s = snapshot.nodes[i];
+                BOOST_REQUIRE(l.contact == s.contact);
+                BOOST_REQUIRE(l.reply_age == s.reply_age);
+                BOOST_REQUIRE_EQUAL(l.queries_failed, s.queries_failed);
+            }
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(test_local)
 {
     get_logger().set_threshold(DEBUG);
@@ -0,0 +1,220 @@
+#define BOOST_TEST_MODULE fetch_coalescer
+#include <boost/test/unit_test.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/spawn.hpp>
+
+#include <fetch_coalescer.h>
+#include <response_part.h>
+#include <session.h>
+#include <task.h>
+#include "util/unwrap.h"
+
+#include <namespaces.h>
+
+namespace utf = boost::unit_test;
+
+BOOST_AUTO_TEST_SUITE(ouinet_fetch_coalescer, * utf::timeout(10))
+
+using namespace std;
+using namespace ouinet;
+
+using Part = http_response::Part;
+
+static const auto rid = cache::ResourceId::from_url("https://example.com/foo");
+
+// Returns the given parts, counting how many were read.
+class PartsReader : public http_response::AbstractReader {
+public:
+    PartsReader(asio::any_io_executor exec, vector<Part> parts, size_t& reads)
+        : _exec(std::move(exec))
+        , _parts(std::move(parts))
+        , _reads(reads)
+    {}
+
+    std::expected<std::optional<Part>, sys::error_code>
+    async_read_part(Async) override {
+        ++_reads;
+        if (_next == _parts.size()) {
+            _is_done = true;
+            return std::nullopt;
+        }
+        return _parts[_next++];
+    }
+
+    bool is_done() const override { return _is_done; }
+    void close() override {}
+    asio::any_io_executor get_executor() override { return _exec; }
+
+private:
+    asio::any_io_executor _exec;
+    vector<Part> _parts;
+    size_t _next = 0;
+    bool _is_done = false;
+    size_t& _reads;
+};
+
+static vector<Part> response_parts() {
+    http_response::Head head;
+    head.result(http::status::ok);
+    head.set(http::field::content_length, "6");
+
+    return { head
+           , http_response::Body({'f', 'o', 'o'})
+           , http_response::Body({'b', 'a', 'r'}) };
+}
+
+static Session upstream(asio::any_io_executor exec, size_t& reads, Async yield) {
+    return unwrap(Session::create(
+            make_unique<PartsReader>(exec, response_parts(), reads),
+            false, yield));
+}
+
+static vector<Part> read_all(Session& s, Async yield) {
+    vector<Part> parts;
+    for (;;) {
+        auto part = unwrap(s.async_read_part(yield));
+        if (!part) break;
+        parts.push_back(std::move(*part));
+    }
+    return parts;
+}
+
+static void run_spawned(std::function<void(asio::yield_context)> f) {
+    asio::io_context ctx;
+
+    task::spawn_detached(ctx.get_executor(), [f = std::move(f)] (auto yield) {
+            try {
+                f(yield);
+            }
+            catch (const std::exception& e) {
+                BOOST_ERROR(string("Test ended with exception: ") + e.what());
+            }
+        });
+
+    ctx.run();
+}
+
+BOOST_AUTO_TEST_CASE(test_follow) {
+    run_spawned([&] (auto y) {
+        auto exec = y.get_executor();
+        FetchCoalescer coalescer(exec);
+
+        BOOST_REQUIRE(!coalescer.follow(rid, Async(y)));
+
+        auto leader = coalescer.lead(rid);
+        BOOST_REQUIRE(leader);
+        BOOST_REQUIRE(!coalescer.lead(rid));  // already in flight
+
+        size_t reads = 0;
+        auto leader_s = unwrap(leader->share(upstream(exec, reads, Async(y)), Async(y)));
+        auto follower_s = unwrap(coalescer.follow(rid, Async(y)));
+
+        BOOST_REQUIRE(leader_s.response_header() == follower_s.response_header());
+
+        auto leader_parts = read_all(leader_s, Async(y));
+        auto follower_parts = read_all(follower_s, Async(y));
+        BOOST_REQUIRE(leader_parts == follower_parts);
+        BOOST_REQUIRE_EQUAL(leader_parts.size(), 3u);
+
+        // The upstream response was only read once
+        // (head, two body parts and end).
+        BOOST_REQUIRE_EQUAL(reads, 4u);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_wait_for_leader) {
+    run_spawned([&] (auto y) {
+        auto exec = y.get_executor();
+        FetchCoalescer coalescer(exec);
+
+        auto leader = coalescer.lead(rid);
+        BOOST_REQUIRE(leader);
+
+        bool followed = false;
+        task::spawn_detached(exec, [&] (asio::yield_context y) {
+            auto s = unwrap(coalescer.follow(rid, Async(y)));
+            BOOST_REQUIRE_EQUAL(read_all(s, Async(y)).size(), 3u);
+            followed = true;
+        });
+
+        // Let the follower attach before sharing.
+        asio::post(exec, y);
+        BOOST_REQUIRE(!followed);
+
+        size_t reads = 0;
+        auto leader_s = unwrap(leader->share(upstream(exec, reads, Async(y)), Async(y)));
+        BOOST_REQUIRE_EQUAL(read_all(leader_s, Async(y)).size(), 3u);
+
+        asio::post(exec, y);
+        BOOST_REQUIRE(followed);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_abandon) {
+    run_spawned([&] (auto y) {
+        auto exec = y.get_executor();
+        FetchCoalescer coalescer(exec);
+
+        auto leader = coalescer.lead(rid);
+        BOOST_REQUIRE(leader);
+
+        bool failed = false;
+        task::spawn_detached(exec, [&] (asio::yield_context y) {
+            auto s = coalescer.follow(rid, Async(y));
+            BOOST_REQUIRE(!s);
+            failed = true;
+        });
+
+        asio::post(exec, y);
+        leader->abandon();
+        asio::post(exec, y);
+        BOOST_REQUIRE(failed);
+
+        // Another request may lead a new fetch.
+        BOOST_REQUIRE(coalescer.lead(rid));
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_max_buffered) {
+    run_spawned([&] (auto y) {
+        auto exec = y.get_executor();
+        FetchCoalescer coalescer(exec, 4);
+
+        auto leader = coalescer.lead(rid);
+        size_t reads = 0;
+        auto leader_s = unwrap(leader->share(upstream(exec, reads, Async(y)), Async(y)));
+        auto follower_s = unwrap(coalescer.follow(rid, Async(y)));
+
+        BOOST_REQUIRE_EQUAL(read_all(leader_s, Async(y)).size(), 3u);
+
+        // Too much data to accept new followers,
+        // but existing ones still get all of it.
+        BOOST_REQUIRE(!coalescer.follow(rid, Async(y)));
+        BOOST_REQUIRE_EQUAL(coalescer.size(), 0u);
+        BOOST_REQUIRE(read_all(follower_s, Async(y)) == response_parts());
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_leader_gone) {
+    run_spawned([&] (auto y) {
+        auto exec = y.get_executor();
+        FetchCoalescer coalescer(exec);
+
+        auto leader = coalescer.lead(rid);
+        size_t reads = 0;
+        auto leader_s = unwrap(leader->share(upstream(exec, reads, Async(y)), Async(y)));
+        auto follower_s = unwrap(coalescer.follow(rid, Async(y)));
+
+        // The leader goes away after reading the head,
+        // the rest of the response is still read for the follower.
+        BOOST_REQUIRE(unwrap(leader_s.async_read_part(Async(y))));
+        leader_s = Session();
+
+        BOOST_REQUIRE(read_all(follower_s, Async(y)) == response_parts());
+        BOOST_REQUIRE_EQUAL(reads, 4u);
+    });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -254,6 +254,36 @@ BOOST_AUTO_TEST_CASE(test_truncate_file)
     }
 }
 
+BOOST_AUTO_TEST_CASE(test_truncate_file_position)
+{
+    temp_file temp_file{test_id};
+    std::string expected_string = "abcXYZ";
+
+    run([&](Async yield) {
+        {
+            async_file_handle aio_file = unwrap(file_io::open_or_create(
+                    exec,
+                    temp_file.get_name()));
+            unwrap(file_io::write(aio_file, boost::asio::const_buffer("abcxyz", 6), yield));
+        }
+
+        // Reopened at position 0, truncating moves to the new end.
+        async_file_handle aio_file = unwrap(file_io::open_or_create(
+                exec,
+                temp_file.get_name()));
+        unwrap(file_io::truncate(aio_file, 3));
+        BOOST_TEST(unwrap(file_io::current_position(aio_file)) == 3u);
+        unwrap(file_io::write(aio_file, boost::asio::const_buffer("XYZ", 3), yield));
+    });
+
+    BOOST_REQUIRE(boost::filesystem::exists(temp_file.get_name()));
+    if (std::ifstream input{temp_file.get_name()} ) {
+        std::string current_string;
+        input >> current_string;
+        BOOST_TEST(expected_string == current_string);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(test_check_or_create_directory)
 {
     temp_file temp_file{test_id};
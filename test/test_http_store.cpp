@@ -16,6 +16,7 @@
 #include <cache/http_sign.h>
 #include <cache/http_store.h>
 #include <cache/chain_hasher.h>
+#include <cache/sigs_file.h>
 #include <defer.h>
 #include <response_part.h>
 #include <session.h>
@@ -200,8 +201,10 @@ static void run_spawned(std::function<void(Async)> f) {
     ctx.run();
 }
 
-void store_response( const fs::path& tmpdir, bool complete, Async yield) {
+std::expected<void, sys::error_code>
+store_response( const fs::path& tmpdir, bool complete, Async yield, bool resume = false) {
     asio::any_io_executor exec = yield.get_executor();
+    std::expected<void, sys::error_code> result;
 
     auto [signed_w, signed_r] = util::connected_pair(yield);
 
@@ -243,14 +246,24 @@ void store_response( const fs::path& tmpdir, bool complete, Async yield) {
     });
 
     // Store response.
-    yield.spawn([ signed_r = std::move(signed_r), &tmpdir, complete
+    yield.spawn([ signed_r = std::move(signed_r), &tmpdir, complete, resume, &result
                 , lock = wc.lock()] (auto y) mutable {
         http_response::Reader signed_rr(std::move(signed_r));
-        auto r = cache::http_store(signed_rr, tmpdir, y);
-        BOOST_CHECK(!complete || r);
+        if (resume) {
+            result = cache::http_store_resume(signed_rr, tmpdir, y);
+            // Let the sender finish.
+            while (true) {
+                auto part = signed_rr.async_read_part(y);
+                if (!part || !*part) break;
+            }
+            return;
+        }
+        result = cache::http_store(signed_rr, tmpdir, y);
+        BOOST_CHECK(!complete || result);
     });
 
     wc.wait(yield);
+    return result;
 }
 
 void store_response_external( const fs::path& tmpdir, const fs::path& tmpcdir, Async yield) {
@@ -341,6 +354,22 @@ static const string rs_body_complete =
     + rs_block_data[2]);
 
 static string rs_sigs(bool complete) {
+    auto h = cache::sigs_file::header();
+    string s = util::bytes::to_string(h);
+    // Last signature missing when incomplete.
+    auto last_b = complete ? rs_block_data.size() : rs_block_data.size() - 1;
+    for (size_t b = 0; b < last_b; ++b) {
+        cache::sigs_file::Record rec{ b * http_::response_data_block
+                                    , *util::base64_decode<sign::Signature::Bytes>(rs_block_sig[b])
+                                    , rs_block_dhash_raw[b]
+                                    , rs_block_chash_raw(b + 1)};  // chained hash of this block
+        s += util::bytes::to_string(rec.serialize());
+    }
+    return s;
+}
+
+// As written by older versions in `data-v4`.
+static string rs_sigs_text(bool complete) {
     stringstream ss;
     // Last signature missing when incomplete.
     auto last_b = complete ? rs_block_data.size() : rs_block_data.size() - 1;
@@ -352,6 +381,12 @@ static string rs_sigs(bool complete) {
     return ss.str();
 }
 
+static void write_file(const fs::path& p, const string& data, Async yield) {
+    fs::remove(p);
+    auto f = unwrap(util::file_io::open_or_create(yield.get_executor(), p));
+    unwrap(util::file_io::write(f, asio::buffer(data), yield));
+}
+
 static const bool true_false[] = {true, false};
 
 BOOST_DATA_TEST_CASE(test_write_response, boost::unit_test::data::make(true_false), complete) {
@@ -399,6 +434,87 @@ BOOST_DATA_TEST_CASE(test_write_response, boost::unit_test::data::make(true_fals
     });
 }
 
+BOOST_DATA_TEST_CASE(test_upgrade_sigs, boost::unit_test::data::make(true_false), complete) {
+    auto tmpdir = fs::unique_path();
+    auto rmdir = ouinet::defer([&tmpdir] {
+        sys::error_code ec;
+        fs::remove_all(tmpdir, ec);
+    });
+    fs::create_directory(tmpdir);
+
+    run_spawned([&] (auto yield) {
+        auto exec = yield.get_executor();
+
+        store_response(tmpdir, complete, yield);
+        write_file(tmpdir / "sigs", rs_sigs_text(complete), yield);
+
+        // Legacy signatures are still usable.
+        {
+            cache::HashList hl = unwrap(cache::http_store_load_hash_list(tmpdir, yield));
+            BOOST_REQUIRE(hl.verify());
+        }
+
+        BOOST_REQUIRE(unwrap(cache::sigs_file::upgrade(tmpdir, yield)));
+        BOOST_REQUIRE(!unwrap(cache::sigs_file::upgrade(tmpdir, yield)));  // already upgraded
+
+        auto f = unwrap(util::file_io::open_readonly(exec, tmpdir / "sigs"));
+        std::string sigs(unwrap(util::file_io::file_size(f)), '\0');
+        unwrap(util::file_io::read(f, asio::buffer(sigs), yield));
+        BOOST_CHECK(sigs == rs_sigs(complete));
+
+        auto sigsm = unwrap(cache::sigs_file::MappedFile::open(tmpdir / "sigs"));
+        BOOST_REQUIRE_EQUAL(sigsm.size(), complete ? rs_block_data.size() : rs_block_data.size() - 1);
+        for (size_t b = 0; b < sigsm.size(); ++b) {
+            BOOST_CHECK_EQUAL(sigsm[b].offset, b * http_::response_data_block);
+            BOOST_CHECK(sigsm[b].block_digest == rs_block_dhash_raw[b]);
+            BOOST_CHECK(sigsm[b].chained_digest == rs_block_chash_raw(b + 1));
+        }
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_resume_response) {
+    auto tmpdir = fs::unique_path();
+    auto rmdir = ouinet::defer([&tmpdir] {
+        sys::error_code ec;
+        fs::remove_all(tmpdir, ec);
+    });
+    fs::create_directory(tmpdir);
+
+    run_spawned([&] (auto yield) {
+        auto exec = yield.get_executor();
+
+        auto read_file = [&] (auto fname) {
+            auto f = unwrap(util::file_io::open_readonly(exec, tmpdir / fname));
+            std::string fdata(unwrap(util::file_io::file_size(f)), '\0');
+            unwrap(util::file_io::read(f, asio::buffer(fdata), yield));
+            return fdata;
+        };
+
+        // Nothing to resume yet.
+        BOOST_REQUIRE(!store_response(tmpdir, true, yield, true));
+
+        store_response(tmpdir, false, yield);
+
+        // Mark the data of the first block, which is stored with its signature,
+        // to check that it is not written again.
+        auto body = read_file("body");
+        body[0] = '-';
+        write_file(tmpdir / "body", body, yield);
+
+        unwrap(store_response(tmpdir, true, yield, true));
+
+        BOOST_CHECK_EQUAL(read_file("head"), rs_head_complete);
+        BOOST_CHECK_EQUAL(read_file("sigs"), rs_sigs(true));
+        body = read_file("body");
+        BOOST_CHECK_EQUAL(body.size(), rs_body_complete.size());
+        BOOST_CHECK_EQUAL(body[0], '-');
+        BOOST_CHECK(body.substr(1) == rs_body_complete.substr(1));
+
+        // A complete response is not resumed.
+        BOOST_REQUIRE(!store_response(tmpdir, true, yield, true));
+    });
+}
+
 BOOST_AUTO_TEST_CASE(test_read_response_missing) {
     run_spawned([&] (auto yield) {
         auto tmpdir = fs::unique_path();
@@ -849,6 +965,17 @@ BOOST_DATA_TEST_CASE(test_hash_list, boost::unit_test::data::make(true_false), c
         store_response(tmpdir, complete, yield);
         cache::HashList hl = unwrap(cache::http_store_load_hash_list(tmpdir, yield));
         BOOST_REQUIRE(hl.verify());
+
+        // The pipeline depth advertised by a peer is bounded.
+        hl.pipeline_depth = 1000;
+        auto [hl_w, hl_r] = util::connected_pair(yield);
+        GenericStream hl_ws(std::move(hl_w));
+        unwrap(hl.write(hl_ws, yield));
+        hl_ws.close();
+
+        http_response::Reader hl_rr(std::move(hl_r));
+        auto loaded = unwrap(cache::HashList::load(hl_rr, hl.signed_head.public_key(), yield));
+        BOOST_CHECK_EQUAL(loaded.pipeline_depth, cache::HashList::max_pipeline_depth);
     });
 }
 
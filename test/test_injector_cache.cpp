@@ -0,0 +1,449 @@
+#define BOOST_TEST_MODULE injector_cache
+#include <boost/test/unit_test.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/spawn.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include <array>
+#include <chrono>
+#include <ctime>
+
+#include <async_sleep.h>
+#include <cache/http_sign.h>
+#include <defer.h>
+#include <injector_cache.h>
+#include <response_part.h>
+#include <session.h>
+#include <task.h>
+#include <util.h>
+#include "util/unwrap.h"
+
+#include <namespaces.h>
+
+namespace utf = boost::unit_test;
+
+BOOST_AUTO_TEST_SUITE(ouinet_injector_cache, * utf::timeout(10))
+
+using namespace std;
+using namespace std::chrono_literals;
+using namespace ouinet;
+
+using Part = http_response::Part;
+
+static const auto rid = cache::ResourceId::from_url("https://example.com/foo");
+
+// Returns the given parts.
+class PartsReader : public http_response::AbstractReader {
+public:
+    PartsReader(asio::any_io_executor exec, vector<Part> parts)
+        : _exec(std::move(exec))
+        , _parts(std::move(parts))
+    {}
+
+    std::expected<std::optional<Part>, sys::error_code>
+    async_read_part(Async) override {
+        if (_next == _parts.size()) {
+            _is_done = true;
+            return std::nullopt;
+        }
+        return _parts[_next++];
+    }
+
+    bool is_done() const override { return _is_done; }
+    void close() override {}
+    asio::any_io_executor get_executor() override { return _exec; }
+
+private:
+    asio::any_io_executor _exec;
+    vector<Part> _parts;
+    size_t _next = 0;
+    bool _is_done = false;
+};
+
+static http_response::Head response_head(const string& cache_control, const string& set_cookie = "") {
+    http_response::Head head;
+    head.result(http::status::ok);
+    head.set(http::field::content_length, "6");
+    if (!cache_control.empty()) head.set(http::field::cache_control, cache_control);
+    if (!set_cookie.empty()) head.set(http::field::set_cookie, set_cookie);
+    return head;
+}
+
+// A response as signed by the injector, which can be stored on disk.
+// Signatures are not checked when storing, so they are just made up.
+static vector<Part> signed_parts(const string& cache_control, const string& url) {
+    http_response::Head head;
+    head.result(http::status::ok);
+    head.set(http::field::cache_control, cache_control);
+    head.set(http_::protocol_version_hdr, "6");
+    head.set(http_::response_uri_hdr, url);
+    head.set( http_::response_injection_hdr
+            , "id=d6076384-2295-462b-a047-fe2c9274e58d,ts=" + to_string(time(nullptr)));
+    head.set( http_::response_block_signatures_hdr
+            , "keyId=\"ed25519=DlBwx8WbSsZP7eni20bf5VKUH3t1XAF/+hlDoLbZzuw=\","
+              "algorithm=\"hs2019\",size=65536");
+    head.set(http::field::transfer_encoding, "chunked");
+
+    auto sig = util::base64_encode(array<uint8_t, 64>{});
+
+    return { head
+           , http_response::ChunkHdr(6, "")
+           , http_response::ChunkBody({'f', 'o', 'o', 'b', 'a', 'r'}, 0)
+           , http_response::ChunkHdr(0, ";" + http_::response_block_signature_ext + "=\"" + sig + "\"")
+           , http_response::Trailer() };
+}
+
+// An origin which counts how many times it was fetched from.
+struct Origin {
+    string cache_control;
+    chrono::milliseconds delay{0};
+    string set_cookie;
+    string signed_url;  // if not empty, send a signed response for it
+    size_t fetches = 0;
+
+    InjectorCache::FetchFresh fetch_fresh() {
+        return [this] (Async yield) {
+            ++fetches;
+            if (delay.count()) async_sleep(delay, yield);
+
+            vector<Part> parts{ response_head(cache_control, set_cookie)
+                              , http_response::Body({'f', 'o', 'o'})
+                              , http_response::Body({'b', 'a', 'r'}) };
+            if (!signed_url.empty()) parts = signed_parts(cache_control, signed_url);
+
+            return Session::create(
+                    make_unique<PartsReader>(yield.get_executor(), std::move(parts)),
+                    false, yield);
+        };
+    }
+};
+
+static vector<Part> read_all(Session& s, Async yield) {
+    vector<Part> parts;
+    for (;;) {
+        auto part = unwrap(s.async_read_part(yield));
+        if (!part) break;
+        parts.push_back(std::move(*part));
+    }
+    return parts;
+}
+
+static vector<Part> fetch_all( InjectorCache& cache, const cache::ResourceId& key
+                             , Origin& origin, bool revalidate, Async yield) {
+    auto s = unwrap(cache.fetch(key, revalidate, origin.fetch_fresh(), yield));
+    return read_all(s, yield);
+}
+
+static vector<Part> fetch_all( InjectorCache& cache, Origin& origin
+                             , bool revalidate, Async yield) {
+    return fetch_all(cache, rid, origin, revalidate, yield);
+}
+
+static string body_of(const vector<Part>& parts) {
+    string body;
+    for (auto& part : parts) {
+        if (auto b = part.as_body()) body.append(b->begin(), b->end());
+        if (auto b = part.as_chunk_body()) body.append(b->begin(), b->end());
+    }
+    return body;
+}
+
+// Responses are stored on disk in the background.
+static void wait_for_disk_size(InjectorCache& cache, size_t old_size, Async yield) {
+    while (cache.disk_size() == old_size) async_sleep(10ms, yield);
+}
+
+static void run_spawned(std::function<void(asio::yield_context)> f) {
+    asio::io_context ctx;
+
+    task::spawn_detached(ctx.get_executor(), [f = std::move(f)] (auto yield) {
+            try {
+                f(yield);
+            }
+            catch (const std::exception& e) {
+                BOOST_ERROR(string("Test ended with exception: ") + e.what());
+            }
+        });
+
+    ctx.run();
+}
+
+BOOST_AUTO_TEST_CASE(test_key) {
+    http::request_header<> rq;
+    rq.method(http::verb::get);
+    rq.target("https://example.com/foo");
+    BOOST_REQUIRE(InjectorCache::key(rq) == rid);
+
+    rq.set(http::field::origin, "https://example.org");
+    BOOST_REQUIRE(!InjectorCache::key(rq));
+    rq.erase(http::field::origin);
+
+    rq.method(http::verb::post);
+    BOOST_REQUIRE(!InjectorCache::key(rq));
+}
+
+BOOST_AUTO_TEST_CASE(test_wants_revalidation) {
+    http::request_header<> rq;
+    BOOST_REQUIRE(!InjectorCache::wants_revalidation(rq));
+
+    rq.set(http::field::cache_control, "max-age=3600");
+    BOOST_REQUIRE(!InjectorCache::wants_revalidation(rq));
+
+    rq.set(http::field::cache_control, "max-age=0");
+    BOOST_REQUIRE(InjectorCache::wants_revalidation(rq));
+
+    rq.set(http::field::cache_control, "no-cache");
+    BOOST_REQUIRE(InjectorCache::wants_revalidation(rq));
+
+    rq.erase(http::field::cache_control);
+    rq.set(http::field::pragma, "no-cache");
+    BOOST_REQUIRE(InjectorCache::wants_revalidation(rq));
+}
+
+BOOST_AUTO_TEST_CASE(test_freshness_lifetime) {
+    auto lifetime = [] (const string& cache_control) {
+        return InjectorCache::freshness_lifetime(response_head(cache_control));
+    };
+
+    BOOST_REQUIRE(!lifetime(""));
+    BOOST_REQUIRE(!lifetime("max-age=0"));
+    BOOST_REQUIRE(!lifetime("max-age=60, no-store"));
+    BOOST_REQUIRE(!lifetime("max-age=60, no-cache"));
+    BOOST_REQUIRE(!lifetime("private, max-age=60"));
+    BOOST_REQUIRE(lifetime("max-age=60") == 60s);
+    BOOST_REQUIRE(lifetime("public, max-age=\"60\"") == 60s);
+    BOOST_REQUIRE(lifetime("max-age=60, s-maxage=600") == 600s);
+
+    auto head = response_head("max-age=60");
+    head.set(http::field::age, "20");
+    BOOST_REQUIRE(InjectorCache::freshness_lifetime(head) == 40s);
+
+    head.set(http::field::age, "60");
+    BOOST_REQUIRE(!InjectorCache::freshness_lifetime(head));
+
+    head = response_head("");
+    head.set(http::field::date, "Sun, 06 Nov 1994 08:49:37 GMT");
+    head.set(http::field::expires, "Sun, 06 Nov 1994 09:49:37 GMT");
+    BOOST_REQUIRE(InjectorCache::freshness_lifetime(head) == 3600s);
+
+    head = response_head("max-age=60");
+    head.set(http::field::set_cookie, "id=1");
+    BOOST_REQUIRE(!InjectorCache::freshness_lifetime(head));
+
+    head = response_head("max-age=60");
+    head.result(http::status::not_found);
+    BOOST_REQUIRE(!InjectorCache::freshness_lifetime(head));
+}
+
+BOOST_AUTO_TEST_CASE(test_memory_hit) {
+    run_spawned([&] (auto y) {
+        InjectorCache cache(y.get_executor(), {}, 1 << 20, 0);
+        Origin origin{"max-age=60"};
+
+        auto first = fetch_all(cache, origin, false, Async(y));
+        BOOST_REQUIRE_EQUAL(first.size(), 3u);
+        BOOST_REQUIRE_EQUAL(origin.fetches, 1u);
+        BOOST_REQUIRE(cache.memory_size() > 0);
+
+        auto second = fetch_all(cache, origin, false, Async(y));
+        BOOST_REQUIRE(first == second);
+        BOOST_REQUIRE_EQUAL(origin.fetches, 1u);
+
+        // Revalidation fetches it again (and caches the new response).
+        fetch_all(cache, origin, true, Async(y));
+        BOOST_REQUIRE_EQUAL(origin.fetches, 2u);
+        fetch_all(cache, origin, false, Async(y));
+        BOOST_REQUIRE_EQUAL(origin.fetches, 2u);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_not_cached) {
+    run_spawned([&] (auto y) {
+        InjectorCache cache(y.get_executor(), {}, 1 << 20, 0);
+        Origin origin{"no-store"};
+
+        fetch_all(cache, origin, false, Async(y));
+        fetch_all(cache, origin, false, Async(y));
+        BOOST_REQUIRE_EQUAL(origin.fetches, 2u);
+        BOOST_REQUIRE_EQUAL(cache.memory_size(), 0u);
+
+        // A response which is not completely read is not cached either.
+        origin.cache_control = "max-age=60";
+        {
+            auto s = unwrap(cache.fetch(rid, false, origin.fetch_fresh(), Async(y)));
+            unwrap(s.async_read_part(Async(y)));
+        }
+        BOOST_REQUIRE_EQUAL(cache.memory_size(), 0u);
+
+        // Nor one which does not fit.
+        InjectorCache small_cache(y.get_executor(), {}, 64, 0);
+        fetch_all(small_cache, origin, false, Async(y));
+        fetch_all(small_cache, origin, false, Async(y));
+        BOOST_REQUIRE_EQUAL(origin.fetches, 5u);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_coalesce_misses) {
+    run_spawned([&] (auto y) {
+        auto exec = y.get_executor();
+        InjectorCache cache(exec, {}, 1 << 20, 0);
+        Origin origin{"max-age=60", 100ms};
+
+        const size_t requests = 5;
+        size_t done = 0;
+
+        for (size_t i = 0; i < requests; ++i) {
+            task::spawn_detached(exec, [&] (asio::yield_context y) {
+                BOOST_REQUIRE_EQUAL(fetch_all(cache, origin, false, Async(y)).size(), 3u);
+                ++done;
+            });
+        }
+
+        while (done < requests) async_sleep(10ms, Async(y));
+
+        BOOST_REQUIRE_EQUAL(origin.fetches, 1u);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_no_coalesce_private) {
+    run_spawned([&] (auto y) {
+        auto exec = y.get_executor();
+        InjectorCache cache(exec, {}, 1 << 20, 0);
+        // Not cacheable, so not to be shared with other requests either.
+        Origin origin{"max-age=60", 100ms, "session=1234"};
+
+        const size_t requests = 2;
+        size_t done = 0;
+
+        for (size_t i = 0; i < requests; ++i) {
+            task::spawn_detached(exec, [&] (asio::yield_context y) {
+                BOOST_REQUIRE_EQUAL(fetch_all(cache, origin, false, Async(y)).size(), 3u);
+                ++done;
+            });
+        }
+
+        while (done < requests) async_sleep(10ms, Async(y));
+
+        BOOST_REQUIRE_EQUAL(origin.fetches, requests);
+        BOOST_REQUIRE_EQUAL(cache.memory_size(), 0u);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_disk_restart) {
+    auto tmpdir = fs::unique_path();
+    auto rmdir = defer([&tmpdir] {
+        sys::error_code ec;
+        fs::remove_all(tmpdir, ec);
+    });
+
+    Origin origin{"max-age=60"};
+    origin.signed_url = "https://example.com/foo";
+
+    run_spawned([&] (auto y) {
+        InjectorCache cache(y.get_executor(), tmpdir, 1 << 20, 1 << 20);
+        unwrap(cache.load(Async(y)));
+        BOOST_REQUIRE_EQUAL(cache.disk_size(), 0u);
+
+        BOOST_REQUIRE_EQUAL(body_of(fetch_all(cache, origin, false, Async(y))), "foobar");
+        wait_for_disk_size(cache, 0, Async(y));
+    });
+
+    // Another instance (without a memory cache) finds it on disk.
+    run_spawned([&] (auto y) {
+        InjectorCache cache(y.get_executor(), tmpdir, 0, 1 << 20);
+        BOOST_REQUIRE_EQUAL(cache.disk_size(), 0u);
+        unwrap(cache.load(Async(y)));
+        BOOST_REQUIRE(cache.disk_size() > 0);
+
+        BOOST_REQUIRE_EQUAL(body_of(fetch_all(cache, origin, false, Async(y))), "foobar");
+        BOOST_REQUIRE_EQUAL(origin.fetches, 1u);
+    });
+
+    // Stale responses are removed when loading.
+    origin.cache_control = "max-age=1";
+    run_spawned([&] (auto y) {
+        InjectorCache cache(y.get_executor(), tmpdir, 0, 1 << 20);
+        auto old_size = cache.disk_size();
+        fetch_all(cache, origin, true, Async(y));
+        wait_for_disk_size(cache, old_size, Async(y));
+    });
+    BOOST_REQUIRE_EQUAL(origin.fetches, 2u);
+
+    run_spawned([&] (auto y) {
+        async_sleep(2s, Async(y));
+        InjectorCache cache(y.get_executor(), tmpdir, 0, 1 << 20);
+        unwrap(cache.load(Async(y)));
+        BOOST_REQUIRE_EQUAL(cache.disk_size(), 0u);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_disk_eviction) {
+    auto tmpdir = fs::unique_path();
+    auto rmdir = defer([&tmpdir] {
+        sys::error_code ec;
+        fs::remove_all(tmpdir, ec);
+    });
+
+    // Responses for longer URLs take more space on disk,
+    // so that storing any of them changes the size of the disk cache.
+    auto url = [] (size_t i) { return "https://example.com/" + string(i + 1, 'x'); };
+    auto key = [&] (size_t i) { return cache::ResourceId::from_url(url(i)); };
+
+    Origin origin{"max-age=60"};
+
+    auto store = [&] (InjectorCache& cache, size_t i, Async yield) {
+        origin.signed_url = url(i);
+        auto old_size = cache.disk_size();
+        fetch_all(cache, key(i), origin, false, yield);
+        wait_for_disk_size(cache, old_size, yield);
+    };
+
+    array<size_t, 3> sizes;
+    run_spawned([&] (auto y) {
+        InjectorCache cache(y.get_executor(), tmpdir / "measure", 0, 1 << 20);
+        unwrap(cache.load(Async(y)));
+        for (size_t i = 0; i < sizes.size(); ++i) {
+            auto old_size = cache.disk_size();
+            store(cache, i, Async(y));
+            sizes[i] = cache.disk_size() - old_size;
+        }
+    });
+
+    // Room for two responses only, with no memory cache to serve them.
+    auto max_disk = sizes[1] + sizes[2] + sizes[0] / 2;
+
+    run_spawned([&] (auto y) {
+        InjectorCache cache(y.get_executor(), tmpdir / "evict", 0, max_disk);
+        unwrap(cache.load(Async(y)));
+
+        store(cache, 0, Async(y));
+        store(cache, 1, Async(y));
+        BOOST_REQUIRE_EQUAL(cache.disk_size(), sizes[0] + sizes[1]);
+
+        // The least recently used one is evicted.
+        store(cache, 2, Async(y));
+        BOOST_REQUIRE_EQUAL(cache.disk_size(), sizes[1] + sizes[2]);
+
+        auto fetches = origin.fetches;
+        for (size_t i : {2, 1}) {
+            origin.signed_url = url(i);
+            BOOST_REQUIRE_EQUAL(body_of(fetch_all(cache, key(i), origin, false, Async(y))), "foobar");
+        }
+        BOOST_REQUIRE_EQUAL(origin.fetches, fetches);
+
+        store(cache, 0, Async(y));
+        BOOST_REQUIRE_EQUAL(origin.fetches, fetches + 1);
+        BOOST_REQUIRE_EQUAL(cache.disk_size(), sizes[0] + sizes[1]);
+    });
+
+    // Loading enforces the budget as well.
+    run_spawned([&] (auto y) {
+        InjectorCache cache(y.get_executor(), tmpdir / "evict", 0, sizes[2]);
+        unwrap(cache.load(Async(y)));
+        BOOST_REQUIRE(cache.disk_size() > 0);
+        BOOST_REQUIRE(cache.disk_size() <= sizes[2]);
+    });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
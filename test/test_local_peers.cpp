@@ -0,0 +1,260 @@
+#define BOOST_TEST_MODULE local_peers
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <boost/asio/ip/address.hpp>
+
+#include <cache/local_peers.h>
+
+BOOST_AUTO_TEST_SUITE(ouinet_local_peers)
+
+using namespace std;
+using namespace ouinet;
+using namespace ouinet::cache;
+
+using udp = asio::ip::udp;
+using Clock = LocalPeers::Clock;
+using PeerId = LocalPeers::PeerId;
+using Msgs = vector<string>;
+
+static const auto update_interval = chrono::seconds(5);
+
+static ResourceId rid(size_t i)
+{
+    return ResourceId::from_url("https://example.com/" + to_string(i));
+}
+
+static udp::endpoint ep(PeerId id)
+{
+    return {asio::ip::make_address("192.168.1." + to_string(id)), 28729};
+}
+
+static void add_peer(LocalPeers& peers, PeerId id)
+{
+    peers.add(id, ep(id), {ep(id)});
+}
+
+static void feed(LocalPeers& peers, PeerId id, const Msgs& msgs, Clock::time_point now)
+{
+    for (auto& msg : msgs) {
+        BOOST_REQUIRE(peers.handle_filter_message(id, msg, now));
+    }
+}
+
+static bool is_delta(const Msgs& msgs)
+{
+    return msgs.size() == 1 && msgs[0].starts_with("DELTA:");
+}
+
+static bool holds(const LocalPeers& peers, PeerId id, const ResourceId& r)
+{
+    auto holders = peers.likely_holders(r);
+    return find(holders.begin(), holders.end(), ep(id)) != holders.end();
+}
+
+// An announcer along with a filter with the same resources,
+// to pick resources which are surely not in it.
+struct Announcer {
+    ContentFilterAnnouncer announcer;
+    CountingContentFilter filter;
+
+    void add(const ResourceId& r) { announcer.add(r); filter.add(r); }
+
+    ResourceId absent() const {
+        for (size_t i = 1000;; ++i) {
+            if (!filter.filter().may_contain(rid(i))) return rid(i);
+        }
+    }
+};
+
+BOOST_AUTO_TEST_CASE(test_publish) {
+    auto t = Clock::now();
+    ContentFilterAnnouncer announcer;
+    announcer.add(rid(0));
+
+    // Nothing is sent to new peers until the filter is first published,
+    // since they would take an empty filter as holding nothing.
+    BOOST_CHECK(announcer.whole_filter().empty());
+
+    auto msgs = announcer.update(t);
+    auto segments = ContentFilter().bytes().size() / ContentFilterAnnouncer::segment_size;
+    BOOST_REQUIRE_EQUAL(msgs.size(), segments);
+    for (auto& msg : msgs) {
+        BOOST_CHECK(msg.starts_with("FILTER:"));
+    }
+    BOOST_CHECK(announcer.whole_filter() == msgs);
+
+    // No changes, nothing to send.
+    BOOST_CHECK(announcer.update(t + update_interval).empty());
+
+    // Other messages are left for the caller.
+    LocalPeers peers;
+    add_peer(peers, 1);
+    BOOST_CHECK(!peers.handle_filter_message(1, "BYE:", t));
+}
+
+BOOST_AUTO_TEST_CASE(test_reassembly) {
+    auto t = Clock::now();
+    Announcer a;
+    a.add(rid(0));
+    auto msgs = a.announcer.update(t);
+    BOOST_REQUIRE(msgs.size() > 1);
+
+    LocalPeers peers;
+
+    // Filters from unknown peers are ignored.
+    feed(peers, 1, msgs, t);
+    add_peer(peers, 1);
+    BOOST_CHECK(holds(peers, 1, a.absent()));
+
+    // Without some segment, there is still no filter for the peer.
+    Msgs incomplete(msgs.begin(), msgs.end() - 1);
+    feed(peers, 1, incomplete, t);
+    feed(peers, 1, incomplete, t);  // duplicated
+    BOOST_CHECK(holds(peers, 1, rid(0)));
+    BOOST_CHECK(holds(peers, 1, a.absent()));
+
+    feed(peers, 1, {msgs.back()}, t);
+    BOOST_CHECK(holds(peers, 1, rid(0)));
+    BOOST_CHECK(!holds(peers, 1, a.absent()));
+}
+
+BOOST_AUTO_TEST_CASE(test_newer_replaces_incomplete) {
+    auto t = Clock::now();
+    Announcer a;
+    a.add(rid(0));
+    auto old_msgs = a.announcer.update(t);
+    BOOST_REQUIRE(old_msgs.size() > 1);
+
+    a.add(rid(1));
+    auto msgs = a.announcer.update(t + ContentFilterAnnouncer::refresh_interval);
+    BOOST_REQUIRE_EQUAL(msgs.size(), old_msgs.size());
+
+    LocalPeers peers;
+    add_peer(peers, 1);
+
+    // Segments of both versions do not make a filter.
+    auto half = msgs.size() / 2;
+    feed(peers, 1, Msgs(old_msgs.begin(), old_msgs.begin() + half), t);
+    feed(peers, 1, Msgs(msgs.begin() + half, msgs.end()), t);
+    BOOST_CHECK(holds(peers, 1, a.absent()));
+
+    // Delayed segments of the older version are ignored.
+    feed(peers, 1, Msgs(old_msgs.begin() + half, old_msgs.end()), t);
+    BOOST_CHECK(holds(peers, 1, a.absent()));
+
+    feed(peers, 1, Msgs(msgs.begin(), msgs.begin() + half), t);
+    BOOST_CHECK(holds(peers, 1, rid(1)));
+    BOOST_CHECK(!holds(peers, 1, a.absent()));
+}
+
+BOOST_AUTO_TEST_CASE(test_delta) {
+    auto t = Clock::now();
+    Announcer a;
+    a.add(rid(0));
+
+    LocalPeers peers;
+    add_peer(peers, 1);
+    feed(peers, 1, a.announcer.update(t), t);
+
+    t += update_interval;
+    a.add(rid(1));
+    auto msgs = a.announcer.update(t);
+    BOOST_REQUIRE(is_delta(msgs));
+    BOOST_CHECK(!holds(peers, 1, rid(1)));
+    feed(peers, 1, msgs, t);
+    BOOST_CHECK(holds(peers, 1, rid(1)));
+    BOOST_CHECK(!holds(peers, 1, a.absent()));
+
+    // A missed delta makes the filter unknown
+    // (instead of giving false negatives).
+    t += update_interval;
+    a.add(rid(2));
+    BOOST_REQUIRE(is_delta(a.announcer.update(t)));  // lost
+
+    t += update_interval;
+    a.add(rid(3));
+    msgs = a.announcer.update(t);
+    BOOST_REQUIRE(is_delta(msgs));
+    feed(peers, 1, msgs, t);
+    BOOST_CHECK(holds(peers, 1, a.absent()));
+
+    // Further deltas are ignored until the whole filter is received again.
+    t += update_interval;
+    a.add(rid(4));
+    msgs = a.announcer.update(t);
+    BOOST_REQUIRE(is_delta(msgs));
+    feed(peers, 1, msgs, t);
+    BOOST_CHECK(holds(peers, 1, a.absent()));
+
+    feed(peers, 1, a.announcer.whole_filter(), t);
+    BOOST_CHECK(holds(peers, 1, rid(2)));
+    BOOST_CHECK(!holds(peers, 1, a.absent()));
+}
+
+BOOST_AUTO_TEST_CASE(test_refresh_with_changes) {
+    auto t0 = Clock::now();
+    ContentFilterAnnouncer announcer;
+    BOOST_REQUIRE(!announcer.update(t0).empty());
+
+    // Changes never stop, but the whole filter is still sent regularly.
+    bool refreshed = false;
+    for (size_t i = 0; !refreshed; ++i) {
+        auto t = t0 + (i + 1) * update_interval;
+        BOOST_REQUIRE(t - t0 <= ContentFilterAnnouncer::refresh_interval);
+        announcer.add(rid(i));
+        auto msgs = announcer.update(t);
+        refreshed = !is_delta(msgs);
+        if (refreshed) {
+            BOOST_CHECK(msgs == announcer.whole_filter());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_likely_holders_order) {
+    auto t = Clock::now();
+    auto r = rid(0);
+
+    Announcer with, without;
+    with.add(r);
+    without.add(rid(1));
+    BOOST_REQUIRE(!without.filter.filter().may_contain(r));
+
+    auto with_msgs = with.announcer.update(t);
+    auto without_msgs = without.announcer.update(t);
+
+    LocalPeers peers;
+    for (PeerId id = 1; id <= 4; ++id) add_peer(peers, id);
+
+    // No filters yet, all peers may hold the resource.
+    BOOST_CHECK_EQUAL(peers.likely_holders(r).size(), 4u);
+
+    feed(peers, 1, with_msgs, t);
+    feed(peers, 2, without_msgs, t);
+    feed(peers, 3, with_msgs, t + chrono::seconds(1));
+    // Peer 4 sends no filter.
+
+    auto holders = peers.likely_holders(r);
+    BOOST_REQUIRE_EQUAL(holders.size(), 3u);
+    BOOST_CHECK_EQUAL(holders[0], ep(3));  // freshest filter
+    BOOST_CHECK_EQUAL(holders[1], ep(1));
+    BOOST_CHECK_EQUAL(holders[2], ep(4));  // no filter
+
+    // A resent filter counts as fresh.
+    feed(peers, 1, with_msgs, t + chrono::seconds(2));
+    holders = peers.likely_holders(r);
+    BOOST_REQUIRE_EQUAL(holders.size(), 3u);
+    BOOST_CHECK_EQUAL(holders[0], ep(1));
+    BOOST_CHECK_EQUAL(holders[1], ep(3));
+
+    // Peers which leave are forgotten.
+    BOOST_CHECK(peers.remove(1));
+    BOOST_CHECK(!peers.remove(1));
+    BOOST_CHECK_EQUAL(peers.likely_holders(r).size(), 2u);
+    BOOST_CHECK_EQUAL(peers.found_peers().size(), 3u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -1,11 +1,17 @@
 #define BOOST_TEST_MODULE logger_tester
 #include <boost/test/unit_test.hpp>
 
+#include <fstream>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
 
 #include "namespaces.h"
 #include "logger.h"
+#include "log_writer.h"
 
 BOOST_AUTO_TEST_SUITE(logger_tester)
 
@@ -44,4 +50,86 @@ BOOST_AUTO_TEST_CASE(test_generate_node_id)
     LOG_DEBUG("This should not make it out from the default logger with the macro");
 }
 
+static fs::path temp_log_path() {
+    return fs::temp_directory_path() / fs::unique_path("ouinet-test-%%%%-%%%%.log");
+}
+
+static vector<string> read_lines(const fs::path& path) {
+    ifstream f(path.string());
+    vector<string> lines;
+    for (string l; getline(f, l);) lines.push_back(l);
+    return lines;
+}
+
+BOOST_AUTO_TEST_CASE(test_log_to_file)
+{
+    auto path = temp_log_path();
+
+    Logger log(INFO);
+    log.log_to_file(path.string());
+    BOOST_REQUIRE(log.is_logging_to_file());
+
+    for (int i = 0; i < 1000; ++i) {
+        log.info(util::str("message ", i));
+        log.debug("filtered out");
+    }
+    log.warn("last", "test_log_to_file");
+    log.flush();
+
+    auto lines = read_lines(path);
+    // An empty line and the start mark come first.
+    BOOST_REQUIRE_EQUAL(lines.size(), 1003u);
+    BOOST_CHECK_EQUAL(lines[1], "OUINET START");
+    for (int i = 0; i < 1000; ++i) {
+        auto suffix = util::str("[INFO]  message ", i);
+        BOOST_REQUIRE(lines[i + 2].ends_with(suffix));
+    }
+    BOOST_CHECK(lines.back().ends_with("[WARN]  test_log_to_file: last"));
+
+    log.log_to_file("");
+    BOOST_CHECK(!log.is_logging_to_file());
+    BOOST_CHECK(!fs::exists(path));
+}
+
+BOOST_AUTO_TEST_CASE(test_writer_drop)
+{
+    auto path = temp_log_path();
+    size_t pushed = 0, written = 0, dropped = 0;
+
+    {
+        LogWriter writer(4);
+        auto file = LogWriter::File::open(path.string());
+        BOOST_REQUIRE(file);
+
+        vector<thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&writer, file] {
+                for (int i = 0; i < 10000; ++i) {
+                    writer.push(file, "record\n", LogWriter::Overflow::drop);
+                }
+            });
+        }
+        for (auto& t : threads) t.join();
+        pushed = 4 * 10000;
+
+        // Dropped records are reported before the next one written.
+        BOOST_CHECK(writer.push(file, "end\n", LogWriter::Overflow::wait));
+        writer.flush();
+    }
+
+    auto lines = read_lines(path);
+    BOOST_REQUIRE(!lines.empty());
+    BOOST_CHECK_EQUAL(lines.back(), "end");
+    lines.pop_back();
+
+    for (auto& l : lines) {
+        if (l == "record") { ++written; continue; }
+        BOOST_REQUIRE(l.ends_with(" log records dropped]"));
+        dropped += stoul(l.substr(1));
+    }
+
+    BOOST_CHECK_EQUAL(written + dropped, pushed);
+    fs::remove(path);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,143 @@
+#define BOOST_TEST_MODULE origin_pools
+#include <boost/test/unit_test.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/spawn.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <origin_pools.h>
+#include <task.h>
+#include "connected_pair.h"
+
+#include <namespaces.h>
+
+namespace utf = boost::unit_test;
+
+BOOST_AUTO_TEST_SUITE(ouinet_origin_pools, * utf::timeout(10))
+
+using namespace std;
+using namespace ouinet;
+using tcp = asio::ip::tcp;
+
+static http::request_header<> request(const string& host) {
+    http::request_header<> rq;
+    rq.target("https://" + host + "/");
+    rq.set(http::field::host, host);
+    return rq;
+}
+
+// Keeps the remote ends of connections open.
+struct Origin {
+    vector<tcp::socket> remotes;
+
+    OriginPools::Connection connect( OriginPools& pools
+                                   , const http::request_header<>& rq
+                                   , asio::yield_context yield) {
+        auto [local, remote] = util::connected_pair(yield);
+        remotes.push_back(std::move(remote));
+        return pools.wrap(rq, GenericStream(std::move(local)));
+    }
+};
+
+static void run_spawned(std::function<void(asio::yield_context)> f) {
+    asio::io_context ctx;
+
+    task::spawn_detached(ctx.get_executor(), [f = std::move(f)] (auto yield) {
+            try {
+                f(yield);
+            }
+            catch (const std::exception& e) {
+                BOOST_ERROR(string("Test ended with exception: ") + e.what());
+            }
+        });
+
+    ctx.run();
+}
+
+BOOST_AUTO_TEST_CASE(test_limits) {
+    run_spawned([&] (auto y) {
+        OriginPools pools({ .max_idle = 3, .max_idle_per_host = 2 });
+        Origin origin;
+        auto rq_a = request("a.example.com");
+        auto rq_b = request("b.example.com");
+
+        BOOST_REQUIRE(!pools.get_connection(rq_a));
+
+        // Connections are put back to their pool when destroyed.
+        {
+            auto c1 = origin.connect(pools, rq_a, y);
+            auto c2 = origin.connect(pools, rq_a, y);
+            auto c3 = origin.connect(pools, rq_a, y);
+        }
+
+        auto s = pools.stats();
+        BOOST_REQUIRE_EQUAL(s.misses, 1u);
+        BOOST_REQUIRE_EQUAL(s.idle, 2u);
+        BOOST_REQUIRE_EQUAL(s.evicted, 1u);
+        BOOST_REQUIRE_EQUAL(s.hosts, 1u);
+
+        BOOST_REQUIRE(pools.get_connection(rq_a));
+        BOOST_REQUIRE_EQUAL(pools.stats().hits, 1u);
+        BOOST_REQUIRE_EQUAL(pools.stats().idle, 2u);  // it went back
+
+        // Connections to the least recently used origin are closed first.
+        {
+            auto c1 = origin.connect(pools, rq_b, y);
+            auto c2 = origin.connect(pools, rq_b, y);
+        }
+
+        s = pools.stats();
+        BOOST_REQUIRE_EQUAL(s.idle, 3u);
+        BOOST_REQUIRE_EQUAL(s.evicted, 2u);
+        BOOST_REQUIRE_EQUAL(s.hosts, 2u);
+
+        BOOST_REQUIRE(pools.get_connection(rq_b));
+        BOOST_REQUIRE(pools.get_connection(rq_b));
+        BOOST_REQUIRE(pools.get_connection(rq_a));
+        BOOST_REQUIRE_EQUAL(pools.stats().hits, 4u);
+    });
+}
+
+static void sleep_for(chrono::steady_clock::duration d, asio::yield_context yield) {
+    asio::steady_timer timer(yield.get_executor(), d);
+    timer.async_wait(yield);
+}
+
+BOOST_AUTO_TEST_CASE(test_idle_timeout) {
+    run_spawned([&] (auto y) {
+        const auto timeout = chrono::milliseconds(100);
+        OriginPools pools({ .idle_timeout = timeout });
+        Origin origin;
+        auto rq_a = request("a.example.com");
+        auto rq_b = request("b.example.com");
+
+        origin.connect(pools, rq_a, y);
+        BOOST_REQUIRE_EQUAL(pools.stats().idle, 1u);
+
+        // Not idle for long enough yet.
+        BOOST_REQUIRE(pools.get_connection(rq_a));
+        BOOST_REQUIRE_EQUAL(pools.stats().idle, 1u);  // it went back
+
+        sleep_for(2 * timeout, y);
+        BOOST_REQUIRE(!pools.get_connection(rq_a));
+
+        auto s = pools.stats();
+        BOOST_REQUIRE_EQUAL(s.expired, 1u);
+        BOOST_REQUIRE_EQUAL(s.idle, 0u);
+        BOOST_REQUIRE_EQUAL(s.hosts, 0u);
+
+        // A pool is kept while its connections are in use,
+        // so that they can go back to it.
+        {
+            auto c = origin.connect(pools, rq_b, y);
+            sleep_for(2 * timeout, y);
+            BOOST_REQUIRE(!pools.get_connection(rq_a));
+            BOOST_REQUIRE_EQUAL(pools.stats().hosts, 1u);
+        }
+
+        BOOST_REQUIRE_EQUAL(pools.stats().idle, 1u);
+        BOOST_REQUIRE(pools.get_connection(rq_b));
+    });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -82,7 +82,7 @@ HR::Part trailer(map<string, string> trailer) {
 }
 
 HR::Part read_full_body(RR& rr, Cancel& c, asio::yield_context y) {
-    HR::Body body({});
+    std::vector<uint8_t> body;
 
     while (true) {
         sys::error_code ec;
@@ -94,7 +94,7 @@ HR::Part read_full_body(RR& rr, Cancel& c, asio::yield_context y) {
         body.insert(body.end(), body_p->begin(), body_p->end());
     }
 
-    return body;
+    return HR::Body(std::move(body));
 }
 
 BOOST_AUTO_TEST_SUITE(ouinet_response_reader)
@@ -507,4 +507,47 @@ BOOST_AUTO_TEST_CASE(test_http11_restart_chunks_body) {
     ctx.run();
 }
 
+BOOST_AUTO_TEST_CASE(test_shared_body) {
+    // Copies of body parts share their data.
+    HR::Part part = HR::ChunkBody(str_to_vec("abcde"), 0);
+    HR::Part copy = part;
+
+    BOOST_REQUIRE_EQUAL(part, copy);
+    BOOST_REQUIRE(part.as_chunk_body()->data() == copy.as_chunk_body()->data());
+
+    HR::Body empty({});
+    BOOST_REQUIRE(empty.empty());
+    BOOST_REQUIRE_EQUAL(empty.buffer().size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(test_pooled_body) {
+    asio::io_context ctx;
+    auto pool = util::BytePool::get(ctx.get_executor());
+    BOOST_REQUIRE(pool == util::BytePool::get(ctx.get_executor()));
+
+    const uint8_t* storage;
+    {
+        util::SharedBytesWriter writer(pool);
+        HR::Body b1(writer.copy(asio::buffer("abc", 3)));
+        HR::Body b2(writer.copy(asio::buffer("de", 2)));
+
+        // Bodies are carved out of the same pooled storage.
+        storage = b1.data();
+        BOOST_REQUIRE(b2.data() == b1.data() + 3);
+        BOOST_REQUIRE_EQUAL(HR::Part(b2), body("de"));
+        BOOST_REQUIRE(b1.slice(1, 2) == util::SharedBytes({'b', 'c'}));
+        BOOST_REQUIRE_EQUAL(pool->free_slabs(), 0u);
+    }
+
+    // Storage is returned to the pool once unused, and reused.
+    BOOST_REQUIRE_EQUAL(pool->free_slabs(), 1u);
+    util::SharedBytesWriter writer(pool);
+    BOOST_REQUIRE(writer.copy(asio::buffer("f", 1)).data() == storage);
+
+    // Data not fitting in pooled storage is allocated.
+    std::vector<uint8_t> big(pool->slab_size() + 1);
+    BOOST_REQUIRE_EQUAL(writer.copy(asio::buffer(big)).size(), big.size());
+    BOOST_REQUIRE_EQUAL(pool->free_slabs(), 1u);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -1,6 +1,7 @@
 #define BOOST_TEST_MODULE routing_table
 #include <boost/test/unit_test.hpp>
 #include <boost/asio.hpp>
+#include <algorithm>
 #include <set>
 
 // Dirty trick to allow us inspect members of the RoutingTable class
@@ -43,6 +44,15 @@ bool unique(initializer_list<T> v)
     return v.size() == s.size();
 }
 
+// The contacts sorted by their distance to `target`, closest first.
+vector<NodeContact> closest_first(const NodeID& target, vector<NodeContact> cs)
+{
+    sort(cs.begin(), cs.end(), [&] (auto& l, auto& r) {
+        return (l.id ^ target) < (r.id ^ target);
+    });
+    return cs;
+}
+
 NodeID from_bitstr(string_view s) {
     NodeID ret;
     for (size_t i = 0; i < NodeID::bit_size; ++i) {
@@ -108,13 +118,13 @@ BOOST_AUTO_TEST_CASE(test_split_bucket) {
             rt.try_add_node(cs[i], true);
         }
 
-        auto ns = rt.find_closest_routing_nodes( from_bitstr("11111111")
-                                               , BUCKET_SIZE);
+        auto ns_target = from_bitstr("11111111");
+        auto ns = rt.find_closest_routing_nodes(ns_target, BUCKET_SIZE);
 
         BOOST_REQUIRE_EQUAL( ns.size(), BUCKET_SIZE);
         BOOST_REQUIRE_EQUAL( ns
-                           , vector<NodeContact>({ cs[0], cs[1], cs[2], cs[3]
-                                                 , cs[4], cs[5], cs[6], cs[7] }));
+                           , closest_first(ns_target, { cs[0], cs[1], cs[2], cs[3]
+                                                      , cs[4], cs[5], cs[6], cs[7] }));
 
         // Last one shouldn't be added
         BOOST_REQUIRE_EQUAL(rt._buckets.size(), 1u);
@@ -144,19 +154,19 @@ BOOST_AUTO_TEST_CASE(test_split_bucket) {
         BOOST_REQUIRE_EQUAL(rt._buckets[0].nodes.size(), BUCKET_SIZE);
         BOOST_REQUIRE_EQUAL(rt._buckets[1].nodes.size(), 1u);
 
-        auto ns1 = rt.find_closest_routing_nodes( from_bitstr("11111111")
-                                               , BUCKET_SIZE);
+        auto ns1_target = from_bitstr("11111111");
+        auto ns1 = rt.find_closest_routing_nodes(ns1_target, BUCKET_SIZE);
 
         BOOST_REQUIRE_EQUAL( ns1
-                           , vector<NodeContact>({ cs[0], cs[1], cs[2], cs[3]
-                                                 , cs[4], cs[5], cs[6], cs[7] }));
+                           , closest_first(ns1_target, { cs[0], cs[1], cs[2], cs[3]
+                                                       , cs[4], cs[5], cs[6], cs[7] }));
 
-        auto ns2 = rt.find_closest_routing_nodes( from_bitstr("0000000000")
-                                               , BUCKET_SIZE);
+        auto ns2_target = from_bitstr("0000000000");
+        auto ns2 = rt.find_closest_routing_nodes(ns2_target, BUCKET_SIZE);
 
         BOOST_REQUIRE_EQUAL( ns2
-                           , vector<NodeContact>({ cs[8], cs[0], cs[1], cs[2]
-                                                 , cs[3], cs[4], cs[5], cs[6] }));
+                           , closest_first(ns2_target, { cs[8], cs[1], cs[2], cs[3]
+                                                       , cs[4], cs[5], cs[6], cs[7] }));
     }
 
     {
@@ -185,12 +195,12 @@ BOOST_AUTO_TEST_CASE(test_split_bucket) {
         BOOST_REQUIRE_EQUAL(rt._buckets[0].nodes.size(), 5u);
         BOOST_REQUIRE_EQUAL(rt._buckets[1].nodes.size(), 4u);
 
-        auto ns1 = rt.find_closest_routing_nodes( from_bitstr("11111111")
-                                                , BUCKET_SIZE);
+        auto ns1_target = from_bitstr("11111111");
+        auto ns1 = rt.find_closest_routing_nodes(ns1_target, BUCKET_SIZE);
 
         BOOST_REQUIRE_EQUAL( ns1
-                           , vector<NodeContact>({ cs[0], cs[1], cs[2], cs[3]
-                                                 , cs[8], cs[4], cs[5], cs[6] }));
+                           , closest_first(ns1_target, { cs[0], cs[1], cs[2], cs[3]
+                                                       , cs[8], cs[5], cs[6], cs[7] }));
 
     }
 
@@ -268,12 +278,12 @@ BOOST_AUTO_TEST_CASE(test_three_buckets_add_to_middle) {
             BOOST_REQUIRE_EQUAL(rt._buckets[0].nodes.size(), 8u);
             BOOST_REQUIRE_EQUAL(rt._buckets[1].nodes.size(), 8u);
 
-            auto ns1 = rt.find_closest_routing_nodes( from_bitstr("11111111")
-                                                    , BUCKET_SIZE);
+            auto ns1_target = from_bitstr("11111111");
+            auto ns1 = rt.find_closest_routing_nodes(ns1_target, BUCKET_SIZE);
 
             BOOST_REQUIRE_EQUAL( ns1
-                               , vector<NodeContact>({ cs[0], cs[1], cs[2], cs[3]
-                                                     , cs[4], cs[5], cs[6], cs[7] }));
+                               , closest_first(ns1_target, { cs[0], cs[1], cs[2], cs[3]
+                                                           , cs[4], cs[5], cs[6], cs[7] }));
         }
 
         NodeContact c { from_bitstr("0100"), endpoint(ip, 5016) };
@@ -286,29 +296,34 @@ BOOST_AUTO_TEST_CASE(test_three_buckets_add_to_middle) {
         BOOST_REQUIRE_EQUAL(rt._buckets[2].nodes.size(), 8u);
 
         {
-            auto ns = rt.find_closest_routing_nodes( from_bitstr("11111111")
-                                                   , BUCKET_SIZE);
+            auto ns_target = from_bitstr("11111111");
+            auto ns = rt.find_closest_routing_nodes(ns_target, BUCKET_SIZE);
 
             BOOST_REQUIRE_EQUAL( ns
-                               , vector<NodeContact>({ cs[0], cs[1], cs[2], cs[3]
-                                                     , cs[4], cs[5], cs[6], cs[7] }));
+                               , closest_first(ns_target, { cs[0], cs[1], cs[2], cs[3]
+                                                          , cs[4], cs[5], cs[6], cs[7] }));
         }
 
         {
-            auto ns = rt.find_closest_routing_nodes( from_bitstr("00000000")
-                                                    , BUCKET_SIZE);
+            auto ns_target = from_bitstr("00000000");
+            auto ns = rt.find_closest_routing_nodes(ns_target, BUCKET_SIZE);
 
             BOOST_REQUIRE_EQUAL( ns
-                               , vector<NodeContact>({ cs[8],  cs[9], cs[10], cs[11]
-                                                     , cs[12], cs[13], cs[14], cs[15] }));
+                               , closest_first(ns_target, { cs[8],  cs[9], cs[10], cs[11]
+                                                          , cs[12], cs[13], cs[14], cs[15] }));
         }
 
         {
-            auto ns = rt.find_closest_routing_nodes(c.id, BUCKET_SIZE);
+            auto ns_target = c.id;
+            auto ns = rt.find_closest_routing_nodes(ns_target, BUCKET_SIZE);
 
-            BOOST_REQUIRE_EQUAL( ns
-                               , vector<NodeContact>({ c,  cs[8], cs[9], cs[10]
-                                                     , cs[11], cs[12], cs[13], cs[14] }));
+            // Which node of the other bucket is left out
+            // depends on the random bits of `c`.
+            auto expected = closest_first(ns_target, { c,  cs[8], cs[9], cs[10], cs[11]
+                                                     , cs[12], cs[13], cs[14], cs[15] });
+            expected.resize(BUCKET_SIZE);
+
+            BOOST_REQUIRE_EQUAL(ns, expected);
         }
     }
 }
@@ -350,12 +365,12 @@ BOOST_AUTO_TEST_CASE(test_three_buckets_add_to_end) {
             BOOST_REQUIRE_EQUAL(rt._buckets[0].nodes.size(), 8u);
             BOOST_REQUIRE_EQUAL(rt._buckets[1].nodes.size(), 8u);
 
-            auto ns1 = rt.find_closest_routing_nodes( from_bitstr("11111111")
-                                                    , BUCKET_SIZE);
+            auto ns1_target = from_bitstr("11111111");
+            auto ns1 = rt.find_closest_routing_nodes(ns1_target, BUCKET_SIZE);
 
             BOOST_REQUIRE_EQUAL( ns1
-                               , vector<NodeContact>({ cs[0], cs[1], cs[2], cs[3]
-                                                     , cs[4], cs[5], cs[6], cs[7] }));
+                               , closest_first(ns1_target, { cs[0], cs[1], cs[2], cs[3]
+                                                           , cs[4], cs[5], cs[6], cs[7] }));
         }
 
         NodeContact c { from_bitstr("0001"), endpoint(ip, 5016) };
@@ -368,29 +383,122 @@ BOOST_AUTO_TEST_CASE(test_three_buckets_add_to_end) {
         BOOST_REQUIRE_EQUAL(rt._buckets[2].nodes.size(), 1u);
 
         {
-            auto ns = rt.find_closest_routing_nodes( from_bitstr("11111111")
-                                                   , BUCKET_SIZE);
+            auto ns_target = from_bitstr("11111111");
+            auto ns = rt.find_closest_routing_nodes(ns_target, BUCKET_SIZE);
 
             BOOST_REQUIRE_EQUAL( ns
-                               , vector<NodeContact>({ cs[0], cs[1], cs[2], cs[3]
-                                                     , cs[4], cs[5], cs[6], cs[7] }));
+                               , closest_first(ns_target, { cs[0], cs[1], cs[2], cs[3]
+                                                          , cs[4], cs[5], cs[6], cs[7] }));
         }
 
         {
-            auto ns = rt.find_closest_routing_nodes( from_bitstr("00000000")
-                                                    , BUCKET_SIZE);
+            auto ns_target = from_bitstr("00000000");
+            auto ns = rt.find_closest_routing_nodes(ns_target, BUCKET_SIZE);
 
             BOOST_REQUIRE_EQUAL( ns
-                               , vector<NodeContact>({ c,     cs[8],  cs[9], cs[10]
-                                                     , cs[11], cs[12], cs[13], cs[14] }));
+                               , closest_first(ns_target, { c,     cs[8],  cs[9], cs[10]
+                                                          , cs[11], cs[12], cs[13], cs[14] }));
         }
 
         {
-            auto ns = rt.find_closest_routing_nodes(cs[8].id, BUCKET_SIZE);
+            auto ns_target = cs[8].id;
+            auto ns = rt.find_closest_routing_nodes(ns_target, BUCKET_SIZE);
 
             BOOST_REQUIRE_EQUAL( ns
-                               , vector<NodeContact>({ cs[8],  cs[9], cs[10], cs[11]
-                                                     , cs[12], cs[13], cs[14], cs[15] }));
+                               , closest_first(ns_target, { cs[8],  cs[9], cs[10], cs[11]
+                                                          , cs[12], cs[13], cs[14], cs[15] }));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_restore) {
+    using namespace std::chrono_literals;
+
+    static const auto BUCKET_SIZE = RoutingTable::BUCKET_SIZE;
+
+    NodeID my_id = from_bitstr("00000000");
+
+    size_t pings_sent = 0;
+    auto send_ping = [&] (NodeContact) { ++pings_sent; };
+
+    RoutingTable rt1(my_id, send_ping);
+
+    const string ip = "192.168.0.1";
+
+    for (uint16_t i = 0; i < BUCKET_SIZE; ++i) {
+        rt1.try_add_node({ NodeID::Range::max().random_id(), endpoint(ip, 5000 + i) }, true);
+    }
+
+    auto stored = rt1.stored_nodes();
+
+    BOOST_REQUIRE_EQUAL(stored.size(), BUCKET_SIZE);
+
+    // Pretend the first node has not replied for a while.
+    stored[0].reply_age = 20min;
+    stored[0].queries_failed = 1;
+
+    RoutingTable rt2(my_id, send_ping);
+    rt2.restore(stored, 10min);
+
+    BOOST_REQUIRE_EQUAL(pings_sent, 0u);
+    BOOST_REQUIRE(rt2.dump_contacts() == rt1.dump_contacts());
+
+    bool found = false;
+
+    auto now = RoutingTable::Clock::now();
+
+    for (auto& b : rt2._buckets) {
+        for (size_t i = 0; i < b.nodes.size(); ++i) {
+            auto n = b.nodes.get(i);
+            if (!(n.contact == stored[0].contact)) {
+                // Not heard from during the downtime.
+                BOOST_REQUIRE(!n.is_questionable(now));
+                BOOST_REQUIRE(n.recv_time <= now - 10min);
+                continue;
+            }
+            found = true;
+            BOOST_REQUIRE(n.is_questionable(now));
+            BOOST_REQUIRE_EQUAL(n.queries_failed, 1);
+        }
+    }
+
+    BOOST_REQUIRE(found);
+}
+
+BOOST_AUTO_TEST_CASE(test_find_closest_exact) {
+    static const auto BUCKET_SIZE = RoutingTable::BUCKET_SIZE;
+
+    NodeID my_id = NodeID::Range::max().random_id();
+
+    RoutingTable rt(my_id, [&] (NodeContact) {});
+
+    // Nodes in every bucket, each differing from us first at a random bit.
+    for (size_t i = 0; i < 5000; ++i) {
+        auto prefix = my_id.to_bitstr().substr(0, rand() % 24);
+        prefix += my_id.bit(prefix.size()) ? '0' : '1';
+        rt.try_add_node({ from_bitstr(prefix), endpoint("192.168.0.1", 5000 + i % 1000) }, true);
+    }
+
+    vector<NodeContact> nodes;
+
+    for (auto& b : rt._buckets) {
+        for (size_t i = 0; i < b.nodes.size(); ++i) {
+            nodes.push_back(b.nodes.contact(i));
+        }
+    }
+
+    BOOST_REQUIRE_GT(rt._buckets.size(), 8u);
+
+    for (size_t i = 0; i < 100; ++i) {
+        // Also look for targets close to us.
+        NodeID target = i % 2 ? NodeID::Range::max().random_id()
+                              : from_bitstr(my_id.to_bitstr().substr(0, rand() % 32));
+
+        for (size_t count : { size_t(1), BUCKET_SIZE, 3 * BUCKET_SIZE, nodes.size() + 1 }) {
+            auto expected = closest_first(target, nodes);
+            if (expected.size() > count) expected.resize(count);
+
+            BOOST_REQUIRE_EQUAL(rt.find_closest_routing_nodes(target, count), expected);
         }
     }
 }
@@ -0,0 +1,80 @@
+#define BOOST_TEST_MODULE rtt_estimator
+#include <boost/test/unit_test.hpp>
+
+#include <bittorrent/rtt_estimator.h>
+
+BOOST_AUTO_TEST_SUITE(ouinet_rtt_estimator)
+
+using namespace std::chrono_literals;
+using ouinet::bittorrent::RttEstimator;
+
+BOOST_AUTO_TEST_CASE(test_defaults) {
+    RttEstimator e;
+
+    BOOST_REQUIRE(!e.has_samples());
+    BOOST_REQUIRE(e.expected() == RttEstimator::default_expected);
+    BOOST_REQUIRE(e.timeout() == RttEstimator::default_timeout);
+}
+
+BOOST_AUTO_TEST_CASE(test_stable_rtt) {
+    RttEstimator e;
+
+    for (int i = 0; i != 20; ++i) e.add_reply_time(100ms);
+
+    // The deviation vanishes, so timeouts approach the round trip time
+    // (but never go below the minimum).
+    BOOST_REQUIRE(e.has_samples());
+    BOOST_REQUIRE(e.expected() >= 100ms);
+    BOOST_REQUIRE(e.expected() < 110ms);
+    BOOST_REQUIRE(e.timeout() == RttEstimator::min_timeout);
+}
+
+BOOST_AUTO_TEST_CASE(test_varying_rtt) {
+    RttEstimator e;
+
+    for (int i = 0; i != 20; ++i) e.add_reply_time(i % 2 ? 200ms : 600ms);
+
+    BOOST_REQUIRE(e.expected() > 600ms);
+    BOOST_REQUIRE(e.timeout() > e.expected());
+    BOOST_REQUIRE(e.timeout() < RttEstimator::default_timeout);
+}
+
+BOOST_AUTO_TEST_CASE(test_backoff) {
+    RttEstimator e;
+
+    e.add_reply_time(1s);
+    auto t = e.timeout();
+
+    e.add_timeout();
+    BOOST_REQUIRE(e.timeout() == 2 * t);
+
+    for (int i = 0; i != 10; ++i) e.add_timeout();
+    BOOST_REQUIRE(e.timeout() == RttEstimator::max_timeout);
+    BOOST_REQUIRE(e.expected() <= e.timeout());
+
+    // A reply resets the backoff.
+    e.add_reply_time(1s);
+    BOOST_REQUIRE(e.timeout() < RttEstimator::max_timeout);
+}
+
+BOOST_AUTO_TEST_CASE(test_backoff_below_min_timeout) {
+    RttEstimator e;
+
+    for (int i = 0; i != 20; ++i) e.add_reply_time(20ms);
+    BOOST_REQUIRE(e.timeout() == RttEstimator::min_timeout);
+
+    // Every timeout counts, even if the estimate is below the minimum.
+    e.add_timeout();
+    BOOST_REQUIRE(e.timeout() == 2 * RttEstimator::min_timeout);
+    e.add_timeout();
+    BOOST_REQUIRE(e.timeout() == 4 * RttEstimator::min_timeout);
+
+    // The backoff is bounded, so a reply after many timeouts resets it.
+    for (int i = 0; i != 100; ++i) e.add_timeout();
+    BOOST_REQUIRE(e.timeout() == RttEstimator::max_timeout);
+
+    e.add_reply_time(20ms);
+    BOOST_REQUIRE(e.timeout() == RttEstimator::min_timeout);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -10,6 +10,7 @@
 #include <task.h>
 #include <defer.h>
 #include <iostream>
+#include <vector>
 
 BOOST_AUTO_TEST_SUITE(ouinet_scheduler)
 
@@ -58,6 +59,43 @@ BOOST_AUTO_TEST_CASE(test_scheduler) {
     ctx.run();
 }
 
+// Jobs get their slots in the order in which they started waiting for them,
+// e.g. so that peers are contacted in order of preference.
+BOOST_AUTO_TEST_CASE(test_scheduler_order) {
+    asio::io_context ctx;
+    auto exec = ctx.get_executor();
+
+    Scheduler scheduler(ctx, 2);
+
+    std::vector<unsigned> started;
+    unsigned run_count = 0;
+
+    for (unsigned i = 0; i < 10; ++i) {
+        task::spawn_detached(exec, [&exec, &scheduler, &started, &run_count, i](auto yield) {
+            sys::error_code ec;
+            auto slot = scheduler.wait_for_slot(yield[ec]);
+            BOOST_REQUIRE(!ec);
+
+            started.push_back(i);
+            ++run_count;
+            auto on_exit = defer([&] { --run_count; });
+
+            BOOST_REQUIRE(run_count <= scheduler.max_running_jobs());
+
+            // Later jobs finish earlier, which should not alter the order.
+            Timer timer(exec);
+            timer.expires_after(chrono::milliseconds(10 * (10 - i)));
+            timer.async_wait(yield[ec]);
+        });
+    }
+
+    ctx.run();
+
+    BOOST_REQUIRE_EQUAL(started.size(), 10u);
+    for (unsigned i = 0; i < started.size(); ++i)
+        BOOST_CHECK_EQUAL(started[i], i);
+}
+
 BOOST_AUTO_TEST_CASE(test_scheduler_cancel) {
     asio::io_context ctx;
     auto exec = ctx.get_executor();
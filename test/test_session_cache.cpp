@@ -0,0 +1,138 @@
+#define BOOST_TEST_MODULE session_cache
+#include <boost/test/unit_test.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/spawn.hpp>
+#include <boost/beast/http.hpp>
+
+#include <ssl/session_cache.h>
+#include <ssl/util.h>
+#include <task.h>
+#include "util/http_server.h"
+#include "util/test_dir.h"
+#include "util/unwrap.h"
+
+#include <namespaces.h>
+
+namespace utf = boost::unit_test;
+
+BOOST_AUTO_TEST_SUITE(ouinet_session_cache, * utf::timeout(20))
+
+using namespace std;
+using namespace std::chrono_literals;
+using namespace ouinet;
+using tcp = asio::ip::tcp;
+
+static asio::ssl::context client_ssl_context_for(const HttpServer& server) {
+    asio::ssl::context ctx{asio::ssl::context::tls_client};
+
+    ctx.load_verify_file(server.certificate_path().string());
+    ctx.set_verify_mode(asio::ssl::verify_peer);
+
+    return ctx;
+}
+
+// Get a resource over a new connection, so that the client gets
+// session tickets which are sent after the handshake.
+static string fetch( const HttpServer& server
+                   , asio::ssl::context& ctx
+                   , const string& session_key
+                   , Async yield) {
+    tcp::socket socket(yield.get_executor());
+    unwrap(socket.async_connect(server.local_endpoint(), yield));
+
+    auto con = unwrap(ssl::util::client_handshake( std::move(socket), ctx
+                                                 , server.host(), session_key
+                                                 , yield));
+
+    http::request<http::string_body> rq{http::verb::get, "/", 11};
+    rq.set(http::field::host, server.authority());
+    rq.keep_alive(false);
+    unwrap(http::async_write(con, rq, yield));
+
+    beast::flat_buffer buffer;
+    http::response<http::string_body> rs;
+    unwrap(http::async_read(con, buffer, rs, yield));
+
+    return rs.body();
+}
+
+static void run_spawned(std::function<void(Async)> f) {
+    asio::io_context ctx;
+
+    task::spawn_detached(ctx.get_executor(), [f = std::move(f)] (auto yield) {
+            try {
+                f(Async(yield));
+            }
+            catch (const std::exception& e) {
+                BOOST_ERROR(string("Test ended with exception: ") + e.what());
+            }
+        });
+
+    ctx.run();
+}
+
+BOOST_AUTO_TEST_CASE(test_resume) {
+    run_spawned([&] (Async yield) {
+        TestDir root;
+        HttpServer server(yield.get_executor(), root.path());
+        server.add_resource("/", "hello");
+
+        auto ctx = client_ssl_context_for(server);
+        auto& cache = ssl::SessionCache::attach(ctx, 16, 1h);
+        BOOST_REQUIRE_EQUAL(ssl::SessionCache::find(ctx.native_handle()), &cache);
+
+        BOOST_REQUIRE_EQUAL(fetch(server, ctx, "a", yield), "hello");
+        auto s = cache.stats();
+        BOOST_REQUIRE_EQUAL(s.full_handshakes, 1u);
+        BOOST_REQUIRE_EQUAL(s.resumed_handshakes, 0u);
+        BOOST_REQUIRE_EQUAL(s.sessions, 1u);
+
+        size_t resumed = 0;
+        cache.on_handshake([&] (bool r) { if (r) ++resumed; });
+
+        BOOST_REQUIRE_EQUAL(fetch(server, ctx, "a", yield), "hello");
+        BOOST_REQUIRE_EQUAL(cache.stats().resumed_handshakes, 1u);
+        BOOST_REQUIRE_EQUAL(resumed, 1u);
+
+        // Sessions are not shared between keys.
+        fetch(server, ctx, "b", yield);
+        s = cache.stats();
+        BOOST_REQUIRE_EQUAL(s.full_handshakes, 2u);
+        BOOST_REQUIRE_EQUAL(s.sessions, 2u);
+
+        // Nor stored without a key.
+        fetch(server, ctx, "", yield);
+        fetch(server, ctx, "", yield);
+        BOOST_REQUIRE_EQUAL(cache.stats().full_handshakes, 4u);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(test_limits) {
+    run_spawned([&] (Async yield) {
+        TestDir root;
+        HttpServer server(yield.get_executor(), root.path());
+        server.add_resource("/", "hello");
+
+        auto ctx = client_ssl_context_for(server);
+        auto& cache = ssl::SessionCache::attach(ctx, 1, 1h);
+
+        // The session for "a" is dropped to keep the one for "b".
+        fetch(server, ctx, "a", yield);
+        fetch(server, ctx, "b", yield);
+        BOOST_REQUIRE_EQUAL(cache.stats().sessions, 1u);
+
+        fetch(server, ctx, "a", yield);
+        BOOST_REQUIRE_EQUAL(cache.stats().full_handshakes, 3u);
+
+        // Expired sessions are not resumed.
+        auto& expiring = ssl::SessionCache::attach(ctx, 16, 0s);
+        fetch(server, ctx, "a", yield);
+        fetch(server, ctx, "a", yield);
+        BOOST_REQUIRE_EQUAL(expiring.stats().resumed_handshakes, 0u);
+        BOOST_REQUIRE_EQUAL(expiring.stats().full_handshakes, 2u);
+    });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,234 @@
+#define BOOST_TEST_MODULE store_index
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+
+#include <boost/filesystem.hpp>
+
+#include <cache/store_index.h>
+#include <cache/store_journal.h>
+
+BOOST_AUTO_TEST_SUITE(ouinet_store_index)
+
+using namespace std;
+using namespace ouinet::cache;
+
+using Policy = StoreIndex::Policy;
+
+namespace fs = boost::filesystem;
+
+static ResourceId rid(const string& url)
+{
+    return ResourceId::from_url(url);
+}
+
+static const auto a = rid("https://example.com/a");
+static const auto b = rid("https://example.com/b");
+static const auto c = rid("https://example.com/c");
+
+BOOST_AUTO_TEST_CASE(test_insert_erase) {
+    StoreIndex index;
+
+    index.insert(a, {.size = 100, .injected = 1000, .accessed = 2000});
+    index.insert(b, {.size = 200, .injected = 1000, .accessed = 2000});
+    BOOST_REQUIRE_EQUAL(index.size(), 2u);
+    BOOST_REQUIRE_EQUAL(index.total_size(), 300u);
+
+    // Replacing an entry updates its size.
+    index.insert(a, {.size = 50, .injected = 1500, .accessed = 2100});
+    BOOST_REQUIRE_EQUAL(index.size(), 2u);
+    BOOST_REQUIRE_EQUAL(index.total_size(), 250u);
+    BOOST_REQUIRE(index.find(a));
+    BOOST_REQUIRE_EQUAL(index.find(a)->injected, 1500);
+
+    BOOST_REQUIRE(index.erase(b));
+    BOOST_REQUIRE(!index.erase(b));
+    BOOST_REQUIRE(!index.find(b));
+    BOOST_REQUIRE(!index.touch(b));
+    BOOST_REQUIRE_EQUAL(index.total_size(), 50u);
+}
+
+BOOST_AUTO_TEST_CASE(test_lru_victims) {
+    StoreIndex index(Policy::lru);
+
+    index.insert(a, {.size = 100, .accessed = 1000});
+    index.insert(b, {.size = 100, .accessed = 1000});  // same second, but inserted later
+    index.insert(c, {.size = 100, .accessed = 1001});
+
+    BOOST_REQUIRE(index.victims(300, {}).empty());
+    BOOST_REQUIRE(index.victims(200, {}) == vector<ResourceId>({a}));
+    BOOST_REQUIRE(index.victims(150, {}) == vector<ResourceId>({a, b}));
+
+    // Accessing `a` makes it the most recently used one.
+    BOOST_REQUIRE(index.touch(a, 1002));
+    BOOST_REQUIRE(index.victims(150, {}) == vector<ResourceId>({b, c}));
+
+    // Entries to keep are skipped.
+    auto keep_b = [&] (const ResourceId& r) { return r == b; };
+    BOOST_REQUIRE(index.victims(150, keep_b) == vector<ResourceId>({c, a}));
+    BOOST_REQUIRE(index.victims(0, keep_b) == vector<ResourceId>({c, a}));
+
+    // Nothing was actually removed.
+    BOOST_REQUIRE_EQUAL(index.total_size(), 300u);
+}
+
+BOOST_AUTO_TEST_CASE(test_lfu_victims) {
+    StoreIndex index(Policy::lfu);
+
+    index.insert(a, {.size = 100, .accessed = 1000});
+    index.insert(b, {.size = 100, .accessed = 1001});
+    index.insert(c, {.size = 100, .accessed = 1002});
+
+    index.touch(a, 1003);
+    index.touch(a, 1004);
+    index.touch(c, 1005);
+
+    // `b` was accessed least, then `c`, then `a`.
+    BOOST_REQUIRE(index.victims(0, {}) == vector<ResourceId>({b, c, a}));
+
+    // Replacing an entry keeps its accesses.
+    index.insert(a, {.size = 100, .accessed = 1006});
+    BOOST_REQUIRE_EQUAL(index.find(a)->hits, 4u);
+    BOOST_REQUIRE(index.victims(0, {}) == vector<ResourceId>({b, c, a}));
+}
+
+BOOST_AUTO_TEST_CASE(test_injected_before) {
+    StoreIndex index;
+
+    index.insert(a, {.size = 100, .injected = 1000});
+    index.insert(b, {.size = 100, .injected = 2000});
+    index.insert(c, {.size = 100, .injected = 0});  // unknown injection time
+
+    auto old = index.injected_before(1500);
+    BOOST_REQUIRE_EQUAL(old.size(), 2u);
+    BOOST_REQUIRE(std::find(old.begin(), old.end(), a) != old.end());
+    BOOST_REQUIRE(std::find(old.begin(), old.end(), c) != old.end());
+}
+
+BOOST_AUTO_TEST_CASE(test_parse_policy) {
+    BOOST_REQUIRE(parse_eviction_policy("lru") == Policy::lru);
+    BOOST_REQUIRE(parse_eviction_policy("lfu") == Policy::lfu);
+    BOOST_REQUIRE(!parse_eviction_policy("fifo"));
+}
+
+static fs::path temp_journal_path()
+{
+    auto dir = fs::temp_directory_path() / fs::unique_path();
+    fs::create_directories(dir);
+    return dir / "store-index";
+}
+
+BOOST_AUTO_TEST_CASE(test_journal) {
+    auto path = temp_journal_path();
+
+    StoreJournal::State state0;
+    state0.entries[a] = {.size = 100, .body_size = 80, .complete = true, .injected = 1000, .expires = 1600, .accessed = 2000, .hits = 3};
+    state0.entries[b] = {.size = 200, .body_size = 10, .complete = false, .injected = 1001, .accessed = 2001, .hits = 1};
+    state0.groups["example.com/a"] = {a};
+
+    {
+        auto journal = StoreJournal::create(path, 42, state0);
+        BOOST_REQUIRE(journal);
+
+        StoreIndex index;
+        for (auto& [rid, e] : state0.entries) index.restore(rid, e);
+        index.set_journal(journal->get());
+
+        index.touch(a, 3000);
+        index.erase(b);
+        index.insert(c, {.size = 300, .injected = 1002, .accessed = 2002});
+        (*journal)->add_item("example.com/c", c);
+        (*journal)->add_item("example.com/b", b);
+        (*journal)->remove_item("example.com/b", b);
+    }
+
+    auto state1 = StoreJournal::load(path, 42);
+    BOOST_REQUIRE(state1);
+    BOOST_REQUIRE(!state1->unclean);
+    BOOST_REQUIRE_EQUAL(state1->entries.size(), 2u);
+    BOOST_REQUIRE_EQUAL(state1->entries[a].accessed, 3000);
+    BOOST_REQUIRE_EQUAL(state1->entries[a].hits, 4u);
+    BOOST_REQUIRE_EQUAL(state1->entries[a].body_size, 80u);
+    BOOST_REQUIRE(state1->entries[a].complete);
+    BOOST_REQUIRE_EQUAL(state1->entries[a].expires, 1600);
+    BOOST_REQUIRE_EQUAL(state1->entries[c].size, 300u);
+    BOOST_REQUIRE(state1->entries.find(b) == state1->entries.end());
+    BOOST_REQUIRE_EQUAL(state1->groups.size(), 2u);
+    BOOST_REQUIRE(state1->groups["example.com/c"] == set<ResourceId>({c}));
+
+    // A different tag invalidates the journal.
+    auto state2 = StoreJournal::load(path, 43);
+    BOOST_REQUIRE(!state2);
+    BOOST_REQUIRE_EQUAL(state2.error(), boost::system::errc::wrong_protocol_type);
+
+    // A truncated last record is ignored.
+    auto size = fs::file_size(path);
+    fs::resize_file(path, size - 1);
+    auto state3 = StoreJournal::load(path, 42);
+    BOOST_REQUIRE(state3);
+    BOOST_REQUIRE(state3->unclean);
+    BOOST_REQUIRE_EQUAL(state3->groups.size(), 3u);  // `b` still in its group
+
+    // Corruption of a record is detected.
+    {
+        fs::fstream f(path, ios::in | ios::out | ios::binary);
+        f.seekp(20);
+        f.put('\xff');
+    }
+    auto state4 = StoreJournal::load(path, 42);
+    BOOST_REQUIRE(!state4);
+    BOOST_REQUIRE_EQUAL(state4.error(), boost::system::errc::bad_message);
+
+    fs::remove_all(path.parent_path());
+}
+
+BOOST_AUTO_TEST_CASE(test_journal_flush) {
+    auto path = temp_journal_path();
+
+    StoreJournal::State state0;
+    state0.entries[a] = {.size = 100, .accessed = 2000, .hits = 1};
+
+    auto journal = StoreJournal::create(path, 42, state0);
+    BOOST_REQUIRE(journal);
+    auto snapshot_size = fs::file_size(path);
+
+    // Loading an open journal is like loading it after a crash.
+    auto state0_open = StoreJournal::load(path, 42);
+    BOOST_REQUIRE(state0_open);
+    BOOST_REQUIRE(state0_open->unclean);
+
+    // Accesses are not written right away.
+    (*journal)->touch(a, 3000);
+    (*journal)->touch(a, 3001);
+    BOOST_REQUIRE_EQUAL(fs::file_size(path), snapshot_size);
+
+    (*journal)->flush();
+    BOOST_REQUIRE_GT(fs::file_size(path), snapshot_size);
+
+    auto state1 = StoreJournal::load(path, 42);
+    BOOST_REQUIRE(state1);
+    BOOST_REQUIRE_EQUAL(state1->entries[a].accessed, 3001);
+    BOOST_REQUIRE_EQUAL(state1->entries[a].hits, 3u);
+
+    // Many accesses are written without waiting for a flush.
+    for (int i = 0; i < 10000; ++i) (*journal)->touch(a, 4000 + i);
+    auto state2 = StoreJournal::load(path, 42);
+    BOOST_REQUIRE(state2);
+    BOOST_REQUIRE_GT(state2->entries[a].accessed, 4000);
+
+    // Other changes are written right away (along with pending accesses).
+    (*journal)->touch(a, 20000);
+    (*journal)->erase(a);
+    auto state3 = StoreJournal::load(path, 42);
+    BOOST_REQUIRE(state3);
+    BOOST_REQUIRE(state3->entries.empty());
+
+    journal->reset();
+    auto state4 = StoreJournal::load(path, 42);
+    BOOST_REQUIRE(state4);
+    BOOST_REQUIRE(!state4->unclean);
+
+    fs::remove_all(path.parent_path());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,196 @@
+#define BOOST_TEST_MODULE swarm_peer_cache
+#include <boost/test/unit_test.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include <chrono>
+#include <fstream>
+
+#include <async_sleep.h>
+#include <bittorrent/mock_dht.h>
+#include <cache/dht_lookup.h>
+#include <cache/swarm_peer_cache.h>
+#include <defer.h>
+#include <task.h>
+#include <util/hash.h>
+#include <namespaces.h>
+#include "util/unwrap.h"
+
+namespace utf = boost::unit_test;
+
+BOOST_AUTO_TEST_SUITE(ouinet_swarm_peer_cache, * utf::timeout(20))
+
+using namespace std;
+using namespace std::chrono_literals;
+using namespace ouinet;
+using namespace ouinet::cache;
+
+using bittorrent::MockDht;
+using bittorrent::NodeID;
+using udp = asio::ip::udp;
+using Peers = SwarmPeerCache::Peers;
+
+static const string swarm_name = "swarm-peer-cache-test";
+
+static udp::endpoint endpoint(const string& ip, uint16_t port)
+{
+    return udp::endpoint(asio::ip::make_address(ip), port);
+}
+
+static NodeID infohash(const string& name)
+{
+    return util::sha1_digest(name);
+}
+
+static fs::path temp_path()
+{
+    return fs::temp_directory_path()
+         / fs::unique_path("ouinet-swarm-peer-cache-test-%%%%-%%%%");
+}
+
+static void run_spawned(std::function<void(Async)> f) {
+    asio::io_context ctx;
+
+    task::spawn_detached(ctx.get_executor(), [f = std::move(f)] (auto yield) {
+            try {
+                f(Async(yield));
+            }
+            catch (const std::exception& e) {
+                BOOST_ERROR(string("Test ended with exception: ") + e.what());
+            }
+        });
+
+    ctx.run();
+}
+
+// A DHT which takes a while to find peers, as one which is still bootstrapping.
+class SlowDht : public MockDht {
+public:
+    using Duration = chrono::steady_clock::duration;
+
+    SlowDht(Executor exec, shared_ptr<Swarms> swarms, Duration delay)
+        : MockDht("slow", std::move(exec), std::move(swarms))
+        , _delay(delay)
+    {}
+
+    std::expected<std::set<UdpEndpoint>, sys::error_code>
+    tracker_get_peers(NodeID infohash, Async yield) override {
+        async_sleep(_delay, yield);
+        return MockDht::tracker_get_peers(infohash, yield);
+    }
+
+private:
+    Duration _delay;
+};
+
+BOOST_AUTO_TEST_CASE(test_store_load) {
+    auto path = temp_path();
+    auto on_exit = ouinet::defer([&] { fs::remove(path); });
+
+    auto now = SwarmPeerCache::Clock::now();
+    Peers peers1{endpoint("192.0.2.1", 1001), endpoint("2001:db8::1", 1002)};
+    Peers peers2{endpoint("192.0.2.2", 2001)};
+
+    {
+        SwarmPeerCache cache(path, 30min);
+        cache.put(infohash("fresh"), peers1, now - 10min);
+        cache.put(infohash("old"), peers2, now - 40min);
+        cache.put(infohash("empty"), {}, now);
+
+        BOOST_REQUIRE_EQUAL(cache.size(), 2);
+        BOOST_REQUIRE(!cache.get(infohash("old")));
+        BOOST_REQUIRE(!cache.get(infohash("empty")));
+        run_spawned([&] (Async yield) { unwrap(cache.store(yield)); });
+    }
+
+    SwarmPeerCache cache(path, 30min);
+    unwrap(cache.load());
+
+    // Expired entries are not stored.
+    BOOST_REQUIRE_EQUAL(cache.size(), 1);
+
+    auto e = cache.get(infohash("fresh"));
+    BOOST_REQUIRE(e);
+    BOOST_REQUIRE(e->peers == peers1);
+    BOOST_REQUIRE(chrono::abs(e->found - (now - 10min)) < 1s);
+
+    // With a shorter TTL it has expired.
+    SwarmPeerCache short_cache(path, 5min);
+    unwrap(short_cache.load());
+    BOOST_REQUIRE_EQUAL(short_cache.size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(test_load_errors) {
+    auto path = temp_path();
+    auto on_exit = ouinet::defer([&] { fs::remove(path); });
+
+    SwarmPeerCache cache(path, 30min);
+
+    auto r1 = cache.load();
+    BOOST_REQUIRE(!r1);
+    BOOST_REQUIRE_EQUAL(r1.error(), sys::errc::no_such_file_or_directory);
+
+    std::ofstream(path.string()) << "ouinet-swarm-peers 0\n";
+
+    auto r2 = cache.load();
+    BOOST_REQUIRE(!r2);
+    BOOST_REQUIRE_EQUAL(r2.error(), sys::errc::wrong_protocol_type);
+}
+
+// Measure how long it takes to get peers for a swarm
+// (from the DHT before and from the cache after a restart).
+BOOST_AUTO_TEST_CASE(test_first_hit_after_restart) {
+    using Clock = chrono::steady_clock;
+
+    auto path = temp_path();
+    auto on_exit = ouinet::defer([&] { fs::remove(path); });
+
+    const auto dht_delay = 1s;
+
+    run_spawned([&] (Async yield) {
+        auto swarms = make_shared<MockDht::Swarms>();
+
+        auto seeder = make_shared<MockDht>("seeder", yield.get_executor(), swarms);
+        seeder->set_endpoints({endpoint("192.0.2.1", 1234)});
+        unwrap(seeder->tracker_announce(infohash(swarm_name), std::nullopt, yield));
+
+        auto dht = make_shared<SlowDht>(yield.get_executor(), swarms, dht_delay);
+
+        Peers peers;
+
+        {
+            auto cache = make_shared<SwarmPeerCache>(path, 30min);
+            DhtLookup lookup(dht, swarm_name, cache);
+
+            auto start = Clock::now();
+            peers = unwrap(lookup.get(yield));
+            auto took = Clock::now() - start;
+
+            BOOST_TEST_MESSAGE("First hit without cached peers: "
+                               << chrono::duration_cast<chrono::milliseconds>(took).count() << "ms");
+            BOOST_REQUIRE(took >= dht_delay);
+            BOOST_REQUIRE(!peers.empty());
+
+            unwrap(cache->store(yield));
+        }
+
+        // Restart.
+        {
+            auto cache = make_shared<SwarmPeerCache>(path, 30min);
+            unwrap(cache->load());
+            DhtLookup lookup(dht, swarm_name, cache);
+
+            auto start = Clock::now();
+            auto cached_peers = unwrap(lookup.get(yield));
+            auto took = Clock::now() - start;
+
+            BOOST_TEST_MESSAGE("First hit with cached peers: "
+                               << chrono::duration_cast<chrono::milliseconds>(took).count() << "ms");
+            BOOST_REQUIRE(took < dht_delay / 10);
+            BOOST_REQUIRE(cached_peers == peers);
+        }
+    });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
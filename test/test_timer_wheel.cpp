@@ -0,0 +1,101 @@
+#define BOOST_TEST_MODULE timer_wheel
+#include <boost/test/unit_test.hpp>
+
+#include <util/timer_wheel.h>
+
+BOOST_AUTO_TEST_SUITE(ouinet_timer_wheel)
+
+using namespace std;
+using namespace std::chrono_literals;
+
+using Clock = chrono::steady_clock;
+using Wheel = ouinet::util::TimerWheel<int>;
+
+static vector<int> expire(Wheel& wheel, Clock::time_point now)
+{
+    vector<int> ret;
+    wheel.expire(now, ret);
+    sort(ret.begin(), ret.end());
+    return ret;
+}
+
+BOOST_AUTO_TEST_CASE(test_expire) {
+    auto start = Clock::now();
+    Wheel wheel(1s, 8, start);
+
+    wheel.schedule(start + 3s, 3);
+    wheel.schedule(start + 1500ms, 1);
+    wheel.schedule(start + 2s, 2);
+    BOOST_REQUIRE_EQUAL(wheel.size(), 3);
+    BOOST_REQUIRE(wheel.next_expiry() == start + 2s);
+
+    // Not before their time...
+    BOOST_REQUIRE(expire(wheel, start + 1900ms).empty());
+    // ...and at most one tick after it.
+    BOOST_REQUIRE(expire(wheel, start + 2s) == (vector<int>{1, 2}));
+    BOOST_REQUIRE(wheel.next_expiry() == start + 3s);
+    BOOST_REQUIRE(expire(wheel, start + 3500ms) == vector<int>{3});
+
+    BOOST_REQUIRE(wheel.empty());
+    BOOST_REQUIRE(!wheel.next_expiry());
+}
+
+BOOST_AUTO_TEST_CASE(test_already_due) {
+    auto start = Clock::now();
+    Wheel wheel(1s, 8, start);
+
+    BOOST_REQUIRE(expire(wheel, start + 5s).empty());
+
+    // Scheduled for a time which has already been expired.
+    wheel.schedule(start + 2s, 1);
+    wheel.schedule(start + 5s, 2);
+    BOOST_REQUIRE(wheel.next_expiry() == start + 5s);
+    BOOST_REQUIRE(expire(wheel, start + 5s) == (vector<int>{1, 2}));
+}
+
+BOOST_AUTO_TEST_CASE(test_several_turns) {
+    auto start = Clock::now();
+    Wheel wheel(1s, 4, start);
+
+    // Same slot, different turns.
+    wheel.schedule(start + 2s, 1);
+    wheel.schedule(start + 6s, 2);
+    wheel.schedule(start + 14s, 3);
+
+    BOOST_REQUIRE(expire(wheel, start + 3s) == vector<int>{1});
+    BOOST_REQUIRE(wheel.next_expiry() == start + 6s);
+    BOOST_REQUIRE(expire(wheel, start + 5s).empty());
+
+    // Jumping several turns at once.
+    wheel.schedule(start + 7s, 4);
+    BOOST_REQUIRE(expire(wheel, start + 13s) == (vector<int>{2, 4}));
+    BOOST_REQUIRE(wheel.next_expiry() == start + 14s);
+    BOOST_REQUIRE(expire(wheel, start + 20s) == vector<int>{3});
+    BOOST_REQUIRE(wheel.empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_many) {
+    auto start = Clock::now();
+    Wheel wheel(1s, 16, start);
+
+    for (int i = 0; i != 1000; ++i) {
+        wheel.schedule(start + chrono::milliseconds(i * 37 % 60000), i);
+    }
+
+    size_t expired = 0;
+    for (auto t = 0s; t <= 60s; t += 1s) {
+        vector<int> out;
+        wheel.expire(start + t, out);
+        for (auto i : out) {
+            auto at = chrono::milliseconds(i * 37 % 60000);
+            BOOST_REQUIRE(at <= t);
+            BOOST_REQUIRE(t - at < 1s);
+        }
+        expired += out.size();
+    }
+
+    BOOST_REQUIRE_EQUAL(expired, 1000);
+    BOOST_REQUIRE(wheel.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()